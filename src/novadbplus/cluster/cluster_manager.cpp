@@ -5193,6 +5193,13 @@ uint64_t ClusterManager::countKeysInSlot(uint32_t slot) {
     return 0;
   }
   auto kvstore = std::move(expdb.value().store);
+  if (kvstore->isKeyCountReady()) {
+    auto count = kvstore->getChunkKeyCount(slot);
+    if (count.ok()) {
+      return count.value();
+    }
+    LOG(ERROR) << "getChunkKeyCount failed:" << count.status().toString();
+  }
   auto ptxn = kvstore->createTransaction(nullptr);
   if (!ptxn.ok()) {
     LOG_STATUS(ptxn.status());
@@ -4,6 +4,8 @@
 
 #include "novadbplus/cluster/migrate_batch.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <memory>
 #include <sstream>
@@ -12,6 +14,8 @@
 #include <utility>
 #include <vector>
 
+#include "lz4.h"
+
 #include "novadbplus/cluster/migrate_manager.h"
 #include "novadbplus/commands/command.h"
 
@@ -32,27 +36,53 @@ Status MigrateBatch::add(const std::string& key, const std::string& value) {
   easyCopy(&_buffer, &_addBytes, value.c_str(), valuelen);
 
   _counter++;
+  _batchCounter++;
   INVARIANT_D(_addBytes == _buffer.size());
   return {ErrorCodes::ERR_OK, ""};
 }
 
+// The batch is sent as one frame:
+//   "5" len(uint32) entries
+//   "7" compressedLen(uint32) len(uint32) lz4(entries)
+// the receiver doesn't reply, it only acks the end of each slot.
 Status MigrateBatch::send() {
   Status s;
   if (_addBytes > 0) {
-    SyncWriteData("5");
-    SyncWriteData(
-      std::string(reinterpret_cast<char*>(&_addBytes), sizeof(uint32_t)));
-    SyncWriteData(std::string(_buffer.begin(), _buffer.end()));
-    uint32_t sendBytes = _buffer.size() + 1 + sizeof(uint32_t);
+    INVARIANT_D(_addBytes == _buffer.size());
+    uint32_t rawLen = _addBytes;
+    _frame.clear();
+    if (_compress) {
+      int bound = LZ4_compressBound(rawLen);
+      const size_t headerLen = 1 + 2 * sizeof(uint32_t);
+      _frame.resize(headerLen + bound);
+      const char* raw = reinterpret_cast<const char*>(_buffer.data());
+      int n = LZ4_compress_default(raw, &_frame[headerLen], rawLen, bound);
+      if (n <= 0) {
+        return {ErrorCodes::ERR_INTERNAL, "lz4 compress failed"};
+      }
+      uint32_t compressedLen = n;
+      _frame[0] = '7';
+      memcpy(&_frame[1], &compressedLen, sizeof(uint32_t));
+      memcpy(&_frame[1 + sizeof(uint32_t)], &rawLen, sizeof(uint32_t));
+      _frame.resize(headerLen + compressedLen);
+    } else {
+      _frame.append("5");
+      _frame.append(reinterpret_cast<char*>(&rawLen), sizeof(uint32_t));
+      _frame.append(reinterpret_cast<const char*>(_buffer.data()), rawLen);
+    }
+    SyncWriteData(_frame);
+    uint32_t sendBytes = _frame.size();
 
     // Rate limit for migration
     _svr->getMigrateManager()->requestRateLimit(sendBytes);
+    _svr->getMigrateManager()->addSnapshotSendStat(
+      _batchCounter, rawLen, sendBytes);
 
-    INVARIANT_D(_addBytes == _buffer.size());
     _sentBytes += sendBytes;
 
     _buffer.clear();
     _addBytes = 0;
+    _batchCounter = 0;
     _sendCounter++;
   }
 
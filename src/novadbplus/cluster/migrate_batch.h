@@ -27,12 +27,15 @@ class MigrateBatch {
  public:
   explicit MigrateBatch(uint32_t maxBytes,
                         std::shared_ptr<BlockingTcpClient> client,
-                        std::shared_ptr<ServerEntry> svr)
+                        std::shared_ptr<ServerEntry> svr,
+                        bool compress = false)
     : _counter(0),
       _sendCounter(0),
+      _batchCounter(0),
       _maxBytes(maxBytes),
       _addBytes(0),
       _sentBytes(0),
+      _compress(compress),
       _client(client),
       _svr(svr) {
     _buffer.reserve(maxBytes);
@@ -51,12 +54,15 @@ class MigrateBatch {
  private:
   uint32_t _counter;      // Number of entries added
   uint32_t _sendCounter;  // Number of batch send to dest
+  uint32_t _batchCounter;  // Number of entries in _buffer
 
   uint32_t _maxBytes;   // Max bytes of bach
   size_t _addBytes;     // Number of bytes add
   uint32_t _sentBytes;  // Number of bytes sent to dest
+  bool _compress;       // Compress the batch by lz4
 
   std::vector<byte> _buffer;
+  std::string _frame;
 
   std::shared_ptr<BlockingTcpClient> _client;
   std::shared_ptr<ServerEntry> _svr;
@@ -720,6 +720,22 @@ bool MigrateManager::containSlot(const SlotsBitmap& smallMap,
   return true;
 }
 
+void MigrateManager::addSnapshotSendStat(uint64_t keys,
+                                         uint64_t bytes,
+                                         uint64_t wireBytes) {
+  _sendStat.keys.fetch_add(keys, std::memory_order_relaxed);
+  _sendStat.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  _sendStat.wireBytes.fetch_add(wireBytes, std::memory_order_relaxed);
+}
+
+void MigrateManager::addSnapshotRecvStat(uint64_t keys,
+                                         uint64_t bytes,
+                                         uint64_t wireBytes) {
+  _recvStat.keys.fetch_add(keys, std::memory_order_relaxed);
+  _recvStat.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  _recvStat.wireBytes.fetch_add(wireBytes, std::memory_order_relaxed);
+}
+
 void MigrateManager::requestRateLimit(uint64_t bytes) {
   /* *
    * Set migration rate limit periodically
@@ -1027,7 +1043,9 @@ void MigrateManager::dstReadyMigrate(asio::ip::tcp::socket sock,
                                      const std::string& slotsArg,
                                      const std::string& StoreidArg,
                                      const std::string& nodeidArg,
-                                     const std::string& taskidArg) {
+                                     const std::string& taskidArg,
+                                     bool sstMode,
+                                     bool compress) {
   std::shared_ptr<BlockingTcpClient> client =
     std::move(_svr->getNetwork()->createBlockingClient(std::move(sock),
                                                        64 * 1024 * 1024));
@@ -1073,6 +1091,8 @@ void MigrateManager::dstReadyMigrate(asio::ip::tcp::socket sock,
     _migrateSendTaskMap[taskidArg]->_sender->setClient(client);
     _migrateSendTaskMap[taskidArg]->_sender->setDstNode(nodeidArg);
     _migrateSendTaskMap[taskidArg]->_sender->setDstStoreid(dstStoreid);
+    _migrateSendTaskMap[taskidArg]->_sender->setSstMode(sstMode);
+    _migrateSendTaskMap[taskidArg]->_sender->setCompress(compress);
     _migrateSendTaskMap[taskidArg]->_sender->start();
     _migrateSendTaskMap[taskidArg]->setState(MigrateSendState::START);
     LOG(INFO) << "sender task marked start on taskid:" << taskidArg;
@@ -1607,7 +1627,7 @@ Expected<std::string> MigrateManager::getMigrateInfo() {
                           _failImportSlots.count())
     ? 1
     : 0;
-  commandLen += (isMigrating * 7 + isImporting * 7);
+  commandLen += (isMigrating * 8 + isImporting * 8);
 
   Command::fmtMultiBulkLen(ss, commandLen);
 
@@ -1642,6 +1662,21 @@ Expected<std::string> MigrateManager::getMigrateInfo() {
     Command::fmtBulk(ss, taskSizeInfo);
     Command::fmtBulk(ss, succcInfo);
     Command::fmtBulk(ss, failInfo);
+
+    int64_t binlogDelay = -1;
+    for (auto& iter : _migrateSendTaskMap) {
+      binlogDelay =
+        std::max(binlogDelay, iter.second->_sender->getBinlogDelay());
+    }
+    Command::fmtBulk(
+      ss,
+      "sender snapshot keys:" +
+        std::to_string(_sendStat.keys.load(std::memory_order_relaxed)) +
+        " bytes:" +
+        std::to_string(_sendStat.bytes.load(std::memory_order_relaxed)) +
+        " wire bytes:" +
+        std::to_string(_sendStat.wireBytes.load(std::memory_order_relaxed)) +
+        " max binlog delay:" + std::to_string(binlogDelay) + "ms");
   }
 
   if (isImporting) {
@@ -1675,6 +1710,14 @@ Expected<std::string> MigrateManager::getMigrateInfo() {
     Command::fmtBulk(ss, taskSizeInfo2);
     Command::fmtBulk(ss, succcInfo2);
     Command::fmtBulk(ss, failInfo2);
+    Command::fmtBulk(
+      ss,
+      "receiver snapshot keys:" +
+        std::to_string(_recvStat.keys.load(std::memory_order_relaxed)) +
+        " bytes:" +
+        std::to_string(_recvStat.bytes.load(std::memory_order_relaxed)) +
+        " wire bytes:" +
+        std::to_string(_recvStat.wireBytes.load(std::memory_order_relaxed)));
   }
 
   if (ss.str().size() == 0) {
@@ -195,7 +195,9 @@ class MigrateManager {
                        const std::string& chunkidArg,
                        const std::string& StoreidArg,
                        const std::string& nodeidArg,
-                       const std::string& taskidArg);
+                       const std::string& taskidArg,
+                       bool sstMode,
+                       bool compress);
 
   void dstPrepareMigrate(asio::ip::tcp::socket sock,
                          const std::string& chunkidArg,
@@ -261,6 +263,9 @@ class MigrateManager {
   Status onRestoreEnd(uint32_t storeId);
 
   void requestRateLimit(uint64_t bytes);
+  // bytes are counted before compression, wireBytes after it
+  void addSnapshotSendStat(uint64_t keys, uint64_t bytes, uint64_t wireBytes);
+  void addSnapshotRecvStat(uint64_t keys, uint64_t bytes, uint64_t wireBytes);
 
   void migrateSenderResize(size_t size);
   void migrateReceiverResize(size_t size);
@@ -356,6 +361,15 @@ class MigrateManager {
   // sender rate limiter
   std::unique_ptr<RateLimiter> _rateLimiter;
 
+  // snapshot stream counters, shown by getMigrateInfo()
+  struct SnapshotStat {
+    std::atomic<uint64_t> keys{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> wireBytes{0};
+  };
+  SnapshotStat _sendStat;
+  SnapshotStat _recvStat;
+
   // ptaskid map
   std::unordered_map<std::string, std::shared_ptr<pTask>> _importPtaskMap;
   std::unordered_map<std::string, std::shared_ptr<pTask>> _migratePtaskMap;
@@ -4,7 +4,14 @@
 
 #include "novadbplus/cluster/migrate_receiver.h"
 
+#include <algorithm>
+#include <fstream>
+
+#include "lz4.h"
+
 #include "novadbplus/commands/command.h"
+#include "novadbplus/utils/portable.h"
+#include "novadbplus/utils/scopeguard.h"
 
 namespace novadbplus {
 
@@ -20,26 +27,50 @@ ChunkMigrateReceiver::ChunkMigrateReceiver(
     _storeid(storeid),
     _taskid(taskid),
     _slots(slots),
+    _sstMode(false),
+    _batchTxnKeys(0),
     _snapshotKeyNum(0),
     _snapshotStartTime(0),
     _snapshotEndTime(0),
     _binlogEndTime(0),
     _taskStartTime(0) {}
 
-Status ChunkMigrateReceiver::receiveSingleBatch() {
+// see MigrateBatch::send() for the frame
+Status ChunkMigrateReceiver::receiveSingleBatch(bool compressed) {
   uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
   uint32_t receiveNum = 0;
   SyncReadData(batchPosData, 4, timeoutSec);
   uint32_t batchPos =
     *reinterpret_cast<const uint32_t*>(batchPosData.value().c_str());
+  uint32_t rawLen = batchPos;
+  if (compressed) {
+    SyncReadData(rawLenData, 4, timeoutSec);
+    rawLen = *reinterpret_cast<const uint32_t*>(rawLenData.value().c_str());
+    if (rawLen > LZ4_MAX_INPUT_SIZE) {
+      return {ErrorCodes::ERR_INTERNAL, "invalid batch size"};
+    }
+  }
 
   SyncReadData(writeBatchData, batchPos, timeoutSec);
   if (!writeBatchData.ok()) {
     return {ErrorCodes::ERR_TIMEOUT, "receive writeBatch data fail"};
   }
+  if (compressed) {
+    std::string raw(rawLen, '\0');
+    int n = LZ4_decompress_safe(writeBatchData.value().data(),
+                                &raw[0],
+                                writeBatchData.value().size(),
+                                rawLen);
+    if (n < 0 || static_cast<uint32_t>(n) != rawLen) {
+      return {ErrorCodes::ERR_INTERNAL, "lz4 decompress batch failed"};
+    }
+    writeBatchData.value().swap(raw);
+  }
 
   auto s = PutSingleBatch(writeBatchData.value(), &receiveNum);
   _snapshotKeyNum.fetch_add(receiveNum, std::memory_order_relaxed);
+  _svr->getMigrateManager()->addSnapshotRecvStat(
+    receiveNum, rawLen, batchPos + (compressed ? 9 : 5));
   TEST_SYNC_POINT_CALLBACK(
     "ChunkMigrateReceiver::receiveSingleBatch::receiveKeyNum", &receiveNum);
   RET_IF_ERR(s);
@@ -47,6 +78,145 @@ Status ChunkMigrateReceiver::receiveSingleBatch() {
   return {ErrorCodes::ERR_OK, ""};
 }
 
+// read filesize slot keynum and then the whole sst file, reply +OK
+// after the file is ingested and the ttl index of the slot is rebuilt, or
+// +STREAM if the store has slaves now. The sender then sends this slot and
+// the rest by batches.
+Status ChunkMigrateReceiver::receiveSstFile() {
+  uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
+  SyncReadData(headerData, 3 * sizeof(uint64_t), timeoutSec);
+  uint64_t header[3];
+  memcpy(header, headerData.value().data(), sizeof(header));
+  uint64_t remain = header[0];
+  uint64_t slot = header[1];
+  uint64_t keyNum = header[2];
+  if (!_sstMode || slot >= CLUSTER_SLOTS || !_slots.test(slot)) {
+    LOG(ERROR) << "receive unexpected sst file of slot:" << slot
+               << " taskid:" << _taskid;
+    return {ErrorCodes::ERR_INTERNAL, "slotid not match"};
+  }
+
+  PStore kvstore = _dbWithLock->store;
+  std::string dir = kvstore->migrateSstDir();
+  std::error_code ec;
+  filesystem::create_directories(dir, ec);
+  if (ec) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "create dir:" + dir + " failed:" + ec.message()};
+  }
+  std::string fname =
+    dir + "/" + _taskid + "_" + std::to_string(slot) + "_recv.sst";
+  // the file is moved into the db if it is ingested
+  auto guard = MakeGuard([&fname] {
+    std::error_code ec;
+    filesystem::remove(fname, ec);
+  });
+  {
+    auto myfile = std::fstream(fname, std::ios::out | std::ios::binary);
+    if (!myfile.is_open()) {
+      LOG(ERROR) << "open file:" << fname << " for write failed";
+      return {ErrorCodes::ERR_INTERNAL, "open file failed"};
+    }
+    while (remain) {
+      size_t batchSize = std::min(remain, static_cast<uint64_t>(1024 * 1024));
+      remain -= batchSize;
+      SyncReadData(fileData, batchSize, timeoutSec);
+      myfile.write(fileData.value().c_str(), fileData.value().size());
+      if (myfile.bad()) {
+        LOG(ERROR) << "write file:" << fname << " failed:" << strerror(errno);
+        return {ErrorCodes::ERR_INTERNAL, "write file failed"};
+      }
+    }
+  }
+
+  // the ingested records are not written into binlog, the slaves of the
+  // store would miss them.
+  auto replMgr = _svr->getReplManager();
+  Status s = replMgr->beginWriteWithoutBinlog(_storeid);
+  if (s.code() == ErrorCodes::ERR_BUSY) {
+    LOG(WARNING) << "store:" << _storeid << " has slaves, slot:" << slot
+                 << " and the rest are streamed, taskid:" << _taskid;
+    _sstMode = false;
+    return _client->writeLine("+STREAM");
+  } else if (!s.ok()) {
+    _client->writeLine("-ERR " + s.toString());
+    return s;
+  }
+  auto replGuard = MakeGuard([this, &replMgr] {
+    Status s = replMgr->endWriteWithoutBinlog(_storeid);
+    if (!s.ok()) {
+      LOG(ERROR) << "store:" << _storeid
+                 << " endWriteWithoutBinlog failed:" << s.toString();
+    }
+  });
+  // the block checksums of the file are verified before it is ingested
+  s = kvstore->ingestSstFiles({fname});
+  if (!s.ok()) {
+    _client->writeLine("-ERR " + s.toString());
+    return s;
+  }
+  s = rebuildTTLIndex(slot);
+  if (!s.ok()) {
+    _client->writeLine("-ERR " + s.toString());
+    return s;
+  }
+  // the ingested keys are not counted by any txn
+  s = kvstore->recountKeys(slot);
+  if (!s.ok()) {
+    _client->writeLine("-ERR " + s.toString());
+    return s;
+  }
+  _snapshotKeyNum.fetch_add(keyNum, std::memory_order_relaxed);
+  _svr->getMigrateManager()->addSnapshotRecvStat(keyNum, header[0], header[0]);
+  s = _client->writeLine("+OK");
+  RET_IF_ERR(s);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+// NOTE(takenliu) TTLIndex's chunkid is different from key's chunkid,
+// so need to recover TTLIndex for the meta records of the ingested slot.
+Status ChunkMigrateReceiver::rebuildTTLIndex(uint32_t slot) {
+  PStore kvstore = _dbWithLock->store;
+  auto eTxn = kvstore->createTransaction(nullptr);
+  RET_IF_ERR_EXPECTED(eTxn);
+  auto cursor = eTxn.value()->createSlotCursor(slot);
+  std::unique_ptr<Transaction> txn;
+  uint32_t batchNum = 0;
+  while (true) {
+    Expected<Record> expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    }
+    RET_IF_ERR_EXPECTED(expRcd);
+    const RecordKey& rk = expRcd.value().getRecordKey();
+    const RecordValue& rv = expRcd.value().getRecordValue();
+    if (rv.getTtl() == 0 || rv.getRecordType() == RecordType::RT_KV) {
+      continue;
+    }
+    if (!txn) {
+      auto ptxn = kvstore->createTransaction(nullptr);
+      RET_IF_ERR_EXPECTED(ptxn);
+      txn = std::move(ptxn.value());
+    }
+    TTLIndex n_ictx(
+      rk.getPrimaryKey(), rv.getRecordType(), rk.getDbId(), rv.getTtl());
+    auto s = txn->setKV(n_ictx.encode(),
+                        RecordValue(RecordType::RT_TTL_INDEX).encode());
+    RET_IF_ERR(s);
+    if (++batchNum >= 1000) {
+      auto commitStatus = txn->commit();
+      RET_IF_ERR_EXPECTED(commitStatus);
+      txn.reset();
+      batchNum = 0;
+    }
+  }
+  if (txn) {
+    auto commitStatus = txn->commit();
+    RET_IF_ERR_EXPECTED(commitStatus);
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Status ChunkMigrateReceiver::receiveSnapshot() {
   if (!isRunning()) {
     LOG(ERROR) << "stop receiver task on taskid:" << _taskid;
@@ -58,6 +228,17 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
   std::string bitmapStr = _slots.to_string();
   ss << "readymigrate " << bitmapStr << " " << _storeid << " " << nodename
      << " " << _taskid;
+  // NOTE: the ingested sst files are not written into binlog, the slaves
+  // of this store would miss them. A slave attached later makes the
+  // sender fall back to batches, see receiveSstFile()
+  _sstMode = _cfg->migrateSnapshotSst &&
+    !_svr->getReplManager()->hasSomeSlave(_storeid);
+  if (_sstMode) {
+    ss << " sst";
+  }
+  if (_cfg->migrateSnapshotCompress) {
+    ss << " lz4";
+  }
   Status s = _client->writeLine(ss.str());
   if (!s.ok()) {
     LOG(ERROR) << "readymigrate srcDb failed:" << s.toString();
@@ -80,6 +261,13 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
   setSnapShotStartTime(startTime);
   setTaskStartTime(startTime);
   uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
+  auto guard = MakeGuard([this] {
+    if (_batchTxn) {
+      _batchTxn->rollback();
+      _batchTxn.reset();
+      _batchTxnKeys = 0;
+    }
+  });
   while (true) {
     if (!isRunning()) {
       LOG(ERROR) << "stop receiver task on taskid:" << _taskid;
@@ -121,12 +309,22 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
     } else if (exptData.value()[0] == '1') {
       SyncWriteData("+OK")
     } else if (exptData.value()[0] == '2') {
+      s = commitBatchTxn();
+      RET_IF_ERR(s);
       SyncWriteData("+OK")
     } else if (exptData.value()[0] == '3') {
+      s = commitBatchTxn();
+      RET_IF_ERR(s);
       SyncWriteData("+OK") break;
     } else if (exptData.value()[0] == '5') {
       auto s = receiveSingleBatch();
       RET_IF_ERR(s);
+    } else if (exptData.value()[0] == '7') {
+      auto s = receiveSingleBatch(true);
+      RET_IF_ERR(s);
+    } else if (exptData.value()[0] == '6') {
+      auto s = receiveSstFile();
+      RET_IF_ERR(s);
     }
   }
   LOG(INFO) << "migrate snapshot transfer done, readnum:" << getSnapshotNum()
@@ -196,15 +394,29 @@ Status ChunkMigrateReceiver::supplySetKV(const std::string& key,
   return {ErrorCodes::ERR_OK, ""};
 }
 
+Status ChunkMigrateReceiver::commitBatchTxn() {
+  if (!_batchTxn) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  auto txn = std::move(_batchTxn);
+  _batchTxnKeys = 0;
+  auto commitStatus = txn->commit();
+  RET_IF_ERR_EXPECTED(commitStatus);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Status ChunkMigrateReceiver::PutSingleBatch(const std::string& migrateBatch,
                                             uint32_t* totalNum) {
   PStore kvstore = _dbWithLock->store;
-  auto eTxn = kvstore->createTransaction(nullptr);
-  if (!eTxn.ok()) {
-    LOG(ERROR) << "createTransaction failed:" << eTxn.status().toString();
-    return eTxn.status();
+  if (!_batchTxn) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    if (!eTxn.ok()) {
+      LOG(ERROR) << "createTransaction failed:" << eTxn.status().toString();
+      return eTxn.status();
+    }
+    _batchTxn = std::move(eTxn.value());
   }
-  std::unique_ptr<Transaction> txn = std::move(eTxn.value());
+  Transaction* txn = _batchTxn.get();
 
   size_t len = migrateBatch.length();
   size_t batchPos = 0;
@@ -245,7 +457,7 @@ Status ChunkMigrateReceiver::PutSingleBatch(const std::string& migrateBatch,
       return {ErrorCodes::ERR_INTERNAL, "slotid not match"};
     }
 
-    Status s = kvstore->setKV(expRk.value(), expRv.value(), txn.get());
+    Status s = kvstore->setKV(expRk.value(), expRv.value(), txn);
     RET_IF_ERR(s);
     // NOTE(takenliu) TTLIndex's chunkid is different from key's chunkid,
     // so need to recover TTLIndex.
@@ -268,12 +480,11 @@ Status ChunkMigrateReceiver::PutSingleBatch(const std::string& migrateBatch,
   }
   DLOG(INFO) << "supplyKVBatch "
              << "size:" << migrateBatch.size() << "content end";
-  auto commitStatus = txn->commit();
-  if (!commitStatus.ok()) {
-    return commitStatus.status();
-  }
-
   *totalNum += batchItem;
+  _batchTxnKeys += batchItem;
+  if (_batchTxnKeys >= BATCH_TXN_MAX_KEYS) {
+    return commitBatchTxn();
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -30,7 +30,8 @@ class ChunkMigrateReceiver {
                                 std::shared_ptr<ServerParams> cfg);
 
   Status receiveSnapshot();
-  Status receiveSingleBatch();
+  Status receiveSingleBatch(bool compressed = false);
+  Status receiveSstFile();
 
   void setDbWithLock(std::unique_ptr<DbWithLock> db) {
     _dbWithLock = std::move(db);
@@ -89,6 +90,8 @@ class ChunkMigrateReceiver {
  private:
   Status supplySetKV(const std::string& key, const std::string& value);
   Status PutSingleBatch(const std::string& writeBatch, uint32_t* totalNum);
+  Status commitBatchTxn();
+  Status rebuildTTLIndex(uint32_t slot);
   mutable std::mutex _mutex;
   std::shared_ptr<ServerEntry> _svr;
   const std::shared_ptr<ServerParams> _cfg;
@@ -98,6 +101,12 @@ class ChunkMigrateReceiver {
   uint32_t _storeid;
   std::string _taskid;
   std::bitset<CLUSTER_SLOTS> _slots;
+  bool _sstMode;
+  // the batches are written by one txn until it has BATCH_TXN_MAX_KEYS
+  // records or a slot is over
+  static constexpr uint32_t BATCH_TXN_MAX_KEYS = 4096;
+  std::unique_ptr<Transaction> _batchTxn;
+  uint32_t _batchTxnKeys;
   std::atomic<uint64_t> _snapshotKeyNum;
   std::atomic<uint64_t> _snapshotStartTime;
   std::atomic<uint64_t> _snapshotEndTime;
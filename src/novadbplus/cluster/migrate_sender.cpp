@@ -4,12 +4,22 @@
 
 #include "novadbplus/cluster/migrate_sender.h"
 
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include <algorithm>
 #include <utility>
 #include <vector>
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/replication/repl_util.h"
 #include "novadbplus/utils/invariant.h"
+#include "novadbplus/utils/portable.h"
+#include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/scopeguard.h"
 #include "novadbplus/utils/time.h"
 
@@ -45,6 +55,9 @@ ChunkMigrateSender::ChunkMigrateSender(const std::bitset<CLUSTER_SLOTS>& slots,
     _dstIp(""),
     _dstPort(0),
     _dstStoreid(0),
+    _sstMode(false),
+    _compress(false),
+    _unackedSlots(0),
     _dstNode(nullptr) {}
 
 Status ChunkMigrateSender::sendChunk() {
@@ -290,10 +303,8 @@ Status ChunkMigrateSender::sendRangeByBatch(Transaction* txn,
                                             uint32_t* totalNum) {
   // need add IS lock for chunks ???
   auto cursor = txn->createSlotsCursor(begin, end);
-  uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
-  Status s;
   MigrateBatch migratebatch(
-    _cfg->migrateSnapshotBatchSizeKB * 1024, _client, _svr);
+    _cfg->migrateSnapshotBatchSizeKB * 1024, _client, _svr, _compress);
   LOG(INFO) << "Migrate SendRange Batch begin, migrate slot: " << begin << " - "
             << end;
 
@@ -337,17 +348,141 @@ Status ChunkMigrateSender::sendRangeByBatch(Transaction* txn,
 
   LOG(INFO) << "Migrate sendRange Batch end, migrate slot: " << begin << " - "
             << end << ", total num: " << *totalNum;
-  // Send over of one slot
+  // Send over of one slot, the next slot goes on without waiting for it
+  return sendSlotOver(_cfg->migrateSnapshotWindow);
+}
+
+// The receiver handles the stream in order and acks a slot over after all
+// the batches before it are written. So the sender only waits for the acks
+// when more than window slots are pending.
+Status ChunkMigrateSender::sendSlotOver(uint32_t window) {
+  Status s;
   SyncWriteData("2");
-  SyncReadData(exptData, _OKSTR.length(), timeoutSec);
+  _unackedSlots++;
+  return recvSlotAcks(window);
+}
 
-  if (exptData.value() != _OKSTR) {
-    LOG(ERROR) << "read receiver data is not +OK on slot:" << begin;
-    return {ErrorCodes::ERR_INTERNAL, "read +OK failed"};
+Status ChunkMigrateSender::recvSlotAcks(uint32_t window) {
+  uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
+  while (_unackedSlots > window) {
+    SyncReadData(exptData, _OKSTR.length(), timeoutSec);
+    if (exptData.value() != _OKSTR) {
+      LOG(ERROR) << "read receiver data is not +OK, data:" << exptData.value();
+      return {ErrorCodes::ERR_INTERNAL, "read +OK failed"};
+    }
+    _unackedSlots--;
   }
   return {ErrorCodes::ERR_OK, ""};
 }
 
+// The records of the slots are written into one sst file, which is sent as
+// a whole and ingested by the receiver, instead of being written one by one.
+Status ChunkMigrateSender::sendRangeBySst(Transaction* txn,
+                                          uint32_t begin,
+                                          uint32_t end,
+                                          uint32_t* totalNum) {
+  auto kvstore = _dbWithLock->store;
+  Status s;
+  std::string dir = kvstore->migrateSstDir();
+  std::error_code ec;
+  filesystem::create_directories(dir, ec);
+  if (ec) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "create dir:" + dir + " failed:" + ec.message()};
+  }
+  std::string fname =
+    dir + "/" + _taskid + "_" + std::to_string(begin) + ".sst";
+  auto guard = MakeGuard([&fname] {
+    std::error_code ec;
+    filesystem::remove(fname, ec);
+  });
+  LOG(INFO) << "Migrate SendRange Sst begin, migrate slot: " << begin << " - "
+            << end;
+
+  auto expNum = kvstore->createSlotsSstFile(txn, begin, end, fname);
+  RET_IF_ERR_EXPECTED(expNum);
+  // Interuppt send snapshot if stop task
+  if (!isRunning()) {
+    LOG(ERROR) << "stop sender send snapshot on taskid:" << _taskid;
+    return {ErrorCodes::ERR_INTERNAL, "stop running"};
+  }
+  // no file for an empty slot
+  if (expNum.value() > 0) {
+    auto ingested = sendSstFile(fname, begin, expNum.value());
+    RET_IF_ERR_EXPECTED(ingested);
+    if (!ingested.value()) {
+      LOG(WARNING) << "receiver refused sst file, migrate slot: " << begin
+                   << " - " << end << " and the rest by batch, taskid:"
+                   << _taskid;
+      _sstMode = false;
+      return sendRangeByBatch(txn, begin, end, totalNum);
+    }
+    *totalNum += expNum.value();
+  }
+
+  LOG(INFO) << "Migrate sendRange Sst end, migrate slot: " << begin << " - "
+            << end << ", total num: " << *totalNum;
+  // Send over of one slot, NOTE: sendSstFile() reads its reply by line, so
+  // no ack can be left pending.
+  return sendSlotOver(0);
+}
+
+// send "6" filesize slot keynum and then the whole file, the receiver
+// replies after it verifies the block checksums and ingests the file.
+// false if the receiver asks for the records instead, see
+// ChunkMigrateReceiver::receiveSstFile()
+Expected<bool> ChunkMigrateSender::sendSstFile(const std::string& fname,
+                                               uint64_t slot,
+                                               uint64_t keyNum) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "open file:" + fname + " failed:" + strerror(errno)};
+  }
+  auto guard = MakeGuard([fd]() { ::close(fd); });
+
+  std::error_code ec;
+  uint64_t size = filesystem::file_size(fname, ec);
+  if (ec) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "stat file:" + fname + " failed:" + ec.message()};
+  }
+  const size_t fileBatch = 1024 * 1024;
+
+  Status s;
+  SyncWriteData("6");
+  SyncWriteData(std::string(reinterpret_cast<char*>(&size), sizeof(size)));
+  SyncWriteData(std::string(reinterpret_cast<char*>(&slot), sizeof(slot)));
+  SyncWriteData(std::string(reinterpret_cast<char*>(&keyNum), sizeof(keyNum)));
+
+  uint32_t timeoutSec = _cfg->migrateNetworkTimeout;
+  uint64_t offset = 0;
+  while (offset < size) {
+    size_t batchSize =
+      std::min(size - offset, static_cast<uint64_t>(fileBatch));
+    _svr->getMigrateManager()->requestRateLimit(batchSize);
+    s = _client->sendFile(
+      fd, offset, batchSize, std::chrono::seconds(timeoutSec));
+    RET_IF_ERR(s);
+    offset += batchSize;
+  }
+
+  // ingesting the file may take a while on the receiver
+  auto rpl = _client->readLine(std::chrono::seconds(timeoutSec * 10));
+  if (!rpl.ok()) {
+    return rpl.status();
+  }
+  if (rpl.value() == "+STREAM") {
+    return false;
+  }
+  if (rpl.value() != _OKSTR) {
+    LOG(ERROR) << "send sst file:" << fname << " failed:" << rpl.value();
+    return {ErrorCodes::ERR_INTERNAL, "receiver reply:" + rpl.value()};
+  }
+  _svr->getMigrateManager()->addSnapshotSendStat(keyNum, size, size);
+  return true;
+}
+
 // deal with slots that is not continuous
 Status ChunkMigrateSender::sendSnapshot() {
   Status s;
@@ -371,13 +506,23 @@ Status ChunkMigrateSender::sendSnapshot() {
   }
   uint32_t timeoutSec = 10;
   uint32_t sendSlotNum = 0;
+  _unackedSlots = 0;
   setSnapShotStartTime(msSinceEpoch());
 
   for (size_t i = 0; i < CLUSTER_SLOTS; i++) {
     if (_slots.test(i)) {
       sendSlotNum++;
       uint32_t sendNum = 0;
-      if (_cfg->migrateSnapshotBatchSizeKB > 0) {
+      if (_sstMode) {
+        auto status = sendRangeBySst(eTxn.value().get(), i, i + 1, &sendNum);
+        _snapshotKeyNum.fetch_add(sendNum, std::memory_order_relaxed);
+        if (!status.ok()) {
+          LOG(ERROR) << "sendRange failed, slot:" << i
+                     << "send keys num:" << getSnapshotNum()
+                     << status.toString();
+          return status;
+        }
+      } else if (_cfg->migrateSnapshotBatchSizeKB > 0) {
         auto status = sendRangeByBatch(eTxn.value().get(), i, i + 1, &sendNum);
         _snapshotKeyNum.fetch_add(sendNum, std::memory_order_relaxed);
         TEST_SYNC_POINT_CALLBACK("ChunkMigrateSender::sendSnapshot::sendKeyNum",
@@ -400,6 +545,8 @@ Status ChunkMigrateSender::sendSnapshot() {
       }
     }
   }
+  s = recvSlotAcks(0);
+  RET_IF_ERR(s);
   SyncWriteData("3");  // send over of all
   SyncReadData(exptData, _OKSTR.length(), timeoutSec);
   if (exptData.value() != _OKSTR) {
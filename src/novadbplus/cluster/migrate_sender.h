@@ -77,6 +77,12 @@ class ChunkMigrateSender {
     _dstStoreid = dstStoreid;
   }
   void setDstNode(const std::string nodeid);
+  void setSstMode(bool sstMode) {
+    _sstMode = sstMode;
+  }
+  void setCompress(bool compress) {
+    _compress = compress;
+  }
 
   uint32_t getStoreid() const {
     return _storeid;
@@ -155,6 +161,15 @@ class ChunkMigrateSender {
                           uint32_t begin,
                           uint32_t end,
                           uint32_t* totalNum);
+  Status sendRangeBySst(Transaction* txn,
+                        uint32_t begin,
+                        uint32_t end,
+                        uint32_t* totalNum);
+  Expected<bool> sendSstFile(const std::string& fname,
+                             uint64_t slot,
+                             uint64_t keyNum);
+  Status sendSlotOver(uint32_t window);
+  Status recvSlotAcks(uint32_t window);
   Status sendSnapshot();
   Status sendLastBinlog();
   Status catchupBinlog(uint64_t end);
@@ -193,6 +208,10 @@ class ChunkMigrateSender {
   std::string _dstIp;
   uint16_t _dstPort;
   uint32_t _dstStoreid;
+  bool _sstMode;
+  bool _compress;
+  // slots sent over but not acknowledged by the receiver yet
+  uint32_t _unackedSlots;
   std::shared_ptr<ClusterNode> _dstNode;
   std::list<std::unique_ptr<ChunkLock>> _slotsLockList;
   std::string _OKSTR = "+OK";
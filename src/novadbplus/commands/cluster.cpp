@@ -991,7 +991,7 @@ class ReadymigrateCommand : public Command {
   ReadymigrateCommand() : Command("readymigrate", "as") {}
 
   ssize_t arity() const {
-    return 5;
+    return -5;
   }
 
   int32_t firstkey() const {
@@ -4,6 +4,7 @@
 
 #include "novadbplus/commands/command.h"
 
+#include <future>
 #include <limits>
 #include <list>
 #include <map>
@@ -63,11 +64,15 @@ void Command::incrCallTimes() {
 
 void Command::incrNanos(uint64_t v) {
   _totalNanoSecs.fetch_add(v, std::memory_order_relaxed);
+  if (!gParams || gParams->latencyTracking) {
+    _latency.record(v / 1000);
+  }
 }
 
 void Command::resetStatInfo() {
   _callTimes = 0;
   _totalNanoSecs = 0;
+  _latency.reset();
 }
 
 uint64_t Command::getCallTimes() const {
@@ -171,7 +176,8 @@ size_t Command::getFlagsCount() const {
                                      CMD_FAST,
                                      CMD_MODULE_GETKEYS,
                                      CMD_MODULE_NO_CLUSTER,
-                                     CMD_ALLOW_CROSS_SLOT};
+                                     CMD_ALLOW_CROSS_SLOT,
+                                     CMD_INLINE};
 
   size_t size = 0;
   for (auto flag : flagarr) {
@@ -205,6 +211,51 @@ Command* Command::getCommand(Session* sess) {
   return it->second;
 }
 
+bool Command::canRunInline(Session* sess, std::unique_ptr<KeyLock>* keyLock) {
+  auto cmd = getCommand(sess);
+  const auto& args = sess->getArgs();
+  if (cmd == nullptr || !(cmd->getFlags() & CMD_INLINE) || args.size() != 2 ||
+      sess->getCtx()->isInMulti()) {
+    return false;
+  }
+
+  auto server = sess->getServerEntry();
+  auto segMgr = server->getSegmentMgr();
+  const auto& key = args[1];
+  uint32_t chunkId =
+    redis_port::keyHashSlot(key.c_str(), key.size()) % segMgr->getChunkSize();
+  uint32_t storeId = segMgr->getStoreid(chunkId);
+  if (storeId >= server->getStores().size()) {
+    return false;
+  }
+
+  // NOTE: the io thread never waits for a lock, a contended key is left to
+  // the worker pool. The command finds the key locked by itself later.
+  auto elk = KeyLock::AquireKeyLock(
+    storeId, chunkId, key, RdLock(), sess, server->getMGLockMgr(), 0);
+  if (!elk.ok()) {
+    return false;
+  }
+
+  Expected<RecordValue> meta(ErrorCodes::ERR_NOTFOUND, "");
+  RecordKey mk(
+    chunkId, sess->getCtx()->getDbId(), RecordType::RT_DATA_META, key, "");
+  if (!server->getStores()[storeId]->probeKV(mk, &meta)) {
+    return false;
+  }
+  // an expired key is deleted by the command, it's a write
+  uint64_t ttl = meta.ok() ? meta.value().getTtl() : 0;
+  if (!server->getParams()->noexpire && ttl != 0 && msSinceEpoch() >= ttl) {
+    return false;
+  }
+  // NOTE: the key lock is held until the command is done, so the meta
+  // probed can't change, and the command is served from it. Reading the
+  // key again might block the io thread if its block is evicted by then.
+  sess->getCtx()->setInlineMeta(key, std::move(meta));
+  *keyLock = std::move(elk.value());
+  return true;
+}
+
 Expected<Command*> Command::precheck(Session* sess) {
   const auto& args = sess->getArgs();
   if (args.size() == 0) {
@@ -278,8 +329,20 @@ Expected<std::string> Command::runSessionCmd(Session* sess) {
   // TODO(vinchen): here there is a copy, it is a waste.
   sess->getCtx()->setArgsBrief(sess->getArgs());
   it->second->incrCallTimes();
+
+  // NOTE: in a pipeline batch, consecutive readonly commands reuse their
+  // txns(with the snapshot re-taken) rather than creating new ones, any
+  // other command drops the kept txns first.
+  bool keepTxns = sess->getCtx()->isPipelineBatch() &&
+    it->second->isReadOnly() && !sess->getCtx()->isInMulti();
+  if (!keepTxns) {
+    sess->getCtx()->dropKeptTxns();
+  }
   auto now = nsSinceEpoch();
-  auto guard = MakeGuard([it, now, sess, commandName] {
+  auto guard = MakeGuard([it, now, sess, commandName, keepTxns] {
+    if (keepTxns) {
+      sess->getCtx()->keepTxns();
+    }
     sess->getCtx()->clearRequestCtx();
     auto end = nsSinceEpoch();
     auto startTs = sess->getCtx()->getReadPacketTs();
@@ -327,6 +390,36 @@ bool Command::useDeleteRange(uint64_t eleCount,
   }
 }
 
+uint64_t Command::getSubKeyVersion(Session* sess,
+                                   const Expected<RecordValue>& rv,
+                                   RecordType valueType) {
+  if (rv.ok()) {
+    return rv.value().getVersion();
+  }
+  if (!isVersionedType(valueType)) {
+    return 0;
+  }
+  return sess->getCtx()->getKeyVersion();
+}
+
+// requirement: keylock held
+Status Command::delVersionedKeyInLock(const RecordKey& mk,
+                                      const RecordValue& rv,
+                                      PStore kvstore,
+                                      Transaction* txn) {
+  INVARIANT_D(rv.getVersion() > 0);
+  Status s = kvstore->delKV(mk, txn);
+  RET_IF_ERR(s);
+
+  if (rv.getTtl() > 0) {
+    TTLIndex ictx(
+      mk.getPrimaryKey(), rv.getRecordType(), mk.getDbId(), rv.getTtl());
+    s = txn->delKV(ictx.encode());
+    RET_IF_ERR(s);
+  }
+  return s;
+}
+
 // should be called with store locked
 // bool Command::isKeyLocked(Session *sess,
 //                           uint32_t storeId,
@@ -391,10 +484,15 @@ Expected<std::pair<std::string, std::list<Record>>> Command::scan(
   const std::string& pk,
   const std::string& from,
   uint64_t cnt,
-  Transaction* txn) {
-  auto cursor = txn->createDataCursor();
+  Transaction* txn,
+  const std::string& skPrefix) {
+  // NOTE: the subkeys with skPrefix are adjacent, an upper bound keeps
+  // rocksdb from reading anything after them
+  auto cursor = skPrefix.empty()
+    ? txn->createDataCursor()
+    : txn->createRangeDataCursor(prefixUpperBound(pk + skPrefix));
   if (from == "0") {
-    cursor->seek(pk);
+    cursor->seek(pk + skPrefix);
   } else {
     auto unhex = unhexlify(from);
     if (!unhex.ok()) {
@@ -438,6 +536,35 @@ Expected<std::pair<std::string, std::list<Record>>> Command::scan(
     std::pair<std::string, std::list<Record>>(nextCursor, std::move(result)));
 }
 
+ScanPlan Command::planScanPattern(const std::string& pattern) {
+  ScanPlan plan;
+  plan.prefix = redis_port::stringmatchprefix(pattern.c_str(), pattern.size());
+  plan.slot = -1;
+  // the same rule as redis_port::keyHashSlot(), the first '{' and the
+  // first '}' after it, with something between them
+  auto start = plan.prefix.find('{');
+  if (start != std::string::npos) {
+    auto end = plan.prefix.find('}', start + 1);
+    if (end != std::string::npos && end != start + 1) {
+      plan.slot =
+        redis_port::keyHashSlot(plan.prefix.c_str(), plan.prefix.size());
+    }
+  }
+  return plan;
+}
+
+std::string Command::prefixUpperBound(const std::string& prefix) {
+  std::string bound(prefix);
+  while (!bound.empty()) {
+    if (static_cast<uint8_t>(bound.back()) != 0xff) {
+      bound.back()++;
+      break;
+    }
+    bound.pop_back();
+  }
+  return bound;
+}
+
 Expected<std::list<Record>> Command::scanSimple(Session* sess,
                                                 const std::string& pk,
                                                 const std::string& from,
@@ -481,14 +608,15 @@ Expected<std::list<Record>> Command::scanSimple(Session* sess,
 Status Command::delKeyOptimismInLock(Session* sess,
                                      uint32_t storeId,
                                      const RecordKey& rk,
-                                     RecordType valueType,
+                                     const RecordValue& rv,
                                      Transaction* txn,
                                      const TTLIndex* ictx) {
   auto s = Command::partialDelSubKeys(sess,
                                       storeId,
                                       std::numeric_limits<uint32_t>::max(),
                                       rk,
-                                      valueType,
+                                      rv.getRecordType(),
+                                      rv.getVersion(),
                                       true,
                                       txn,
                                       ictx);
@@ -633,6 +761,7 @@ Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                                               uint32_t subCount,
                                               const RecordKey& mk,
                                               RecordType valueType,
+                                              uint64_t version,
                                               bool deleteMeta,
                                               Transaction* txn,
                                               const TTLIndex* ictx) {
@@ -666,7 +795,8 @@ Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                       mk.getDbId(),
                       RecordType::RT_HASH_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
   } else if (valueType == RecordType::RT_LIST_META) {
     RecordKey fakeEle(mk.getChunkId(),
@@ -680,20 +810,23 @@ Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                       mk.getDbId(),
                       RecordType::RT_SET_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
   } else if (valueType == RecordType::RT_ZSET_META) {
     RecordKey fakeEle(mk.getChunkId(),
                       mk.getDbId(),
                       RecordType::RT_ZSET_S_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
     RecordKey fakeEle1(mk.getChunkId(),
                        mk.getDbId(),
                        RecordType::RT_ZSET_H_ELE,
                        mk.getPrimaryKey(),
-                       "");
+                       "",
+                       version);
     prefixes.push_back(fakeEle1.prefixPk());
   } else if (valueType == RecordType::RT_TBITMAP_META) {
     RecordKey fakeEle(mk.getChunkId(),
@@ -833,12 +966,21 @@ Status Command::delKey(Session* sess,
       key, valueType, sess->getCtx()->getDbId(), eValue.value().getTtl());
     if (useDeleteRange(cnt.value(), valueType, server->getParams())) {
       LOG(INFO) << "bigkey delete:" << hexlify(mk.getPrimaryKey())
-                << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value();
+                << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value()
+                << ",version:" << eValue.value().getVersion();
+      if (eValue.value().getVersion() > 0) {
+        return Command::delVersionedKeyInLock(mk, eValue.value(), kvstore, txn);
+      }
       return Command::delKeyPessimisticInLock(
         sess, storeId, mk, valueType, ictx.getTTL() > 0 ? &ictx : nullptr);
     } else {
-      Status s = Command::delKeyOptimismInLock(
-        sess, storeId, mk, valueType, txn, ictx.getTTL() > 0 ? &ictx : nullptr);
+      Status s = Command::delKeyOptimismInLock(sess,
+                                               storeId,
+                                               mk,
+                                               eValue.value(),
+                                               txn,
+                                               ictx.getTTL() > 0 ? &ictx
+                                                                 : nullptr);
       if (s.code() == ErrorCodes::ERR_COMMIT_RETRY && i != RETRY_CNT - 1) {
         continue;
       }
@@ -875,6 +1017,9 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
   // NOTE(takenliu) we need setReplOnly
   sg.getSession()->getCtx()->setReplOnly(kvstore->getMode() ==
                                          KVStore::StoreMode::REPLICATE_ONLY);
+  // the meta probed by canRunInline(), never read it again on the io thread
+  const auto* inlineMeta =
+    sess->isOnIoThread() ? sess->getCtx()->getInlineMeta(key) : nullptr;
 
   for (uint32_t i = 0; i < RETRY_CNT; ++i) {
     // NOTE(takenliu) expireKeyIfNeeded don't use txn from params,
@@ -886,7 +1031,8 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    Expected<RecordValue> eValue = kvstore->getKV(mk, txn.get());
+    Expected<RecordValue> eValue =
+      inlineMeta ? *inlineMeta : kvstore->getKV(mk, txn.get());
     if (!eValue.ok()) {
       // maybe ErrorCodes::ERR_NOTFOUND
       ++sess->getServerEntry()->getServerStat().keyspaceMisses;
@@ -921,6 +1067,11 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
       // NOTE(vinchen): if replOnly, it can't delete record, but return
       // ErrorCodes::ERR_EXPIRED
       return {ErrorCodes::ERR_EXPIRED, ""};
+    } else if (sess->isOnIoThread()) {
+      // NOTE: the key expired after Command::canRunInline(), the io thread
+      // doesn't write, the key is left to the ttl index or the next access
+      // on the worker pool.
+      return {ErrorCodes::ERR_EXPIRED, ""};
     }
     auto cnt = rcd_util::getSubKeyCount(mk, eValue.value());
     if (!cnt.ok()) {
@@ -928,9 +1079,13 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
     }
 
     TTLIndex ictx(key, valueType, sess->getCtx()->getDbId(), targetTtl);
-    if (useDeleteRange(cnt.value(), valueType, server->getParams())) {
+    bool bigKey = useDeleteRange(cnt.value(), valueType, server->getParams());
+    if (bigKey) {
       LOG(INFO) << "bigkey delete:" << hexlify(mk.getPrimaryKey())
-                << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value();
+                << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value()
+                << ",version:" << eValue.value().getVersion();
+    }
+    if (bigKey && eValue.value().getVersion() == 0) {
       Status s = Command::delKeyPessimisticInLock(
         sg.getSession(), storeId, mk, valueType, &ictx);
       if (s.ok()) {
@@ -938,24 +1093,341 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
       } else {
         return s;
       }
-    } else {
-      Status s = Command::delKeyOptimismInLock(
-        sg.getSession(), storeId, mk, valueType, txn.get(), &ictx);
-      if (!s.ok()) {
-        return s;
+    }
+    Status s = bigKey
+      ? Command::delVersionedKeyInLock(mk, eValue.value(), kvstore, txn.get())
+      : Command::delKeyOptimismInLock(
+          sg.getSession(), storeId, mk, eValue.value(), txn.get(), &ictx);
+    if (!s.ok()) {
+      return s;
+    }
+    auto eCmt = txn.get()->commit();
+    if (!eCmt.ok()) {
+      return eCmt.status();
+    }
+    return {ErrorCodes::ERR_EXPIRED, ""};
+  }
+  // should never reach here
+  INVARIANT_D(0);
+  return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+}
+
+// NOTE: the txn is committed in this function.
+Expected<uint32_t> Command::expireKeysInStore(
+  LocalSession* sess,
+  const std::vector<TTLIndex>& indexes,
+  uint32_t* rangeDeletes) {
+  auto server = sess->getServerEntry();
+  INVARIANT(server != nullptr);
+  if (indexes.empty()) {
+    return 0u;
+  }
+
+  // the batch is written into binlog as one "del k1 k2 ..."
+  std::vector<std::string> args{"del"};
+  std::vector<int> keyIndex;
+  for (const auto& ictx : indexes) {
+    INVARIANT_D(ictx.getDbId() == indexes[0].getDbId());
+    keyIndex.push_back(args.size());
+    args.push_back(ictx.getPriKey());
+  }
+  sess->setArgs(args);
+  sess->getCtx()->setDbId(indexes[0].getDbId());
+
+  auto segMgr = server->getSegmentMgr();
+  auto locklist =
+    segMgr->getAllKeysLocked(sess, args, keyIndex, mgl::LockMode::LOCK_X);
+  RET_IF_ERR_EXPECTED(locklist);
+  auto expdb = segMgr->getDbHasLocked(sess, args[1]);
+  RET_IF_ERR_EXPECTED(expdb);
+  PStore kvstore = expdb.value().store;
+  uint32_t storeId = expdb.value().dbId;
+  if (kvstore->getMode() == KVStore::StoreMode::REPLICATE_ONLY) {
+    return 0u;
+  }
+  std::vector<uint32_t> chunkIds;
+  for (const auto& ictx : indexes) {
+    auto expKeyDb = segMgr->getDbHasLocked(sess, ictx.getPriKey());
+    RET_IF_ERR_EXPECTED(expKeyDb);
+    INVARIANT_D(expKeyDb.value().dbId == storeId);
+    chunkIds.push_back(expKeyDb.value().chunkId);
+  }
+
+  for (uint32_t i = 0; i < RETRY_CNT; ++i) {
+    auto ptxn = kvstore->createTransaction(sess);
+    RET_IF_ERR_EXPECTED(ptxn);
+    std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+
+    uint32_t deleted = 0;
+    std::vector<std::pair<RecordKey, TTLIndex>> bigKeys;
+    uint64_t currentTs = msSinceEpoch();
+    for (size_t j = 0; j < indexes.size(); ++j) {
+      const auto& ictx = indexes[j];
+      RecordKey mk(
+        chunkIds[j], ictx.getDbId(), ictx.getType(), ictx.getPriKey(), "");
+      Expected<RecordValue> eValue = kvstore->getKV(mk, txn.get());
+      if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
+        continue;
       }
-      auto eCmt = txn.get()->commit();
-      if (!eCmt.ok()) {
-        return eCmt.status();
+      RET_IF_ERR_EXPECTED(eValue);
+
+      // the key may have been rewritten since the index was scanned
+      uint64_t targetTtl = eValue.value().getTtl();
+      if (targetTtl == 0 || currentTs < targetTtl) {
+        continue;
       }
-      return {ErrorCodes::ERR_EXPIRED, ""};
+      RecordType valueType = eValue.value().getRecordType();
+      auto cnt = rcd_util::getSubKeyCount(mk, eValue.value());
+      RET_IF_ERR_EXPECTED(cnt);
+
+      TTLIndex realIdx(ictx.getPriKey(), valueType, ictx.getDbId(), targetTtl);
+      uint64_t version = eValue.value().getVersion();
+      if (useDeleteRange(cnt.value(), valueType, server->getParams())) {
+        LOG(INFO) << "bigkey delete:" << hexlify(mk.getPrimaryKey())
+                  << ",rcdType:" << rt2Char(valueType)
+                  << ",size:" << cnt.value() << ",version:" << version;
+        if (version > 0) {
+          Status s =
+            delVersionedKeyInLock(mk, eValue.value(), kvstore, txn.get());
+          RET_IF_ERR(s);
+          deleted++;
+          continue;
+        }
+        bigKeys.emplace_back(std::move(mk), std::move(realIdx));
+        continue;
+      }
+      auto eDel = partialDelSubKeys(sess,
+                                    storeId,
+                                    std::numeric_limits<uint32_t>::max(),
+                                    mk,
+                                    valueType,
+                                    version,
+                                    true,
+                                    txn.get(),
+                                    &realIdx);
+      RET_IF_ERR_EXPECTED(eDel);
+      deleted++;
     }
+
+    auto eCmt = txn->commit();
+    if (eCmt.status().code() == ErrorCodes::ERR_COMMIT_RETRY &&
+        i != RETRY_CNT - 1) {
+      continue;
+    }
+    RET_IF_ERR_EXPECTED(eCmt);
+
+    for (const auto& bigKey : bigKeys) {
+      Status s = delKeyPessimisticInLock(sess,
+                                         storeId,
+                                         bigKey.first,
+                                         bigKey.second.getType(),
+                                         &bigKey.second);
+      RET_IF_ERR(s);
+      deleted++;
+      if (rangeDeletes) {
+        (*rangeDeletes)++;
+      }
+    }
+    return deleted;
   }
   // should never reach here
   INVARIANT_D(0);
   return {ErrorCodes::ERR_INTERNAL, "not reachable"};
 }
 
+struct StoreBatch {
+  PStore store;
+  std::vector<size_t> index;
+  std::vector<RecordKey> keys;
+  std::vector<Expected<RecordValue>> values;
+};
+
+void batchGetFromStore(StoreBatch* batch, Session* sess) {
+  auto ptxn = batch->store->createTransaction(sess);
+  if (!ptxn.ok()) {
+    for (size_t i = 0; i < batch->keys.size(); ++i) {
+      batch->values.emplace_back(ptxn.status());
+    }
+    return;
+  }
+  batch->values = batch->store->multiGetKV(batch->keys, ptxn.value().get());
+}
+
+std::vector<Expected<RecordValue>> Command::expireKeysIfNeeded(
+  Session* sess,
+  const std::vector<std::string>& keys,
+  RecordType tp,
+  bool hasVersion) {
+  auto server = sess->getServerEntry();
+  INVARIANT(server != nullptr);
+  std::vector<Expected<RecordValue>> result(
+    keys.size(), Expected<RecordValue>(ErrorCodes::ERR_NOTFOUND, ""));
+
+  // storeId -> keys in that kvstore
+  std::map<uint32_t, StoreBatch> batches;
+  // hold the (recursive) key locks until all the lookups are done
+  std::list<DbWithLock> dbs;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto expdb =
+      server->getSegmentMgr()->getDbWithKeyLock(sess, keys[i], RdLock());
+    if (!expdb.ok()) {
+      result[i] = expdb.status();
+      continue;
+    }
+    auto& batch = batches[expdb.value().dbId];
+    batch.store = expdb.value().store;
+    batch.index.push_back(i);
+    batch.keys.emplace_back(
+      expdb.value().chunkId, sess->getCtx()->getDbId(), tp, keys[i], "");
+    dbs.emplace_back(std::move(expdb.value()));
+  }
+
+  // NOTE: one rocksdb MultiGet per kvstore. The first kvstore is read in
+  // the current thread, the others are handed to the batch-read pool when
+  // there are enough keys. SessionCtx isn't thread-safe, so each pooled
+  // lookup runs with its own local session, made from sess.
+  auto pool = server->getBatchReadPool();
+  bool parallel = pool != nullptr && batches.size() > 1 &&
+    keys.size() >= server->getParams()->batchReadParallelKeys;
+  std::vector<std::future<void>> pending;
+  std::vector<StoreBatch*> inlineBatches;
+  for (auto& kv : batches) {
+    StoreBatch* batch = &kv.second;
+    if (!parallel || inlineBatches.empty()) {
+      inlineBatches.push_back(batch);
+      continue;
+    }
+    auto sg = std::make_shared<LocalSessionGuard>(server, sess);
+    sg->getSession()->getCtx()->setDbId(sess->getCtx()->getDbId());
+    auto done = std::make_shared<std::promise<void>>();
+    pending.emplace_back(done->get_future());
+    pool->schedule([batch, done, sg]() {
+      const auto guard = MakeGuard([&done] { done->set_value(); });
+      batchGetFromStore(batch, sg->getSession());
+    });
+  }
+  for (auto batch : inlineBatches) {
+    // the meta probed by canRunInline(), never read it again on the io
+    // thread
+    const Expected<RecordValue>* inlineMeta = nullptr;
+    if (sess->isOnIoThread() && batch->keys.size() == 1) {
+      inlineMeta = sess->getCtx()->getInlineMeta(keys[batch->index[0]]);
+    }
+    if (inlineMeta) {
+      batch->values.emplace_back(*inlineMeta);
+      continue;
+    }
+    batchGetFromStore(batch, sess);
+  }
+  for (auto& f : pending) {
+    f.wait();
+  }
+
+  uint64_t currentTs = msSinceEpoch();
+  auto& serverStat = server->getServerStat();
+  for (auto& kv : batches) {
+    auto& batch = kv.second;
+    INVARIANT_D(batch.values.size() == batch.index.size());
+    for (size_t j = 0; j < batch.index.size(); ++j) {
+      size_t i = batch.index[j];
+      auto& eValue = batch.values[j];
+      if (!eValue.ok()) {
+        // maybe ErrorCodes::ERR_NOTFOUND
+        ++serverStat.keyspaceMisses;
+        result[i] = eValue.status();
+        continue;
+      }
+
+      uint64_t targetTtl = eValue.value().getTtl();
+      if (!server->getParams()->noexpire && targetTtl != 0 &&
+          currentTs >= targetTtl) {
+        // expired keys are rare, let the single key path delete them
+        result[i] = expireKeyIfNeeded(sess, keys[i], tp, hasVersion);
+        continue;
+      }
+
+      RecordType valueType = eValue.value().getRecordType();
+      if (valueType != tp && tp != RecordType::RT_DATA_META) {
+        result[i] = {ErrorCodes::ERR_WRONG_TYPE,
+                     "-WRONGTYPE Operation against a key holding the wrong "
+                     "kind of value(" +
+                       keys[i] + ")\r\n"};
+        continue;
+      }
+      if (hasVersion &&
+          !sess->getCtx()->verifyVersion(eValue.value().getVersionEP())) {
+        ++serverStat.keyspaceIncorrectEp;
+        result[i] = {ErrorCodes::ERR_WRONG_VERSION_EP, ""};
+        continue;
+      }
+      ++serverStat.keyspaceHits;
+      result[i] = std::move(eValue);
+    }
+  }
+  return result;
+}
+
+std::vector<Status> Command::parallelForStores(
+  Session* sess,
+  const std::vector<uint32_t>& storeIds,
+  const std::function<Status(size_t, Transaction*)>& fn) {
+  auto server = sess->getServerEntry();
+  INVARIANT(server != nullptr);
+  std::vector<Status> result(storeIds.size(), {ErrorCodes::ERR_OK, ""});
+
+  // hold the kvstore locks until all the kvstores are done
+  std::list<DbWithLock> dbs;
+  std::vector<std::pair<size_t, PStore>> stores;
+  for (size_t i = 0; i < storeIds.size(); ++i) {
+    auto expdb = server->getSegmentMgr()->getDb(
+      sess, storeIds[i], mgl::LockMode::LOCK_IS);
+    if (!expdb.ok()) {
+      result[i] = expdb.status();
+      continue;
+    }
+    stores.emplace_back(i, expdb.value().store);
+    dbs.emplace_back(std::move(expdb.value()));
+  }
+
+  // NOTE: SessionCtx isn't thread-safe, the pooled kvstores use their own
+  // local sessions and txns, which don't see the kept txns of a pipeline
+  // batch.
+  auto pool = server->getScanPool();
+  std::vector<std::future<void>> pending;
+  std::vector<std::pair<size_t, PStore>*> inlineStores;
+  for (auto& store : stores) {
+    if (pool == nullptr || inlineStores.empty()) {
+      inlineStores.push_back(&store);
+      continue;
+    }
+    auto sg = std::make_shared<LocalSessionGuard>(server, sess);
+    sg->getSession()->getCtx()->setDbId(sess->getCtx()->getDbId());
+    auto done = std::make_shared<std::promise<void>>();
+    pending.emplace_back(done->get_future());
+    pool->schedule([&store, &result, &fn, done, sg]() {
+      const auto guard = MakeGuard([&done] { done->set_value(); });
+      auto ptxn = store.second->createTransaction(sg->getSession());
+      if (!ptxn.ok()) {
+        result[store.first] = ptxn.status();
+        return;
+      }
+      result[store.first] = fn(store.first, ptxn.value().get());
+    });
+  }
+  for (auto store : inlineStores) {
+    auto ptxn = sess->getCtx()->createTransaction(store->second);
+    if (!ptxn.ok()) {
+      result[store->first] = ptxn.status();
+      continue;
+    }
+    result[store->first] = fn(store->first, ptxn.value());
+  }
+  for (auto& f : pending) {
+    f.wait();
+  }
+  return result;
+}
+
 std::string Command::fmtErr(const std::string& s) {
   if (s.size() != 0 && s[0] == '-') {
     return s;
@@ -5,6 +5,7 @@
 #ifndef SRC_novadbPLUS_COMMANDS_COMMAND_H_
 #define SRC_novadbPLUS_COMMANDS_COMMAND_H_
 
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
@@ -14,6 +15,7 @@
 #include <vector>
 
 #include "novadbplus/lock/lock.h"
+#include "novadbplus/network/latency_record.h"
 #include "novadbplus/network/session_ctx.h"
 #include "novadbplus/server/server_entry.h"
 #include "novadbplus/server/session.h"
@@ -22,6 +24,16 @@
 
 namespace novadbplus {
 
+// what a MATCH pattern tells about the keys it matches, before reading any
+// of them. See Command::planScanPattern().
+struct ScanPlan {
+  // the keys matched all start with prefix
+  std::string prefix;
+  // the keys matched all belong to slot if the hash tag is literal,
+  // otherwise -1
+  int32_t slot;
+};
+
 class Command {
  public:
   using CmdMap = std::unordered_map<std::string, Command*>;
@@ -48,6 +60,10 @@ class Command {
   void incrNanos(uint64_t);
   uint64_t getCallTimes() const;
   uint64_t getNanos() const;
+  // execute time(us) of the calls, fed by incrNanos()
+  const LatencyHistogram& getLatencyHistogram() const {
+    return _latency;
+  }
   void resetStatInfo();
   bool isReadOnly() const;
   bool isMultiKey() const;
@@ -59,6 +75,10 @@ class Command {
   size_t getFlagsCount() const;
   static std::vector<std::string> listCommands();
   static Command* getCommand(Session* sess);
+  // whether the request of sess is a CMD_INLINE command whose key can be
+  // read from memory, so it can be run on the io thread. The key lock is
+  // taken without waiting and kept in keyLock for the command to reuse.
+  static bool canRunInline(Session* sess, std::unique_ptr<KeyLock>* keyLock);
   // precheck returns command name
   static Expected<Command*> precheck(Session* sess);
   static Expected<std::string> runSessionCmd(Session* sess);
@@ -75,12 +95,54 @@ class Command {
                                                  RecordType tp,
                                                  bool hasVersion = true);
 
+  // batched expireKeyIfNeeded(), the result of keys[i] is returned at
+  // index i. All the keys should have been locked by the caller, using
+  // SegmentMgr::getAllKeysLocked().
+  static std::vector<Expected<RecordValue>> expireKeysIfNeeded(
+    Session* sess,
+    const std::vector<std::string>& keys,
+    RecordType tp,
+    bool hasVersion = true);
+
+  // run fn(i, txn) for each kvstore storeIds[i], return the status of
+  // each. The kvstores are locked(IS) by the session in the current thread.
+  // The first one runs here with the session's txn, the others run in
+  // parallel on the scan pool without session, if there is one.
+  static std::vector<Status> parallelForStores(
+    Session* sess,
+    const std::vector<uint32_t>& storeIds,
+    const std::function<Status(size_t, Transaction*)>& fn);
+
+  // delete the expired keys of indexes in one transaction, so they make a
+  // single binlog. All the indexes should belong to the same store and db.
+  // The big keys are deleted by deleteRange one by one after the commit,
+  // and counted by rangeDeletes. Return the number of keys deleted.
+  static Expected<uint32_t> expireKeysInStore(
+    LocalSession* sess,
+    const std::vector<TTLIndex>& indexes,
+    uint32_t* rangeDeletes = nullptr);
+
+  // the version of the subkeys of key. An existing key keeps the version of
+  // its meta, and a new hash/set/zset takes SessionCtx::getKeyVersion(),
+  // which is 0 unless versionedKeys is set.
+  static uint64_t getSubKeyVersion(Session* sess,
+                                   const Expected<RecordValue>& rv,
+                                   RecordType valueType);
+
+  // the subkeys of pk, only those with a secondary key starting with
+  // skPrefix if it's not empty
   static Expected<std::pair<std::string, std::list<Record>>> scan(
     Session* sess,
     const std::string& pk,
     const std::string& from,
     uint64_t cnt,
-    Transaction* txn);
+    Transaction* txn,
+    const std::string& skPrefix = "");
+
+  static ScanPlan planScanPattern(const std::string& pattern);
+  // the least string greater than all the strings starting with prefix,
+  // empty if there isn't one
+  static std::string prefixUpperBound(const std::string& prefix);
 
   // NOTE[zakzheng] scanSimple will seek to from,
   // and will return cnt number of element if enough
@@ -147,13 +209,20 @@ class Command {
   static Status delKeyOptimismInLock(Session* sess,
                                      uint32_t storeId,
                                      const RecordKey& rk,
-                                     RecordType valueType,
+                                     const RecordValue& rv,
                                      Transaction* txn,
                                      const TTLIndex* ictx = nullptr);
   static bool useDeleteRange(uint64_t eleCount,
                              RecordType type,
                              const std::shared_ptr<ServerParams>& cfg);
 
+  // delete a big versioned key by its meta and ttl index only, its subkeys
+  // are invisible since then and left to the compaction filter.
+  static Status delVersionedKeyInLock(const RecordKey& mk,
+                                      const RecordValue& rv,
+                                      PStore kvstore,
+                                      Transaction* txn);
+
   static Expected<std::string> delSubkeysRange(Session* sess,
                                                uint32_t storeId,
                                                const RecordKey& mk,
@@ -165,6 +234,7 @@ class Command {
                                               uint32_t subCount,
                                               const RecordKey& mk,
                                               RecordType valueType,
+                                              uint64_t version,
                                               bool deleteMeta,
                                               Transaction* txn,
                                               const TTLIndex* ictx = nullptr);
@@ -179,6 +249,7 @@ class Command {
 
   std::atomic<uint64_t> _callTimes;
   std::atomic<uint64_t> _totalNanoSecs;
+  LatencyHistogram _latency;
 };
 
 std::unordered_map<std::string, Command*>& commandMap();
@@ -7,6 +7,8 @@
 #include <limits>
 #include <memory>
 #include <random>
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -133,15 +135,57 @@ void testDel(std::shared_ptr<ServerEntry> svr) {
   const auto guard =
     MakeGuard([] { SyncPoint::GetInstance()->ClearAllCallBacks(); });
   std::cout << "begin delete zset" << std::endl;
+  // a versioned zset is deleted by its meta only, the elements are left to
+  // the compaction filter
+  bool versioned = svr->getParams()->versionedKeys;
+  uint32_t pessimistic = 0;
   SyncPoint::GetInstance()->EnableProcessing();
   SyncPoint::GetInstance()->SetCallBack(
     "delKeyPessimistic::TotalCount", [&](void* arg) {
       uint64_t v = *(static_cast<uint64_t*>(arg));
-      EXPECT_EQ(v, 20001U);
+      if (pessimistic++ == 0) {
+        EXPECT_EQ(v, 20001U);
+      }
     });
   sess.setArgs({"del", "testzsetdel"});
   auto expect = Command::runSessionCmd(&sess);
   EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtOne());
+  EXPECT_EQ(pessimistic, versioned ? 0U : 1U);
+
+  // the stale elements are invisible to the recreated key
+  sess.setArgs({"zadd", "testzsetdel", "1", "1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"zrange", "testzsetdel", "0", "-1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), "*1\r\n$1\r\n1\r\n");
+  sess.setArgs({"zscore", "testzsetdel", "2"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtNull());
+
+  for (int i = 0; i < 10000; ++i) {
+    sess.setArgs({"hset", "testhashdel", std::to_string(i), "v"});
+    expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+  }
+  sess.setArgs({"del", "testhashdel"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(pessimistic, versioned ? 0U : 2U);
+  sess.setArgs({"hset", "testhashdel", "a", "v"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"hlen", "testhashdel"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtOne());
+  sess.setArgs({"hget", "testhashdel", "1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtNull());
 }
 
 void testSpopOptimize(std::shared_ptr<ServerEntry> svr) {
@@ -209,19 +253,22 @@ void testSpopOptimize(std::shared_ptr<ServerEntry> svr) {
 }
 
 TEST(Command, del) {
-  const auto guard = MakeGuard([] { destroyEnv(); });
+  for (bool versioned : {false, true}) {
+    const auto guard = MakeGuard([] { destroyEnv(); });
 
-  EXPECT_TRUE(setupEnv());
-  auto cfg = makeServerParam();
-  auto server = makeServerEntry(cfg);
+    EXPECT_TRUE(setupEnv());
+    auto cfg = makeServerParam();
+    cfg->versionedKeys = versioned;
+    auto server = makeServerEntry(cfg);
 
-  testDel(server);
-  testSpopOptimize(server);
+    testDel(server);
+    testSpopOptimize(server);
 
 #ifndef _WIN32
-  server->stop();
-  EXPECT_EQ(server.use_count(), 1);
+    server->stop();
+    EXPECT_EQ(server.use_count(), 1);
 #endif
+  }
 }
 
 TEST(Command, expire) {
@@ -1086,6 +1133,216 @@ TEST_P(CommandCommonTest, BinlogEnabled) {
 
 INSTANTIATE_TEST_CASE_P(BinlogEnabled, CommandCommonTest, testing::Bool());
 
+// the bulk strings of a reply, without the lengths
+static std::vector<std::string> replyBulks(const std::string& reply) {
+  std::vector<std::string> result;
+  size_t pos = 0;
+  while (pos < reply.size()) {
+    auto end = reply.find("\r\n", pos);
+    INVARIANT(end != std::string::npos);
+    if (reply[pos] != '*' && reply[pos] != '$') {
+      result.emplace_back(reply.substr(pos, end - pos));
+    }
+    pos = end + 2;
+  }
+  return result;
+}
+
+TEST(Command, keysAndScanAcrossStores) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  auto server = makeServerEntry(cfg);
+
+  {
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext);
+    NoSchedNetSession sess(
+      server, std::move(socket), 1, false, nullptr, nullptr);
+    for (uint32_t i = 0; i < 100; ++i) {
+      sess.setArgs({"set", "user:" + std::to_string(i), "v"});
+      EXPECT_TRUE(Command::runSessionCmd(&sess).ok());
+      sess.setArgs({"sadd", "other:" + std::to_string(i), "a", "b"});
+      EXPECT_TRUE(Command::runSessionCmd(&sess).ok());
+    }
+
+    // the keys of the kvstores but the last are sent before returning
+    sess.setArgs({"keys", "user:*", "1000"});
+    auto expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    std::string reply = sess.getResponse()[0] + expect.value();
+    EXPECT_EQ(reply.substr(0, 6), "*100\r\n");
+    std::set<std::string> keys;
+    for (const auto& key : replyBulks(reply)) {
+      EXPECT_EQ(key.substr(0, 5), "user:");
+      keys.insert(key);
+    }
+    EXPECT_EQ(keys.size(), 100U);
+
+    // limit
+    size_t sent = sess.getResponse()[0].size();
+    sess.setArgs({"keys", "*", "10"});
+    expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    reply = sess.getResponse()[0].substr(sent) + expect.value();
+    EXPECT_EQ(reply.substr(0, 5), "*10\r\n");
+    EXPECT_EQ(replyBulks(reply).size(), 10U);
+
+    // no key matched
+    sess.setArgs({"keys", "none:*"});
+    expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    EXPECT_EQ(expect.value(), "*0\r\n");
+
+    keys.clear();
+    std::string cursor = "0";
+    do {
+      sess.setArgs({"scan", cursor, "match", "user:*", "count", "7"});
+      expect = Command::runSessionCmd(&sess);
+      EXPECT_TRUE(expect.ok());
+      auto bulks = replyBulks(expect.value());
+      EXPECT_LE(bulks.size(), 8U);
+      cursor = bulks[0];
+      for (size_t i = 1; i < bulks.size(); ++i) {
+        EXPECT_EQ(bulks[i].substr(0, 5), "user:");
+        EXPECT_TRUE(keys.insert(bulks[i]).second);
+      }
+    } while (cursor != "0");
+    EXPECT_EQ(keys.size(), 100U);
+
+    // the hash tag pins the keys matched to one slot
+    for (uint32_t i = 0; i < 20; ++i) {
+      sess.setArgs({"set", "tag:{t}:" + std::to_string(i), "v"});
+      EXPECT_TRUE(Command::runSessionCmd(&sess).ok());
+    }
+    sess.setArgs({"keys", "tag:{t}:*"});
+    expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    EXPECT_EQ(replyBulks(expect.value()).size(), 20U);
+
+    keys.clear();
+    cursor = "0";
+    do {
+      sess.setArgs({"scan", cursor, "match", "tag:{t}:*", "count", "7"});
+      expect = Command::runSessionCmd(&sess);
+      EXPECT_TRUE(expect.ok());
+      auto bulks = replyBulks(expect.value());
+      cursor = bulks[0];
+      for (size_t i = 1; i < bulks.size(); ++i) {
+        EXPECT_EQ(bulks[i].substr(0, 8), "tag:{t}:");
+        EXPECT_TRUE(keys.insert(bulks[i]).second);
+      }
+    } while (cursor != "0");
+    EXPECT_EQ(keys.size(), 20U);
+
+    // all the kvstores of a page share one scanMaxTimes
+    cfg->scanDefaultMaxIterateTimes = 10;
+    keys.clear();
+    cursor = "0";
+    do {
+      sess.getCtx()->resetStatisticInfo();
+      sess.setArgs({"scan", cursor, "match", "user:*", "count", "1000"});
+      expect = Command::runSessionCmd(&sess);
+      EXPECT_TRUE(expect.ok());
+      auto log = sess.getCtx()->generateScanRecordLogIfNeeded();
+      auto examined = log.substr(std::string("Scan_examined: ").size());
+      EXPECT_LE(std::stoul(examined), 10U);
+      auto bulks = replyBulks(expect.value());
+      cursor = bulks[0];
+      for (size_t i = 1; i < bulks.size(); ++i) {
+        EXPECT_EQ(bulks[i].substr(0, 5), "user:");
+        EXPECT_TRUE(keys.insert(bulks[i]).second);
+      }
+    } while (cursor != "0");
+    EXPECT_EQ(keys.size(), 100U);
+  }
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+TEST(Command, canRunInline) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  auto server = makeServerEntry(cfg);
+
+  {
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext), socket2(ioContext);
+    NoSchedNetSession sess(
+      server, std::move(socket), 1, false, nullptr, nullptr);
+    NoSchedNetSession sess2(
+      server, std::move(socket2), 1, false, nullptr, nullptr);
+    sess.setArgs({"set", "k", "v"});
+    EXPECT_TRUE(Command::runSessionCmd(&sess).ok());
+    sess.setArgs({"set", "e", "v", "px", "1"});
+    EXPECT_TRUE(Command::runSessionCmd(&sess).ok());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::unique_ptr<KeyLock> keyLock;
+    sess.setArgs({"set", "k", "v"});
+    EXPECT_FALSE(Command::canRunInline(&sess, &keyLock));
+
+    // the key lock is kept for the command
+    sess.setArgs({"get", "k"});
+    EXPECT_TRUE(Command::canRunInline(&sess, &keyLock));
+    EXPECT_NE(keyLock, nullptr);
+    keyLock.reset();
+
+    // the key is locked by another session, never wait for it
+    auto segMgr = server->getSegmentMgr();
+    uint32_t chunkId = redis_port::keyHashSlot("k", 1) % segMgr->getChunkSize();
+    auto elk = KeyLock::AquireKeyLock(segMgr->getStoreid(chunkId),
+                                      chunkId,
+                                      "k",
+                                      mgl::LockMode::LOCK_X,
+                                      &sess2,
+                                      server->getMGLockMgr());
+    EXPECT_TRUE(elk.ok());
+    EXPECT_FALSE(Command::canRunInline(&sess, &keyLock));
+    EXPECT_EQ(keyLock, nullptr);
+    elk.value().reset();
+
+    // the expired key is deleted by the worker pool
+    sess.setArgs({"get", "e"});
+    EXPECT_FALSE(Command::canRunInline(&sess, &keyLock));
+    EXPECT_EQ(keyLock, nullptr);
+  }
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+TEST(Command, planScanPattern) {
+  auto plan = Command::planScanPattern("user:*");
+  EXPECT_EQ(plan.prefix, "user:");
+  EXPECT_EQ(plan.slot, -1);
+
+  plan = Command::planScanPattern("user:{123}:*");
+  EXPECT_EQ(plan.prefix, "user:{123}:");
+  EXPECT_EQ(plan.slot, (int32_t)redis_port::keyHashSlot("123", 3));
+
+  // the hash tag isn't literal
+  plan = Command::planScanPattern("user:{1*}:*");
+  EXPECT_EQ(plan.prefix, "user:{1");
+  EXPECT_EQ(plan.slot, -1);
+
+  plan = Command::planScanPattern("*");
+  EXPECT_EQ(plan.prefix, "");
+  EXPECT_EQ(plan.slot, -1);
+
+  EXPECT_EQ(Command::prefixUpperBound("ab"), "ac");
+  EXPECT_EQ(Command::prefixUpperBound(std::string("a\xff", 2)), "b");
+  EXPECT_EQ(Command::prefixUpperBound(std::string("\xff\xff", 2)), "");
+}
+
 TEST(Command, common_scan) {
   const auto guard = MakeGuard([] { destroyEnv(); });
 
@@ -1973,7 +2230,10 @@ TEST(Command, info) {
     {"info", "rocksdbstats"},
     {"info", "rocksdbperfstats"},
     {"info", "rocksdbbgerror"},
+    {"info", "latencystats"},
     {"info", "invalid"},  // it's ok
+    {"latency", "histogram"},
+    {"latency", "histogram", "set", "lock_key", "invalid"},
     {"rocksproperty", "rocksdb.base-level", "0"},
     {"rocksproperty", "all", "0"},
     {"rocksproperty", "rocksdb.base-level"},
@@ -1998,7 +2258,10 @@ TEST(Command, info) {
     {{"config", "resetstat", "commandstats"}, Command::fmtOK()},
     {{"config", "resetstat", "stats"}, Command::fmtOK()},
     {{"config", "resetstat", "rocksdbstats"}, Command::fmtOK()},
+    {{"config", "resetstat", "latencystats"}, Command::fmtOK()},
     {{"config", "resetstat", "invalid"}, Command::fmtOK()},  // it's ok
+    {{"config", "resetstat", "commandstats"}, Command::fmtOK()},
+    {{"echo", "a"}, Command::fmtBulk("a")},
     {{"novadbadmin", "sleep", "1"}, Command::fmtOK()},
     {{"novadbadmin", "recovery"}, Command::fmtOK()},
   };
@@ -2016,12 +2279,27 @@ TEST(Command, info) {
     {"novadbadmin", "sleep", "1", "2"},
     {"novadbadmin", "recovery", "1"},
     {"novadbadmin", "invalid"},
+    {"latency", "invalid"},
   };
 
   testCommandArray(server, correctArr, false);
   testCommandArrayResult(server, okArr);
   testCommandArray(server, wrongArr, true);
 
+  // the single echo since the resetstat takes one bucket
+  {
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext);
+    NetSession sess(server, std::move(socket), 1, false, nullptr, nullptr);
+    sess.setArgs({"latency", "histogram", "echo"});
+    auto expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    std::string prefix =
+      "*2\r\n$4\r\necho\r\n*4\r\n$5\r\ncalls\r\n:1\r\n"
+      "$14\r\nhistogram_usec\r\n*2\r\n";
+    EXPECT_EQ(expect.value().substr(0, prefix.size()), prefix);
+  }
+
 #ifndef _WIN32
   server->stop();
   EXPECT_EQ(server.use_count(), 1);
@@ -2127,6 +2405,132 @@ TEST(Command, revision) {
 #endif
 }
 
+void testPipelineBatch(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext), socket2(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+  NetSession sess2(svr, std::move(socket2), 1, false, nullptr, nullptr);
+
+  sess.getCtx()->setPipelineBatch(true);
+  sess.setArgs({"hset", "pipeline_h", "f", "v1"});
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+
+  // readonly commands reuse the txns kept from the previous ones
+  for (int i = 0; i < 3; i++) {
+    sess.setArgs({"hget", "pipeline_h", "f"});
+    expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    EXPECT_EQ(expect.value(), Command::fmtBulk("v1"));
+  }
+
+  // a kept txn still sees the writes of other sessions
+  sess2.setArgs({"hset", "pipeline_h", "f", "v2"});
+  expect = Command::runSessionCmd(&sess2);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"hget", "pipeline_h", "f"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtBulk("v2"));
+
+  // and a write drops them
+  sess.setArgs({"hset", "pipeline_h", "f", "v3"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"hget", "pipeline_h", "f"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtBulk("v3"));
+  sess.getCtx()->setPipelineBatch(false);
+}
+
+void testListRangeRead(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  // long enough for the range reads to take several batches
+  std::vector<std::string> expected;
+  std::vector<std::string> args = {"rpush", "rangelist"};
+  for (int i = 0; i < 3000; i++) {
+    expected.emplace_back(i % 1000 == 500 ? "dup" : std::to_string(i));
+    args.emplace_back(expected.back());
+  }
+  sess.setArgs(args);
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+
+  auto checkRange = [&sess](const std::vector<std::string>& list,
+                            int64_t start,
+                            int64_t end) {
+    sess.setArgs(
+      {"lrange", "rangelist", std::to_string(start), std::to_string(end)});
+    auto expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    std::stringstream ss;
+    Command::fmtMultiBulkLen(ss, end - start + 1);
+    for (int64_t i = start; i <= end; i++) {
+      Command::fmtBulk(ss, list[i]);
+    }
+    EXPECT_EQ(expect.value(), ss.str());
+  };
+  checkRange(expected, 0, expected.size() - 1);
+  checkRange(expected, 1030, 2047);
+  checkRange(expected, 2999, 2999);
+
+  // removing from the tail reads the list backward
+  sess.setArgs({"lrem", "rangelist", "-2", "dup"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtLongLong(2));
+  expected.erase(expected.begin() + 2500);
+  expected.erase(expected.begin() + 1500);
+  checkRange(expected, 0, expected.size() - 1);
+
+  sess.setArgs({"linsert", "rangelist", "before", "2990", "new"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtLongLong(2999));
+  expected.insert(expected.begin() + 2988, "new");
+  checkRange(expected, 0, expected.size() - 1);
+
+  sess.setArgs({"linsert", "rangelist", "after", "3", "new"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  expected.insert(expected.begin() + 4, "new");
+  checkRange(expected, 0, expected.size() - 1);
+}
+
+TEST(Command, listRangeRead) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  auto server = makeServerEntry(cfg);
+
+  testListRangeRead(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+TEST(Command, pipelineBatch) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  auto server = makeServerEntry(cfg);
+
+  testPipelineBatch(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
 // NOTE(tanninzhu) restorevalue command will return multi response,
 // it's only for redis-sync, we fix sendbuffer structure, cant support it,
 // so we dont use this test
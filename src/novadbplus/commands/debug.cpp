@@ -9,6 +9,8 @@
 #endif
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
 #include <chrono>
 #include <clocale>
@@ -107,83 +109,166 @@ class KeysCommand : public Command {
                                           : myself->getMaster()->getSlots();
     }
 
-    std::list<std::string> result;
-    for (ssize_t i = 0; i < server->getKVStoreCount(); i++) {
-      auto expdb =
-        server->getSegmentMgr()->getDb(sess, i, mgl::LockMode::LOCK_IS);
-      if (!expdb.ok()) {
-        if (expdb.status().code() == ErrorCodes::ERR_STORE_NOT_OPEN) {
-          continue;
-        }
-        return expdb.status();
-      }
-
-      PStore kvstore = expdb.value().store;
-      auto ptxn = sess->getCtx()->createTransaction(kvstore);
-      if (!ptxn.ok()) {
-        return ptxn.status();
+    auto dbId = sess->getCtx()->getDbId();
+    uint32_t chunkSize = server->getSegmentMgr()->getChunkSize();
+    bool noexpire = server->getParams()->noexpire;
+    auto plan = Command::planScanPattern(pattern);
+    const auto& prefix = plan.prefix;
+    // the keys found by all the kvstores, not more than limit
+    std::atomic<uint64_t> found(0);
+    // the bytes formatted by all the kvstores, they stop as soon as the
+    // reply is over client-output-buffer-limit-normal-hard-mb
+    std::atomic<uint64_t> bytes(0);
+    uint64_t maxBytes = sess->getType() == Session::Type::NET
+      ? server->getParams()->clientOutputBufferLimitNormalHardMB << 20
+      : 0;
+    std::atomic<bool> overflow(false);
+    std::vector<uint32_t> storeIds;
+    uint32_t firstChunkId = 0;
+    if (plan.slot >= 0) {
+      // all the keys matched are in the slot of the hash tag
+      firstChunkId = plan.slot;
+      chunkSize = plan.slot + 1;
+      storeIds.push_back(server->getSegmentMgr()->getStoreid(plan.slot));
+    } else {
+      for (uint32_t i = 0; i < server->getKVStoreCount(); i++) {
+        storeIds.push_back(i);
       }
-      auto cursor = ptxn.value()->createDataCursor();
+    }
+    std::vector<StoreKeys> storeKeys(storeIds.size());
 
-      cursor->seek("");
-      while (true) {
-        Expected<Record> exptRcd = cursor->next();
-        if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
-          break;
-        }
-        if (!exptRcd.ok()) {
-          return exptRcd.status();
-        }
-        if (exptRcd.value().getRecordKey().getDbId() !=
-            sess->getCtx()->getDbId()) {
-          continue;
-        }
-        auto keyType = exptRcd.value().getRecordKey().getRecordType();
-        // NOTE(vinchen):
-        // RecordType::RT_TTL_INDEX and RecordType::BINLOG
-        // is always at the last of rocksdb, and the chunkid is very big
-        auto chunkId = exptRcd.value().getRecordKey().getChunkId();
-        if (chunkId >= server->getSegmentMgr()->getChunkSize()) {
-          break;
-        }
-        // NOTE(wayenchen) ignore slot not belong to me
-        if (enableCluster && !checkSlots.test(chunkId)) {
-          continue;
+    // NOTE: the meta keys of a chunk and db are adjacent and ordered by the
+    // primary key, so the keys with the literal prefix of the pattern are
+    // found by one seek per chunk, and the subkeys are never read.
+    auto results = Command::parallelForStores(
+      sess, storeIds, [&](size_t i, Transaction* txn) -> Status {
+        std::stringstream ss;
+        std::unique_ptr<BasicDataCursor> cursor;
+        if (plan.slot >= 0) {
+          RecordKey rk(plan.slot, dbId, RecordType::RT_DATA_META, prefix, "");
+          cursor = txn->createRangeDataCursor(Command::prefixUpperBound(
+            rk.prefixPk().substr(0, RecordKey::getHdrSize() + prefix.size())));
+        } else {
+          cursor = txn->createDataCursor();
         }
+        uint32_t chunkId = firstChunkId;
+        while (chunkId < chunkSize && found.load() < (uint64_t)limit &&
+               !overflow.load()) {
+          // NOTE(wayenchen) ignore slot not belong to me
+          if (enableCluster && !checkSlots.test(chunkId)) {
+            chunkId++;
+            continue;
+          }
+          RecordKey rk(chunkId, dbId, RecordType::RT_DATA_META, prefix, "");
+          cursor->seek(
+            rk.prefixPk().substr(0, RecordKey::getHdrSize() + prefix.size()));
+
+          uint32_t nextChunkId = chunkSize;
+          while (true) {
+            Expected<Record> exptRcd = cursor->next();
+            if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+              break;
+            }
+            RET_IF_ERR_EXPECTED(exptRcd);
+            storeKeys[i].examined++;
+            const auto& recordKey = exptRcd.value().getRecordKey();
+            const auto& key = recordKey.getPrimaryKey();
+            if (recordKey.getChunkId() != chunkId ||
+                recordKey.getRecordType() != RecordType::RT_DATA_META ||
+                recordKey.getDbId() != dbId ||
+                key.compare(0, prefix.size(), prefix) != 0) {
+              // skip the chunks without any key
+              nextChunkId = std::max(recordKey.getChunkId(), chunkId + 1);
+              break;
+            }
 
-        auto key = exptRcd.value().getRecordKey().getPrimaryKey();
+            if (!allkeys && !redis_port::stringmatchlen(pattern.c_str(),
+                                                        pattern.size(),
+                                                        key.c_str(),
+                                                        key.size(),
+                                                        0)) {
+              continue;
+            }
 
-        if (!allkeys &&
-            !redis_port::stringmatchlen(
-              pattern.c_str(), pattern.size(), key.c_str(), key.size(), 0)) {
-          continue;
+            auto ttl = exptRcd.value().getRecordValue().getTtl();
+            if (!noexpire && ttl != 0 && ttl < ts) {  // skip the expired key
+              continue;
+            }
+            if (found.fetch_add(1) >= (uint64_t)limit) {
+              break;
+            }
+            auto before = ss.tellp();
+            Command::fmtBulk(ss, key);
+            storeKeys[i].count++;
+            if (maxBytes &&
+                bytes.fetch_add(ss.tellp() - before) >= maxBytes) {
+              overflow = true;
+              break;
+            }
+          }
+          chunkId = nextChunkId;
         }
-
-        auto ttl = exptRcd.value().getRecordValue().getTtl();
-        if (keyType != RecordType::RT_DATA_META ||
-            (!server->getParams()->noexpire && ttl != 0 &&
-             ttl < ts)) {  // skip the expired key
+        storeKeys[i].reply = ss.str();
+        return {ErrorCodes::ERR_OK, ""};
+      });
+
+    uint64_t count = 0;
+    uint64_t size = 0;
+    uint64_t examined = 0;
+    for (size_t i = 0; i < storeIds.size(); i++) {
+      examined += storeKeys[i].examined;
+      if (!results[i].ok()) {
+        if (results[i].code() == ErrorCodes::ERR_STORE_NOT_OPEN) {
           continue;
         }
-        RET_IF_MEMORY_REQUEST_FAILED(sess, key.size());
-        result.emplace_back(std::move(key));
-        if (result.size() >= (size_t)limit) {
-          break;
-        }
-      }
-      if (result.size() >= (size_t)limit) {
-        break;
+        return results[i];
       }
+      count += storeKeys[i].count;
+      size += storeKeys[i].reply.size();
     }
+    sess->getCtx()->addScanRecord(examined, count);
+    if (overflow.load()) {
+      return {ErrorCodes::ERR_MEMORY_LIMIT, ""};
+    }
+    RET_IF_MEMORY_REQUEST_FAILED(sess, size);
 
     std::stringstream ss;
-    Command::fmtMultiBulkLen(ss, result.size());
-    for (const auto& v : result) {
-      RET_IF_MEMORY_REQUEST_FAILED(sess, v.size());
-      Command::fmtBulk(ss, v);
+    Command::fmtMultiBulkLen(ss, count);
+    std::vector<std::string> pieces;
+    pieces.emplace_back(ss.str());
+    for (auto& keys : storeKeys) {
+      if (!keys.reply.empty()) {
+        pieces.emplace_back(std::move(keys.reply));
+      }
     }
-    return ss.str();
+    // NOTE: the keys of each kvstore are sent as they are, rather than
+    // copied into one reply. The scripts take the reply as a whole.
+    if (sess->getType() != Session::Type::NET || sess->isInLua()) {
+      std::string reply;
+      reply.reserve(size + pieces[0].size());
+      for (const auto& piece : pieces) {
+        reply.append(piece);
+      }
+      return reply;
+    }
+    // the pieces but the last are taken all or none, so the array is never
+    // cut short by an error reply
+    std::string reply = std::move(pieces.back());
+    pieces.pop_back();
+    if (!pieces.empty()) {
+      RET_IF_ERR(sess->takeResponses(std::move(pieces)));
+    }
+    return reply;
   }
+
+ private:
+  // the keys found in one kvstore, formatted as bulks
+  struct StoreKeys {
+    std::string reply;
+    uint64_t count = 0;
+    // the records read, for the slowlog
+    uint64_t examined = 0;
+  };
 } keysCmd;
 
 class DbsizeCommand : public Command {
@@ -226,7 +311,6 @@ class DbsizeCommand : public Command {
     auto currentDbid = sess->getCtx()->getDbId();
     auto ts = msSinceEpoch();
 
-    // TODO(vinchen): should use a faster way
     std::list<std::string> result;
 
     std::bitset<CLUSTER_SLOTS> checkSlots;
@@ -248,6 +332,21 @@ class DbsizeCommand : public Command {
       }
 
       PStore kvstore = expdb.value().store;
+      // NOTE: the counters count the expired keys not deleted yet, the same
+      // as containexpire
+      if (!containSubkey &&
+          (containExpire || server->getParams()->dbsizeByKeyCount) &&
+          kvstore->isKeyCountReady()) {
+        auto counts = kvstore->getKeyCounts(currentDbid);
+        RET_IF_ERR_EXPECTED(counts);
+        for (const auto& kv : counts.value()) {
+          if (enableCluster && !checkSlots.test(kv.first)) {
+            continue;
+          }
+          size += kv.second;
+        }
+        continue;
+      }
       // NOTE(takenliu): dbsizeCmmand and flushallCommand has confliction,
       //   so we use kvstore->createTransaction() instead of
       //   getCtx()->createTransaction(),
@@ -720,6 +819,9 @@ class IterAllCommand : public Command {
         auto key = exptRcd.value().getRecordKey().getPrimaryKey();
         RecordKey mk(chunkId, dbid, RecordType::RT_DATA_META, key, "");
         Expected<RecordValue> eValue = kvstore->getKV(mk, ptxn.value());
+        if (rcd_util::isStaleSubKey(exptRcd.value().getRecordKey(), eValue)) {
+          continue;
+        }
         if (eValue.ok()) {
           targetTtl = eValue.value().getTtl();
         } else {
@@ -1991,6 +2093,30 @@ class ClientCommand : public Command {
   }
 } clientCmd;
 
+// the latency histograms(us) which don't belong to a command
+static std::vector<std::pair<std::string, LatencyHistogram*>>
+otherLatencyHistograms() {
+  static const std::array<std::string, LockLatencyType::MAX_LLT> lockNames{
+    "lock_store", "lock_chunk", "lock_key"};
+  static const std::array<std::string, RocksdbLatencyType::MAX_RLT>
+    rocksdbNames{
+      "rocksdb_put", "rocksdb_get", "rocksdb_delete", "rocksdb_commit"};
+
+  std::vector<std::pair<std::string, LatencyHistogram*>> hists;
+  for (uint8_t i = 0; i < LockLatencyType::MAX_LLT; ++i) {
+    hists.emplace_back(lockNames[i],
+                       &lockLatencyHistogram(static_cast<LockLatencyType>(i)));
+  }
+  for (uint8_t i = 0; i < RocksdbLatencyType::MAX_RLT; ++i) {
+    hists.emplace_back(
+      rocksdbNames[i],
+      &rocksdbLatencyHistogram(static_cast<RocksdbLatencyType>(i)));
+  }
+  hists.emplace_back("pool_queue", &poolQueueLatencyHistogram());
+  hists.emplace_back("send_packet", &sendPacketLatencyHistogram());
+  return hists;
+}
+
 class InfoCommand : public Command {
  public:
   InfoCommand() : Command("info", "lt") {}
@@ -2041,6 +2167,7 @@ class InfoCommand : public Command {
     infoBinlogInfo(allsections, defsections, section, sess, result);
     infoCPU(allsections, defsections, section, sess, result);
     infoCommandStats(allsections, defsections, section, sess, result);
+    infoLatencyStats(allsections, defsections, section, sess, result);
     infoCluster(allsections, defsections, section, sess, result);
     infoKeyspace(allsections, defsections, section, sess, result);
     infoBackup(allsections, defsections, section, sess, result);
@@ -2367,6 +2494,35 @@ class InfoCommand : public Command {
     }
   }
 
+  static void infoLatencyStats(bool allsections,
+                               bool defsections,
+                               const std::string& section,
+                               Session* sess,
+                               std::stringstream& result) {
+    if (allsections || section == "latencystats") {
+      std::stringstream ss;
+      ss << "# Latencystats\r\n";
+      auto fmtPercentiles = [&ss](const std::string& name,
+                                  const LatencyHistogram& hist) {
+        auto snap = hist.snapshot();
+        if (snap.count == 0) {
+          return;
+        }
+        ss << "latency_percentiles_usec_" << name
+           << ":p50=" << snap.percentile(50) << ",p99=" << snap.percentile(99)
+           << ",p99.9=" << snap.percentile(99.9) << "\r\n";
+      };
+      for (const auto& kv : commandMap()) {
+        fmtPercentiles(kv.first, kv.second->getLatencyHistogram());
+      }
+      for (const auto& kv : otherLatencyHistograms()) {
+        fmtPercentiles(kv.first, *kv.second);
+      }
+      ss << "\r\n";
+      result << ss.str();
+    }
+  }
+
   static void infoKeyspace(bool allsections,
                            bool defsections,
                            const std::string& section,
@@ -2455,6 +2611,10 @@ class InfoCommand : public Command {
         server->getStatCountByName(sess, "rocksdb.compaction-filter-count");
       auto expire_count =
         server->getStatCountByName(sess, "rocksdb.compaction-kv-expired-count");
+      auto subkey_expire_count = server->getStatCountByName(
+        sess, "rocksdb.compaction-subkey-expired-count");
+      bool valueCacheEnabled = server->getParams()->valueCacheMB > 0;
+      bool metaCacheEnabled = server->getParams()->compactionMetaCacheMB > 0;
 
       uint64_t blockUsage = server->getBlockCache()->GetUsage();
       uint64_t blockPinnedUsage = server->getBlockCache()->GetPinnedUsage();
@@ -2484,6 +2644,24 @@ class InfoCommand : public Command {
         ss << "rocksdb.rowcache.usage:" << rowUsage << "\r\n";
         ss << "rocksdb.rowcache.pinnedusage:" << rowPinnedUsage << "\r\n";
       }
+      if (valueCacheEnabled) {
+        for (auto name : {"valuecache.capacity",
+                          "valuecache.usage",
+                          "valuecache.hits",
+                          "valuecache.misses"}) {
+          ss << name << ":" << server->getStatCountByName(sess, name)
+             << "\r\n";
+        }
+      }
+      if (metaCacheEnabled) {
+        for (auto name : {"metacache.capacity",
+                          "metacache.usage",
+                          "metacache.hits",
+                          "metacache.misses"}) {
+          ss << name << ":" << server->getStatCountByName(sess, name)
+             << "\r\n";
+        }
+      }
       ss << "rocksdb.mem-table-flush-pending:" << mem_pending << "\r\n";
       ss << "rocksdb.estimate-pending-compaction-bytes:" << compaction_pending
          << "\r\n";
@@ -2491,6 +2669,8 @@ class InfoCommand : public Command {
       ss << "rocksdb.number.iter.skip:" << iter_skip << "\r\n";
       ss << "rocksdb.compaction-filter-count:" << filter_count << "\r\n";
       ss << "rocksdb.compaction-kv-expired-count:" << expire_count << "\r\n";
+      ss << "rocksdb.compaction-subkey-expired-count:" << subkey_expire_count
+         << "\r\n";
       ss << "\r\n";
       result << ss.str();
     }
@@ -2797,6 +2977,20 @@ class ObjectCommand : public Command {
       if (arg1 == "refcount") {
         return Command::fmtOne();
       } else if (arg1 == "encoding") {
+        if (vt == RecordType::RT_HASH_META) {
+          auto eMeta = HashMetaValue::decode(rv.value().getValue());
+          RET_IF_ERR_EXPECTED(eMeta);
+          if (eMeta.value().isCompact()) {
+            return Command::fmtBulk("ziplist");
+          }
+        } else if (vt == RecordType::RT_ZSET_META) {
+          auto eMeta = ZSlMetaValue::decode(rv.value().getValue());
+          RET_IF_ERR_EXPECTED(eMeta);
+          if (eMeta.value().getEncoding() ==
+              ZSlMetaValue::Encoding::ENCODING_ORDERED) {
+            return Command::fmtBulk("ordered");
+          }
+        }
         return Command::fmtBulk(m.at(vt));
       } else if (arg1 == "idletime") {
         return Command::fmtLongLong(0);
@@ -2921,6 +3115,12 @@ class ConfigCommand : public Command {
         kv.second->resetStatInfo();
       }
     }
+    if (reset_all || configName == "latencystats") {
+      LOG(INFO) << "reset latencystats";
+      for (const auto& kv : otherLatencyHistograms()) {
+        kv.second->reset();
+      }
+    }
     if (reset_all || configName == "stats") {
       LOG(INFO) << "reset stats";
       std::stringstream ss;
@@ -3770,6 +3970,97 @@ class slowlogCommand : public Command {
   }
 } slowlogCmd;
 
+class LatencyCommand : public Command {
+ public:
+  LatencyCommand() : Command("latency", "as") {}
+
+  ssize_t arity() const {
+    return -2;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  bool sameWithRedis() const {
+    return false;
+  }
+
+  // name, calls, and the cumulative count of each non-empty bucket
+  static void fmtHistogram(std::stringstream& ss,
+                           const std::string& name,
+                           const LatencyHistogram::Snapshot& snap) {
+    uint32_t buckets = 0;
+    for (auto cnt : snap.counts) {
+      buckets += cnt != 0;
+    }
+    Command::fmtBulk(ss, name);
+    Command::fmtMultiBulkLen(ss, 4);
+    Command::fmtBulk(ss, "calls");
+    Command::fmtLongLong(ss, snap.count);
+    Command::fmtBulk(ss, "histogram_usec");
+    Command::fmtMultiBulkLen(ss, buckets * 2);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+      if (snap.counts[i] == 0) {
+        continue;
+      }
+      seen += snap.counts[i];
+      Command::fmtLongLong(ss, LatencyHistogram::bucketHigh(i));
+      Command::fmtLongLong(ss, seen);
+    }
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    const auto& args = sess->getArgs();
+    if (toLower(args[1]) != "histogram") {
+      return {ErrorCodes::ERR_PARSEOPT,
+              "unknown subcommand, try LATENCY HISTOGRAM [name ...]"};
+    }
+
+    // without names, all the histograms with some calls are returned,
+    // unknown names are skipped
+    std::map<std::string, const LatencyHistogram*> hists;
+    for (const auto& kv : commandMap()) {
+      hists.emplace(kv.first, &kv.second->getLatencyHistogram());
+    }
+    for (const auto& kv : otherLatencyHistograms()) {
+      hists.emplace(kv.first, kv.second);
+    }
+    std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> snaps;
+    if (args.size() == 2) {
+      for (const auto& kv : hists) {
+        auto snap = kv.second->snapshot();
+        if (snap.count != 0) {
+          snaps.emplace_back(kv.first, snap);
+        }
+      }
+    } else {
+      for (size_t i = 2; i < args.size(); ++i) {
+        auto it = hists.find(toLower(args[i]));
+        if (it != hists.end()) {
+          snaps.emplace_back(it->first, it->second->snapshot());
+        }
+      }
+    }
+
+    std::stringstream ss;
+    Command::fmtMultiBulkLen(ss, snaps.size() * 2);
+    for (const auto& kv : snaps) {
+      fmtHistogram(ss, kv.first, kv.second);
+    }
+    return ss.str();
+  }
+} latencyCmd;
+
 class reshapeCommand : public Command {
  public:
   reshapeCommand() : Command("reshape", "sM") {}
@@ -3944,6 +4235,82 @@ class compactRangeCommand : public Command {
   }
 } compactRangeCmd;
 
+// recountkeys <kvstoreid>
+// count the keys of all the chunks again, the key counters of the store are
+// used after that, e.g. the stores written before the counters exist.
+class recountKeysCommand : public Command {
+ public:
+  recountKeysCommand() : Command("recountkeys", "as") {}
+
+  ssize_t arity() const {
+    return -1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    const auto server = sess->getServerEntry();
+    const auto& args = sess->getArgs();
+
+    if (args.size() > 2) {
+      return {ErrorCodes::ERR_PARSEOPT, "invalid recountkeys params"};
+    }
+    if (!server->getParams()->keyCountEnabled) {
+      return {ErrorCodes::ERR_INTERNAL,
+              "This instance has key count disabled"};
+    }
+
+    uint64_t i = 0;
+    uint64_t storeEndIndex = server->getKVStoreCount();
+    if (args.size() == 2) {
+      auto eStoreId = novadbplus::stoull(args[1]);
+      RET_IF_ERR_EXPECTED(eStoreId);
+      if (eStoreId.value() >= storeEndIndex) {
+        return {ErrorCodes::ERR_PARSEOPT, "invalid storeid"};
+      }
+
+      i = eStoreId.value();
+      storeEndIndex = i + 1;
+    }
+
+    auto chunkSize = server->getSegmentMgr()->getChunkSize();
+    for (; i < storeEndIndex; i++) {
+      auto expdb =
+        server->getSegmentMgr()->getDb(sess, i, mgl::LockMode::LOCK_IX);
+      RET_IF_ERR_EXPECTED(expdb);
+
+      PStore kvstore = expdb.value().store;
+      // NOTE: a chunk written after it is recounted has to be counted
+      kvstore->startKeyCount();
+      for (uint32_t chunkid = 0; chunkid < chunkSize; chunkid++) {
+        // NOTE: the writes of the chunk are blocked during the counting
+        auto lock = ChunkLock::AquireChunkLock(i,
+                                               chunkid,
+                                               mgl::LockMode::LOCK_X,
+                                               nullptr,
+                                               server->getMGLockMgr());
+        RET_IF_ERR_EXPECTED(lock);
+        auto s = kvstore->recountKeys(chunkid);
+        RET_IF_ERR(s);
+      }
+      auto s = kvstore->setKeyCountReady();
+      RET_IF_ERR(s);
+      LOG(INFO) << "recountKeys on store:" << i << " done";
+    }
+    return Command::fmtOK();
+  }
+} recountKeysCmd;
+
 // deleteFilesInRange [data|default|binlog] start end <kvstoreid>
 class deleteFilesInRangeGenericCommand : public Command {
  public:
@@ -4062,6 +4429,14 @@ class deleteFilesInRangeGenericCommand : public Command {
       LOG(INFO) << "deleteFilesInRange on store:" << i << " slots: [" << start
                 << ", " << end << "]";
       RET_IF_ERR(s);
+      // the files dropped are not counted by any txn, the slots are still
+      // locked here
+      for (uint32_t slot = start; slot <= end; slot++) {
+        if (server->getSegmentMgr()->getStoreid(slot) == i) {
+          s = expDb.value().store->recountKeys(slot);
+          RET_IF_ERR(s);
+        }
+      }
       i++;
     }
     return Command::fmtOK();
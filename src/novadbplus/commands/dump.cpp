@@ -14,7 +14,7 @@
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/storage/record.h"
-#include "novadbplus/storage/skiplist.h"
+#include "novadbplus/storage/zset_index.h"
 #include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/string.h"
 
@@ -528,7 +528,8 @@ class SetSerializer : public Serializer {
                      _sess->getCtx()->getDbId(),
                      RecordType::RT_SET_ELE,
                      _key,
-                     "");
+                     "",
+                     _rv.getVersion());
     cursor->seek(fakeRk.prefixPk());
     while (true) {
       Expected<Record> eRcd = cursor->next();
@@ -578,15 +579,19 @@ class ZsetSerializer : public Serializer {
       return eMeta.status();
     }
     ZSlMetaValue meta = eMeta.value();
-    SkipList zsl(
-      expdb.value().chunkId, _sess->getCtx()->getDbId(), _key, meta, kvstore);
-
-    auto expwr = saveLen(payload, &_pos, zsl.getCount() - 1);
+    auto zsl = createZsetIndex(expdb.value().chunkId,
+                               _sess->getCtx()->getDbId(),
+                               _key,
+                               meta,
+                               kvstore,
+                               _rv.getVersion());
+
+    auto expwr = saveLen(payload, &_pos, zsl->getCount() - 1);
     if (!expwr.ok()) {
       return expwr.status();
     }
 
-    auto rev = zsl.scanByRank(0, zsl.getCount() - 1, true, ptxn.value());
+    auto rev = zsl->scanByRank(0, zsl->getCount() - 1, true, ptxn.value());
     if (!rev.ok()) {
       return rev.status();
     }
@@ -619,6 +624,14 @@ class HashSerializer : public Serializer {
     if (!expwr.ok()) {
       return expwr.status();
     }
+    if (expHashMeta.value().isCompact()) {
+      for (const auto& field : expHashMeta.value().getFields()) {
+        Serializer::saveString(payload, &_pos, field.first);
+        Serializer::saveString(payload, &_pos, field.second);
+      }
+      _begin = 0;
+      return _pos - _begin;
+    }
 
     auto server = _sess->getServerEntry();
     auto expdb = server->getSegmentMgr()->getDbHasLocked(_sess, _key);
@@ -636,7 +649,8 @@ class HashSerializer : public Serializer {
                      _sess->getCtx()->getDbId(),
                      RecordType::RT_HASH_ELE,
                      _key,
-                     "");
+                     "",
+                     _rv.getVersion());
     auto cursor = ptxn.value()->createDataCursor();
     cursor->seek(fakeRk.prefixPk());
     while (true) {
@@ -1082,6 +1096,7 @@ class SetDeserializer : public Deserializer {
                      _key,
                      "");
     SetMetaValue sm;
+    uint64_t version = _sess->getCtx()->getKeyVersion();
 
     for (size_t i = 0; i < len; i++) {
       std::string ele = loadString(_payload, &_pos);
@@ -1089,7 +1104,8 @@ class SetDeserializer : public Deserializer {
                    metaRk.getDbId(),
                    RecordType::RT_SET_ELE,
                    metaRk.getPrimaryKey(),
-                   std::move(ele));
+                   std::move(ele),
+                   version);
       RecordValue rv("", RecordType::RT_SET_ELE, -1);
       Status s = kvstore->setKV(rk, rv, txn);
       if (!s.ok()) {
@@ -1101,7 +1117,9 @@ class SetDeserializer : public Deserializer {
                               RecordValue(sm.encode(),
                                           RecordType::RT_SET_META,
                                           _sess->getCtx()->getVersionEP(),
-                                          _ttl),
+                                          _ttl,
+                                          -1,
+                                          version),
                               txn);
     if (!s.ok()) {
       return s;
@@ -1151,26 +1169,26 @@ class ZsetDeserializer : public Deserializer {
       return eMeta.status();
     }
     INVARIANT_D(eMeta.status().code() == ErrorCodes::ERR_NOTFOUND);
-    ZSlMetaValue meta(1, 1, 0);
-    RecordValue rv(meta.encode(),
+    uint64_t version = _sess->getCtx()->getKeyVersion();
+    const auto& params = server->getParams();
+    auto eNewMeta = initZsetIndex(zsetEncodingFromStr(params->zsetEncoding),
+                                  rk,
+                                  version,
+                                  kvstore,
+                                  txn);
+    if (!eNewMeta.ok()) {
+      return eNewMeta.status();
+    }
+    RecordValue rv(eNewMeta.value().encode(),
                    RecordType::RT_ZSET_META,
                    _sess->getCtx()->getVersionEP(),
-                   _ttl);
+                   _ttl,
+                   -1,
+                   version);
     Status s = kvstore->setKV(rk, rv, txn);
     if (!s.ok()) {
       return s;
     }
-    RecordKey headRk(rk.getChunkId(),
-                     rk.getDbId(),
-                     RecordType::RT_ZSET_S_ELE,
-                     rk.getPrimaryKey(),
-                     std::to_string(ZSlMetaValue::HEAD_ID));
-    ZSlEleValue headVal;
-    RecordValue headRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
-    s = kvstore->setKV(headRk, headRv, txn);
-    if (!s.ok()) {
-      return s;
-    }
 
     for (int32_t i = 0; i < Command::RETRY_CNT; ++i) {
       // maybe very slow
@@ -1207,6 +1225,7 @@ class HashDeserializer : public Deserializer {
       return expdb.status();
     }
     PStore kvstore = expdb.value().store;
+    uint64_t version = _sess->getCtx()->getKeyVersion();
     for (size_t i = 0; i < len; i++) {
       std::string field = loadString(_payload, &_pos);
       std::string value = loadString(_payload, &_pos);
@@ -1215,7 +1234,8 @@ class HashDeserializer : public Deserializer {
                    _sess->getCtx()->getDbId(),
                    RecordType::RT_HASH_ELE,
                    _key,
-                   field);
+                   field,
+                   version);
       RecordValue rv(value, RecordType::RT_HASH_ELE, -1);
       Status s = kvstore->setKV(rk, rv, txn);
       if (!s.ok()) {
@@ -1233,7 +1253,9 @@ class HashDeserializer : public Deserializer {
     RecordValue metaRv(std::move(hashMeta.encode()),
                        RecordType::RT_HASH_META,
                        _sess->getCtx()->getVersionEP(),
-                       _ttl);
+                       _ttl,
+                       -1,
+                       version);
     Status s = kvstore->setKV(metaRk, metaRv, txn);
     if (!s.ok()) {
       return s;
@@ -1604,6 +1626,14 @@ class RestoreMetaCommand : public Command {
   }
 } restoremetaCommand;
 
+bool isCompactHashMeta(const RecordValue& rv) {
+  if (rv.getRecordType() != RecordType::RT_HASH_META) {
+    return false;
+  }
+  auto hMeta = HashMetaValue::decode(rv.getValue());
+  return hMeta.ok() && hMeta.value().isCompact();
+}
+
 Expected<std::string> recordList2Aof(const std::list<Record>& list) {
   if (list.size() == 0) {
     return std::string("");
@@ -1618,6 +1648,8 @@ Expected<std::string> recordList2Aof(const std::list<Record>& list) {
   uint64_t bitmapLen = 0;
   uint64_t maxId = 0;
   std::string bitmapStr;
+  // for compact hash
+  std::vector<HashMetaValue::Field> hashFields;
   switch (type) {
     case novadbplus::RecordType::RT_KV:
       INVARIANT_D(list.size() == 1);
@@ -1638,6 +1670,25 @@ Expected<std::string> recordList2Aof(const std::list<Record>& list) {
       Command::fmtBulk(ss, key);
       break;
 
+    case novadbplus::RecordType::RT_HASH_META: {
+      // NOTE: only a compact hash reaches here, as a single meta record
+      // carrying all of its fields inline.
+      INVARIANT_D(list.size() == 1);
+      auto hMeta =
+        HashMetaValue::decode(list.front().getRecordValue().getValue());
+      if (!hMeta.ok()) {
+        return hMeta.status();
+      }
+      if (!hMeta.value().isCompact()) {
+        return {ErrorCodes::ERR_INTERNAL, "hash meta is not compact"};
+      }
+      hashFields = hMeta.value().getFields();
+      Command::fmtMultiBulkLen(ss, 2 + hashFields.size() * 2);
+      Command::fmtBulk(ss, "HMSET");
+      Command::fmtBulk(ss, key);
+      break;
+    }
+
     case novadbplus::RecordType::RT_SET_ELE:
       Command::fmtMultiBulkLen(ss, 2 + list.size());
       Command::fmtBulk(ss, "SADD");
@@ -1693,6 +1744,13 @@ Expected<std::string> recordList2Aof(const std::list<Record>& list) {
         Command::fmtBulk(ss, rtValue.getValue());
         break;
 
+      case novadbplus::RecordType::RT_HASH_META:
+        for (const auto& field : hashFields) {
+          Command::fmtBulk(ss, field.first);
+          Command::fmtBulk(ss, field.second);
+        }
+        break;
+
       case novadbplus::RecordType::RT_SET_ELE:
         Command::fmtBulk(ss, rtKey.getSecondaryKey());
         break;
@@ -1789,15 +1847,21 @@ Expected<std::string> key2Aof(Session* sess, const std::string& key) {
     result.emplace_back(mk, eValue.value());
   }
 
+  bool compact = isCompactHashMeta(eValue.value());
+  if (compact) {
+    result.emplace_back(mk, eValue.value());
+  }
+
   auto type = eValue.value().getEleType();
 
-  RecordKey fakeEle(expdb.value().chunkId, dbid, type, key, "");
+  RecordKey fakeEle(
+    expdb.value().chunkId, dbid, type, key, "", eValue.value().getVersion());
   std::string prefix = fakeEle.prefixPk();
   auto cursor = ptxn.value()->createDataCursor();
   cursor->seek(prefix);
 
   uint64_t count = 0;
-  while (true) {
+  while (!compact) {
     Expected<Record> exptRcd = cursor->next();
     if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
       break;
@@ -1883,8 +1947,12 @@ class RestoreValueCommand : public Command {
     auto ptxn = sess->getCtx()->createTransaction(kvstore);
     RET_IF_ERR_EXPECTED(ptxn);
 
-    RecordKey fakeEle(
-      slotId, pCtx->getDbId(), rv.value().getEleType(), key, "");
+    RecordKey fakeEle(slotId,
+                      pCtx->getDbId(),
+                      rv.value().getEleType(),
+                      key,
+                      "",
+                      rv.value().getVersion());
     std::string prefix = fakeEle.prefixPk();
     auto cursor = ptxn.value()->createDataCursor();
     cursor->seek(prefix);
@@ -1902,7 +1970,13 @@ class RestoreValueCommand : public Command {
     /* 2. set/hmset/sadd/rpush/zadd *n */
     std::list<Record> result;
     uint64_t count = 0;
-    while (true) {
+    bool compact = isCompactHashMeta(rv.value());
+    if (compact) {
+      RecordKey mk(slotId, pCtx->getDbId(), RecordType::RT_DATA_META, key, "");
+      result.emplace_back(mk, rv.value());
+      count = rv.value().getEleCnt();
+    }
+    while (!compact) {
       Expected<Record> exptRcd = cursor->next();
       if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
         break;
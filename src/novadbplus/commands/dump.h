@@ -189,6 +189,7 @@ Expected<std::unique_ptr<Deserializer>> getDeserializer(
   const std::string& key,
   const uint64_t ttl);
 
+bool isCompactHashMeta(const RecordValue& rv);
 Expected<std::string> recordList2Aof(const std::list<Record>& list);
 Expected<std::string> key2Aof(Session* sess, const std::string& key);
 
@@ -258,7 +258,7 @@ class GenericTtlCommand : public Command {
 
 class TtlCommand : public GenericTtlCommand {
  public:
-  TtlCommand() : GenericTtlCommand("ttl", "rF") {}
+  TtlCommand() : GenericTtlCommand("ttl", "rFi") {}
 
   ssize_t arity() const {
     return 2;
@@ -279,7 +279,7 @@ class TtlCommand : public GenericTtlCommand {
 
 class PTtlCommand : public GenericTtlCommand {
  public:
-  PTtlCommand() : GenericTtlCommand("pttl", "rF") {}
+  PTtlCommand() : GenericTtlCommand("pttl", "rFi") {}
 
   ssize_t arity() const {
     return 2;
@@ -300,7 +300,7 @@ class PTtlCommand : public GenericTtlCommand {
 
 class ExistsCommand : public Command {
  public:
-  ExistsCommand() : Command("exists", "rFc") {}
+  ExistsCommand() : Command("exists", "rFci") {}
 
   ssize_t arity() const {
     return -2;
@@ -331,11 +331,10 @@ class ExistsCommand : public Command {
       return locklist.status();
     }
 
-    for (size_t j = 1; j < args.size(); j++) {
-      const std::string& key = args[j];
-
-      Expected<RecordValue> rv =
-        Command::expireKeyIfNeeded(sess, key, RecordType::RT_DATA_META);
+    std::vector<std::string> keys(args.begin() + 1, args.end());
+    auto values =
+      Command::expireKeysIfNeeded(sess, keys, RecordType::RT_DATA_META);
+    for (const auto& rv : values) {
       if (rv.status().code() == ErrorCodes::ERR_EXPIRED) {
         continue;
       } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -351,7 +350,7 @@ class ExistsCommand : public Command {
 
 class TypeCommand : public Command {
  public:
-  TypeCommand() : Command("type", "rF") {}
+  TypeCommand() : Command("type", "rFi") {}
 
   ssize_t arity() const {
     return 2;
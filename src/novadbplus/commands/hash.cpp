@@ -19,10 +19,141 @@
 
 namespace novadbplus {
 
+// NOTE: HashFields reads and writes the fields of a hash in both the
+// compact and the plain encoding of HashMetaValue. An empty hash starts
+// compact if hashMaxCompactEntries > 0, and moves its fields to
+// RT_HASH_ELE records once it grows past the limits. The caller writes
+// the meta value after the changes.
+class HashFields {
+ public:
+  HashFields(Session* sess,
+             PStore kvstore,
+             Transaction* txn,
+             const RecordKey& metaRk,
+             const Expected<RecordValue>& eValue,
+             HashMetaValue* meta)
+    : _kvstore(kvstore),
+      _txn(txn),
+      _metaRk(metaRk),
+      _version(
+        Command::getSubKeyVersion(sess, eValue, RecordType::RT_HASH_META)),
+      _meta(meta) {
+    const auto& params = sess->getServerEntry()->getParams();
+    _maxEntries = params->hashMaxCompactEntries;
+    _maxValue = params->hashMaxCompactValue;
+  }
+
+  RecordKey subKey(const std::string& field) const {
+    return RecordKey(_metaRk.getChunkId(),
+                     _metaRk.getDbId(),
+                     RecordType::RT_HASH_ELE,
+                     _metaRk.getPrimaryKey(),
+                     field,
+                     _version);
+  }
+
+  // the caller should write the meta value with this version
+  uint64_t getVersion() const {
+    return _version;
+  }
+
+  // return ERR_NOTFOUND if the field doesn't exist
+  Expected<std::string> get(const std::string& field) {
+    if (_meta->isCompact()) {
+      const std::string* value = _meta->getField(field);
+      if (value == nullptr) {
+        return {ErrorCodes::ERR_NOTFOUND, ""};
+      }
+      return *value;
+    }
+    auto eValue = _kvstore->getKV(subKey(field), _txn);
+    if (!eValue.ok()) {
+      return eValue.status();
+    }
+    return eValue.value().getValue();
+  }
+
+  // isNew should be the result of a get() of the same field before
+  Status set(const std::string& field, const std::string& value, bool isNew) {
+    if (_meta->getCount() == 0 && !_meta->isCompact() && _maxEntries > 0) {
+      _meta->setCompact(true);
+    }
+    if (_meta->isCompact() &&
+        (field.size() > _maxValue || value.size() > _maxValue)) {
+      RET_IF_ERR(toPlain());
+    }
+    if (_meta->isCompact()) {
+      bool inserted = _meta->setField(field, value);
+      INVARIANT_D(inserted == isNew);
+      if (_meta->getCount() > _maxEntries) {
+        RET_IF_ERR(toPlain());
+      }
+      return {ErrorCodes::ERR_OK, ""};
+    }
+
+    RecordValue subRv(value, RecordType::RT_HASH_ELE, -1);
+    RET_IF_ERR(_kvstore->setKV(subKey(field), subRv, _txn));
+    if (isNew) {
+      _meta->setCount(_meta->getCount() + 1);
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  }
+
+  // return false if the field doesn't exist
+  Expected<bool> del(const std::string& field) {
+    if (_meta->isCompact()) {
+      return _meta->delField(field);
+    }
+    RecordKey subRk = subKey(field);
+    auto eValue = _kvstore->getKV(subRk, _txn);
+    if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return false;
+    }
+    RET_IF_ERR_EXPECTED(eValue);
+    RET_IF_ERR(_kvstore->delKV(subRk, _txn));
+    if (_meta->getCount() == 0) {
+      LOG(ERROR) << "invalid hashmeta of " << _metaRk.getPrimaryKey();
+    } else {
+      _meta->setCount(_meta->getCount() - 1);
+    }
+    return true;
+  }
+
+  // all the fields of a compact hash as RT_HASH_ELE records
+  std::list<Record> compactRecords() const {
+    INVARIANT_D(_meta->isCompact());
+    std::list<Record> result;
+    for (const auto& field : _meta->getFields()) {
+      result.emplace_back(
+        subKey(field.first),
+        RecordValue(field.second, RecordType::RT_HASH_ELE, -1));
+    }
+    return result;
+  }
+
+ private:
+  Status toPlain() {
+    for (const auto& field : _meta->getFields()) {
+      RecordValue subRv(field.second, RecordType::RT_HASH_ELE, -1);
+      RET_IF_ERR(_kvstore->setKV(subKey(field.first), subRv, _txn));
+    }
+    _meta->setCompact(false);
+    return {ErrorCodes::ERR_OK, ""};
+  }
+
+  PStore _kvstore;
+  Transaction* _txn;
+  const RecordKey& _metaRk;
+  uint64_t _version;
+  HashMetaValue* _meta;
+  uint32_t _maxEntries;
+  uint32_t _maxValue;
+};
+
 Expected<std::string> hincrfloatGeneric(Session* sess,
                                         const RecordKey& metaRk,
                                         const Expected<RecordValue>& eValue,
-                                        const RecordKey& subRk,
+                                        const std::string& field,
                                         long double inc,
                                         PStore kvstore) {
   auto ptxn = sess->getCtx()->createTransaction(kvstore);
@@ -46,35 +177,36 @@ Expected<std::string> hincrfloatGeneric(Session* sess,
     hashMeta = std::move(exptHashMeta.value());
   }  // no else, else not found , so subkeyCount = 0, ttl = 0
 
-  auto getSubkeyExpt = kvstore->getKV(subRk, ptxn.value());
+  HashFields fields(sess, kvstore, ptxn.value(), metaRk, eValue, &hashMeta);
+  auto getSubkeyExpt = fields.get(field);
   long double nowVal = 0;
+  bool isNew = false;
   if (getSubkeyExpt.ok()) {
-    Expected<long double> val =
-      ::novadbplus::stold(getSubkeyExpt.value().getValue());
+    Expected<long double> val = ::novadbplus::stold(getSubkeyExpt.value());
     if (!val.ok()) {
       return {ErrorCodes::ERR_DECODE, "hash value is not a valid float"};
     }
     nowVal = val.value();
   } else if (getSubkeyExpt.status().code() == ErrorCodes::ERR_NOTFOUND) {
     nowVal = 0;
-    hashMeta.setCount(hashMeta.getCount() + 1);
+    isNew = true;
   } else {
     return getSubkeyExpt.status();
   }
 
   nowVal += inc;
-  RecordValue newVal(
-    ::novadbplus::ldtos(nowVal, true), RecordType::RT_HASH_ELE, -1);
+  Status setStatus =
+    fields.set(field, ::novadbplus::ldtos(nowVal, true), isNew);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
-  Status setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
-  if (!setStatus.ok()) {
-    return setStatus;
-  }
-  setStatus = kvstore->setKV(subRk, newVal, ptxn.value());
+  metaValue.setVersion(fields.getVersion());
+  setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
   if (!setStatus.ok()) {
     return setStatus;
   }
@@ -90,7 +222,7 @@ Expected<std::string> hincrfloatGeneric(Session* sess,
 Expected<std::string> hincrGeneric(Session* sess,
                                    const RecordKey& metaRk,
                                    const Expected<RecordValue>& eValue,
-                                   const RecordKey& subRk,
+                                   const std::string& field,
                                    int64_t inc,
                                    PStore kvstore) {
   auto ptxn = sess->getCtx()->createTransaction(kvstore);
@@ -114,18 +246,19 @@ Expected<std::string> hincrGeneric(Session* sess,
     hashMeta = std::move(exptHashMeta.value());
   }  // no else, else not found , so subkeyCount = 0, ttl = 0
 
-  auto getSubkeyExpt = kvstore->getKV(subRk, ptxn.value());
+  HashFields fields(sess, kvstore, ptxn.value(), metaRk, eValue, &hashMeta);
+  auto getSubkeyExpt = fields.get(field);
   int64_t nowVal = 0;
+  bool isNew = false;
   if (getSubkeyExpt.ok()) {
-    Expected<int64_t> val =
-      ::novadbplus::stoll(getSubkeyExpt.value().getValue());
+    Expected<int64_t> val = ::novadbplus::stoll(getSubkeyExpt.value());
     if (!val.ok()) {
       return {ErrorCodes::ERR_DECODE, "hash value is not an integer "};
     }
     nowVal = val.value();
   } else if (getSubkeyExpt.status().code() == ErrorCodes::ERR_NOTFOUND) {
     nowVal = 0;
-    hashMeta.setCount(hashMeta.getCount() + 1);
+    isNew = true;
   } else {
     return getSubkeyExpt.status();
   }
@@ -135,17 +268,17 @@ Expected<std::string> hincrGeneric(Session* sess,
     return {ErrorCodes::ERR_OVERFLOW, "increment or decrement would overflow"};
   }
   nowVal += inc;
-  RecordValue newVal(std::to_string(nowVal), RecordType::RT_HASH_ELE, -1);
+  Status setStatus = fields.set(field, std::to_string(nowVal), isNew);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
-  Status setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
-  if (!setStatus.ok()) {
-    return setStatus;
-  }
-  setStatus = kvstore->setKV(subRk, newVal, ptxn.value());
+  metaValue.setVersion(fields.getVersion());
+  setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
   if (!setStatus.ok()) {
     return setStatus;
   }
@@ -267,16 +400,17 @@ class SizeGeneric : public Command {
                  key,
                  "");
     for (const auto oneEletype : eleType) {
-      RecordKey start(
-        mk.getChunkId(), mk.getDbId(), oneEletype, mk.getPrimaryKey(), "", 0);
-      RecordKey end(mk.getChunkId(),
-                    mk.getDbId(),
-                    oneEletype,
-                    mk.getPrimaryKey(),
-                    "",
-                    UINT64_MAX);
+      RecordKey start(mk.getChunkId(),
+                      mk.getDbId(),
+                      oneEletype,
+                      mk.getPrimaryKey(),
+                      "",
+                      rv.value().getVersion());
+      // the varint of version ends with a byte < 0x80, so the subkeys of
+      // this version are all in [sbegin, send)
       std::string sbegin = start.prefixPk();
-      std::string send = end.prefixPk();
+      std::string send = sbegin;
+      send.back()++;
       auto size = expdb.value().store->GetApproximateSizes(
         ColumnFamilyNumber::ColumnFamily_Default,
         &sbegin,
@@ -287,6 +421,14 @@ class SizeGeneric : public Command {
       }
       result += size.value();
     }
+    if (metaType == RecordType::RT_HASH_META) {
+      auto eMeta = HashMetaValue::decode(rv.value().getValue());
+      RET_IF_ERR_EXPECTED(eMeta);
+      if (eMeta.value().isCompact()) {
+        // the fields are inline in the meta value
+        result += rv.value().getValue().size();
+      }
+    }
     return fmtLongLong(result);
   }
 };
@@ -372,18 +514,25 @@ class HExistsCommand : public Command {
       return rv.status();
     }
 
-    RecordKey subRk(expdb.value().chunkId,
-                    pCtx->getDbId(),
-                    RecordType::RT_HASH_ELE,
-                    key,
-                    subkey);
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_HASH_META,
+                     key,
+                     "");
     PStore kvstore = expdb.value().store;
 
     auto ptxn = sess->getCtx()->createTransaction(kvstore);
     if (!ptxn.ok()) {
       return ptxn.status();
     }
-    Expected<RecordValue> eVal = kvstore->getKV(subRk, ptxn.value());
+    HashFields fields(
+      sess, kvstore, ptxn.value(), metaRk, rv, &exptHashMeta.value());
+    auto eVal = fields.get(subkey);
     if (eVal.ok()) {
       return Command::fmtOne();
     } else if (eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -451,11 +600,23 @@ class HAllCommand : public Command {
     if (!ptxn.ok()) {
       return ptxn.status();
     }
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    if (exptHashMeta.value().isCompact()) {
+      RET_IF_MEMORY_REQUEST_FAILED(sess, rv.value().getValue().size());
+      HashFields fields(
+        sess, kvstore, ptxn.value(), metaRk, rv, &exptHashMeta.value());
+      return fields.compactRecords();
+    }
     RecordKey fakeEle(expdb.value().chunkId,
                       metaRk.getDbId(),
                       RecordType::RT_HASH_ELE,
                       metaRk.getPrimaryKey(),
-                      "");
+                      "",
+                      rv.value().getVersion());
     std::string prefix = fakeEle.prefixPk();
     auto cursor = ptxn.value()->createDataCursor();
     cursor->seek(prefix);
@@ -593,20 +754,28 @@ class HGetRecordCommand : public Command {
       return rv.status();
     }
 
-    RecordKey subRk(expdb.value().chunkId,
-                    pCtx->getDbId(),
-                    RecordType::RT_HASH_ELE,
-                    key,
-                    subkey);
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_HASH_META,
+                     key,
+                     "");
     PStore kvstore = expdb.value().store;
 
     auto ptxn = sess->getCtx()->createTransaction(kvstore);
     if (!ptxn.ok()) {
       return ptxn.status();
     }
-    Expected<RecordValue> eVal = kvstore->getKV(subRk, ptxn.value());
+    HashFields fields(
+      sess, kvstore, ptxn.value(), metaRk, rv, &exptHashMeta.value());
+    auto eVal = fields.get(subkey);
     if (eVal.ok()) {
-      return std::move(Record(std::move(subRk), std::move(eVal.value())));
+      return Record(fields.subKey(subkey),
+                    RecordValue(eVal.value(), RecordType::RT_HASH_ELE, -1));
     } else {
       return eVal.status();
     }
@@ -732,11 +901,6 @@ class HIncrByFloatCommand : public Command {
                      RecordType::RT_HASH_META,
                      key,
                      "");
-    RecordKey subRk(expdb.value().chunkId,
-                    pCtx->getDbId(),
-                    RecordType::RT_HASH_ELE,
-                    key,
-                    subkey);
     PStore kvstore = expdb.value().store;
 
     // now, we have no need to deal with expire, though it may still
@@ -749,12 +913,12 @@ class HIncrByFloatCommand : public Command {
     // here maybe one more time io than the original novadb
     for (int32_t i = 0; i < RETRY_CNT - 1; ++i) {
       auto result =
-        hincrfloatGeneric(sess, metaRk, rv, subRk, inc.value(), kvstore);
+        hincrfloatGeneric(sess, metaRk, rv, subkey, inc.value(), kvstore);
       if (result.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
         return result;
       }
     }
-    return hincrfloatGeneric(sess, metaRk, rv, subRk, inc.value(), kvstore);
+    return hincrfloatGeneric(sess, metaRk, rv, subkey, inc.value(), kvstore);
   }
 } hincrbyfloatCmd;
 
@@ -811,11 +975,6 @@ class HIncrByCommand : public Command {
                      key,
                      "");
     // uint32_t storeId = expdb.value().dbId;
-    RecordKey subRk(expdb.value().chunkId,
-                    pCtx->getDbId(),
-                    RecordType::RT_HASH_ELE,
-                    key,
-                    subkey);
     PStore kvstore = expdb.value().store;
 
     // now, we have no need to deal with expire, though it may still
@@ -827,12 +986,12 @@ class HIncrByCommand : public Command {
 
     // here maybe one more time io than the original novadb
     for (int32_t i = 0; i < RETRY_CNT - 1; ++i) {
-      auto result = hincrGeneric(sess, metaRk, rv, subRk, inc, kvstore);
+      auto result = hincrGeneric(sess, metaRk, rv, subkey, inc, kvstore);
       if (result.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
         return result;
       }
     }
-    return hincrGeneric(sess, metaRk, rv, subRk, inc, kvstore);
+    return hincrGeneric(sess, metaRk, rv, subkey, inc, kvstore);
   }
 } hincrbyCommand;
 
@@ -917,13 +1076,36 @@ class HMGetGeneric : public Command {
       Command::fmtMultiBulkLen(ss, args.size() - 2);
     }
 
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    if (exptHashMeta.value().isCompact()) {
+      for (size_t i = 2; i < args.size(); ++i) {
+        const std::string* value = exptHashMeta.value().getField(args[i]);
+        if (value == nullptr) {
+          Command::fmtNull(ss);
+        } else {
+          RET_IF_MEMORY_REQUEST_FAILED(sess, value->size());
+          Command::fmtBulk(ss, *value);
+        }
+      }
+      return ss.str();
+    }
+
+    std::vector<RecordKey> subKeys;
+    subKeys.reserve(args.size() - 2);
     for (size_t i = 2; i < args.size(); ++i) {
-      RecordKey subKey(expdb.value().chunkId,
-                       pCtx->getDbId(),
-                       RecordType::RT_HASH_ELE,
-                       key,
-                       args[i]);
-      Expected<RecordValue> eValue = kvstore->getKV(subKey, ptxn.value());
+      subKeys.emplace_back(expdb.value().chunkId,
+                           pCtx->getDbId(),
+                           RecordType::RT_HASH_ELE,
+                           key,
+                           args[i],
+                           rv.value().getVersion());
+    }
+    auto eValues = kvstore->multiGetKV(subKeys, ptxn.value());
+    for (const auto& eValue : eValues) {
       if (!eValue.ok()) {
         if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
           Command::fmtNull(ss);
@@ -1015,16 +1197,12 @@ Status hmcas(Session* sess,
 
   constexpr int OPSET = 0;
   constexpr int OPADD = 1;
+  HashFields fields(sess, kvstore, ptxn.value(), metaRk, eValue, &hashMeta);
   for (const auto& keyPos : uniqkeys) {
     bool exists = true;
-    RecordKey rk(expdb.value().chunkId,
-                 pCtx->getDbId(),
-                 RecordType::RT_HASH_ELE,
-                 key,
-                 keyPos.first);
-    Expected<RecordValue> rv = kvstore->getKV(rk, ptxn.value());
+    auto rv = fields.get(keyPos.first);
     if (rv.ok()) {
-      existkvs[keyPos.first] = rv.value().getValue();
+      existkvs[keyPos.first] = rv.value();
     } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
       exists = false;
     } else {
@@ -1037,15 +1215,9 @@ Status hmcas(Session* sess,
       return eop.status();
     }
 
-    RecordKey subrk(expdb.value().chunkId,
-                    pCtx->getDbId(),
-                    RecordType::RT_HASH_ELE,
-                    key,
-                    keyPos.first);
     if (eop.value() == OPSET || (!exists && eop.value() == OPADD)) {
-      RecordValue subrv(
-        subargs[keyPos.second + 2], RecordType::RT_HASH_ELE, -1);
-      Status s = kvstore->setKV(subrk, subrv, ptxn.value());
+      Status s =
+        fields.set(keyPos.first, subargs[keyPos.second + 2], !exists);
       if (!s.ok()) {
         return s;
       }
@@ -1058,9 +1230,8 @@ Status hmcas(Session* sess,
       if (!ev1.ok()) {
         return ev1.status();
       }
-      RecordValue subrv(
-        std::to_string(ev1.value() + ev.value()), RecordType::RT_HASH_ELE, -1);
-      Status s = kvstore->setKV(subrk, subrv, ptxn.value());
+      Status s = fields.set(
+        keyPos.first, std::to_string(ev1.value() + ev.value()), false);
       if (!s.ok()) {
         return s;
       }
@@ -1083,12 +1254,12 @@ Status hmcas(Session* sess,
       cas = vsn + 1;
     }
   }
-  hashMeta.setCount(hashMeta.getCount() + uniqkeys.size() - existkvs.size());
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
+  metaValue.setVersion(fields.getVersion());
   metaValue.setCas(cas);
   Status s = kvstore->setKV(metaRk, metaValue, ptxn.value());
   if (!s.ok()) {
@@ -1289,26 +1460,30 @@ class HMSetGeneric : public Command {
       hashMeta = std::move(exptHashMeta.value());
     }  // no else, else not found , so subkeyCount = 0, ttl = 0
 
+    HashFields fields(sess, kvstore, ptxn.value(), metaRk, eValue, &hashMeta);
     for (const auto& v : rcds) {
-      auto getSubkeyExpt = kvstore->getKV(v.getRecordKey(), ptxn.value());
+      const std::string& field = v.getRecordKey().getSecondaryKey();
+      auto getSubkeyExpt = fields.get(field);
+      bool isNew = false;
       if (!getSubkeyExpt.ok()) {
         if (getSubkeyExpt.status().code() != ErrorCodes::ERR_NOTFOUND) {
           return getSubkeyExpt.status();
         }
+        isNew = true;
         inserted += 1;
       }
       Status setStatus =
-        kvstore->setKV(v.getRecordKey(), v.getRecordValue(), ptxn.value());
+        fields.set(field, v.getRecordValue().getValue(), isNew);
       if (!setStatus.ok()) {
         return setStatus;
       }
     }
-    hashMeta.setCount(hashMeta.getCount() + inserted);
     RecordValue metaValue(hashMeta.encode(),
                           RecordType::RT_HASH_META,
                           sess->getCtx()->getVersionEP(),
                           ttl,
                           eValue);
+    metaValue.setVersion(fields.getVersion());
     metaValue.setCas(-1);
     Status setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
     if (!setStatus.ok()) {
@@ -1481,12 +1656,13 @@ class HSetGeneric : public Command {
     }  // no else, else not found , so subkeyCount = 0, ttl = 0
 
     bool updated = false;
-    auto getSubkeyExpt = kvstore->getKV(subRk, ptxn.value());
+    HashFields fields(sess, kvstore, ptxn.value(), metaRk, eValue, &hashMeta);
+    const std::string& field = subRk.getSecondaryKey();
+    auto getSubkeyExpt = fields.get(field);
     if (getSubkeyExpt.ok()) {
       updated = true;
     } else if (getSubkeyExpt.status().code() == ErrorCodes::ERR_NOTFOUND) {
       updated = false;
-      hashMeta.setCount(hashMeta.getCount() + 1);
     } else {
       return getSubkeyExpt.status();
     }
@@ -1495,16 +1671,17 @@ class HSetGeneric : public Command {
       return Command::fmtZero();
     }
 
+    Status setStatus = fields.set(field, subRv.getValue(), !updated);
+    if (!setStatus.ok()) {
+      return setStatus;
+    }
     RecordValue metaValue(hashMeta.encode(),
                           RecordType::RT_HASH_META,
                           sess->getCtx()->getVersionEP(),
                           ttl,
                           eValue);
-    Status setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
-    if (!setStatus.ok()) {
-      return setStatus;
-    }
-    setStatus = kvstore->setKV(subRk, subRv, ptxn.value());
+    metaValue.setVersion(fields.getVersion());
+    setStatus = kvstore->setKV(metaRk, metaValue, ptxn.value());
     if (!setStatus.ok()) {
       return setStatus;
     }
@@ -1583,41 +1760,28 @@ class HDelCommand : public Command {
       hashMeta = std::move(exptHashMeta.value());
     }  // no else, else not found , so subkeyCount = 0, ttl = 0
 
+    HashFields fields(sess, kvstore, txn, metaKey, eValue, &hashMeta);
     for (size_t i = 2; i < args.size(); ++i) {
-      RecordKey subRk(metaKey.getChunkId(),
-                      dbId,
-                      RecordType::RT_HASH_ELE,
-                      metaKey.getPrimaryKey(),
-                      args[i]);
-      Expected<RecordValue> eVal = kvstore->getKV(subRk, txn);
-      if (eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
-        continue;
-      }
-      if (!eVal.ok()) {
-        return eVal.status();
+      Expected<bool> eDel = fields.del(args[i]);
+      if (!eDel.ok()) {
+        return eDel.status();
       }
-      Status s = kvstore->delKV(subRk, txn);
-      if (!s.ok()) {
-        return s;
+      if (eDel.value()) {
+        realDel++;
       }
-      realDel++;
     }
 
     // modify meta data
-    INVARIANT_D(realDel <= hashMeta.getCount());
     Status s;
-    if (realDel >= hashMeta.getCount()) {
-      if (realDel > hashMeta.getCount()) {
-        LOG(ERROR) << "invalid hashmeta of " << metaKey.getPrimaryKey();
-      }
+    if (hashMeta.getCount() == 0) {
       s = Command::delKeyAndTTL(sess, metaKey, eValue.value(), kvstore, txn);
     } else {
-      hashMeta.setCount(hashMeta.getCount() - realDel);
       RecordValue metaValue(hashMeta.encode(),
                             RecordType::RT_HASH_META,
                             sess->getCtx()->getVersionEP(),
                             ttl,
                             eValue);
+      metaValue.setVersion(fields.getVersion());
       s = kvstore->setKV(metaKey, metaValue, txn);
     }
     if (!s.ok()) {
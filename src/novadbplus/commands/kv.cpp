@@ -14,6 +14,7 @@
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/commands/dump.h"
+#include "novadbplus/utils/bitops.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/scopeguard.h"
@@ -523,7 +524,7 @@ class SetNxExCommand : public Command {
 
 class StrlenCommand : public Command {
  public:
-  StrlenCommand() : Command("strlen", "rF") {}
+  StrlenCommand() : Command("strlen", "rFi") {}
 
   ssize_t arity() const {
     return 2;
@@ -807,7 +808,7 @@ class GetVsnCommand : public Command {
 
 class GetCommand : public GetGenericCmd {
  public:
-  GetCommand() : GetGenericCmd("get", "rF") {}
+  GetCommand() : GetGenericCmd("get", "rFi") {}
 
   ssize_t arity() const {
     return 2;
@@ -1716,12 +1717,12 @@ class MGetCommand : public Command {
       return locklist.status();
     }
 
+    std::vector<std::string> keys(args.begin() + 1, args.end());
+    auto values = Command::expireKeysIfNeeded(sess, keys, RecordType::RT_KV);
+
     std::stringstream ss;
-    Command::fmtMultiBulkLen(ss, sess->getArgs().size() - 1);
-    for (size_t i = 1; i < sess->getArgs().size(); ++i) {
-      const std::string& key = sess->getArgs()[i];
-      Expected<RecordValue> rv =
-        Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
+    Command::fmtMultiBulkLen(ss, keys.size());
+    for (const auto& rv : values) {
       if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
           rv.status().code() == ErrorCodes::ERR_NOTFOUND ||
           rv.status().code() == ErrorCodes::ERR_WRONG_TYPE) {
@@ -1741,13 +1742,6 @@ class BitopCommand : public Command {
  public:
   BitopCommand() : Command("bitop", "wm") {}
 
-  enum class Op {
-    BITOP_AND,
-    BITOP_OR,
-    BITOP_XOR,
-    BITOP_NOT,
-  };
-
   ssize_t arity() const {
     return -4;
   }
@@ -1768,19 +1762,19 @@ class BitopCommand : public Command {
     const auto& args = sess->getArgs();
     const std::string& opName = toLower(args[1]);
     const std::string& targetKey = args[2];
-    Op op;
+    bitops::Op op;
     if (opName == "and") {
-      op = Op::BITOP_AND;
+      op = bitops::Op::AND;
     } else if (opName == "or") {
-      op = Op::BITOP_OR;
+      op = bitops::Op::OR;
     } else if (opName == "xor") {
-      op = Op::BITOP_XOR;
+      op = bitops::Op::XOR;
     } else if (opName == "not") {
-      op = Op::BITOP_NOT;
+      op = bitops::Op::NOT;
     } else {
       return {ErrorCodes::ERR_PARSEPKT, "syntax error"};
     }
-    if (op == Op::BITOP_NOT && args.size() != 4) {
+    if (op == bitops::Op::NOT && args.size() != 4) {
       return {
         ErrorCodes::ERR_PARSEPKT,
         "BITOP NOT must be called with a single source key."};  // NOLINT(whitespace/line_length)
@@ -1837,29 +1831,7 @@ class BitopCommand : public Command {
       }
       return Command::fmtZero();
     }
-    std::string result(maxLen, 0);
-    for (size_t i = 0; i < maxLen; ++i) {
-      unsigned char output = (vals[0].size() <= i) ? 0 : vals[0][i];
-      if (op == Op::BITOP_NOT)
-        output = ~output;
-      for (size_t j = 1; j < numKeys; ++j) {
-        unsigned char byte = (vals[j].size() <= i) ? 0 : vals[j][i];
-        switch (op) {
-          case Op::BITOP_AND:
-            output &= byte;
-            break;
-          case Op::BITOP_OR:
-            output |= byte;
-            break;
-          case Op::BITOP_XOR:
-            output ^= byte;
-            break;
-          default:
-            INVARIANT_D(0);
-        }
-      }
-      result[i] = output;
-    }
+    std::string result = bitops::bitop(op, vals, maxLen);
 
     auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, targetKey);
     if (!expdb.ok()) {
@@ -2172,8 +2144,7 @@ class RenameGenericCommand : public Command {
       return cnt.status();
     }
 
-    std::vector<std::string> prefixes =
-      getEleType(rk, rv.value().getRecordType());
+    std::vector<std::string> prefixes = getEleType(rk, rv.value());
     std::vector<Record> pending;
     pending.reserve(cnt.value());
     for (const auto& prefix : prefixes) {
@@ -2203,7 +2174,8 @@ class RenameGenericCommand : public Command {
                    dstRk.getDbId(),
                    srcRk.getRecordType(),
                    dst,
-                   srcRk.getSecondaryKey());
+                   srcRk.getSecondaryKey(),
+                   srcRk.getVersion());
       const RecordValue& rv = ele.getRecordValue();
       Status s = dststore->setKV(rk, rv, dptxn.value());
       if (!s.ok()) {
@@ -2228,14 +2200,16 @@ class RenameGenericCommand : public Command {
  private:
   bool _flagnx;
   std::vector<std::string> getEleType(const RecordKey& rk,
-                                      const RecordType& type) {
+                                      const RecordValue& rv) {
     std::vector<std::string> ret;
+    RecordType type = rv.getRecordType();
     if (type == RecordType::RT_HASH_META) {
       RecordKey fakeRk(rk.getChunkId(),
                        rk.getDbId(),
                        RecordType::RT_HASH_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       rv.getVersion());
       ret.push_back(fakeRk.prefixPk());
     } else if (type == RecordType::RT_LIST_META) {
       RecordKey fakeRk(rk.getChunkId(),
@@ -2249,20 +2223,23 @@ class RenameGenericCommand : public Command {
                        rk.getDbId(),
                        RecordType::RT_SET_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       rv.getVersion());
       ret.push_back(fakeRk.prefixPk());
     } else if (type == RecordType::RT_ZSET_META) {
       RecordKey fakeRk(rk.getChunkId(),
                        rk.getDbId(),
                        RecordType::RT_ZSET_S_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       rv.getVersion());
       ret.push_back(fakeRk.prefixPk());
       RecordKey fakeRk2(rk.getChunkId(),
                         rk.getDbId(),
                         RecordType::RT_ZSET_H_ELE,
                         rk.getPrimaryKey(),
-                        "");
+                        "",
+                        rv.getVersion());
       ret.push_back(fakeRk2.prefixPk());
     } else if (type == RecordType::RT_TBITMAP_META) {
       RecordKey fakeRk(rk.getChunkId(),
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <cctype>
 #include <clocale>
+#include <deque>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <utility>
@@ -153,6 +155,127 @@ Expected<std::string> genericPush(Session* sess,
   return Command::fmtLongLong(lm.getTail() - lm.getHead());
 }
 
+// NOTE: list elements are keyed by their decimal index, and all the live
+// indexes of a list have the same number of digits (they start from INITSEQ),
+// so the elements of an index range are a contiguous key range. ListRangeReader
+// reads such a range in batches, each with one bounded cursor, instead of
+// one point get per element. Batches grow from MIN_BATCH to MAX_BATCH, so that
+// a caller which stops early doesn't read much more than it needs.
+class ListRangeReader {
+ public:
+  static constexpr uint64_t MIN_BATCH = 32;
+  static constexpr uint64_t MAX_BATCH = 1024;
+  static constexpr size_t READAHEAD_SIZE = 256 * 1024;
+
+  // read the elements of [begin, end), from begin if pos is LP_HEAD,
+  // from end - 1 otherwise
+  ListRangeReader(PStore kvstore,
+                  Transaction* txn,
+                  const RecordKey& metaRk,
+                  uint64_t begin,
+                  uint64_t end,
+                  ListPos pos = ListPos::LP_HEAD)
+    : _kvstore(kvstore),
+      _txn(txn),
+      _metaRk(metaRk),
+      _begin(begin),
+      _end(end),
+      _pos(pos),
+      _batch(MIN_BATCH) {
+    INVARIANT_D(begin <= end);
+  }
+
+  // the value of the next element, ERR_EXHAUST after the last one
+  Expected<RecordValue> next() {
+    if (_buf.empty()) {
+      if (_begin >= _end) {
+        return {ErrorCodes::ERR_EXHAUST, "no more list elements"};
+      }
+      auto s = fill();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    RecordValue rv = std::move(_buf.front());
+    _buf.pop_front();
+    return rv;
+  }
+
+ private:
+  RecordKey eleKey(uint64_t idx) const {
+    return RecordKey(_metaRk.getChunkId(),
+                     _metaRk.getDbId(),
+                     RecordType::RT_LIST_ELE,
+                     _metaRk.getPrimaryKey(),
+                     std::to_string(idx));
+  }
+
+  Status fill() {
+    uint64_t cnt = std::min(_batch, _end - _begin);
+    _batch = std::min(_batch * 2, MAX_BATCH);
+    uint64_t begin, end;
+    if (_pos == ListPos::LP_HEAD) {
+      begin = _begin;
+      end = _begin + cnt;
+      _begin = end;
+    } else {
+      begin = _end - cnt;
+      end = _end;
+      _end = begin;
+    }
+
+    std::vector<RecordValue> values;
+    values.reserve(cnt);
+    uint64_t idx = begin;
+    if (cnt > 1) {
+      auto cursor =
+        _txn->createRangeDataCursor(eleKey(end).encode(), READAHEAD_SIZE);
+      cursor->seek(eleKey(begin).encode());
+      while (idx < end) {
+        auto exptRcd = cursor->next();
+        if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+          break;
+        }
+        if (!exptRcd.ok()) {
+          return exptRcd.status();
+        }
+        const RecordKey& rk = exptRcd.value().getRecordKey();
+        if (rk.getRecordType() != RecordType::RT_LIST_ELE ||
+            rk.getPrimaryKey() != _metaRk.getPrimaryKey() ||
+            rk.getSecondaryKey() != std::to_string(idx)) {
+          break;
+        }
+        values.emplace_back(exptRcd.value().getRecordValue());
+        idx++;
+      }
+    }
+    // whatever the cursor didn't return in order is read by point gets
+    for (; idx < end; idx++) {
+      auto eSubVal = _kvstore->getKV(eleKey(idx), _txn);
+      if (!eSubVal.ok()) {
+        return eSubVal.status();
+      }
+      values.emplace_back(std::move(eSubVal.value()));
+    }
+
+    if (_pos == ListPos::LP_HEAD) {
+      std::move(values.begin(), values.end(), std::back_inserter(_buf));
+    } else {
+      std::move(values.rbegin(), values.rend(), std::back_inserter(_buf));
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  }
+
+  PStore _kvstore;
+  Transaction* _txn;
+  RecordKey _metaRk;
+  uint64_t _begin;
+  uint64_t _end;
+  ListPos _pos;
+  uint64_t _batch;
+  std::deque<RecordValue> _buf;
+};
+
 class LLenCommand : public Command {
  public:
   LLenCommand() : Command("llen", "rF") {}
@@ -848,20 +971,21 @@ class LRangeCommand : public Command {
     start += head;
     std::stringstream ss;
     Command::fmtMultiBulkLen(ss, rangelen);
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_LIST_META,
+                     key,
+                     "");
+    ListRangeReader reader(
+      kvstore, ptxn.value(), metaRk, start, start + rangelen);
     while (rangelen--) {
-      RecordKey subRk(expdb.value().chunkId,
-                      pCtx->getDbId(),
-                      RecordType::RT_LIST_ELE,
-                      key,
-                      std::to_string(start));
-      Expected<RecordValue> eSubVal = kvstore->getKV(subRk, ptxn.value());
+      Expected<RecordValue> eSubVal = reader.next();
       if (eSubVal.ok()) {
         RET_IF_MEMORY_REQUEST_FAILED(sess, eSubVal.value().getValue().size());
         Command::fmtBulk(ss, eSubVal.value().getValue());
       } else {
         return eSubVal.status();
       }
-      start++;
     }
     return ss.str();
   }
@@ -1150,13 +1274,20 @@ class LRemCommand : public Command {
       return ptxn.status();
     }
 
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_LIST_META,
+                     key,
+                     "");
+    // NOTE: the readers below only read indexes this txn hasn't written
+    ListRangeReader reader(kvstore, ptxn.value(), metaRk, head, tail, pos);
     for (size_t i = 0; i < len; i++) {
       RecordKey subRk(expdb.value().chunkId,
                       pCtx->getDbId(),
                       RecordType::RT_LIST_ELE,
                       key,
                       std::to_string(index));
-      Expected<RecordValue> expRv = kvstore->getKV(subRk, ptxn.value());
+      Expected<RecordValue> expRv = reader.next();
       if (!expRv.ok()) {
         return expRv.status();
       }
@@ -1204,13 +1335,14 @@ class LRemCommand : public Command {
     for (ssize_t i = lBorder - 1; i >= 0; i--) {
       uint64_t pos = hole[i + 1] - 1;
       uint64_t nextHole = hole[i];
+      ListRangeReader segReader(kvstore,
+                                ptxn.value(),
+                                metaRk,
+                                nextHole + 1,
+                                hole[i + 1],
+                                ListPos::LP_TAIL);
       for (; pos > nextHole; pos--) {
-        RecordKey subRk(expdb.value().chunkId,
-                        pCtx->getDbId(),
-                        RecordType::RT_LIST_ELE,
-                        key,
-                        std::to_string(pos));
-        Expected<RecordValue> eSubVal = kvstore->getKV(subRk, ptxn.value());
+        Expected<RecordValue> eSubVal = segReader.next();
         if (!eSubVal.ok()) {
           return eSubVal.status();
         }
@@ -1232,13 +1364,10 @@ class LRemCommand : public Command {
     for (size_t i = rBorder + 1; i < hole.size(); i++) {
       uint64_t pos = hole[i - 1] + 1;
       uint64_t nextHole = hole[i];
+      ListRangeReader segReader(
+        kvstore, ptxn.value(), metaRk, pos, nextHole, ListPos::LP_HEAD);
       for (; pos < nextHole; pos++) {
-        RecordKey subRk(expdb.value().chunkId,
-                        pCtx->getDbId(),
-                        RecordType::RT_LIST_ELE,
-                        key,
-                        std::to_string(pos));
-        Expected<RecordValue> eSubVal = kvstore->getKV(subRk, ptxn.value());
+        Expected<RecordValue> eSubVal = segReader.next();
         if (!eSubVal.ok()) {
           return eSubVal.status();
         }
@@ -1280,11 +1409,6 @@ class LRemCommand : public Command {
 
     lm.setHead(head);
     lm.setTail(tail);
-    RecordKey metaRk(expdb.value().chunkId,
-                     pCtx->getDbId(),
-                     RecordType::RT_LIST_META,
-                     key,
-                     "");
     Status s;
     if (head == tail) {
       s =
@@ -1379,13 +1503,14 @@ class LInsertCommand : public Command {
     if (!ptxn.ok()) {
       return ptxn.status();
     }
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_LIST_META,
+                     key,
+                     "");
+    ListRangeReader reader(kvstore, ptxn.value(), metaRk, head, tail);
     while (len > 0) {
-      RecordKey subRk(expdb.value().chunkId,
-                      pCtx->getDbId(),
-                      RecordType::RT_LIST_ELE,
-                      key,
-                      std::to_string(index));
-      Expected<RecordValue> eSubRv = kvstore->getKV(subRk, ptxn.value());
+      Expected<RecordValue> eSubRv = reader.next();
       if (!eSubRv.ok()) {
         return eSubRv.status();
       }
@@ -1423,19 +1548,21 @@ class LInsertCommand : public Command {
       moveLen = rightEle;
     }
 
+    // the elements to move are read ahead of the indexes being written
+    ListRangeReader moveReader(kvstore,
+                               ptxn.value(),
+                               metaRk,
+                               step > 0 ? index + 1 : index - moveLen,
+                               step > 0 ? index + 1 + moveLen : index,
+                               step > 0 ? ListPos::LP_HEAD : ListPos::LP_TAIL);
     while (moveLen > 0) {
-      RecordKey subRk(expdb.value().chunkId,
-                      pCtx->getDbId(),
-                      RecordType::RT_LIST_ELE,
-                      key,
-                      std::to_string(index + step));
-      Expected<RecordValue> eSubVal = kvstore->getKV(subRk, ptxn.value());
+      Expected<RecordValue> eSubVal = moveReader.next();
       if (!eSubVal.ok()) {
         return eSubVal.status();
       }
 
-      RecordKey newRk(subRk.getChunkId(),
-                      subRk.getDbId(),
+      RecordKey newRk(expdb.value().chunkId,
+                      pCtx->getDbId(),
                       RecordType::RT_LIST_ELE,
                       key,
                       std::to_string(index));
@@ -1459,11 +1586,6 @@ class LInsertCommand : public Command {
 
     lm.setHead(head);
     lm.setTail(tail);
-    RecordKey metaRk(expdb.value().chunkId,
-                     pCtx->getDbId(),
-                     RecordType::RT_LIST_META,
-                     key,
-                     "");
     s = kvstore->setKV(metaRk,
                        RecordValue(lm.encode(),
                                    RecordType::RT_LIST_META,
@@ -128,6 +128,8 @@ class HPLLObject {
   int add(const std::string& subkey);
   int add(const char* data, size_t size);
   uint64_t getHllCount() const;
+  // use the cached cardinality if it is valid, without updating it
+  uint64_t getHllCountCached() const;
   // Note(vinchen): it is not const;
   uint64_t getHllCountFast();
   std::string encode() const;
@@ -296,16 +298,23 @@ uint64_t HPLLObject::getHllCount() const {
   return count;
 }
 
+uint64_t HPLLObject::getHllCountCached() const {
+  uint64_t count;
+  if (redis_port::hllGetCachedCount(_hdr, &count)) {
+    return count;
+  }
+  return getHllCount();
+}
+
+// NOTE(vinchen): pfcount should be a read only command,
+// so it can't use getHllCountFast(). It is used by the writers
+// to store the cardinality together with the registers.
 uint64_t HPLLObject::getHllCountFast() {
-  // NOTE(vinchen): pfcount should be a read only command,
-  // so here it should not use hpll->getHllCountFast()
-  INVARIANT_D(0);
   int invalid = 0;
   auto count = redis_port::hllCountFast(_hdr, _hdrSize, &invalid);
   if (invalid) {
     return (uint64_t)-1;
   }
-  hllInvalidateCache();
   return count;
 }
 
@@ -528,8 +537,9 @@ class PfCountCommand : public Command {
     auto hpll = std::make_unique<HPLLObject>(rv.value().getValue());
 
     // NOTE(vinchen): pfcount should be a read only command,
-    // so here it should not use hpll->getHllCountFast()
-    auto count = hpll->getHllCount();
+    // so here it should not use hpll->getHllCountFast().
+    // The cardinality cached by pfmerge is valid until the next pfadd.
+    auto count = hpll->getHllCountCached();
     if (count == (uint64_t)-1) {
       return {ErrorCodes::ERR_INVALID_HLL, ""};
     }
@@ -616,6 +626,10 @@ class PfMergeCommand : public Command {
     if (result->updateByRawHpll(hpll.get()) == -1) {
       return {ErrorCodes::ERR_INVALID_HLL, ""};
     }
+    // cache the cardinality for the later pfcount, pfadd invalidates it
+    if (result->getHllCountFast() == (uint64_t)-1) {
+      return {ErrorCodes::ERR_INVALID_HLL, ""};
+    }
 
     auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, key);
     if (!expdb.ok()) {
@@ -309,13 +309,17 @@ class RestoreBackupCommand : public Command {
   }
 } restoreBackupCommand;
 
-// fullSync storeId dstStoreId ip port
+// fullSync storeId ip port [streaming|join]
+// streaming: the files are sent whole by sendfile(2), and more connections
+//   of the slave can join to send the files concurrently.
+// join: the connection joins the streaming fullsync of storeId to ip:port,
+//   it takes the files not sent yet until "+DONE".
 class FullSyncCommand : public Command {
  public:
   FullSyncCommand() : Command("fullsync", "as") {}
 
   ssize_t arity() const {
-    return 4;
+    return -4;
   }
 
   int32_t firstkey() const {
@@ -466,6 +470,10 @@ class ApplyBinlogsGeneric : public Command {
 
     size_t cnt = 0;
     BinlogReader reader(binlogs);
+    // the parallel applier takes the whole batch
+    bool parallel =
+      mode == BinlogApplyMode::KEEP_BINLOG_ID && replMgr->isParallelApply();
+    std::vector<ReplLogRawV2> logs;
     while (true) {
       auto eLog = reader.next();
       if (eLog.status().code() == ErrorCodes::ERR_EXHAUST) {
@@ -475,7 +483,9 @@ class ApplyBinlogsGeneric : public Command {
         return eLog.status();
       }
       Status s;
-      if (mode == BinlogApplyMode::KEEP_BINLOG_ID) {
+      if (parallel) {
+        logs.emplace_back(std::move(eLog.value()));
+      } else if (mode == BinlogApplyMode::KEEP_BINLOG_ID) {
         s = replMgr->applyRepllogV2(sess,
                                     storeId,
                                     eLog.value().getReplLogKey(),
@@ -504,6 +514,13 @@ class ApplyBinlogsGeneric : public Command {
       return {ErrorCodes::ERR_PARSEOPT, "invalid binlog size of binlog count"};
     }
 
+    if (parallel) {
+      auto s = replMgr->applyRepllogsV2(sess, storeId, logs);
+      if (!s.ok()) {
+        LOG(ERROR) << "applyRepllogsV2 failed:" << s.toString();
+        return s;
+      }
+    }
     return {ErrorCodes::ERR_OK, ""};
   }
 
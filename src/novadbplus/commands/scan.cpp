@@ -12,7 +12,7 @@
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/storage/record.h"
-#include "novadbplus/storage/skiplist.h"
+#include "novadbplus/storage/zset_index.h"
 #include "novadbplus/storage/varint.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/redis_port.h"
@@ -29,9 +29,11 @@ class ScanGenericCommand : public Command {
 
   virtual RecordType getRcdType() const = 0;
 
+  // version is the version of the meta, see Command::getSubKeyVersion()
   virtual RecordKey genFakeRcd(uint32_t chunkId,
                                uint32_t dbId,
-                               const std::string& key) const = 0;
+                               const std::string& key,
+                               uint64_t version) const = 0;
 
   virtual Expected<std::string> genResult(Session* sess,
                                           const std::string& cursor,
@@ -111,12 +113,17 @@ class ScanGenericCommand : public Command {
       auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
       RET_IF_ERR_EXPECTED(eMetaContent);
       ZSlMetaValue meta = eMetaContent.value();
-      SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
+      auto sl = createZsetIndex(expdb.value().chunkId,
+                                pCtx->getDbId(),
+                                key,
+                                meta,
+                                kvstore,
+                                rv.value().getVersion());
       Zrangespec range;
       if (zslParseRange(cursorArg.c_str(), maxscore.c_str(), &range) != 0) {
         return {ErrorCodes::ERR_ZSLPARSERANGE, ""};
       }
-      auto arr = sl.scanByScore(range, 0, count + 1, false, ptxn.value());
+      auto arr = sl->scanByScore(range, 0, count + 1, false, ptxn.value());
       RET_IF_ERR_EXPECTED(arr);
       std::stringstream ss;
       Command::fmtMultiBulkLen(ss, 2);
@@ -134,6 +141,34 @@ class ScanGenericCommand : public Command {
       return ss.str();
     }
 
+    const bool NOCASE = false;
+    if (getRcdType() == RecordType::RT_HASH_META) {
+      auto eMeta = HashMetaValue::decode(rv.value().getValue());
+      RET_IF_ERR_EXPECTED(eMeta);
+      if (eMeta.value().isCompact()) {
+        // like redis, a small hash is returned in one batch
+        std::list<Record> rcds;
+        for (const auto& field : eMeta.value().getFields()) {
+          if (usePatten &&
+              !redis_port::stringmatchlen(pat.c_str(),
+                                          pat.size(),
+                                          field.first.c_str(),
+                                          field.first.size(),
+                                          NOCASE)) {
+            continue;
+          }
+          rcds.emplace_back(
+            RecordKey(expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_HASH_ELE,
+                      key,
+                      field.first),
+            RecordValue(field.second, RecordType::RT_HASH_ELE, -1));
+        }
+        return genResult(sess, "0", rcds);
+      }
+    }
+
     // cursor should be an integer
     auto ecursor = novadbplus::stoull(cursorArg);
     if (!ecursor.ok()) {
@@ -148,12 +183,15 @@ class ScanGenericCommand : public Command {
       // cursor is invalid in cursormap, start with "0"
       cursor = 0;
     }
-    RecordKey fake = genFakeRcd(expdb.value().chunkId, pCtx->getDbId(), key);
+    RecordKey fake = genFakeRcd(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value().getVersion());
 
-    auto batch =
-      Command::scan(sess, fake.prefixPk(), realCursor, count, ptxn.value());
+    // only the subkeys with the literal prefix of the pattern are read
+    auto plan = Command::planScanPattern(pat);
+    auto batch = Command::scan(
+      sess, fake.prefixPk(), realCursor, count, ptxn.value(), plan.prefix);
     RET_IF_ERR_EXPECTED(batch);
-    const bool NOCASE = false;
+    uint64_t examined = batch.value().second.size();
     for (std::list<Record>::iterator it = batch.value().second.begin();
          it != batch.value().second.end();) {
       if (usePatten &&
@@ -168,6 +206,7 @@ class ScanGenericCommand : public Command {
         ++it;
       }
     }
+    pCtx->addScanRecord(examined, batch.value().second.size());
     if (cursor == 0) {
       // the first element start with 1;
       cursor = 1;
@@ -198,8 +237,9 @@ class ZScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_ZSET_H_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_ZSET_H_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(Session* sess,
@@ -231,12 +271,14 @@ class ZScanbyscoreCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
+                       const std::string& key,
+                       uint64_t version) const final {
     return {chunkId,
             dbId,
             RecordType::RT_ZSET_S_ELE,
             key,
-            std::to_string(ZSlMetaValue::HEAD_ID)};
+            std::to_string(ZSlMetaValue::HEAD_ID),
+            version};
   }
 
   Expected<std::string> genResult(Session* sess,
@@ -284,8 +326,9 @@ class SScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_SET_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_SET_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(Session* sess,
@@ -314,8 +357,9 @@ class HScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_HASH_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_HASH_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(Session* sess,
@@ -467,6 +511,8 @@ class ScanCommand : public Command {
     // init filter config.
     filter.setPattern(pattern);
     filter.setType(type);
+    // seek the keys with the literal prefix of "MATCH" only
+    auto plan = Command::planScanPattern(pattern);
 
     // Step 2: check if this scan command cursor has been stored in cursorMap_
     uint64_t kvstoreId{0};
@@ -509,71 +555,100 @@ class ScanCommand : public Command {
     auto server = sess->getServerEntry();
     auto params = server->getParams();
     uint64_t seq{0};
-    uint64_t scanTimes{0};
     uint64_t scanMaxTimes = params->scanDefaultMaxIterateTimes;
 
     count += 1;  // in order to add mapping, scan one more key.
 
-    // Step 3: scan data across all kv-stores one by one
+    // Step 3: scan kv-store id alone first, with the whole scanMaxTimes,
+    // as the last page stopped there. If it falls short, the next kv-stores
+    // are scanned in parallel, a wave of them at a time, and share what is
+    // left of scanMaxTimes. The keys are taken in the order of kv-stores,
+    // as if they were scanned one by one.
+    size_t wave = 1;
+    if (server->getScanPool() != nullptr) {
+      wave += params->scanThreadNum;
+    }
+    auto dbId = sess->getCtx()->getDbId();
+    auto firstRecordKey = genRecordKey(0, dbId, "");
     size_t id = kvstoreId;
-    for (; id < server->getKVStoreCount(); ++id) {
-      if (batch.size() >= count || scanTimes >= scanMaxTimes) {
-        break;
+    uint64_t examined = 0;
+    // scan stops in kv-store id for "COUNT" or its share of scanMaxTimes
+    bool stopped = false;
+    for (size_t next = kvstoreId;
+         next < server->getKVStoreCount() && !stopped;) {
+      uint64_t left = scanMaxTimes - examined;
+      size_t n = next == kvstoreId ? 1 : std::min<uint64_t>(wave, left);
+      std::vector<uint32_t> storeIds;
+      for (; next < server->getKVStoreCount() && storeIds.size() < n;
+           ++next) {
+        storeIds.push_back(next);
       }
-
-      // use scope to control expdb life-time. (RAII)
-      {
-        auto expdb =
-          server->getSegmentMgr()->getDb(sess, id, mgl::LockMode::LOCK_IS);
-        RET_IF_ERR_EXPECTED(expdb);
-        auto* pCtx = sess->getCtx();
-        auto kvstore = expdb.value().store;
-        auto ptxn = sess->getCtx()->createTransaction(kvstore);
-        RET_IF_ERR_EXPECTED(ptxn);
-
-        /**
-         * set recordKey policy:
-         * 1. id == kvstoreId
-         *   means: start scan this kv-store, use lastScanRecordKey from mapping
-         * 2. id != kvstoreId
-         *   means: for new kv-store, should scan from its first keys
-         */
-        auto recordKey = [&]() -> RecordKey {
-          if (id == kvstoreId) {
-            return lastScanRecordKey;
-          } else {
-            return genRecordKey(0, pCtx->getDbId(), "");
+      uint64_t budget = left / storeIds.size();
+
+      std::vector<StoreScan> scans(storeIds.size());
+      auto results = Command::parallelForStores(
+        sess, storeIds, [&](size_t i, Transaction* txn) -> Status {
+          /**
+           * set recordKey policy:
+           * 1. id == kvstoreId
+           *   means: start scan this kv-store, use lastScanRecordKey
+           * 2. id != kvstoreId
+           *   means: for new kv-store, should scan from its first keys
+           */
+          const auto& recordKey =
+            storeIds[i] == kvstoreId ? lastScanRecordKey : firstRecordKey;
+          auto& scan = scans[i];
+          auto expRecordKeys = scanKvstore(slots,
+                                           filter,
+                                           plan,
+                                           recordKey,
+                                           dbId,
+                                           storeIds[i],
+                                           kvstoreCount,
+                                           count,
+                                           &scan.seq,
+                                           &scan.scanTimes,
+                                           budget,
+                                           &scan.seqs,
+                                           txn);
+          RET_IF_ERR_EXPECTED(expRecordKeys);
+          scan.keys = std::move(expRecordKeys.value());
+          return {ErrorCodes::ERR_OK, ""};
+        });
+
+      for (const auto& scan : scans) {
+        examined += scan.scanTimes;
+      }
+      for (size_t i = 0; i < storeIds.size() && !stopped; ++i) {
+        RET_IF_ERR(results[i]);
+        id = storeIds[i];
+        const auto& scan = scans[i];
+        uint64_t need = count - batch.size();
+        for (const auto& key : scan.keys) {
+          if (batch.size() >= count) {
+            break;
           }
-        }();
-        auto expRecordKeys = scanKvstore(slots,
-                                         filter,
-                                         recordKey,
-                                         pCtx->getDbId(),
-                                         id,
-                                         kvstoreCount,
-                                         count - batch.size(),
-                                         &seq,
-                                         &scanTimes,
-                                         scanMaxTimes,
-                                         ptxn.value());
-        RET_IF_ERR_EXPECTED(expRecordKeys);
-        const auto& recordKeys = expRecordKeys.value();
-        for (const auto& key : recordKeys) {
           RET_IF_MEMORY_REQUEST_FAILED(sess,
                                        (RecordKey::MEMORY_USED_BESIDES_KEY +
                                         key.getPrimaryKey().size() +
                                         key.getSecondaryKey().size()));
           batch.emplace_back(key);
         }
+        if (scan.keys.size() >= need) {
+          seq += scan.seqs[need - 1];
+          stopped = true;
+        } else {
+          seq += scan.seq;
+          stopped = scan.scanTimes >= budget;
+        }
       }
     }
 
-    id -= 1;         // id need operator-- after loop
     filter.reset();  // reset _filter condition
     cursor += seq;   // seq is real cursor position.
 
     // means ERR_EXHAUST, should set cursor to 0
-    if (batch.size() < count && scanTimes < scanMaxTimes) {
+    if (!stopped) {
       cursor = 0;
     }
 
@@ -588,11 +663,23 @@ class ScanCommand : public Command {
      * cursor = |   seqId    | real-cursor |
      */
     cursor = (cursor | (seqId << 48U));
+    sess->getCtx()->addScanRecord(examined, batch.size());
 
     return genResult(sess, cursor, batch);
   }
 
  private:
+  /**
+   * @brief the keys scanned in one kv-store
+   */
+  struct StoreScan {
+    std::list<RecordKey> keys;
+    // seqs[i] is the seq when keys[i] is found
+    std::vector<uint64_t> seqs;
+    uint64_t seq = 0;
+    uint64_t scanTimes = 0;
+  };
+
   class Filter {
    public:
     // RT_DATA_META means RT_ALL here.
@@ -722,6 +809,22 @@ class ScanCommand : public Command {
     return {slotsId, dbId, RecordType::RT_DATA_META, primaryKey, ""};
   }
 
+  /**
+   * @brief the least key of the slot with the primary key prefix, all the
+   *   keys in the slot and db starting with prefix are right after it
+   * @param slotsId aka chunkId
+   * @param dbId
+   * @param prefix literal prefix of "MATCH"
+   * @return
+   */
+  static std::string genSlotPrefix(uint32_t slotsId,
+                                   uint32_t dbId,
+                                   const std::string& prefix) {
+    auto slotKey = genRecordKey(slotsId, dbId, prefix);
+    return slotKey.prefixPk().substr(0,
+                                     RecordKey::getHdrSize() + prefix.size());
+  }
+
   /**
    * @brief generate result string
    * @param sess command session
@@ -770,11 +873,13 @@ class ScanCommand : public Command {
    * @param kvstoreId for kvstoreSlots
    * @param lastScanKey lastScanKey from cursorMap_
    * @param count need scan number
+   * @param seqs the seq when each key is found
    * @param txn transaction
    * @return {cursor, key-list}
    */
   auto scanKvstore(const std::bitset<CLUSTER_SLOTS>& slots,
                    const Filter& filter,
+                   const ScanPlan& plan,
                    const RecordKey& lastScanRecordKey,
                    uint32_t dbId,
                    int kvstoreId,
@@ -783,10 +888,24 @@ class ScanCommand : public Command {
                    uint64_t* seq,
                    uint64_t* scanTimes,
                    uint64_t scanMaxTimes,
+                   std::vector<uint64_t>* seqs,
                    Transaction* txn) -> Expected<std::list<RecordKey>> {
     std::list<RecordKey> result;
     auto kvstoreSlots = getKvstoreSlots(kvstoreId, kvstoreCount, slots);
-    auto cursor = txn->createDataCursor();
+    std::unique_ptr<BasicDataCursor> cursor;
+    if (plan.slot >= 0) {
+      // all the keys matched are in one range of the slot
+      bool mySlot = kvstoreSlots.test(plan.slot);
+      kvstoreSlots.reset();
+      if (!mySlot) {
+        return result;
+      }
+      kvstoreSlots.set(plan.slot);
+      cursor = txn->createRangeDataCursor(Command::prefixUpperBound(
+        genSlotPrefix(plan.slot, dbId, plan.prefix)));
+    } else {
+      cursor = txn->createDataCursor();
+    }
     cursor->seek(lastScanRecordKey.encode());
 
     while (result.size() < count && *scanTimes < scanMaxTimes) {
@@ -817,16 +936,20 @@ class ScanCommand : public Command {
             expRecord.status().code() != ErrorCodes::ERR_EXHAUST) {
           if (result.empty() || (result.back() != record.getRecordKey())) {
             result.emplace_back(record.getRecordKey());
+            seqs->push_back(*seq);
           }
         }
       });
 
       // check if this record match scan condition
-      auto recordSlotId = record.getRecordKey().getChunkId();
-      auto recordDbId = record.getRecordKey().getDbId();
-      auto recordType = record.getRecordKey().getRecordType();
+      const auto& recordKey = record.getRecordKey();
+      auto recordSlotId = recordKey.getChunkId();
+      auto recordDbId = recordKey.getDbId();
+      auto recordType = recordKey.getRecordType();
       if (!kvstoreSlots.test(recordSlotId) || recordDbId != dbId ||
-          recordType != RecordType::RT_DATA_META) {
+          recordType != RecordType::RT_DATA_META ||
+          recordKey.getPrimaryKey().compare(
+            0, plan.prefix.size(), plan.prefix) != 0) {
         // seq: this key in DBID db's position
         // means, recordDbId == dbId && recordType == RT_DATA_META
         // seq should NOT include this key.
@@ -838,15 +961,21 @@ class ScanCommand : public Command {
         //     recordType == RecordType::RT_DATA_META) {
         //   (*seq)++;
         // }
-        auto nextSlot = getNextSlot(slots, recordSlotId);
-        // nextSlot == -1 means this kv-store has been iterated over
-        if (nextSlot == -1) {
-          break;
+        // the keys with the prefix of this slot may be after this record
+        std::string slotPrefix;
+        if (kvstoreSlots.test(recordSlotId)) {
+          slotPrefix = genSlotPrefix(recordSlotId, dbId, plan.prefix);
+        }
+        if (slotPrefix.empty() || recordKey.encode() >= slotPrefix) {
+          auto nextSlot = getNextSlot(kvstoreSlots, recordSlotId);
+          // nextSlot == -1 means this kv-store has been iterated over
+          if (nextSlot == -1) {
+            break;
+          }
+          slotPrefix = genSlotPrefix(nextSlot, dbId, plan.prefix);
         }
 
-        // construct new record key to seek
-        auto nextRecordKey = genRecordKey(nextSlot, dbId, "");
-        cursor->seek(nextRecordKey.encode());
+        cursor->seek(slotPrefix);
         continue;
       }
 
@@ -873,6 +1002,7 @@ class ScanCommand : public Command {
       }
 
       result.emplace_back(record.getRecordKey());
+      seqs->push_back(*seq);
     }
 
     return result;
@@ -49,12 +49,14 @@ Expected<std::string> genericSRem(Session* sess,
 
   bool resetSKIndex(false);
   uint64_t cnt = 0;
+  uint64_t version = rv.value().getVersion();
   for (size_t i = 0; i < args.size(); ++i) {
     RecordKey subRk(metaRk.getChunkId(),
                     metaRk.getDbId(),
                     RecordType::RT_SET_ELE,
                     metaRk.getPrimaryKey(),
-                    args[i]);
+                    args[i],
+                    version);
     Expected<RecordValue> rv = kvstore->getKV(subRk, txn);
     if (rv.ok()) {
       cnt += 1;
@@ -129,12 +131,15 @@ Expected<std::string> genericSAdd(Session* sess,
 
   bool resetSKIndex(false);
   uint64_t cnt = 0;
+  uint64_t version =
+    Command::getSubKeyVersion(sess, rv, RecordType::RT_SET_META);
   for (size_t i = 2; i < args.size(); ++i) {
     RecordKey subRk(metaRk.getChunkId(),
                     metaRk.getDbId(),
                     RecordType::RT_SET_ELE,
                     metaRk.getPrimaryKey(),
-                    args[i]);
+                    args[i],
+                    version);
 
     Expected<RecordValue> subrv = kvstore->getKV(subRk, txn);
     if (subrv.ok()) {
@@ -158,13 +163,13 @@ Expected<std::string> genericSAdd(Session* sess,
   if (resetSKIndex) {
     sm.setSKIndex("");
   }
-  Status s = kvstore->setKV(metaRk,
-                            RecordValue(sm.encode(),
-                                        RecordType::RT_SET_META,
-                                        sess->getCtx()->getVersionEP(),
-                                        ttl,
-                                        rv),
-                            txn);
+  RecordValue metaValue(sm.encode(),
+                        RecordType::RT_SET_META,
+                        sess->getCtx()->getVersionEP(),
+                        ttl,
+                        rv);
+  metaValue.setVersion(version);
+  Status s = kvstore->setKV(metaRk, metaValue, txn);
   if (!s.ok()) {
     return s;
   }
@@ -235,8 +240,12 @@ class SMembersCommand : public Command {
     std::stringstream ss;
     Command::fmtMultiBulkLen(ss, ssize);
     auto cursor = ptxn.value()->createDataCursor();
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
     cursor->seek(fake.prefixPk());
     while (true) {
       Expected<Record> exptRcd = cursor->next();
@@ -323,7 +332,8 @@ class SIsMemberCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_SET_ELE,
                     key,
-                    subkey);
+                    subkey,
+                    rv.value().getVersion());
     Expected<RecordValue> eSubVal = kvstore->getKV(subRk, ptxn.value());
     if (eSubVal.ok()) {
       return Command::fmtOne();
@@ -449,8 +459,12 @@ class SrandMemberCommand : public Command {
       // TODO(vinchen):  should be configable
       return {ErrorCodes::ERR_INTERNAL, "bulk too big"};
     }
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
     cursor->seek(fake.prefixPk());
     while (true) {
       Expected<Record> exptRcd = cursor->next();
@@ -570,8 +584,12 @@ class SpopCommand : public Command {
     if (!ptxn.ok()) {
       return ptxn.status();
     }
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
     // NOTE(zakzheng) get index of last scan.
     std::string spopFrom;
     if (sm.getSKIndex().size() > 0) {
@@ -579,7 +597,8 @@ class SpopCommand : public Command {
                          pCtx->getDbId(),
                          RecordType::RT_SET_ELE,
                          key,
-                         sm.getSKIndex());
+                         sm.getSKIndex(),
+                         rv.value().getVersion());
       spopFrom = indexKey.encode();
     } else {
       spopFrom = "0";
@@ -926,7 +945,8 @@ class SdiffgenericCommand : public Command {
                         pCtx->getDbId(),
                         RecordType::RT_SET_ELE,
                         args[i],
-                        ""};
+                        "",
+                        rv.value().getVersion()};
       cursor->seek(fake.prefixPk());
       while (true) {
         Expected<Record> exptRcd = cursor->next();
@@ -1085,6 +1105,8 @@ class SintergenericCommand : public Command {
 
     // stored all sets sorted by their length
     std::vector<std::pair<size_t, uint64_t>> setList;
+    // the subkey version of args[i]
+    std::vector<uint64_t> versions(args.size(), 0);
     for (size_t i = startkey; i < args.size(); i++) {
       Expected<RecordValue> rv =
         Command::expireKeyIfNeeded(sess, args[i], RecordType::RT_SET_META);
@@ -1112,6 +1134,7 @@ class SintergenericCommand : public Command {
         return Command::fmtNull();
       }
       setList.push_back(std::make_pair(i, setLength));
+      versions[i] = rv.value().getVersion();
     }
     std::sort(setList.begin(), setList.end(), [](auto& left, auto& right) {
       return left.second < right.second;
@@ -1134,7 +1157,8 @@ class SintergenericCommand : public Command {
                          pCtx->getDbId(),
                          RecordType::RT_SET_ELE,
                          key,
-                         "");
+                         "",
+                         versions[setList[i].first]);
         cursor->seek(fakeRk.prefixPk());
         while (true) {
           Expected<Record> expRcd = cursor->next();
@@ -1170,7 +1194,8 @@ class SintergenericCommand : public Command {
                         pCtx->getDbId(),
                         RecordType::RT_SET_ELE,
                         key,
-                        *iter);
+                        *iter,
+                        versions[setList[i].first]);
         Expected<RecordValue> subValue = kvstore->getKV(subRk, ptxn.value());
         // if key not found, erase it
         if (!subValue.ok() ||
@@ -1472,7 +1497,8 @@ class SuniongenericCommand : public Command {
                        pCtx->getDbId(),
                        RecordType::RT_SET_ELE,
                        args[i],
-                       "");
+                       "",
+                       rv.value().getVersion());
       cursor->seek(fakeRk.prefixPk());
       while (true) {
         Expected<Record> exptRcd = cursor->next();
@@ -7,7 +7,7 @@
 #include <vector>
 
 #include "novadbplus/commands/command.h"
-#include "novadbplus/storage/skiplist.h"
+#include "novadbplus/storage/zset_index.h"
 #include "novadbplus/storage/varint.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/string.h"
@@ -93,11 +93,25 @@ class SortCommand : public Command {
     }
 
     if (fieldKey.size() != 0) {
+      if (byRv.value().getRecordType() == RecordType::RT_HASH_META) {
+        auto eMeta = HashMetaValue::decode(byRv.value().getValue());
+        if (!eMeta.ok()) {
+          return eMeta.status();
+        }
+        if (eMeta.value().isCompact()) {
+          const std::string* value = eMeta.value().getField(fieldKey);
+          if (value == nullptr) {
+            return {ErrorCodes::ERR_NOTFOUND, ""};
+          }
+          return *value;
+        }
+      }
       RecordKey hashRk(expdb.value().chunkId,
                        pCtx->getDbId(),
                        RecordType::RT_HASH_ELE,
                        metaKey,
-                       fieldKey);
+                       fieldKey,
+                       byRv.value().getVersion());
       auto hashVal = byStore->getKV(hashRk, byExptxn.value());
       if (!hashVal.ok()) {
         return hashVal.status();
@@ -295,7 +309,7 @@ class SortCommand : public Command {
     // get the length of the object
     ssize_t veclen(0);
     uint64_t lHead(0), lTail(0);
-    std::unique_ptr<SkipList> sl(nullptr);
+    std::unique_ptr<ZsetIndex> sl(nullptr);
     switch (keyType) {
       case RecordType::RT_LIST_META: {
         auto lm = ListMetaValue::decode(rv->getValue());
@@ -322,11 +336,12 @@ class SortCommand : public Command {
         }
         ZSlMetaValue meta = zm.value();
         veclen = meta.getCount() - 1;
-        sl = std::make_unique<SkipList>(metaRk.getChunkId(),
-                                        metaRk.getDbId(),
-                                        metaRk.getPrimaryKey(),
-                                        meta,
-                                        kvstore);
+        sl = createZsetIndex(metaRk.getChunkId(),
+                             metaRk.getDbId(),
+                             metaRk.getPrimaryKey(),
+                             meta,
+                             kvstore,
+                             rv->getVersion());
         break;
       }
       default:
@@ -405,7 +420,8 @@ class SortCommand : public Command {
                           pCtx->getDbId(),
                           RecordType::RT_SET_ELE,
                           key,
-                          ""};
+                          "",
+                          rv->getVersion()};
       cursor->seek(fakeRk.prefixPk());
       while (true) {
         Expected<Record> expRcd = cursor->next();
@@ -15,6 +15,7 @@
 #include "novadbplus/commands/command.h"
 #include "novadbplus/commands/dump.h"
 #include "novadbplus/storage/varint.h"
+#include "novadbplus/utils/bitops.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/redis_port.h"
 
@@ -1352,13 +1353,6 @@ class TBitopCommand : public Command {
  public:
   TBitopCommand() : Command("tbitop", "wm") {}
 
-  enum class Op {
-    BITOP_AND,
-    BITOP_OR,
-    BITOP_XOR,
-    BITOP_NOT,
-  };
-
   ssize_t arity() const {
     return -4;
   }
@@ -1380,19 +1374,19 @@ class TBitopCommand : public Command {
     const std::string& opName = toLower(args[1]);
     const std::string& targetKey = args[2];
 
-    Op op;
+    bitops::Op op;
     if (opName == "and") {
-      op = Op::BITOP_AND;
+      op = bitops::Op::AND;
     } else if (opName == "or") {
-      op = Op::BITOP_OR;
+      op = bitops::Op::OR;
     } else if (opName == "xor") {
-      op = Op::BITOP_XOR;
+      op = bitops::Op::XOR;
     } else if (opName == "not") {
-      op = Op::BITOP_NOT;
+      op = bitops::Op::NOT;
     } else {
       return {ErrorCodes::ERR_PARSEPKT, "syntax error"};
     }
-    if (op == Op::BITOP_NOT && args.size() != 4) {
+    if (op == bitops::Op::NOT && args.size() != 4) {
       return {ErrorCodes::ERR_PARSEPKT,
               "-ERR BITOP NOT must be called with a single source key."};
     }
@@ -1441,36 +1435,7 @@ class TBitopCommand : public Command {
     TBitMapMetaValue meta(maxBitAmount, 0, 1, fragmentLen);
 
     auto maxlen = meta.byteAmount();
-    std::string result(maxlen, 0);
-    for (size_t i = 0; i < maxlen; ++i) {
-      unsigned char output = (vals[0].size() <= i) ? 0 : vals[0][i];
-      if (op == Op::BITOP_NOT)
-        output = ~output;
-      for (size_t j = 1; j < numKeys; ++j) {
-        bool skip = false;
-        unsigned char byte = (vals[j].size() <= i) ? 0 : vals[j][i];
-        switch (op) {
-          case Op::BITOP_AND:
-            output &= byte;
-            skip = (output == 0);
-            break;
-          case Op::BITOP_OR:
-            output |= byte;
-            skip = (output == 0xff);
-            break;
-          case Op::BITOP_XOR:
-            output ^= byte;
-            break;
-          default:
-            INVARIANT_D(0);
-        }
-
-        if (skip) {
-          break;
-        }
-      }
-      result[i] = output;
-    }
+    std::string result = bitops::bitop(op, vals, maxlen);
 
     // delete the old key
     auto s = Command::delKey(
@@ -14,6 +14,7 @@
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/storage/skiplist.h"
+#include "novadbplus/storage/zset_index.h"
 #include "novadbplus/storage/varint.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/redis_port.h"
@@ -49,7 +50,9 @@ Expected<std::string> genericZrem(Session* sess,
     return eMetaContent.status();
   }
   ZSlMetaValue meta = eMetaContent.value();
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
+  uint64_t version = eMeta.value().getVersion();
+  auto sl = createZsetIndex(
+    mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore, version);
 
   uint32_t cnt = 0;
   for (const auto& subkey : subkeys) {
@@ -57,7 +60,8 @@ Expected<std::string> genericZrem(Session* sess,
                  pCtx->getDbId(),
                  RecordType::RT_ZSET_H_ELE,
                  mk.getPrimaryKey(),
-                 subkey);
+                 subkey,
+                 version);
     Expected<RecordValue> eValue = kvstore->getKV(hk, ptxn.value());
     if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
       return eValue.status();
@@ -71,7 +75,7 @@ Expected<std::string> genericZrem(Session* sess,
       if (!oldScore.ok()) {
         return oldScore.status();
       }
-      Status s = sl.remove(oldScore.value(), subkey, ptxn.value());
+      Status s = sl->remove(oldScore.value(), subkey, ptxn.value());
       if (!s.ok()) {
         return s;
       }
@@ -82,20 +86,15 @@ Expected<std::string> genericZrem(Session* sess,
     }
   }
   Status s;
-  if (sl.getCount() > 1) {
-    s = sl.save(ptxn.value(), eMeta, pCtx->getVersionEP());
+  if (sl->getCount() > 1) {
+    s = sl->save(ptxn.value(), eMeta, pCtx->getVersionEP());
   } else {
-    INVARIANT(sl.getCount() == 1);
+    INVARIANT(sl->getCount() == 1);
     s = Command::delKeyAndTTL(sess, mk, eMeta.value(), kvstore, ptxn.value());
     if (!s.ok()) {
       return s;
     }
-    RecordKey head(mk.getChunkId(),
-                   pCtx->getDbId(),
-                   RecordType::RT_ZSET_S_ELE,
-                   mk.getPrimaryKey(),
-                   std::to_string(ZSlMetaValue::HEAD_ID));
-    s = kvstore->delKV(head, ptxn.value());
+    s = sl->drop(ptxn.value());
   }
   if (!s.ok()) {
     return s;
@@ -142,7 +141,8 @@ Expected<std::string> genericZadd(Session* sess,
   SessionCtx* pCtx = sess->getCtx();
 
   ZSlMetaValue meta;
-
+  uint64_t version =
+    Command::getSubKeyVersion(sess, eMeta, RecordType::RT_ZSET_META);
   if (eMeta.ok()) {
     auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
     if (!eMetaContent.ok()) {
@@ -152,43 +152,43 @@ Expected<std::string> genericZadd(Session* sess,
   } else {
     INVARIANT_D(eMeta.status().code() == ErrorCodes::ERR_NOTFOUND ||
                 eMeta.status().code() == ErrorCodes::ERR_EXPIRED);
-    // head node also included into the count
-    ZSlMetaValue tmp(1 /*lvl*/, 1 /*count*/, 0 /*tail*/);
-    RecordValue rv(
-      tmp.encode(), RecordType::RT_ZSET_META, pCtx->getVersionEP());
-    Status s = kvstore->setKV(mk, rv, txn);
-    if (!s.ok()) {
-      return s;
-    }
-    RecordKey head(mk.getChunkId(),
-                   pCtx->getDbId(),
-                   RecordType::RT_ZSET_S_ELE,
-                   mk.getPrimaryKey(),
-                   std::to_string(ZSlMetaValue::HEAD_ID));
-    ZSlEleValue headVal;
-    RecordValue subRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
-    s = kvstore->setKV(head, subRv, txn);
-    if (!s.ok()) {
-      return s;
+    const auto& params = sess->getServerEntry()->getParams();
+    auto eNewMeta = initZsetIndex(zsetEncodingFromStr(params->zsetEncoding),
+                                  mk,
+                                  version,
+                                  kvstore,
+                                  txn);
+    if (!eNewMeta.ok()) {
+      return eNewMeta.status();
     }
-    meta = ZSlMetaValue::decode(rv.getValue()).value();
+    meta = eNewMeta.value();
   }
 
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
-  std::stringstream ss;
+  auto sl = createZsetIndex(
+    mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore, version);
   double newScore = 0;
-  // sl.traverse(ss, ptxn.value());
+  std::vector<RecordKey> hks;
+  hks.reserve(subKeys.size());
   for (const auto& entry : subKeys) {
-    RecordKey hk(mk.getChunkId(),
-                 pCtx->getDbId(),
-                 RecordType::RT_ZSET_H_ELE,
-                 mk.getPrimaryKey(),
-                 entry.first);
+    hks.emplace_back(mk.getChunkId(),
+                     pCtx->getDbId(),
+                     RecordType::RT_ZSET_H_ELE,
+                     mk.getPrimaryKey(),
+                     entry.first,
+                     version);
+  }
+  auto eValues = kvstore->multiGetKV(hks, txn);
+  // the new nodes are linked in one pass after the loop, sorted as
+  // the skiplist
+  std::vector<std::pair<double, std::string>> toInsert;
+  size_t idx = 0;
+  for (const auto& entry : subKeys) {
+    const RecordKey& hk = hks[idx];
+    const Expected<RecordValue>& eValue = eValues[idx++];
     newScore = entry.second;
     if (std::isnan(newScore)) {
       return {ErrorCodes::ERR_NAN, ""};
     }
-    Expected<RecordValue> eValue = kvstore->getKV(hk, txn);
     if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
       return eValue.status();
     }
@@ -198,12 +198,9 @@ Expected<std::string> genericZadd(Session* sess,
       }
       added++;
       processed++;
-      Status s = sl.insert(entry.second, entry.first, txn);
-      if (!s.ok()) {
-        return s;
-      }
+      toInsert.emplace_back(entry.second, entry.first);
       RecordValue hv(newScore, RecordType::RT_ZSET_H_ELE);
-      s = kvstore->setKV(hk, hv, txn);
+      Status s = kvstore->setKV(hk, hv, txn);
       if (!s.ok()) {
         return s;
       }
@@ -229,14 +226,11 @@ Expected<std::string> genericZadd(Session* sess,
       updated++;
       processed++;
       // change score
-      Status s = sl.remove(oldScore.value(), entry.first, txn);
-      if (!s.ok()) {
-        return s;
-      }
-      s = sl.insert(newScore, entry.first, txn);
+      Status s = sl->remove(oldScore.value(), entry.first, txn);
       if (!s.ok()) {
         return s;
       }
+      toInsert.emplace_back(newScore, entry.first);
       RecordValue hv(newScore, RecordType::RT_ZSET_H_ELE);
       s = kvstore->setKV(hk, hv, txn);
       if (!s.ok()) {
@@ -244,8 +238,15 @@ Expected<std::string> genericZadd(Session* sess,
       }
     }
   }
+  std::sort(toInsert.begin(), toInsert.end(), [](const auto& a, const auto& b) {
+    return slCmp(a.first, a.second, b.first, b.second) < 0;
+  });
+  Status s = sl->insertBatch(toInsert, txn);
+  if (!s.ok()) {
+    return s;
+  }
   // NOTE(vinchen): skiplist save one time
-  Status s = sl.save(txn, eMeta, sess->getCtx()->getVersionEP());
+  s = sl->save(txn, eMeta, sess->getCtx()->getVersionEP());
   if (!s.ok()) {
     return s;
   }
@@ -275,7 +276,8 @@ Expected<std::string> genericZRank(Session* sess,
                mk.getDbId(),
                RecordType::RT_ZSET_H_ELE,
                mk.getPrimaryKey(),
-               subkey);
+               subkey,
+               mv.getVersion());
   Expected<RecordValue> eValue = kvstore->getKV(hk, ptxn.value());
   if (!eValue.ok()) {
     if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -294,8 +296,13 @@ Expected<std::string> genericZRank(Session* sess,
     return eMetaContent.status();
   }
   const ZSlMetaValue& meta = eMetaContent.value();
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
-  Expected<uint32_t> rank = sl.rank(score.value(), subkey, ptxn.value());
+  auto sl = createZsetIndex(mk.getChunkId(),
+                            mk.getDbId(),
+                            mk.getPrimaryKey(),
+                            meta,
+                            kvstore,
+                            mv.getVersion());
+  Expected<uint32_t> rank = sl->rank(score.value(), subkey, ptxn.value());
   if (!rank.ok()) {
     return rank.status();
   }
@@ -372,11 +379,16 @@ class ZRemByRangeGenericCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(
-      mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
+    uint64_t version = eMeta.value().getVersion();
+    auto sl = createZsetIndex(mk.getChunkId(),
+                              mk.getDbId(),
+                              mk.getPrimaryKey(),
+                              meta,
+                              kvstore,
+                              version);
 
     if (_type == Type::RANK) {
-      int64_t llen = sl.getCount() - 1;
+      int64_t llen = sl->getCount() - 1;
       if (start < 0) {
         start = llen + start;
       }
@@ -396,19 +408,19 @@ class ZRemByRangeGenericCommand : public Command {
 
     std::list<std::pair<double, std::string>> result;
     if (_type == Type::RANK) {
-      auto tmp = sl.removeRangeByRank(start + 1, end + 1, ptxn.value());
+      auto tmp = sl->removeRangeByRank(start + 1, end + 1, ptxn.value());
       if (!tmp.ok()) {
         return tmp.status();
       }
       result = std::move(tmp.value());
     } else if (_type == Type::SCORE) {
-      auto tmp = sl.removeRangeByScore(range, ptxn.value());
+      auto tmp = sl->removeRangeByScore(range, ptxn.value());
       if (!tmp.ok()) {
         return tmp.status();
       }
       result = std::move(tmp.value());
     } else if (_type == Type::LEX) {
-      auto tmp = sl.removeRangeByLex(lexrange, ptxn.value());
+      auto tmp = sl->removeRangeByLex(lexrange, ptxn.value());
       if (!tmp.ok()) {
         return tmp.status();
       }
@@ -419,7 +431,8 @@ class ZRemByRangeGenericCommand : public Command {
                    pCtx->getDbId(),
                    RecordType::RT_ZSET_H_ELE,
                    mk.getPrimaryKey(),
-                   v.second);
+                   v.second,
+                   version);
       auto s = kvstore->delKV(hk, ptxn.value());
       if (!s.ok()) {
         return s;
@@ -427,20 +440,15 @@ class ZRemByRangeGenericCommand : public Command {
     }
 
     Status s;
-    if (sl.getCount() > 1) {
-      s = sl.save(ptxn.value(), eMeta, pCtx->getVersionEP());
+    if (sl->getCount() > 1) {
+      s = sl->save(ptxn.value(), eMeta, pCtx->getVersionEP());
     } else {
-      INVARIANT(sl.getCount() == 1);
+      INVARIANT(sl->getCount() == 1);
       s = Command::delKeyAndTTL(sess, mk, eMeta.value(), kvstore, ptxn.value());
       if (!s.ok()) {
         return s;
       }
-      RecordKey head(mk.getChunkId(),
-                     pCtx->getDbId(),
-                     RecordType::RT_ZSET_S_ELE,
-                     mk.getPrimaryKey(),
-                     std::to_string(ZSlMetaValue::HEAD_ID));
-      s = kvstore->delKV(head, ptxn.value());
+      s = sl->drop(ptxn.value());
     }
     if (!s.ok()) {
       return s;
@@ -620,6 +628,185 @@ class ZRemCommand : public Command {
   }
 } zremCmd;
 
+// ZCONVERT key
+// rewrite the zset with the encoding of zset-encoding, return 1 if it is
+// converted, 0 if it has the encoding already. The members are rewritten
+// with a new version, the old subkeys are left to the compaction filter.
+// It needs versionedKeys, the old subkeys are in the way otherwise.
+class ZConvertCommand : public Command {
+ public:
+  ZConvertCommand() : Command("zconvert", "w") {}
+
+  ssize_t arity() const {
+    return 2;
+  }
+
+  int32_t firstkey() const {
+    return 1;
+  }
+
+  int32_t lastkey() const {
+    return 1;
+  }
+
+  int32_t keystep() const {
+    return 1;
+  }
+
+  bool sameWithRedis() const {
+    return false;
+  }
+
+  // the members are moved in batches, each read and indexed by fresh
+  // ZsetIndex, so only the txn holds the whole zset, and it's accounted by
+  // the memory limit of the session.
+  static constexpr int64_t CONVERT_BATCH = 1000;
+
+  Expected<std::string> convert(Session* sess,
+                                PStore kvstore,
+                                const RecordKey& mk,
+                                const RecordValue& rv,
+                                ZSlMetaValue::Encoding encoding) {
+    SessionCtx* pCtx = sess->getCtx();
+    auto ptxn = pCtx->createTransaction(kvstore);
+    if (!ptxn.ok()) {
+      return ptxn.status();
+    }
+    auto eMeta = ZSlMetaValue::decode(rv.getValue());
+    if (!eMeta.ok()) {
+      return eMeta.status();
+    }
+    if (eMeta.value().getEncoding() == encoding) {
+      return Command::fmtZero();
+    }
+
+    uint64_t version = pCtx->getKeyVersion();
+    auto eNewMeta = initZsetIndex(encoding, mk, version, kvstore, ptxn.value());
+    if (!eNewMeta.ok()) {
+      return eNewMeta.status();
+    }
+    ZSlMetaValue newMeta = eNewMeta.value();
+    auto openOld = [&mk, &eMeta, &kvstore, &rv]() {
+      return createZsetIndex(mk.getChunkId(),
+                             mk.getDbId(),
+                             mk.getPrimaryKey(),
+                             eMeta.value(),
+                             kvstore,
+                             rv.getVersion());
+    };
+    // the head is also counted
+    int64_t count = openOld()->getCount() - 1;
+    int64_t start = 0;
+    do {
+      int64_t len = std::min(CONVERT_BATCH, count - start);
+      auto sl = openOld();
+      auto members = sl->scanByRank(start, len, false, ptxn.value());
+      if (!members.ok()) {
+        return members.status();
+      }
+      start += len;
+
+      uint64_t size = 0;
+      for (const auto& member : members.value()) {
+        size += member.second.size() + sizeof(member.first);
+      }
+      RET_IF_MEMORY_REQUEST_FAILED(sess, size);
+      for (const auto& member : members.value()) {
+        RecordKey hk(mk.getChunkId(),
+                     mk.getDbId(),
+                     RecordType::RT_ZSET_H_ELE,
+                     mk.getPrimaryKey(),
+                     member.second,
+                     version);
+        RecordValue hv(member.first, RecordType::RT_ZSET_H_ELE);
+        Status s = kvstore->setKV(hk, hv, ptxn.value());
+        if (!s.ok()) {
+          return s;
+        }
+      }
+      auto newSl = createZsetIndex(mk.getChunkId(),
+                                   mk.getDbId(),
+                                   mk.getPrimaryKey(),
+                                   newMeta,
+                                   kvstore,
+                                   version);
+      Status s = newSl->insertBatch(
+        {members.value().begin(), members.value().end()}, ptxn.value());
+      if (!s.ok()) {
+        return s;
+      }
+      s = newSl->save(ptxn.value(), rv, pCtx->getVersionEP());
+      if (!s.ok()) {
+        return s;
+      }
+      // the next batch goes on from the meta saved in the txn
+      auto eSaved = kvstore->getKV(mk, ptxn.value());
+      if (!eSaved.ok()) {
+        return eSaved.status();
+      }
+      auto eSavedMeta = ZSlMetaValue::decode(eSaved.value().getValue());
+      if (!eSavedMeta.ok()) {
+        return eSavedMeta.status();
+      }
+      newMeta = eSavedMeta.value();
+    } while (start < count);
+
+    auto eCmt = pCtx->commitTransaction(ptxn.value());
+    if (!eCmt.ok()) {
+      return eCmt.status();
+    }
+    return Command::fmtOne();
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    const std::string& key = sess->getArgs()[1];
+    auto server = sess->getServerEntry();
+    if (!server->getParams()->versionedKeys) {
+      return {ErrorCodes::ERR_INTERNAL,
+              "This instance has versioned keys disabled"};
+    }
+    auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
+      sess, key, mgl::LockMode::LOCK_X);
+    if (!expdb.ok()) {
+      return expdb.status();
+    }
+
+    Expected<RecordValue> rv =
+      Command::expireKeyIfNeeded(sess, key, RecordType::RT_ZSET_META);
+    if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
+        rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return Command::fmtZero();
+    } else if (!rv.ok()) {
+      return rv.status();
+    }
+
+    SessionCtx* pCtx = sess->getCtx();
+    INVARIANT(pCtx != nullptr);
+    RecordKey metaRk(expdb.value().chunkId,
+                     pCtx->getDbId(),
+                     RecordType::RT_ZSET_META,
+                     key,
+                     "");
+    auto encoding = zsetEncodingFromStr(server->getParams()->zsetEncoding);
+    for (int32_t i = 0; i < RETRY_CNT; ++i) {
+      Expected<std::string> s =
+        convert(sess, expdb.value().store, metaRk, rv.value(), encoding);
+      if (s.ok()) {
+        return s.value();
+      }
+      if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+        return s.status();
+      }
+      if (i == RETRY_CNT - 1) {
+        return s.status();
+      }
+    }
+
+    INVARIANT_D(0);
+    return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+  }
+} zconvertCmd;
+
 class ZCardCommand : public Command {
  public:
   ZCardCommand() : Command("zcard", "rF") {}
@@ -907,35 +1094,17 @@ class ZCountCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto f = sl.firstInRange(range, ptxn.value());
-    if (!f.ok()) {
-      return f.status();
-    }
-    if (f.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtZero();
-    }
-    auto first = sl.getCacheNode(f.value());
-    Expected<uint32_t> rank =
-      sl.rank(first->getScore(), first->getSubKey(), ptxn.value());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    // sl.getCount()-1 : total skiplist nodes exclude head
-    uint32_t count = (sl.getCount() - 1 - (rank.value() - 1));
-    auto l = sl.lastInRange(range, ptxn.value());
-    if (!l.ok()) {
-      return l.status();
-    }
-    if (l.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtLongLong(count);
-    }
-    auto last = sl.getCacheNode(l.value());
-    rank = sl.rank(last->getScore(), last->getSubKey(), ptxn.value());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    return Command::fmtLongLong(count - (sl.getCount() - 1 - rank.value()));
+    auto sl = createZsetIndex(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              meta,
+                              kvstore,
+                              rv.value().getVersion());
+    auto count = sl->countInRange(range, ptxn.value());
+    if (!count.ok()) {
+      return count.status();
+    }
+    return Command::fmtLongLong(count.value());
   }
 } zcountCommand;
 
@@ -997,36 +1166,18 @@ class ZlexCountCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
+    auto sl = createZsetIndex(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              meta,
+                              kvstore,
+                              rv.value().getVersion());
 
-    auto f = sl.firstInLexRange(range, ptxn.value());
-    if (!f.ok()) {
-      return f.status();
-    }
-    if (f.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtZero();
+    auto count = sl->countInLexRange(range, ptxn.value());
+    if (!count.ok()) {
+      return count.status();
     }
-    auto first = sl.getCacheNode(f.value());
-    Expected<uint32_t> rank =
-      sl.rank(first->getScore(), first->getSubKey(), ptxn.value());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    // sl.getCount()-1 : total skiplist nodes exclude head
-    uint32_t count = (sl.getCount() - 1 - (rank.value() - 1));
-    auto l = sl.lastInLexRange(range, ptxn.value());
-    if (!l.ok()) {
-      return l.status();
-    }
-    if (l.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtLongLong(count);
-    }
-    auto last = sl.getCacheNode(l.value());
-    rank = sl.rank(last->getScore(), last->getSubKey(), ptxn.value());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    return Command::fmtLongLong(count - (sl.getCount() - 1 - rank.value()));
+    return Command::fmtLongLong(count.value());
   }
 } zlexCntCmd;
 
@@ -1133,8 +1284,13 @@ class ZRangeByScoreGenericCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto arr = sl.scanByScore(range, offset, limit, _rev, ptxn.value());
+    auto sl = createZsetIndex(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              meta,
+                              kvstore,
+                              rv.value().getVersion());
+    auto arr = sl->scanByScore(range, offset, limit, _rev, ptxn.value());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1268,8 +1424,13 @@ class ZRangeByLexGenericCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto arr = sl.scanByLex(range, offset, limit, _rev, ptxn.value());
+    auto sl = createZsetIndex(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              meta,
+                              kvstore,
+                              rv.value().getVersion());
+    auto arr = sl->scanByLex(range, offset, limit, _rev, ptxn.value());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1368,8 +1529,13 @@ class ZRangeGenericCommand : public Command {
       return eMetaContent.status();
     }
     ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    int64_t len = sl.getCount() - 1;
+    auto sl = createZsetIndex(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              meta,
+                              kvstore,
+                              rv.value().getVersion());
+    int64_t len = sl->getCount() - 1;
     if (start < 0) {
       start = len + start;
     }
@@ -1386,7 +1552,7 @@ class ZRangeGenericCommand : public Command {
       end = len - 1;
     }
     int64_t rangeLen = end - start + 1;
-    auto arr = sl.scanByRank(start, rangeLen, _rev, ptxn.value());
+    auto arr = sl->scanByRank(start, rangeLen, _rev, ptxn.value());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1479,7 +1645,8 @@ class ZScoreCommand : public Command {
                  pCtx->getDbId(),
                  RecordType::RT_ZSET_H_ELE,
                  key,
-                 subkey);
+                 subkey,
+                 rv.value().getVersion());
     Expected<RecordValue> eValue = kvstore->getKV(hk, ptxn.value());
     if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
       return eValue.status();
@@ -1850,16 +2017,19 @@ class ZUnionInterGenericCommand : public Command {
       }
 
       RecordType keyType = zsetList[i].second.getRecordType();
+      uint64_t version = zsetList[i].second.getVersion();
       if (fakei == 0 || _op == ZsetOp::SET_OP_UNION) {
         if (keyType == RecordType::RT_ZSET_META) {
           Expected<ZSlMetaValue> zslMeta =
             ZSlMetaValue::decode(zsetList[i].second.getValue());
-          SkipList sl(expdb.value().chunkId,
-                      pCtx->getDbId(),
-                      key,
-                      zslMeta.value(),
-                      kvstore);
-          auto arr = sl.scanByRank(0, sl.getCount() - 1, false, ptxn.value());
+          auto sl = createZsetIndex(expdb.value().chunkId,
+                                    pCtx->getDbId(),
+                                    key,
+                                    zslMeta.value(),
+                                    kvstore,
+                                    version);
+          auto arr =
+            sl->scanByRank(0, sl->getCount() - 1, false, ptxn.value());
           if (!arr.ok()) {
             return arr.status();
           }
@@ -1879,7 +2049,8 @@ class ZUnionInterGenericCommand : public Command {
                        pCtx->getDbId(),
                        RecordType::RT_SET_ELE,
                        key,
-                       "");
+                       "",
+                       version);
           cursor->seek(rk.prefixPk());
           while (true) {
             Expected<Record> expRcd = cursor->next();
@@ -1909,8 +2080,12 @@ class ZUnionInterGenericCommand : public Command {
           : RecordType::RT_SET_ELE;
         for (auto iter = scoreMap.begin(); iter != scoreMap.end();) {
           const std::string& subkey = iter->first;
-          RecordKey rk(
-            expdb.value().chunkId, pCtx->getDbId(), eleType, key, subkey);
+          RecordKey rk(expdb.value().chunkId,
+                       pCtx->getDbId(),
+                       eleType,
+                       key,
+                       subkey,
+                       version);
           auto eVal = kvstore->getKV(rk, ptxn.value());
 
           if (!eVal.ok() || eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
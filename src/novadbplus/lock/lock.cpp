@@ -111,14 +111,13 @@ StoreLock::StoreLock(uint32_t storeId,
   //     StoreLock.
   // :ILock(new StoresLock(getParentMode(mode), nullptr, mgr),
   : ILock(nullptr, new mgl::MGLock(mgr), sess, isRecursive), _storeId(storeId) {
-  // NOTE(takenliu): std::to_string() has performance issue in multi thread,
-  //     because it will use std::locale(), so use snprintf instead.
-  std::string target = "store_" + uitos(storeId);
+  // NOTE: store/chunk locks use integer targets, no string is built.
   if (_sess) {
     _sess->getCtx()->setWaitLock(storeId, 0, "", mode);
   }
   novadb_LOCK_LATENCY_RECORD(
-    (_lockResult = _mgl->lock(target, mode, lockTimeoutMs)),
+    (_lockResult = _mgl->lock(
+       mgl::LockTargetType::LOCK_TARGET_STORE, storeId, mode, lockTimeoutMs)),
     _sess,
     uitos(_storeId),
     LockLatencyType::LLT_STORE);
@@ -153,14 +152,12 @@ ChunkLock::ChunkLock(uint32_t storeId,
   if (_parent->getLockResult() != mgl::LockRes::LOCKRES_OK) {
     _lockResult = _parent->getLockResult();
   } else {
-    // NOTE(takenliu): std::to_string() has performance issue in multi thread,
-    //     because it will use std::locale(), so use snprintf instead.
-    std::string target = "chunk_" + uitos(chunkId);
     if (_sess) {
       _sess->getCtx()->setWaitLock(storeId, chunkId, "", mode);
     }
     novadb_LOCK_LATENCY_RECORD(
-      (_lockResult = _mgl->lock(target, mode, lockTimeoutMs)),
+      (_lockResult = _mgl->lock(
+         mgl::LockTargetType::LOCK_TARGET_CHUNK, chunkId, mode, lockTimeoutMs)),
       _sess,
       uitos(_chunkId),
       LockLatencyType::LLT_CHUNK);
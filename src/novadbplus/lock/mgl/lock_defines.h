@@ -32,6 +32,15 @@ enum class LockRes : std::uint8_t {
   LOCKRES_NUM = 5,
 };
 
+// store/chunk level locks are identified by an integer instead of a target
+// string, so that they can be hashed and compared without building any
+// string. LOCK_TARGET_STRING is for all the others(key_xxx, stores...).
+enum class LockTargetType : std::uint8_t {
+  LOCK_TARGET_STRING = 0,
+  LOCK_TARGET_STORE = 1,
+  LOCK_TARGET_CHUNK = 2,
+};
+
 const char* lockModeRepr(LockMode mode);
 
 bool isConflict(uint16_t modes, LockMode mode);
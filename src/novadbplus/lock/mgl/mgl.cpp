@@ -18,10 +18,13 @@ std::list<MGLock*> MGLock::_dummyList{};
 MGLock::MGLock(MGLockMgr* mgr)
   : _id(_idGen.fetch_add(1, std::memory_order_relaxed)),
     _target(""),
+    _targetType(LockTargetType::LOCK_TARGET_STRING),
+    _targetId(0),
     _targetHash(0),
     _mode(LockMode::LOCK_NONE),
     _res(LockRes::LOCKRES_UNINITED),
     _resIter(_dummyList.end()),
+    _fastLocked(false),
     _lockMgr(mgr),
     _threadId(getCurThreadId()) {
   INVARIANT_D(_lockMgr != nullptr);
@@ -35,6 +38,7 @@ void MGLock::releaseLockResult() {
   std::lock_guard<std::mutex> lk(_mutex);
   _res = LockRes::LOCKRES_UNINITED;
   _resIter = _dummyList.end();
+  _fastLocked = false;
 }
 
 void MGLock::setLockResult(LockRes res, std::list<MGLock*>::iterator iter) {
@@ -43,6 +47,13 @@ void MGLock::setLockResult(LockRes res, std::list<MGLock*>::iterator iter) {
   _resIter = iter;
 }
 
+void MGLock::setFastLockResult() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _res = LockRes::LOCKRES_OK;
+  _resIter = _dummyList.end();
+  _fastLocked = true;
+}
+
 void MGLock::unlock() {
   LockRes status = getStatus();
   if (status != LockRes::LOCKRES_UNINITED) {
@@ -58,14 +69,40 @@ LockRes MGLock::lock(const std::string& target,
                      LockMode mode,
                      uint64_t timeoutMs) {
   _target = target;
+  _targetType = LockTargetType::LOCK_TARGET_STRING;
+  _targetId = 0;
   _mode = mode;
-  INVARIANT_D(getStatus() == LockRes::LOCKRES_UNINITED);
-  _resIter = _dummyList.end();
   if (_target != "") {
     _targetHash = static_cast<uint64_t>(std::hash<std::string>{}(_target));
   } else {
     _targetHash = 0;
   }
+  return lockInternal(timeoutMs);
+}
+
+LockRes MGLock::lock(LockTargetType type,
+                     uint32_t id,
+                     LockMode mode,
+                     uint64_t timeoutMs) {
+  INVARIANT_D(type != LockTargetType::LOCK_TARGET_STRING);
+  _target.clear();
+  _targetType = type;
+  _targetId = (static_cast<uint64_t>(enum2Int(type)) << 32) | id;
+  _mode = mode;
+  // finalizer of murmurhash3, spreads the id bits over the shards
+  uint64_t h = _targetId;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  _targetHash = h;
+  return lockInternal(timeoutMs);
+}
+
+LockRes MGLock::lockInternal(uint64_t timeoutMs) {
+  INVARIANT_D(getStatus() == LockRes::LOCKRES_UNINITED);
+  _resIter = _dummyList.end();
   _lockMgr->lock(this);
   if (getStatus() == LockRes::LOCKRES_OK) {
     return LockRes::LOCKRES_OK;
@@ -81,6 +118,21 @@ std::list<MGLock*>::iterator MGLock::getLockIter() const {
   return _resIter;
 }
 
+bool MGLock::isFastLocked() const {
+  return _fastLocked;
+}
+
+std::string MGLock::getTargetRepr() const {
+  switch (_targetType) {
+    case LockTargetType::LOCK_TARGET_STORE:
+      return "store_" + uitos(static_cast<uint32_t>(_targetId));
+    case LockTargetType::LOCK_TARGET_CHUNK:
+      return "chunk_" + uitos(static_cast<uint32_t>(_targetId));
+    default:
+      return _target;
+  }
+}
+
 void MGLock::notify() {
   _cv.notify_one();
 }
@@ -98,6 +150,7 @@ LockRes MGLock::getStatus() const {
 }
 
 std::string MGLock::toString() const {
+  std::string target = getTargetRepr();
   std::lock_guard<std::mutex> lk(_mutex);
   char buf[256];
   snprintf(buf,
@@ -105,7 +158,7 @@ std::string MGLock::toString() const {
            "id:%" PRIu64 " target:%s targetHash:%" PRIu64
            " LockMode:%s LockRes:%d threadId:%s",
            _id,
-           _target.c_str(),
+           target.c_str(),
            _targetHash,
            lockModeRepr(_mode),
            static_cast<int>(_res),
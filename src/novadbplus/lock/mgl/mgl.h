@@ -31,6 +31,10 @@ class MGLock {
   MGLock& operator=(const MGLock&) const = delete;
   ~MGLock();
   LockRes lock(const std::string& target, LockMode mode, uint64_t timeoutMs);
+  LockRes lock(LockTargetType type,
+               uint32_t id,
+               LockMode mode,
+               uint64_t timeoutMs);
   void unlock();
   uint64_t getHash() const {
     return _targetHash;
@@ -39,9 +43,18 @@ class MGLock {
     return _mode;
   }
   LockRes getStatus() const;
+  // empty if it's an integer target
   const std::string& getTarget() const {
     return _target;
   }
+  LockTargetType getTargetType() const {
+    return _targetType;
+  }
+  // (type << 32 | id) of an integer target
+  uint64_t getTargetId() const {
+    return _targetId;
+  }
+  std::string getTargetRepr() const;
   std::string toString() const;
   const std::string& getThreadId() const {
     return _threadId;
@@ -50,13 +63,18 @@ class MGLock {
  private:
   friend class LockSchedCtx;
   void setLockResult(LockRes res, std::list<MGLock*>::iterator iter);
+  void setFastLockResult();
   void releaseLockResult();
   std::list<MGLock*>::iterator getLockIter() const;
+  bool isFastLocked() const;
   void notify();
   bool waitLock(uint64_t timeoutMs);
+  LockRes lockInternal(uint64_t timeoutMs);
 
   const uint64_t _id;
   std::string _target;
+  LockTargetType _targetType;
+  uint64_t _targetId;
   uint64_t _targetHash;
   LockMode _mode;
 
@@ -65,6 +83,8 @@ class MGLock {
   std::condition_variable _cv;
   LockRes _res;
   std::list<MGLock*>::iterator _resIter;
+  // granted by LockSchedCtx::lockFast(), _resIter is not valid
+  bool _fastLocked;
   MGLockMgr* _lockMgr;
   std::string _threadId;
 
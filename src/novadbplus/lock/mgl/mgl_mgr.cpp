@@ -60,7 +60,8 @@ LockSchedCtx::LockSchedCtx()
   : _runningModes(0),
     _pendingModes(0),
     _runningRefCnt(enum2Int(LockMode::LOCK_MODE_NUM), 0),
-    _pendingRefCnt(enum2Int(LockMode::LOCK_MODE_NUM), 0) {}
+    _pendingRefCnt(enum2Int(LockMode::LOCK_MODE_NUM), 0),
+    _fastRunningCnt(0) {}
 
 // NOTE(deyukong): if compitable locks come endlessly,
 // and we always schedule compitable locks first.
@@ -78,6 +79,18 @@ void LockSchedCtx::lock(MGLock* core) {
   }
 }
 
+bool LockSchedCtx::lockFast(MGLock* core) {
+  auto mode = core->getMode();
+  if ((mode != LockMode::LOCK_IS && mode != LockMode::LOCK_IX) ||
+      !_pendingList.empty() || isConflict(_runningModes, mode)) {
+    return false;
+  }
+  incrRunningRef(mode);
+  ++_fastRunningCnt;
+  core->setFastLockResult();
+  return true;
+}
+
 void LockSchedCtx::schedPendingLocks() {
   std::list<MGLock*>::iterator it = _pendingList.begin();
   while (it != _pendingList.end()) {
@@ -102,13 +115,18 @@ void LockSchedCtx::schedPendingLocks() {
 bool LockSchedCtx::unlock(MGLock* core) {
   auto mode = core->getMode();
   if (core->getStatus() == LockRes::LOCKRES_OK) {
-    _runningList.erase(core->getLockIter());
+    if (core->isFastLocked()) {
+      INVARIANT_D(_fastRunningCnt != 0);
+      --_fastRunningCnt;
+    } else {
+      _runningList.erase(core->getLockIter());
+    }
     decRunningRef(mode);
     core->releaseLockResult();
     if (_runningModes != 0) {
       return false;
     }
-    INVARIANT_D(_runningList.size() == 0);
+    INVARIANT_D(_runningList.size() == 0 && _fastRunningCnt == 0);
     schedPendingLocks();
   } else if (core->getStatus() == LockRes::LOCKRES_WAIT) {
     _pendingList.erase(core->getLockIter());
@@ -120,7 +138,8 @@ bool LockSchedCtx::unlock(MGLock* core) {
   } else {
     INVARIANT_D(0);
   }
-  return _pendingList.empty() && _runningList.empty();
+  return _pendingList.empty() && _runningList.empty() &&
+    _fastRunningCnt == 0;
 }
 
 void LockSchedCtx::incrPendingRef(LockMode mode) {
@@ -167,6 +186,9 @@ std::string LockSchedCtx::toString() {
   for (auto i : _runningList) {
     ss << "running: {" << i->toString() << "}\r\n";
   }
+  if (_fastRunningCnt) {
+    ss << "running: {fast intent locks:" << _fastRunningCnt << "}\r\n";
+  }
 
   for (auto i : _pendingList) {
     ss << "pending: {" << i->toString() << "}\r\n";
@@ -180,6 +202,10 @@ std::vector<std::string> LockSchedCtx::getShardLocks() {
   for (auto i : _runningList) {
     tempLocks.push_back("running: {" + i->toString() + "}");
   }
+  if (_fastRunningCnt) {
+    tempLocks.push_back("running: {fast intent locks:" +
+                        std::to_string(_fastRunningCnt) + "}");
+  }
 
   for (auto i : _pendingList) {
     tempLocks.push_back("pending: {" + i->toString() + "}");
@@ -191,6 +217,10 @@ void MGLockMgr::lock(MGLock* core) {
   uint64_t hash = core->getHash();
   LockShard& shard = _shards[hash % SHARD_NUM];
   std::lock_guard<std::mutex> lk(shard.mutex);
+  if (core->getTargetType() != LockTargetType::LOCK_TARGET_STRING) {
+    shard.idMap[core->getTargetId()].lock(core);
+    return;
+  }
   auto iter = shard.map.find(core->getTarget());
   if (iter == shard.map.end()) {
     LockSchedCtx tmp;
@@ -209,6 +239,14 @@ void MGLockMgr::unlock(MGLock* core) {
   INVARIANT_D(core->getStatus() == LockRes::LOCKRES_WAIT ||
               core->getStatus() == LockRes::LOCKRES_OK);
 
+  if (core->getTargetType() != LockTargetType::LOCK_TARGET_STRING) {
+    auto iter = shard.idMap.find(core->getTargetId());
+    INVARIANT(iter != shard.idMap.end());
+    if (iter->second.unlock(core)) {
+      shard.idMap.erase(iter);
+    }
+    return;
+  }
   auto iter = shard.map.find(core->getTarget());
   INVARIANT(iter != shard.map.end());
   bool empty = iter->second.unlock(core);
@@ -238,6 +276,12 @@ std::vector<std::string> MGLockMgr::getLockList() {
         list.push_back(v);
       }
     }
+    for (auto& iter : shard.idMap) {
+      auto locklist = iter.second.getShardLocks();
+      for (auto& v : locklist) {
+        list.push_back(v);
+      }
+    }
   }
   return list;
 }
@@ -26,6 +26,10 @@ class LockSchedCtx {
   LockSchedCtx();
   LockSchedCtx(LockSchedCtx&&) = default;
   void lock(MGLock* core);
+  // grant an uncontended intent lock(IS/IX) by reference counting only,
+  // without linking it into _runningList. returns false if the lock has
+  // to go through lock().
+  bool lockFast(MGLock* core);
   bool unlock(MGLock* core);
   std::string toString();
   std::vector<std::string> getShardLocks();
@@ -42,6 +46,8 @@ class LockSchedCtx {
   std::vector<uint16_t> _pendingRefCnt;
   std::list<MGLock*> _runningList;
   std::list<MGLock*> _pendingList;
+  // running locks granted by lockFast()
+  uint32_t _fastRunningCnt;
 };
 
 /* First come first lock
@@ -62,6 +68,7 @@ class LockSchedCtx {
 struct alignas(128) LockShard {
   std::mutex mutex;
   std::unordered_map<std::string, LockSchedCtx> map;
+  std::unordered_map<uint64_t, LockSchedCtx> idMap;
 };
 
 // TODO(vinchen): now there is a warning here, because the MGLockMgr change from
@@ -70,10 +77,11 @@ struct alignas(128) LockShard {
 class MGLockMgr {
  public:
   MGLockMgr() = default;
-  void lock(MGLock* core);
-  void unlock(MGLock* core);
+  virtual ~MGLockMgr() = default;
+  virtual void lock(MGLock* core);
+  virtual void unlock(MGLock* core);
   std::string toString();
-  std::vector<std::string> getLockList();
+  virtual std::vector<std::string> getLockList();
 
  private:
   static constexpr size_t SHARD_NUM = 32;
@@ -11,6 +11,7 @@
 
 #include "novadbplus/lock/mgl/mgl.h"
 #include "novadbplus/lock/mgl/mgl_mgr.h"
+#include "novadbplus/lock/mgl/sharded_mgl_mgr.h"
 
 namespace novadbplus {
 
@@ -105,5 +106,144 @@ TEST(MGL, Starvation) {
   l3.unlock();
 }
 
+TEST(MGL, IdTarget) {
+  MGLockMgr mgr;
+  MGLock l1(&mgr), l2(&mgr), l3(&mgr), l4(&mgr);
+  EXPECT_EQ(
+    l1.lock(LockTargetType::LOCK_TARGET_STORE, 1, LockMode::LOCK_X, 1000),
+    LockRes::LOCKRES_OK);
+  // the same id in another level is another target
+  EXPECT_EQ(
+    l2.lock(LockTargetType::LOCK_TARGET_CHUNK, 1, LockMode::LOCK_X, 1000),
+    LockRes::LOCKRES_OK);
+  EXPECT_EQ(l3.lock("store_1", LockMode::LOCK_X, 1000), LockRes::LOCKRES_OK);
+  EXPECT_EQ(
+    l4.lock(LockTargetType::LOCK_TARGET_STORE, 1, LockMode::LOCK_IS, 100),
+    LockRes::LOCKRES_TIMEOUT);
+  EXPECT_EQ(l1.getTargetRepr(), "store_1");
+  EXPECT_EQ(l2.getTargetRepr(), "chunk_1");
+  l1.unlock();
+  l2.unlock();
+  l3.unlock();
+  l4.unlock();
+  EXPECT_TRUE(mgr.getLockList().empty());
+}
+
+TEST(ShardedMGL, ShardNum) {
+  EXPECT_EQ(ShardedMGLockMgr(1).getShardNum(), size_t(1));
+  EXPECT_EQ(ShardedMGLockMgr(100).getShardNum(), size_t(128));
+  EXPECT_EQ(ShardedMGLockMgr(1 << 20).getShardNum(), size_t(65536));
+  EXPECT_GE(ShardedMGLockMgr().getShardNum(), size_t(64));
+}
+
+TEST(ShardedMGL, OneTarget) {
+  ShardedMGLockMgr mgr;
+  MGLock l1(&mgr), l2(&mgr), l3(&mgr), l4(&mgr), l5(&mgr);
+  EXPECT_EQ(l1.lock("something", LockMode::LOCK_IS, 1000), LockRes::LOCKRES_OK);
+  EXPECT_EQ(l2.lock("something", LockMode::LOCK_IS, 1000), LockRes::LOCKRES_OK);
+  EXPECT_EQ(l3.lock("something", LockMode::LOCK_IX, 1000), LockRes::LOCKRES_OK);
+  EXPECT_EQ(l4.lock("something", LockMode::LOCK_IX, 1000), LockRes::LOCKRES_OK);
+  EXPECT_EQ(l5.lock("something", LockMode::LOCK_S, 1000),
+            LockRes::LOCKRES_TIMEOUT);
+  l1.unlock();
+  l2.unlock();
+  l3.unlock();
+  l4.unlock();
+  l5.unlock();
+  EXPECT_TRUE(mgr.getLockList().empty());
+}
+
+TEST(ShardedMGL, FastPath) {
+  ShardedMGLockMgr mgr(4);
+  MGLock l1(&mgr), l2(&mgr), l3(&mgr), l4(&mgr);
+  EXPECT_EQ(
+    l1.lock(LockTargetType::LOCK_TARGET_CHUNK, 7, LockMode::LOCK_IS, 1000),
+    LockRes::LOCKRES_OK);
+  EXPECT_EQ(
+    l2.lock(LockTargetType::LOCK_TARGET_CHUNK, 7, LockMode::LOCK_IX, 1000),
+    LockRes::LOCKRES_OK);
+  auto list = mgr.getLockList();
+  EXPECT_EQ(list.size(), size_t(1));
+  EXPECT_EQ(list[0], "running: {fast intent locks:2}");
+
+  std::thread tmp([&l3]() {
+    EXPECT_EQ(
+      l3.lock(LockTargetType::LOCK_TARGET_CHUNK, 7, LockMode::LOCK_X, 10000),
+      LockRes::LOCKRES_OK);
+  });
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  // X is pending, intent locks can't take the fast path any more
+  EXPECT_EQ(
+    l4.lock(LockTargetType::LOCK_TARGET_CHUNK, 7, LockMode::LOCK_IS, 100),
+    LockRes::LOCKRES_TIMEOUT);
+  l4.unlock();
+  l1.unlock();
+  l2.unlock();
+  tmp.join();
+  l3.unlock();
+  EXPECT_TRUE(mgr.getLockList().empty());
+}
+
+TEST(ShardedMGL, Starvation) {
+  ShardedMGLockMgr mgr;
+  MGLock l1(&mgr), l2(&mgr), l3(&mgr);
+  EXPECT_EQ(l1.lock("something", LockMode::LOCK_IS, 1000), LockRes::LOCKRES_OK);
+  std::thread tmp([&l2]() {
+    EXPECT_EQ(l2.lock("something", LockMode::LOCK_X, 10000),
+              LockRes::LOCKRES_OK);
+  });
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  EXPECT_EQ(l3.lock("something", LockMode::LOCK_IX, 1000),
+            LockRes::LOCKRES_TIMEOUT);
+  l1.unlock();
+  tmp.join();
+  l2.unlock();
+  l3.unlock();
+}
+
+TEST(ShardedMGL, MultiThread) {
+  ShardedMGLockMgr mgr(16);
+  constexpr uint32_t threadNum = 8;
+  constexpr uint32_t loop = 2000;
+  constexpr uint32_t keyNum = 4;
+  // only written with the X lock of the key held
+  std::vector<uint64_t> counters(keyNum, 0);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < threadNum; i++) {
+    threads.emplace_back([&mgr, &counters, i]() {
+      for (uint32_t j = 0; j < loop; j++) {
+        uint32_t k = (i + j) % keyNum;
+        MGLock store(&mgr), chunk(&mgr), key(&mgr);
+        EXPECT_EQ(store.lock(LockTargetType::LOCK_TARGET_STORE,
+                             0,
+                             LockMode::LOCK_IX,
+                             10000),
+                  LockRes::LOCKRES_OK);
+        EXPECT_EQ(chunk.lock(LockTargetType::LOCK_TARGET_CHUNK,
+                             k,
+                             LockMode::LOCK_IX,
+                             10000),
+                  LockRes::LOCKRES_OK);
+        EXPECT_EQ(
+          key.lock("key_" + std::to_string(k), LockMode::LOCK_X, 10000),
+          LockRes::LOCKRES_OK);
+        counters[k]++;
+        key.unlock();
+        chunk.unlock();
+        store.unlock();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  uint64_t total = 0;
+  for (auto c : counters) {
+    total += c;
+  }
+  EXPECT_EQ(total, uint64_t(threadNum) * loop);
+  EXPECT_TRUE(mgr.getLockList().empty());
+}
+
 }  // namespace mgl
 }  // namespace novadbplus
@@ -0,0 +1,113 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include "novadbplus/lock/mgl/sharded_mgl_mgr.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "novadbplus/lock/mgl/mgl.h"
+#include "novadbplus/utils/invariant.h"
+
+namespace novadbplus {
+
+namespace mgl {
+
+size_t ShardedMGLockMgr::roundShardNum(size_t shardNum) {
+  if (shardNum == 0) {
+    shardNum = std::max(std::thread::hardware_concurrency(), 4U) * 16;
+  }
+  size_t n = 1;
+  while (n < shardNum && n < MAX_SHARD_NUM) {
+    n <<= 1;
+  }
+  return n;
+}
+
+ShardedMGLockMgr::ShardedMGLockMgr(size_t shardNum)
+  : _shardMask(roundShardNum(shardNum) - 1),
+    _shards(new Shard[_shardMask + 1]) {}
+
+ShardedMGLockMgr::Shard& ShardedMGLockMgr::getShard(const MGLock* core) {
+  return _shards[core->getHash() & _shardMask];
+}
+
+void ShardedMGLockMgr::lockInCtx(Shard* shard,
+                                 std::unique_ptr<LockSchedCtx>* ctx,
+                                 MGLock* core) {
+  if (!*ctx) {
+    if (shard->freeCtxs.empty()) {
+      *ctx = std::make_unique<LockSchedCtx>();
+    } else {
+      *ctx = std::move(shard->freeCtxs.back());
+      shard->freeCtxs.pop_back();
+    }
+  }
+  if (!(*ctx)->lockFast(core)) {
+    (*ctx)->lock(core);
+  }
+}
+
+void ShardedMGLockMgr::lock(MGLock* core) {
+  Shard& shard = getShard(core);
+  std::lock_guard<std::mutex> lk(shard.mutex);
+  if (core->getTargetType() != LockTargetType::LOCK_TARGET_STRING) {
+    lockInCtx(&shard, &shard.idMap[core->getTargetId()], core);
+  } else {
+    lockInCtx(&shard, &shard.map[core->getTarget()], core);
+  }
+}
+
+template <typename Map, typename Key>
+void ShardedMGLockMgr::unlockInMap(Shard* shard,
+                                   Map* map,
+                                   const Key& key,
+                                   MGLock* core) {
+  auto iter = map->find(key);
+  INVARIANT(iter != map->end());
+  bool empty = iter->second->unlock(core);
+  if (empty) {
+    // NOTE: an empty LockSchedCtx has no running/pending lock and all its
+    // ref counts are zero, it can be reused as a new one.
+    if (shard->freeCtxs.size() < MAX_FREE_CTX_PER_SHARD) {
+      shard->freeCtxs.emplace_back(std::move(iter->second));
+    }
+    map->erase(iter);
+  }
+}
+
+void ShardedMGLockMgr::unlock(MGLock* core) {
+  Shard& shard = getShard(core);
+  std::lock_guard<std::mutex> lk(shard.mutex);
+
+  INVARIANT_D(core->getStatus() == LockRes::LOCKRES_WAIT ||
+              core->getStatus() == LockRes::LOCKRES_OK);
+
+  if (core->getTargetType() != LockTargetType::LOCK_TARGET_STRING) {
+    unlockInMap(&shard, &shard.idMap, core->getTargetId(), core);
+  } else {
+    unlockInMap(&shard, &shard.map, core->getTarget(), core);
+  }
+}
+
+std::vector<std::string> ShardedMGLockMgr::getLockList() {
+  std::vector<std::string> list;
+  for (size_t i = 0; i <= _shardMask; i++) {
+    Shard& shard = _shards[i];
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    for (auto& iter : shard.map) {
+      auto locklist = iter.second->getShardLocks();
+      list.insert(list.end(), locklist.begin(), locklist.end());
+    }
+    for (auto& iter : shard.idMap) {
+      auto locklist = iter.second->getShardLocks();
+      list.insert(list.end(), locklist.begin(), locklist.end());
+    }
+  }
+  return list;
+}
+
+}  // namespace mgl
+}  // namespace novadbplus
@@ -0,0 +1,67 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_LOCK_MGL_SHARDED_MGL_MGR_H__
+#define SRC_novadbPLUS_LOCK_MGL_SHARDED_MGL_MGR_H__
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "novadbplus/lock/mgl/lock_defines.h"
+#include "novadbplus/lock/mgl/mgl_mgr.h"
+
+namespace novadbplus {
+
+namespace mgl {
+
+// MGLockMgr for hosts with many cores:
+// 1) the number of shards scales with the cores instead of a fixed 32.
+// 2) uncontended intent locks(IS/IX, which are what the store/chunk level
+//    locks of every command are) are granted by LockSchedCtx::lockFast(),
+//    without linking them into the running list.
+// 3) LockSchedCtx are pooled per shard, instead of being created and
+//    destroyed with the first/last lock of a target.
+class ShardedMGLockMgr : public MGLockMgr {
+ public:
+  // shardNum is rounded up to a power of 2, 0 means 16 shards per core
+  explicit ShardedMGLockMgr(size_t shardNum = 0);
+  ShardedMGLockMgr(const ShardedMGLockMgr&) = delete;
+  ShardedMGLockMgr& operator=(const ShardedMGLockMgr&) = delete;
+  void lock(MGLock* core) final;
+  void unlock(MGLock* core) final;
+  std::vector<std::string> getLockList() final;
+  size_t getShardNum() const {
+    return _shardMask + 1;
+  }
+
+ private:
+  struct alignas(128) Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<LockSchedCtx>> map;
+    std::unordered_map<uint64_t, std::unique_ptr<LockSchedCtx>> idMap;
+    std::vector<std::unique_ptr<LockSchedCtx>> freeCtxs;
+  };
+
+  static constexpr size_t MAX_SHARD_NUM = 65536;
+  static constexpr size_t MAX_FREE_CTX_PER_SHARD = 16;
+
+  static size_t roundShardNum(size_t shardNum);
+  Shard& getShard(const MGLock* core);
+  void lockInCtx(Shard* shard,
+                 std::unique_ptr<LockSchedCtx>* ctx,
+                 MGLock* core);
+  template <typename Map, typename Key>
+  void unlockInMap(Shard* shard, Map* map, const Key& key, MGLock* core);
+
+  const size_t _shardMask;
+  std::unique_ptr<Shard[]> _shards;
+};
+
+}  // namespace mgl
+
+}  // namespace novadbplus
+#endif  // SRC_novadbPLUS_LOCK_MGL_SHARDED_MGL_MGR_H__
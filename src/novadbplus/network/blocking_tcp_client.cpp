@@ -4,7 +4,17 @@
 
 #include "novadbplus/network/blocking_tcp_client.h"
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -315,6 +325,87 @@ Status BlockingTcpClient::writeOneBatch(const char* data,
   }
 }
 
+Status BlockingTcpClient::waitWritable(std::chrono::seconds timeout) {
+  _notified = false;
+  auto self(shared_from_this());
+  _socket.async_wait(asio::ip::tcp::socket::wait_write,
+                     [this, self](const asio::error_code& oec) {
+                       std::unique_lock<std::mutex> lk(_mutex);
+                       _ec = oec;
+                       _notified = true;
+                       _cv.notify_one();
+                     });
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  if (_cv.wait_for(lk, timeout, [this] { return _notified; })) {
+    if (_ec) {
+      closeSocket();
+      return {ErrorCodes::ERR_NETWORK, _ec.message()};
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  closeSocket();
+  return {ErrorCodes::ERR_TIMEOUT, "sendFile timeout"};
+}
+
+Status BlockingTcpClient::sendFile(int fd,
+                                   uint64_t offset,
+                                   size_t size,
+                                   std::chrono::seconds timeout) {
+#ifdef __linux__
+  // the socket is non-blocking, sendfile() writes what fits into the
+  // socket buffer and we wait for it to drain before the next round.
+  while (size) {
+    off_t off = static_cast<off_t>(offset);
+    size_t sendSize = std::min(size, static_cast<size_t>(_netBatchSize));
+    ssize_t n = ::sendfile(_socket.native_handle(), fd, &off, sendSize);
+    if (n > 0) {
+      offset += n;
+      size -= n;
+      if (_rateLimiter) {
+        _rateLimiter->Request(n);
+      }
+      continue;
+    }
+    if (n == 0) {
+      return {ErrorCodes::ERR_INTERNAL, "sendfile reaches end of file"};
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      std::string err = strerror(errno);
+      closeSocket();
+      return {ErrorCodes::ERR_NETWORK, "sendfile failed:" + err};
+    }
+    auto s = waitWritable(timeout);
+    RET_IF_ERR(s);
+  }
+  return {ErrorCodes::ERR_OK, ""};
+#else
+  // no zero-copy path, read the range and write it as usual
+  std::string buf;
+  buf.resize(std::min(size, static_cast<size_t>(_netBatchSize)));
+  if (::lseek(fd, offset, SEEK_SET) < 0) {
+    return {ErrorCodes::ERR_INTERNAL, "lseek failed"};
+  }
+  while (size) {
+    size_t readSize = std::min(size, buf.size());
+    auto n = ::read(fd, &buf[0], readSize);
+    if (n <= 0) {
+      return {ErrorCodes::ERR_INTERNAL, "read file failed"};
+    }
+    auto s = writeOneBatch(buf.c_str(), n, timeout);
+    RET_IF_ERR(s);
+    size -= n;
+    if (_rateLimiter) {
+      _rateLimiter->Request(n);
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+#endif
+}
+
 Status BlockingTcpClient::writeLine(const std::string& line) {
   std::string line1 = line;
   line1.append("\r\n");
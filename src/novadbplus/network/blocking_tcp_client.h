@@ -44,6 +44,12 @@ class BlockingTcpClient
                        uint32_t size,
                        std::chrono::seconds timeout);
   Status writeData(const std::string& data);
+  // write [offset, offset + size) of the file fd to the socket, by
+  // sendfile(2) where it is available so the data skips user space.
+  Status sendFile(int fd,
+                  uint64_t offset,
+                  size_t size,
+                  std::chrono::seconds timeout);
 
   std::string getRemoteRepr() const {
     try {
@@ -137,6 +143,7 @@ class BlockingTcpClient
 
  private:
   Expected<std::string> realRead(size_t bufSize, std::chrono::seconds timeout);
+  Status waitWritable(std::chrono::seconds timeout);
   std::mutex _mutex;
   std::condition_variable _cv;
   bool _inited;
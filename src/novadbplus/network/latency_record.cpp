@@ -4,6 +4,9 @@
 
 #include "novadbplus/network/latency_record.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace novadbplus {
 
 LockLatencyRecord::LockLatencyRecord()
@@ -90,4 +93,80 @@ void RocksdbLatencyRecord::reset() {
   _failRocksdb = 0;
 }
 
+LatencyHistogram::~LatencyHistogram() {
+  for (auto& shard : _shards) {
+    delete shard.load(std::memory_order_relaxed);
+  }
+}
+
+LatencyHistogram::Shard* LatencyHistogram::allocShard(uint32_t idx) {
+  auto shard = new Shard();
+  Shard* expected = nullptr;
+  if (!_shards[idx].compare_exchange_strong(
+        expected, shard, std::memory_order_acq_rel)) {
+    // another thread of the same shard won
+    delete shard;
+    return expected;
+  }
+  return shard;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snap;
+  for (const auto& s : _shards) {
+    auto shard = s.load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      continue;
+    }
+    for (uint32_t i = 0; i < BUCKETS; ++i) {
+      auto cnt = shard->counts[i].load(std::memory_order_relaxed);
+      snap.counts[i] += cnt;
+      snap.count += cnt;
+    }
+    snap.sum += shard->sum.load(std::memory_order_relaxed);
+    snap.max = std::max(snap.max, shard->max.load(std::memory_order_relaxed));
+  }
+  return snap;
+}
+
+void LatencyHistogram::reset() {
+  for (auto& s : _shards) {
+    auto shard = s.load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      continue;
+    }
+    for (auto& cnt : shard->counts) {
+      cnt.store(0, std::memory_order_relaxed);
+    }
+    shard->sum.store(0, std::memory_order_relaxed);
+    shard->max.store(0, std::memory_order_relaxed);
+  }
+}
+
+uint64_t LatencyHistogram::bucketHigh(uint32_t idx) {
+  if (idx < 2 * SUB_BUCKETS) {
+    return idx;
+  }
+  uint32_t shift = idx / SUB_BUCKETS - 1;
+  uint64_t low = static_cast<uint64_t>(SUB_BUCKETS + idx % SUB_BUCKETS)
+    << shift;
+  return low + (1ULL << shift) - 1;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::ceil(count * p / 100));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(bucketHigh(i), max);
+    }
+  }
+  return max;
+}
+
 }  // namespace novadbplus
@@ -6,6 +6,7 @@
 #define SRC_novadbPLUS_NETWORK_LATENCY_RECORD_H_
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <utility>
@@ -63,6 +64,113 @@ struct RocksdbLatencyRecord {
   void reset();
 };
 
+// A lock-free latency histogram with HDR-style log-linear buckets: values
+// below 2 * SUB_BUCKETS are exact, larger ones keep SUB_BITS significant bits
+// after the leading one, so a percentile is off by at most 1/SUB_BUCKETS.
+// Each thread records into one of SHARDS copies of the counters (allocated on
+// first use), which are merged by snapshot().
+class LatencyHistogram {
+ public:
+  static constexpr uint32_t SUB_BITS = 3;
+  static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BITS;
+  // values are capped at 2^MAX_BITS - 1 (us, about 12 days)
+  static constexpr uint32_t MAX_BITS = 40;
+  static constexpr uint32_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+  static constexpr uint32_t SHARDS = 8;
+
+  struct Snapshot {
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    // the smallest recorded value v such that at least p percent of the
+    // values are <= v, up to the bucket precision
+    uint64_t percentile(double p) const;
+  };
+
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+  ~LatencyHistogram();
+
+  void record(uint64_t value) {
+    auto shard = getShard(threadShardIdx());
+    if (value > MAX_VALUE) {
+      value = MAX_VALUE;
+    }
+    shard->counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard->sum.fetch_add(value, std::memory_order_relaxed);
+    auto max = shard->max.load(std::memory_order_relaxed);
+    while (max < value &&
+           !shard->max.compare_exchange_weak(
+             max, value, std::memory_order_relaxed)) {
+    }
+  }
+  Snapshot snapshot() const;
+  void reset();
+
+  static uint32_t bucketIndex(uint64_t value) {
+    if (value < 2 * SUB_BUCKETS) {
+      return static_cast<uint32_t>(value);
+    }
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS +
+      static_cast<uint32_t>((value >> shift) - SUB_BUCKETS);
+  }
+  // the largest value which falls into bucket idx
+  static uint64_t bucketHigh(uint32_t idx);
+
+ private:
+  static constexpr uint64_t MAX_VALUE = (1ULL << MAX_BITS) - 1;
+
+  struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+  };
+
+  static uint32_t threadShardIdx() {
+    static std::atomic<uint32_t> nextIdx{0};
+    static thread_local uint32_t idx =
+      nextIdx.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return idx;
+  }
+  Shard* getShard(uint32_t idx) {
+    auto shard = _shards[idx].load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      return allocShard(idx);
+    }
+    return shard;
+  }
+  Shard* allocShard(uint32_t idx);
+
+  std::array<std::atomic<Shard*>, SHARDS> _shards{};
+};
+
+// process wide latency histograms(us), fed when latency-tracking is on
+inline LatencyHistogram& lockLatencyHistogram(LockLatencyType type) {
+  static std::array<LatencyHistogram, LockLatencyType::MAX_LLT> hists;
+  return hists[type];
+}
+
+inline LatencyHistogram& rocksdbLatencyHistogram(RocksdbLatencyType type) {
+  static std::array<LatencyHistogram, RocksdbLatencyType::MAX_RLT> hists;
+  return hists[type];
+}
+
+// time a task waits in a worker pool queue
+inline LatencyHistogram& poolQueueLatencyHistogram() {
+  static LatencyHistogram hist;
+  return hist;
+}
+
+// time spent sending a reply to a client
+inline LatencyHistogram& sendPacketLatencyHistogram() {
+  static LatencyHistogram hist;
+  return hist;
+}
+
 }  // namespace novadbplus
 
 #endif  // SRC_novadbPLUS_NETWORK_LATENCY_RECORD_H_
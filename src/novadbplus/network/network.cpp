@@ -9,6 +9,8 @@
 #include <memory>
 #include <string>
 
+#include "novadbplus/commands/command.h"
+#include "novadbplus/network/latency_record.h"
 #include "novadbplus/server/server_entry.h"
 #include "novadbplus/storage/varint.h"
 #include "novadbplus/utils/invariant.h"
@@ -53,7 +55,14 @@ constexpr ssize_t REDIS_IOBUF_LEN = (1024 * 16);
 constexpr ssize_t REDIS_MAX_QUERYBUF_LEN = (1024 * 1024 * 1024);
 constexpr ssize_t REDIS_INLINE_MAX_SIZE = (1024 * 64);
 constexpr ssize_t REDIS_MBULK_BIG_ARG = (1024 * 32);
+// the most bytes read at a time for the rest of a big arg
+constexpr size_t REDIS_BIG_ARG_READ_LEN = (1024 * 256);
 const int BUFFER_LONG_SIZE = 10 * 1024 * 1024;
+// responses smaller than this are coalesced into one chunk
+constexpr size_t NET_SEND_RSP_CHUNK_SIZE = (1024 * 16);
+// replies of a pipeline batch are flushed early only beyond this size
+constexpr size_t NET_SEND_RSP_PIPELINE_SIZE = (1024 * 64);
+constexpr size_t NET_SEND_RSP_FREE_CHUNKS = 4;
 
 std::string RequestMatrix::toString() const {
   std::stringstream ss;
@@ -80,7 +89,7 @@ std::string NetworkMatrix::toString() const {
   std::stringstream ss;
   ss << "\nstickyPackets\t" << stickyPackets << "\nconnCreated\t" << connCreated
      << "\nconnReleased\t" << connReleased << "\ninvalidPackets\t"
-     << invalidPackets;
+     << invalidPackets << "\ninlineCommands\t" << inlineCommands;
   return ss.str();
 }
 
@@ -89,6 +98,7 @@ void NetworkMatrix::reset() {
   connCreated = 0;
   connReleased = 0;
   invalidPackets = 0;
+  inlineCommands = 0;
 }
 
 NetworkMatrix NetworkMatrix::operator-(const NetworkMatrix& right) {
@@ -97,6 +107,7 @@ NetworkMatrix NetworkMatrix::operator-(const NetworkMatrix& right) {
   result.connCreated = connCreated - right.connCreated;
   result.connReleased = connReleased - right.connReleased;
   result.invalidPackets = invalidPackets - right.invalidPackets;
+  result.inlineCommands = inlineCommands - right.inlineCommands;
   return result;
 }
 
@@ -420,14 +431,20 @@ NetSession::NetSession(std::shared_ptr<ServerEntry> server,
     _closeAfterRsp(false),
     _state(State::Created),
     _sock(std::move(sock)),
-    _queryBuf(std::vector<char>()),
+    _queryBuf(QueryBuffer()),
     _queryBufPos(0),
+    _queryBufStart(0),
+    _bigArgLen(0),
     _reqType(RedisReqMode::REDIS_REQ_UNKNOWN),
     _multibulklen(0),
     _bulkLen(-1),
     _isSendRunning(false),
     _callbackCanWrite(false),
     _isEnded(false),
+    _sendBufferBytes(0),
+    _sendBufferBackBytes(0),
+    _inPipelineBatch(false),
+    _onIoThread(false),
     _closeResponse(false),
     _netMatrix(netMatrix),
     _reqMatrix(reqMatrix),
@@ -557,12 +574,31 @@ asio::ip::tcp::socket* NetSession::getSock() {
 }
 
 Status NetSession::setResponse(const std::string& s) {
+  return appendResponse(&s, nullptr, 1);
+}
+
+Status NetSession::takeResponse(std::string&& s) {
+  return appendResponse(&s, &s, 1);
+}
+
+Status NetSession::takeResponses(std::vector<std::string>&& pieces) {
+  return appendResponse(pieces.data(), pieces.data(), pieces.size());
+}
+
+Status NetSession::appendResponse(const std::string* pieces,
+                                  std::string* movables,
+                                  size_t n) {
   std::lock_guard<std::mutex> lk(_mutex);
+  size_t size = 0;
+  for (size_t i = 0; i < n; i++) {
+    size += pieces[i].size();
+  }
   // when writing response to socket, check memory limit first.
-  // memory used = content(in memory) + content(will be in sendbuffer)
+  // memory used = content(in memory) + content(will be in sendbuffer,
+  //               unless it's moved in)
   //             + sendbuffer(current) + _sendBufferBack(maybe not empty)
-  _commandUsedMemory =
-    s.size() * 2 + _sendBuffer.size() + _sendBufferBack.size();
+  _commandUsedMemory = size * (movables ? 1 : 2) + _sendBufferBytes +
+    _sendBufferBackBytes;
   auto status = checkMemLimit();
   if (!status.ok()) {
     if (_server) {
@@ -582,7 +618,7 @@ Status NetSession::setResponse(const std::string& s) {
     return {ErrorCodes::ERR_NETWORK, "connection is ended"};
   }
 
-  if (s.empty()) {
+  if (size == 0) {
     LOG(WARNING) << "setResponse response is empty, id:" << id()
                  << " addr:" << getRemoteRepr();
     return {ErrorCodes::ERR_OK, ""};
@@ -601,18 +637,66 @@ Status NetSession::setResponse(const std::string& s) {
 
 #define NET_SEND_RSP_BATCH_SIZE 1400
 
-  if (_isSendRunning) {
-    std::copy(s.begin(), s.end(), std::back_inserter(_sendBufferBack));
-  } else {
-    std::copy(s.begin(), s.end(), std::back_inserter(_sendBuffer));
-    if (_sendBuffer.size() > NET_SEND_RSP_BATCH_SIZE) {
-      drainRspWithoutLock();
+  for (size_t i = 0; i < n; i++) {
+    const auto& s = pieces[i];
+    auto movable = movables ? &movables[i] : nullptr;
+    if (s.empty()) {
+      continue;
+    }
+    if (_isSendRunning) {
+      appendToChain(&_sendBufferBack, &_sendBufferBackBytes, s, movable);
+    } else {
+      appendToChain(&_sendBuffer, &_sendBufferBytes, s, movable);
+      size_t flushSize = _inPipelineBatch ? NET_SEND_RSP_PIPELINE_SIZE
+                                          : NET_SEND_RSP_BATCH_SIZE;
+      if (_sendBufferBytes > flushSize) {
+        drainRspWithoutLock();
+      }
     }
   }
   resetMemoryLimit();
   return {ErrorCodes::ERR_OK, ""};
 }
 
+void NetSession::appendToChain(std::deque<std::string>* chain,
+                               size_t* chainBytes,
+                               const std::string& s,
+                               std::string* movable) {
+  *chainBytes += s.size();
+  if (!chain->empty() &&
+      chain->back().size() + s.size() <= NET_SEND_RSP_CHUNK_SIZE) {
+    chain->back().append(s);
+    return;
+  }
+  if (movable && s.size() > NET_SEND_RSP_CHUNK_SIZE / 2) {
+    chain->emplace_back(std::move(*movable));
+    return;
+  }
+  std::string chunk;
+  if (s.size() <= NET_SEND_RSP_CHUNK_SIZE && !_freeChunks.empty()) {
+    chunk = std::move(_freeChunks.back());
+    _freeChunks.pop_back();
+  } else {
+    chunk.reserve(std::max(s.size(), NET_SEND_RSP_CHUNK_SIZE));
+  }
+  chunk.append(s);
+  chain->emplace_back(std::move(chunk));
+}
+
+void NetSession::recycleChain(std::deque<std::string>* chain) {
+  for (auto& chunk : *chain) {
+    if (_freeChunks.size() >= NET_SEND_RSP_FREE_CHUNKS) {
+      break;
+    }
+    if (chunk.capacity() >= NET_SEND_RSP_CHUNK_SIZE &&
+        chunk.capacity() < NET_SEND_RSP_CHUNK_SIZE * 2) {
+      chunk.clear();
+      _freeChunks.emplace_back(std::move(chunk));
+    }
+  }
+  chain->clear();
+}
+
 void NetSession::start() {
   stepState();
 }
@@ -648,19 +732,31 @@ void NetSession::setRspAndClose(const std::string& s) {
   resetMultiBulkCtx();
 }
 
+void NetSession::consumeQueryBuf(ssize_t n) {
+  INVARIANT_D(n >= 0 && _queryBufStart + n <= _queryBufPos);
+  _queryBufStart += n;
+  if (_queryBufStart == _queryBufPos) {
+    // all parsed, restart from the head of _queryBuf for free
+    _queryBufStart = 0;
+    _queryBufPos = 0;
+    _queryBuf[0] = 0;
+  }
+}
+
 void NetSession::processInlineBuffer() {
   char* newline = nullptr;
   std::vector<std::string> argv;
   std::string aux;
   size_t querylen;
   size_t linefeed_chars = 1;
+  char* querybuf = _queryBuf.data() + _queryBufStart;
 
   /* Search for end of line */
-  newline = strchr(_queryBuf.data(), '\n');
+  newline = strchr(querybuf, '\n');
 
   /* Nothing to do without a \r\n */
   if (newline == NULL) {
-    if (_queryBufPos > REDIS_INLINE_MAX_SIZE) {
+    if (_queryBufPos - _queryBufStart > REDIS_INLINE_MAX_SIZE) {
       ++_netMatrix->invalidPackets;
       setRspAndClose("Protocol error: too big inline request");
       setState(State::Stop);
@@ -671,14 +767,14 @@ void NetSession::processInlineBuffer() {
   }
 
   /* Handle the \r\n case. */
-  if (newline && newline != _queryBuf.data() && *(newline - 1) == '\r') {
+  if (newline && newline != querybuf && *(newline - 1) == '\r') {
     newline--;
     linefeed_chars++;
   }
 
   /* Split the input buffer up to the \r\n */
-  querylen = newline - (_queryBuf.data());
-  aux = std::string(_queryBuf.data(), querylen);
+  querylen = newline - querybuf;
+  aux = std::string(querybuf, querylen);
   auto ret = redis_port::splitargs(argv, aux);
   if (ret == NULL) {
     setRspAndClose("Protocol error: unbalanced quotes in request");
@@ -687,7 +783,7 @@ void NetSession::processInlineBuffer() {
   }
 
   /* Leave data after the first line of the query in the buffer */
-  shiftQueryBuf(querylen + linefeed_chars, -1);
+  consumeQueryBuf(querylen + linefeed_chars);
 
   if (_args.size() != 0) {
     LOG(FATAL) << "BUG: _args.size:" << _args.size() << " not empty";
@@ -712,10 +808,12 @@ void NetSession::processMultibulkBuffer() {
   long long ll;  // NOLINT(runtime/int)
   int pos = 0;
   int ok = 0;
+  char* querybuf = _queryBuf.data() + _queryBufStart;
+  ssize_t qblen = _queryBufPos - _queryBufStart;
   if (_multibulklen == 0) {
-    newLine = strchr(_queryBuf.data(), '\r');
+    newLine = strchr(querybuf, '\r');
     if (newLine == nullptr) {
-      if (_queryBufPos > REDIS_INLINE_MAX_SIZE) {
+      if (qblen > REDIS_INLINE_MAX_SIZE) {
         ++_netMatrix->invalidPackets;
         setRspAndClose("Protocol error: too big mbulk count string");
         setState(State::Stop);
@@ -726,7 +824,7 @@ void NetSession::processMultibulkBuffer() {
       return;
     }
     /* Buffer should also contain \n */
-    if (newLine - _queryBuf.data() > _queryBufPos - 2) {
+    if (newLine - querybuf > qblen - 2) {
       // not complete line
       setState(State::DrainReqNet);
       return;
@@ -734,14 +832,14 @@ void NetSession::processMultibulkBuffer() {
 
     /* We know for sure there is a whole line since newline != NULL,
      * so go ahead and find out the multi bulk length. */
-    if (_queryBuf[0] != '*') {
+    if (querybuf[0] != '*') {
       LOG(ERROR) << "multiBulk first char not *";
       ++_netMatrix->invalidPackets;
       setRspAndClose("Protocol error: multiBulk first char not *");
       setState(State::Stop);
       return;
     }
-    char* newStart = _queryBuf.data() + 1;
+    char* newStart = querybuf + 1;
     ok = redis_port::string2ll(newStart, newLine - newStart, &ll);
     if (!ok || ll > 1024 * 1024) {
       ++_netMatrix->invalidPackets;
@@ -749,9 +847,9 @@ void NetSession::processMultibulkBuffer() {
       setState(State::Stop);
       return;
     }
-    pos = newLine - _queryBuf.data() + 2;
+    pos = newLine - querybuf + 2;
     if (ll <= 0) {
-      shiftQueryBuf(pos, -1);
+      consumeQueryBuf(pos);
 
       INVARIANT(_args.size() == 0);
       setState(State::Process);
@@ -765,16 +863,18 @@ void NetSession::processMultibulkBuffer() {
 
   while (_multibulklen) {
     if (_bulkLen == -1) {
-      newLine = strchr(_queryBuf.data() + pos, '\r');
+      newLine = strchr(querybuf + pos, '\r');
       if (newLine == nullptr) {
         // NOTE(vinchen): For logical correctly, here it should minus
         // pos. In fact, it is also a bug for redis. But because of the
         // REDIS_MBULK_BIG_ARG optimization, it is not a problem in
         // redis now.
-        if (_queryBufPos - pos > REDIS_INLINE_MAX_SIZE) {
+        if (qblen - pos > REDIS_INLINE_MAX_SIZE) {
           ++_netMatrix->invalidPackets;
           LOG(ERROR) << "_multibulklen = " << _multibulklen
-                     << ", _queryBufPos = " << _queryBufPos << ", pos =" << pos;
+                     << ", _queryBufPos = " << _queryBufPos
+                     << ", _queryBufStart = " << _queryBufStart
+                     << ", pos =" << pos;
           INVARIANT_D(0);
           setRspAndClose("Protocol error: too big bulk count string");
           setState(State::Stop);
@@ -784,19 +884,18 @@ void NetSession::processMultibulkBuffer() {
       }
 
       /* Buffer should also contain \n */
-      if (newLine - _queryBuf.data() > _queryBufPos - 2) {
+      if (newLine - querybuf > qblen - 2) {
         break;
       }
-      if (_queryBuf.data()[pos] != '$') {
+      if (querybuf[pos] != '$') {
         std::stringstream s;
         ++_netMatrix->invalidPackets;
-        s << "Protocol error: expected '$', got '" << _queryBuf.data()[pos]
-          << "'";
+        s << "Protocol error: expected '$', got '" << querybuf[pos] << "'";
         setRspAndClose(s.str());
         setState(State::Stop);
         return;
       }
-      char* newStart = _queryBuf.data() + pos + 1;
+      char* newStart = querybuf + pos + 1;
       ok = redis_port::string2ll(newStart, newLine - newStart, &ll);
 
       uint32_t maxBulkLen = CONFIG_DEFAULT_PROTO_MAX_BULK_LEN;
@@ -809,32 +908,45 @@ void NetSession::processMultibulkBuffer() {
         setState(State::Stop);
         return;
       }
-      pos += newLine - (_queryBuf.data() + pos) + 2;
-      // the optimization of ll >= REDIS_MBULK_BIG_ARG
-      // is not ported from redis
-      if (ll >= REDIS_MBULK_BIG_ARG) {
-        /* If we are going to read a large object from network
-         * try to make it likely that it will start at c->querybuf
-         * boundary so that we can optimize object creation
-         * avoiding a large copy of data. */
-        shiftQueryBuf(pos, -1);
-        pos = 0;
-      }
+      pos += newLine - (querybuf + pos) + 2;
       _bulkLen = ll;
     }
-    if (_queryBufPos - pos < _bulkLen + 2) {
+    if (_bulkLen >= REDIS_MBULK_BIG_ARG) {
+      // like the REDIS_MBULK_BIG_ARG optimization of redis,
+      // a big arg is assembled in its own string rather than in _queryBuf.
+      // It is reserved once and appended as the bytes arrive, so it is
+      // neither zero-filled nor reallocated, see drainReqNet().
+      if (_bigArgLen == 0) {
+        _bigArgLen = _bulkLen + 2;
+        _bigArg.reserve(_bigArgLen);
+      }
+      size_t n = std::min(static_cast<size_t>(qblen - pos),
+                          _bigArgLen - _bigArg.size());
+      _bigArg.append(querybuf + pos, n);
+      pos += n;
+      if (_bigArg.size() < _bigArgLen) {
+        // not complete, _queryBuf is drained
+        break;
+      }
+      // strip the trailing \r\n
+      _bigArg.resize(_bulkLen);
+      _args.emplace_back(std::move(_bigArg));
+      _bigArg.clear();
+      _bigArgLen = 0;
+      _bulkLen = -1;
+      _multibulklen -= 1;
+    } else if (qblen - pos < _bulkLen + 2) {
       // not complete
       break;
     } else {
-      // TODO(vinchen): There is a optimization is not ported from redis
-      _args.push_back(std::string(_queryBuf.data() + pos, _bulkLen));
+      _args.emplace_back(querybuf + pos, _bulkLen);
       pos += _bulkLen + 2;
       _bulkLen = -1;
       _multibulklen -= 1;
     }
   }
   if (pos != 0) {
-    shiftQueryBuf(pos, -1);
+    consumeQueryBuf(pos);
   }
   if (_multibulklen == 0) {
     setState(State::Process);
@@ -889,28 +1001,71 @@ void NetSession::drainReqCallback(const std::error_code& ec, size_t actualLen) {
     return;
   }
   setState(State::DrainReqBuf);
+  if (_server && _type == Session::Type::NET &&
+      _server->getParams()->inlineReadEnabled) {
+    processInline();
+    return;
+  }
   schedule();
 }
 
+void NetSession::setPipelineBatch(bool v) {
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _inPipelineBatch = v;
+  }
+  _ctx->setPipelineBatch(v);
+}
+
 void NetSession::parseAndProcessReq() {
+  // all the complete requests in _queryBuf are executed here as one batch,
+  // with the replies flushed by drainRsp() below.
+  bool pipelineBatch = _server && _server->getParams()->pipelineBatchEnabled;
+  if (pipelineBatch) {
+    setPipelineBatch(true);
+  }
   while (_state == State::DrainReqBuf) {
-    if (_reqType == RedisReqMode::REDIS_REQ_UNKNOWN) {
-      if (_queryBuf[0] == '*') {
-        _reqType = RedisReqMode::REDIS_REQ_MULTIBULK;
-      } else {
-        _reqType = RedisReqMode::REDIS_REQ_INLINE;
-      }
-    }
-    if (_reqType == RedisReqMode::REDIS_REQ_MULTIBULK) {
-      processMultibulkBuffer();
-    } else if (_reqType == RedisReqMode::REDIS_REQ_INLINE) {
-      processInlineBuffer();
+    parseReq();
+  }
+  if (pipelineBatch) {
+    setPipelineBatch(false);
+  }
+  drainRsp();
+  if (_state == State::DrainReqNet) {
+    drainReqNet();
+  }
+}
+
+void NetSession::parseReq() {
+  if (_reqType == RedisReqMode::REDIS_REQ_UNKNOWN) {
+    if (_queryBuf[_queryBufStart] == '*') {
+      _reqType = RedisReqMode::REDIS_REQ_MULTIBULK;
     } else {
-      LOG(FATAL) << "unknown request type";
+      _reqType = RedisReqMode::REDIS_REQ_INLINE;
     }
   }
+  if (_reqType == RedisReqMode::REDIS_REQ_MULTIBULK) {
+    processMultibulkBuffer();
+  } else if (_reqType == RedisReqMode::REDIS_REQ_INLINE) {
+    processInlineBuffer();
+  } else {
+    LOG(FATAL) << "unknown request type";
+  }
+}
+
+void NetSession::processInline() {
+  _onIoThread = true;
+  while (_state == State::DrainReqBuf) {
+    parseReq();
+  }
+  _onIoThread = false;
   drainRsp();
-  if (_state == State::DrainReqNet) {
+  auto state = _state.load(std::memory_order_relaxed);
+  if (state == State::Process) {
+    // processReq() left a parsed request to the worker pool, nothing
+    // should be touched here after schedule()
+    schedule();
+  } else if (state == State::DrainReqNet) {
     drainReqNet();
   }
 }
@@ -957,29 +1112,41 @@ void NetSession::resetMultiBulkCtx() {
   _multibulklen = 0;
   _bulkLen = -1;
   _args.clear();
+  _bigArg.clear();
+  _bigArgLen = 0;
 }
 
 void NetSession::drainReqBuf() {
-  INVARIANT(_queryBufPos != 0);
+  INVARIANT(_queryBufPos != _queryBufStart);
   drainReqCallback(std::error_code(), 0);
 }
 
 void NetSession::drainReqNet() {
+  auto self(shared_from_this());
+  // drop the parsed bytes, only a partial request is left here
+  if (_queryBufStart != 0) {
+    shiftQueryBuf(_queryBufStart, -1);
+    _queryBufStart = 0;
+  }
+
   // we may do a sync-read to reduce async-callbacks
   size_t wantLen = REDIS_IOBUF_LEN;
+  if (_bigArgLen != 0) {
+    // read the rest of a big arg in bigger pieces, they are appended to
+    // _bigArg right after, see processMultibulkBuffer()
+    wantLen = std::max(
+      wantLen, std::min(_bigArgLen - _bigArg.size(), REDIS_BIG_ARG_READ_LEN));
+  }
   // here we use >= than >, so the last element will always be 0,
   // it's convinent for c-style string search
   if (wantLen + _queryBufPos >= _queryBuf.size()) {
-    // the fill should be as fast as memset in 02 mode, refer to here
-    // NOLINT(whitespace/line_length)
-    // https://stackoverflow.com/questions/8848575/fastest-way-to-reset-every-value-of-stdvectorint-to-0)
-    _queryBuf.resize((wantLen + _queryBufPos) * 2, 0);
+    // QueryBuffer default-initializes, so growing it doesn't zero-fill
+    _queryBuf.resize((wantLen + _queryBufPos) * 2);
   }
 
   // TODO(deyukong): I believe async_read_some wont callback if no
   // readable-event is set on the fd or this callback will be a deadloop
   // it needs futher tests
-  auto self(shared_from_this());
   _sock.async_read_some(
     asio::buffer(_queryBuf.data() + _queryBufPos, wantLen),
     [this, self](const std::error_code& ec, size_t actualLen) {
@@ -989,10 +1156,21 @@ void NetSession::drainReqNet() {
 }
 
 void NetSession::processReq() {
+  // the key lock of an inline command, held until the command is done
+  std::unique_ptr<KeyLock> inlineLock;
+  if (_onIoThread && _args.size()) {
+    if (!Command::canRunInline(this, &inlineLock)) {
+      // leave it in State::Process for the worker pool, see processInline()
+      return;
+    }
+    ++_netMatrix->inlineCommands;
+  }
   bool continueSched = true;
   if (_args.size()) {
     _ctx->setProcessPacketStart(nsSinceEpoch());
     continueSched = _server->processRequest(reinterpret_cast<Session*>(this));
+    _ctx->resetInlineMeta();
+    inlineLock.reset();
     _reqMatrix->processed += 1;
     _reqMatrix->processCost += nsSinceEpoch() - _ctx->getProcessPacketStart();
     _ctx->resetStatisticInfo();
@@ -1002,7 +1180,7 @@ void NetSession::processReq() {
     setState(State::Stop);
   } else if (!_closeAfterRsp) {
     resetMultiBulkCtx();
-    if (_queryBufPos == 0) {
+    if (_queryBufPos == _queryBufStart) {
       setState(State::DrainReqNet);
       return;
     } else {
@@ -1028,21 +1206,32 @@ void NetSession::drainRsp() {
 }
 
 void NetSession::drainRspWithoutLock() {
-  if (_sendBuffer.size() == 0) {
+  if (_sendBufferBytes == 0) {
     return;
   }
   uint64_t now = nsSinceEpoch();
   _isSendRunning = true;
   auto self(shared_from_this());
-  if (_sendBuffer.size() > BUFFER_LONG_SIZE) {
+  if (_sendBufferBytes > BUFFER_LONG_SIZE) {
     LOG(WARNING) << "drainRspWithoutLock async_write long size:"
-                 << _sendBuffer.size();
+                 << _sendBufferBytes;
+  }
+  // the chunks stay untouched until drainRspCallback(), responses
+  // arriving meanwhile go to _sendBufferBack
+  std::vector<asio::const_buffer> buffers;
+  buffers.reserve(_sendBuffer.size());
+  for (const auto& chunk : _sendBuffer) {
+    buffers.emplace_back(asio::buffer(chunk));
   }
   asio::async_write(
     _sock,
-    asio::buffer(_sendBuffer.data(), _sendBuffer.size()),
+    buffers,
     [this, self, now](const std::error_code& ec, size_t actualLen) {
-      _reqMatrix->sendPacketCost += nsSinceEpoch() - now;
+      auto cost = nsSinceEpoch() - now;
+      _reqMatrix->sendPacketCost += cost;
+      if (!gParams || gParams->latencyTracking) {
+        sendPacketLatencyHistogram().record(cost / 1000);
+      }
       drainRspCallback(ec, actualLen);
     });
 }
@@ -1053,33 +1242,39 @@ void NetSession::drainRspCallback(const std::error_code& ec, size_t actualLen) {
     endSession();
     return;
   }
-  if (actualLen != _sendBuffer.size()) {
+  if (actualLen != _sendBufferBytes) {
     LOG(ERROR) << "conn:" << _connId << ",actualLen:" << actualLen
-               << ",bufsize:" << _sendBuffer.size() << ",invalid drainRsp len";
+               << ",bufsize:" << _sendBufferBytes << ",invalid drainRsp len";
     endSession();
+    std::lock_guard<std::mutex> lk(_mutex);
     _sendBuffer.clear();
+    _sendBufferBytes = 0;
     return;
   }
   if (_server) {
     // TODO(vinchen): Is it right when cluster = true
-    _server->getServerStat().netOutputBytes += _sendBuffer.size();
+    _server->getServerStat().netOutputBytes += _sendBufferBytes;
   }
 
+  bool sendDone = false;
   {
     std::lock_guard<std::mutex> lk(_mutex);
     INVARIANT(_isSendRunning);
-    _sendBuffer.clear();
+    recycleChain(&_sendBuffer);
     _sendBuffer.swap(_sendBufferBack);
+    _sendBufferBytes = _sendBufferBackBytes;
+    _sendBufferBackBytes = 0;
 
-    if (_callbackCanWrite && !_sendBuffer.empty()) {
+    if (_callbackCanWrite && _sendBufferBytes != 0) {
       _callbackCanWrite = false;
       drainRspWithoutLock();
     } else {
       _callbackCanWrite = false;
       _isSendRunning = false;
     }
+    sendDone = _sendBufferBytes == 0;
   }
-  if (_closeResponse && _sendBuffer.empty()) {
+  if (_closeResponse && sendDone) {
     endSession();
   }
 }
@@ -1131,8 +1326,11 @@ void NetSession::stepState() {
       parseAndProcessReq();
       return;
     case State::Process:
-      INVARIANT_D(_type != Session::Type::NET);
       processReq();
+      if (_type == Session::Type::NET) {
+        // a request parsed by processInline(), go on with the rest
+        parseAndProcessReq();
+      }
       return;
     default:
       LOG(FATAL) << "connId:" << _connId
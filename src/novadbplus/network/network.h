@@ -8,10 +8,12 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <deque>
 #include <list>
 #include <map>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -45,6 +47,7 @@ class NetworkMatrix {
   Atom<uint64_t> connCreated{0};
   Atom<uint64_t> connReleased{0};
   Atom<uint64_t> invalidPackets{0};
+  Atom<uint64_t> inlineCommands{0};
   NetworkMatrix operator-(const NetworkMatrix& right);
   std::string toString() const;
   void reset();
@@ -139,6 +142,34 @@ class NetworkAsio {
   std::string _name;
 };
 
+// an allocator which default-initializes instead of value-initializes, so
+// growing a std::vector<char> doesn't zero-fill memory that is about to be
+// overwritten by socket reads.
+template <typename T>
+class DefaultInitAllocator : public std::allocator<T> {
+ public:
+  template <typename U>
+  struct rebind {
+    using other = DefaultInitAllocator<U>;
+  };
+
+  DefaultInitAllocator() noexcept = default;
+  template <typename U>
+  DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}  // NOLINT
+
+  template <typename U>
+  void construct(U* ptr) noexcept(
+    std::is_nothrow_default_constructible<U>::value) {
+    ::new (static_cast<void*>(ptr)) U;
+  }
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+};
+
+using QueryBuffer = std::vector<char, DefaultInitAllocator<char>>;
+
 struct SendBuffer {
   std::vector<char> buffer;
   bool closeAfterThis;
@@ -162,6 +193,8 @@ class NetSession : public Session {
   asio::ip::tcp::socket borrowConn();
   asio::ip::tcp::socket* getSock();
   virtual Status setResponse(const std::string& s);
+  Status takeResponse(std::string&& s) override;
+  Status takeResponses(std::vector<std::string>&& pieces) override;
   void setCloseAfterRsp();
   virtual void start();
   virtual Status cancel();
@@ -215,6 +248,13 @@ class NetSession : public Session {
 
   // parse req and process req
   virtual void parseAndProcessReq();
+  // parse and process req on the io thread, as long as they are cheap
+  // reads(see Command::canRunInline()), and hand the rest over to the
+  // worker pool.
+  void processInline();
+  bool isOnIoThread() const final {
+    return _onIoThread;
+  }
 
   // handle msg parsed from drainReqCallback
   virtual void processReq();
@@ -224,25 +264,52 @@ class NetSession : public Session {
  private:
   FRIEND_TEST(NetSession, drainReqInvalid);
   FRIEND_TEST(NetSession, Completed);
+  FRIEND_TEST(NetSession, BigArg);
+  FRIEND_TEST(NetSession, ResponseChain);
   FRIEND_TEST(Command, common);
   friend class NoSchedNetSession;
 
   void processMultibulkBuffer();
   void processInlineBuffer();
+  void parseReq();
 
   // network is ok, but client's msg is not ok, reply and close
   void setRspAndClose(const std::string&);
 
   // utils to shift parsed partial params from _queryBuf
   void shiftQueryBuf(ssize_t start, ssize_t end);
+  // mark n bytes from _queryBufStart as parsed
+  void consumeQueryBuf(ssize_t n);
+  void setPipelineBatch(bool v);
+
+  // each of the n pieces is copied into the tail chunk of
+  // _sendBuffer/_sendBufferBack if possible, otherwise it's moved(if
+  // movables) or copied into a new chunk. The pieces are checked against
+  // the memory limit as a whole, so either all or none of them is taken.
+  Status appendResponse(const std::string* pieces,
+                        std::string* movables,
+                        size_t n);
+  void appendToChain(std::deque<std::string>* chain,
+                     size_t* chainBytes,
+                     const std::string& s,
+                     std::string* movable);
+  void recycleChain(std::deque<std::string>* chain);
 
  protected:
   uint64_t _connId;
   bool _closeAfterRsp;
   std::atomic<State> _state;
   asio::ip::tcp::socket _sock;
-  std::vector<char> _queryBuf;
+  QueryBuffer _queryBuf;
   ssize_t _queryBufPos;
+  // bytes in [0, _queryBufStart) have been parsed, they are dropped
+  // lazily before the next read rather than after every command.
+  ssize_t _queryBufStart;
+  // a bulk arg of at least REDIS_MBULK_BIG_ARG bytes is appended to
+  // _bigArg(with the trailing \r\n) as it is read, and then moved into
+  // _args. _bigArgLen is its full length, or 0 if there isn't one.
+  std::string _bigArg;
+  size_t _bigArgLen;
 
   // contexts for RedisReqMode::REDIS_REQ_MULTIBULK
   RedisReqMode _reqType;
@@ -256,8 +323,20 @@ class NetSession : public Session {
   bool _callbackCanWrite;
   bool _isEnded;
   bool _first;
-  std::vector<char> _sendBuffer;
-  std::vector<char> _sendBufferBack;
+  // responses are queued as chains of chunks, _sendBuffer is the chain
+  // being written(by one scatter-gather write) and _sendBufferBack collects
+  // responses meanwhile. Small responses are coalesced into the tail chunk,
+  // large ones are moved in as a chunk of their own.
+  std::deque<std::string> _sendBuffer;
+  size_t _sendBufferBytes;
+  std::deque<std::string> _sendBufferBack;
+  size_t _sendBufferBackBytes;
+  // chunks recycled from the sent chain
+  std::vector<std::string> _freeChunks;
+  // executing a pipeline batch, replies are flushed at the end of it
+  bool _inPipelineBatch;
+  // in processInline()
+  bool _onIoThread;
   bool _closeResponse;
 
   std::shared_ptr<NetworkMatrix> _netMatrix;
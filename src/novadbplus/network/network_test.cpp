@@ -132,6 +132,99 @@ TEST(NetSession, Completed) {
   EXPECT_EQ(sess->_args[1], "1");
 }
 
+TEST(NetSession, BigArg) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  auto sess =
+    std::make_shared<NoSchedNetSession>(nullptr,
+                                        std::move(socket),
+                                        1,
+                                        false,
+                                        std::make_shared<NetworkMatrix>(),
+                                        std::make_shared<RequestMatrix>());
+
+  std::string value(100 * 1024, 'v');
+  std::string req = "*3\r\n$3\r\nset\r\n$1\r\nk\r\n$" +
+    std::to_string(value.size()) + "\r\n" + value + "\r\n";
+  // the header and a part of the value arrive in _queryBuf
+  size_t firstLen = req.size() - value.size() / 2;
+  sess->setState(NetSession::State::DrainReqNet);
+  sess->_queryBuf.resize(firstLen + 1);
+  std::copy(req.begin(), req.begin() + firstLen, sess->_queryBuf.begin());
+  sess->drainReqCallback(std::error_code(), firstLen);
+  sess->parseAndProcessReq();
+  EXPECT_EQ(sess->_state.load(), NetSession::State::DrainReqNet);
+  EXPECT_EQ(sess->_args.size(), size_t(2));
+  EXPECT_EQ(sess->_queryBufPos, 0);
+  EXPECT_EQ(sess->_bigArgLen, value.size() + 2);
+  EXPECT_GE(sess->_bigArg.capacity(), value.size() + 2);
+
+  // and the rest is appended to _bigArg as it arrives
+  size_t restLen = req.size() - firstLen;
+  EXPECT_EQ(sess->_bigArg.size() + restLen, sess->_bigArgLen);
+  sess->_queryBuf.resize(restLen + 1);
+  std::copy(req.begin() + firstLen, req.end(), sess->_queryBuf.begin());
+  sess->drainReqCallback(std::error_code(), restLen);
+  EXPECT_EQ(sess->_state.load(), NetSession::State::DrainReqBuf);
+  sess->parseAndProcessReq();
+  EXPECT_EQ(sess->_state.load(), NetSession::State::Process);
+  EXPECT_EQ(sess->_args.size(), size_t(3));
+  EXPECT_EQ(sess->_args[0], "set");
+  EXPECT_EQ(sess->_args[1], "k");
+  EXPECT_EQ(sess->_args[2], value);
+  EXPECT_TRUE(sess->_bigArg.empty());
+  EXPECT_EQ(sess->_bigArgLen, 0U);
+}
+
+TEST(NetSession, ResponseChain) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  auto sess =
+    std::make_shared<NoSchedNetSession>(nullptr,
+                                        std::move(socket),
+                                        1,
+                                        false,
+                                        std::make_shared<NetworkMatrix>(),
+                                        std::make_shared<RequestMatrix>());
+
+  // small responses are coalesced, large ones are moved in
+  std::string expect;
+  for (uint32_t i = 0; i < 100; i++) {
+    std::string rsp = ":" + std::to_string(i) + "\r\n";
+    expect += rsp;
+    EXPECT_TRUE(sess->setResponse(rsp).ok());
+  }
+  EXPECT_EQ(sess->_sendBufferBack.size(), size_t(1));
+
+  std::string big(64 * 1024, 'b');
+  expect += big;
+  const char* bigData = big.data();
+  EXPECT_TRUE(sess->takeResponse(std::move(big)).ok());
+  EXPECT_EQ(sess->_sendBufferBack.size(), size_t(2));
+  EXPECT_EQ(sess->_sendBufferBack.back().data(), bigData);
+
+  EXPECT_TRUE(sess->setResponse("+OK\r\n").ok());
+  expect += "+OK\r\n";
+  EXPECT_EQ(sess->_sendBufferBack.size(), size_t(3));
+  EXPECT_EQ(sess->_sendBufferBackBytes, expect.size());
+
+  // the pieces are taken all or none
+  sess->_hardMemoryLimit = expect.size() + 100;
+  EXPECT_FALSE(
+    sess->takeResponses({"*2\r\n", "$1\r\na\r\n", std::string(100, 'x')})
+      .ok());
+  EXPECT_EQ(sess->_sendBufferBackBytes, expect.size());
+  sess->_hardMemoryLimit = 0;
+  EXPECT_TRUE(
+    sess->takeResponses({"*2\r\n", "$1\r\na\r\n", "$1\r\nb\r\n"}).ok());
+  expect += "*2\r\n$1\r\na\r\n$1\r\nb\r\n";
+  EXPECT_EQ(sess->_sendBufferBackBytes, expect.size());
+
+  auto rsp = sess->getResponse();
+  EXPECT_EQ(rsp.size(), size_t(1));
+  EXPECT_EQ(rsp[0], expect);
+}
+
 class session : public std::enable_shared_from_this<session> {
  public:
   explicit session(asio::ip::tcp::socket socket) : _socket(std::move(socket)) {}
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <list>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -27,16 +28,20 @@ SessionCtx::SessionCtx(Session* sess)
     _processPacketStart(0),
     _lockRecord(),
     _rocksdbRecord(),
+    _scanExamined(0),
+    _scanReturned(0),
     _timestamp(TSEP_UNINITED),
     _version(VERSIONEP_UNINITED),
     _perfLevel(PerfLevel::kDisable),
     _perfLevelFlag(false),
     _txnVersion(-1),
+    _keyVersion(0),
     _extendProtocol(false),
     _replOnly(false),
     _session(sess),
     _isMonitor(false),
-    _flags(0) {
+    _flags(0),
+    _pipelineBatch(false) {
   _perfContext.Reset();
   _ioContext.Reset();
 }
@@ -120,13 +125,50 @@ void SessionCtx::clearRequestCtx() {
   }
   _perfLevelFlag = false;
   _replOnly = false;
+  _keyVersion = 0;
+}
+
+uint64_t SessionCtx::getKeyVersion() {
+  auto server = _session->getServerEntry();
+  if (!server || !server->getParams()->versionedKeys) {
+    return 0;
+  }
+  if (_keyVersion == 0) {
+    _keyVersion = rcd_util::newKeyVersion();
+  }
+  return _keyVersion;
+}
+
+void SessionCtx::setInlineMeta(const std::string& key,
+                               Expected<RecordValue>&& meta) {
+  _inlineKey = key;
+  _inlineMeta = std::make_unique<Expected<RecordValue>>(std::move(meta));
+}
+
+const Expected<RecordValue>* SessionCtx::getInlineMeta(
+  const std::string& key) const {
+  if (_inlineMeta == nullptr || _inlineKey != key) {
+    return nullptr;
+  }
+  return _inlineMeta.get();
+}
+
+void SessionCtx::resetInlineMeta() {
+  _inlineKey.clear();
+  _inlineMeta.reset();
 }
 
 Expected<Transaction*> SessionCtx::createTransaction(const PStore& kvstore) {
   std::lock_guard<std::mutex> lk(_mutex);
   Transaction* txn = nullptr;
+  auto kept = _keptTxnMap.find(kvstore->dbId());
   if (_txnMap.count(kvstore->dbId()) > 0) {
     txn = _txnMap[kvstore->dbId()].get();
+  } else if (kept != _keptTxnMap.end()) {
+    txn = kept->second.get();
+    txn->refreshSnapshot();
+    _txnMap[kvstore->dbId()] = std::move(kept->second);
+    _keptTxnMap.erase(kept);
   } else {
     auto ptxn = kvstore->createTransaction(_session);
     if (!ptxn.ok()) {
@@ -158,6 +200,30 @@ Expected<uint64_t> SessionCtx::commitTransaction(Transaction* txn) {
   return eCmt;
 }
 
+void SessionCtx::setPipelineBatch(bool v) {
+  _pipelineBatch = v;
+  if (!v) {
+    dropKeptTxns();
+  }
+}
+
+bool SessionCtx::isPipelineBatch() const {
+  return _pipelineBatch;
+}
+
+void SessionCtx::keepTxns() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  for (auto& txn : _txnMap) {
+    _keptTxnMap[txn.first] = std::move(txn.second);
+  }
+  _txnMap.clear();
+}
+
+void SessionCtx::dropKeptTxns() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _keptTxnMap.clear();
+}
+
 Status SessionCtx::commitAll(const std::string& cmd) {
   std::lock_guard<std::mutex> lk(_mutex);
 
@@ -356,8 +422,25 @@ std::string SessionCtx::generateRocksdbRecordLogIfNeeded(
   return RLTToString[type] + _rocksdbRecord[type].toString();
 }
 
+void SessionCtx::addScanRecord(uint64_t examined, uint64_t returned) {
+  _scanExamined += examined;
+  _scanReturned += returned;
+}
+
+std::string SessionCtx::generateScanRecordLogIfNeeded() const {
+  if (_scanExamined == 0) {
+    return "";
+  }
+  std::stringstream ss;
+  ss << "Scan_examined: " << _scanExamined
+     << " Scan_returned: " << _scanReturned;
+  return ss.str();
+}
+
 void SessionCtx::resetStatisticInfo() {
   _processPacketStart.store(0, std::memory_order_relaxed);
+  _scanExamined = 0;
+  _scanReturned = 0;
 
   for (auto& lr : _lockRecord) {
     lr.reset();
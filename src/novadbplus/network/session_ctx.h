@@ -80,6 +80,14 @@ class SessionCtx {
   Status rollbackAll();
   Expected<Transaction*> createTransaction(const PStore& kvstore);
   Expected<uint64_t> commitTransaction(Transaction*);
+  // In a pipeline batch (see NetSession::parseAndProcessReq()), the txns
+  // of a readonly command are kept by keepTxns() instead of being dropped
+  // by clearRequestCtx(), and createTransaction() hands them out again,
+  // with a fresh snapshot, to the next readonly command.
+  void setPipelineBatch(bool v);
+  bool isPipelineBatch() const;
+  void keepTxns();
+  void dropKeptTxns();
   void setExtendProtocol(bool v);
   void setExtendProtocolValue(uint64_t ts, uint64_t version);
   bool setPerfLevel(const std::string& level);
@@ -89,6 +97,16 @@ class SessionCtx {
   uint64_t getVersionEP() const {
     return _version;
   }
+  // the version of the hash/set/zset keys created by the running command,
+  // taken once by rcd_util::newKeyVersion() and reset by clearRequestCtx().
+  // It is 0(not versioned) unless versionedKeys is set.
+  uint64_t getKeyVersion();
+  // the meta of key probed by Command::canRunInline(), the inline command
+  // is served from it rather than reading key again on the io thread.
+  void setInlineMeta(const std::string& key, Expected<RecordValue>&& meta);
+  // the probed meta of key, or nullptr
+  const Expected<RecordValue>* getInlineMeta(const std::string& key) const;
+  void resetInlineMeta();
   PerfLevel getPerfLevel() const {
     return _perfLevel;
   }
@@ -152,6 +170,11 @@ class SessionCtx {
 
   std::string generateRocksdbRecordLogIfNeeded(RocksdbLatencyType);
 
+  // the records read and the keys replied by the scan commands
+  void addScanRecord(uint64_t examined, uint64_t returned);
+
+  std::string generateScanRecordLogIfNeeded() const;
+
   void resetStatisticInfo();
 
   static constexpr uint64_t VERSIONEP_UNINITED = -1;
@@ -171,12 +194,17 @@ class SessionCtx {
 
   std::array<LockLatencyRecord, LockLatencyType::MAX_LLT> _lockRecord;
   std::array<RocksdbLatencyRecord, RocksdbLatencyType::MAX_RLT> _rocksdbRecord;
+  uint64_t _scanExamined;
+  uint64_t _scanReturned;
 
   uint64_t _timestamp;
   uint64_t _version;
   PerfLevel _perfLevel;
   bool _perfLevelFlag;
   uint64_t _txnVersion;
+  uint64_t _keyVersion;
+  std::string _inlineKey;
+  std::unique_ptr<Expected<RecordValue>> _inlineMeta;
   bool _extendProtocol;
   bool _replOnly;
   Session* _session;
@@ -190,6 +218,8 @@ class SessionCtx {
   std::vector<ILock*> _locks;
   // multi key
   std::unordered_map<std::string, std::unique_ptr<Transaction>> _txnMap;
+  std::unordered_map<std::string, std::unique_ptr<Transaction>> _keptTxnMap;
+  bool _pipelineBatch;
   std::vector<std::string> _argsBrief;
   rocksdb::PerfContext _perfContext;
   rocksdb::IOStatsContext _ioContext;
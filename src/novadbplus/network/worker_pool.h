@@ -15,6 +15,7 @@
 
 #include "asio.hpp"
 
+#include "novadbplus/network/latency_record.h"
 #include "novadbplus/server/server_params.h"
 #include "novadbplus/utils/atomic_utility.h"
 #include "novadbplus/utils/invariant.h"
@@ -58,6 +59,9 @@ class WorkerPool {
     auto taskWrap = [this, mytask = std::move(task), enQueueTs]() mutable {
       int64_t outQueueTs = nsSinceEpoch();
       _matrix->queueTime += outQueueTs - enQueueTs;
+      if (!gParams || gParams->latencyTracking) {
+        poolQueueLatencyHistogram().record((outQueueTs - enQueueTs) / 1000);
+      }
       ++_matrix->executing;
       try {
         mytask();
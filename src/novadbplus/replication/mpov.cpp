@@ -2,6 +2,13 @@
 // Please refer to the license text that comes with this novadb open source
 // project for additional information.
 
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
 #include <chrono>
 #include <fstream>
 #include <list>
@@ -23,7 +30,8 @@ namespace novadbplus {
 bool ReplManager::supplyFullSync(asio::ip::tcp::socket sock,
                                  const std::string& storeIdArg,
                                  const std::string& slaveIpArg,
-                                 const std::string& slavePortArg) {
+                                 const std::string& slavePortArg,
+                                 const std::string& modeArg) {
   std::shared_ptr<BlockingTcpClient> client =
     std::move(_svr->getNetwork()->createBlockingClient(std::move(sock),
                                                        64 * 1024 * 1024));
@@ -58,15 +66,28 @@ bool ReplManager::supplyFullSync(asio::ip::tcp::socket sock,
     client->writeLine("-ERR invalid expSlavePort");
     return false;
   }
+
+  auto mode = toLower(modeArg);
+  if (!mode.empty() && mode != "streaming" && mode != "join") {
+    LOG(ERROR) << "ReplManager::supplyFullSync modeArg error:" << modeArg;
+    client->writeLine("-ERR invalid mode");
+    return false;
+  }
+  bool streaming = !mode.empty();
   LOG(INFO) << "ReplManager::supplyFullSync storeId:" << storeIdArg << " "
-            << slaveIpArg << ":" << slavePortArg;
+            << slaveIpArg << ":" << slavePortArg << " mode:" << modeArg;
   uint16_t slavePort = static_cast<uint16_t>(expSlavePort.value());
+  if (mode == "join") {
+    return joinFullSync(std::move(client), storeId, slaveIpArg, slavePort);
+  }
   _fullPusher->schedule([this,
                          storeId,
                          client(std::move(client)),
                          slaveIpArg,
-                         slavePort]() mutable {
-    supplyFullSyncRoutine(std::move(client), storeId, slaveIpArg, slavePort);
+                         slavePort,
+                         streaming]() mutable {
+    supplyFullSyncRoutine(
+      std::move(client), storeId, slaveIpArg, slavePort, streaming);
   });
 
   return true;
@@ -151,7 +172,10 @@ void ReplManager::masterPushRoutine(uint32_t storeId, uint64_t clientId) {
       nextSched = SCLOCK::now();
       lastSend = nextSched;
     } else {
-      nextSched = SCLOCK::now() + std::chrono::milliseconds(10);
+      // NOTE: the new binlogs wake it up before nextSched
+      uint32_t idleMs =
+        _pushNotifiers[storeId] ? gBinlogPushIdleMs : gBinlogPushPollMs;
+      nextSched = SCLOCK::now() + std::chrono::milliseconds(idleMs);
       if (needHeartbeat) {
         lastSend = SCLOCK::now();
       }
@@ -229,6 +253,7 @@ bool ReplManager::registerIncrSync(asio::ip::tcp::socket sock,
 
   uint64_t firstPos = 0;
   uint64_t lastFlushBinlogId = 0;
+  uint64_t fullSyncBinlogId = 0;
 
   {
     // NOTE(takenliu): registerIncrSync() need be mutual exclusive
@@ -246,6 +271,7 @@ bool ReplManager::registerIncrSync(asio::ip::tcp::socket sock,
     _logRecycStatus[storeId]->isRunning = true;
     firstPos = _logRecycStatus[storeId]->minValidBinlogID;
     lastFlushBinlogId = _logRecycStatus[storeId]->lastFlushBinlogId;
+    fullSyncBinlogId = _logRecycStatus[storeId]->fullSyncBinlogId;
   }
 
   auto guard = MakeGuard([this, storeId] {
@@ -263,6 +289,18 @@ bool ReplManager::registerIncrSync(asio::ip::tcp::socket sock,
     return false;
   }
 
+  // the slave misses the records written without binlog, the reply makes
+  // it fullsync, see beginWriteWithoutBinlog()
+  if (binlogPos < fullSyncBinlogId) {
+    std::stringstream ss;
+    ss << "-ERR fullsync required,storeId:" << storeId
+       << ",fullSyncBinlogId:" << fullSyncBinlogId
+       << ",slave binlogPos:" << binlogPos;
+    client->writeLine(ss.str());
+    LOG(WARNING) << ss.str();
+    return false;
+  }
+
   // NOTE(deyukong): this check is not precise
   // (not in the same critical area with the modification to _pushStatus),
   // but it does not harm correctness.
@@ -319,6 +357,14 @@ bool ReplManager::registerIncrSyncStatus(
     client->writeLine(ss.str());
     return false;
   }
+  // beginWriteWithoutBinlog() may be called after the check above
+  if (binlogPos < _logRecycStatus[storeId]->fullSyncBinlogId) {
+    LOG(WARNING) << "registerIncrSync store:" << storeId
+                 << " refused, slave binlogPos:" << binlogPos
+                 << " fullSyncBinlogId:"
+                 << _logRecycStatus[storeId]->fullSyncBinlogId;
+    return false;
+  }
 
   std::string slaveNode = listenIpArg + ":" + std::to_string(listen_port);
   auto iter = _fullPushStatus[storeId].find(slaveNode);
@@ -373,6 +419,80 @@ bool ReplManager::registerIncrSyncStatus(
   return true;
 }
 
+// NOTE: it's refused while the store has slaves, they would miss the
+// records, and the writer falls back to the writes with binlog. A slave
+// detached meanwhile has not applied the binlog written after the writes,
+// so it's asked to fullsync when it comes back.
+Status ReplManager::beginWriteWithoutBinlog(uint32_t storeId) {
+  std::lock_guard<std::mutex> wlk(_writeWithoutBinlogMutex);
+  uint64_t oldBarrier = 0;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto& recycStatus = _logRecycStatus[storeId];
+    if (!_pushStatus[storeId].empty() || !_fullPushStatus[storeId].empty()) {
+      return {ErrorCodes::ERR_BUSY, "store has slaves"};
+    }
+    if (recycStatus->writesWithoutBinlog++ > 0) {
+      return {ErrorCodes::ERR_OK, ""};
+    }
+    // no incrsync or fullsync is accepted from now on
+    oldBarrier = recycStatus->fullSyncBinlogId;
+    recycStatus->fullSyncBinlogId = UINT64_MAX;
+  }
+  // in case the server restarts before endWriteWithoutBinlog()
+  Status s = saveFullSyncBinlogId(storeId, UINT64_MAX);
+  if (!s.ok()) {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _logRecycStatus[storeId]->writesWithoutBinlog--;
+    _logRecycStatus[storeId]->fullSyncBinlogId = oldBarrier;
+  }
+  return s;
+}
+
+Status ReplManager::endWriteWithoutBinlog(uint32_t storeId) {
+  std::lock_guard<std::mutex> wlk(_writeWithoutBinlogMutex);
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    INVARIANT_D(_logRecycStatus[storeId]->writesWithoutBinlog > 0);
+    if (--_logRecycStatus[storeId]->writesWithoutBinlog > 0) {
+      return {ErrorCodes::ERR_OK, ""};
+    }
+  }
+  return writeFullSyncBarrier(storeId);
+}
+
+Status ReplManager::writeFullSyncBarrier(uint32_t storeId) {
+  LocalSessionGuard sg(_svr.get());
+  auto expdb = _svr->getSegmentMgr()->getDb(
+    sg.getSession(), storeId, mgl::LockMode::LOCK_NONE);
+  RET_IF_ERR_EXPECTED(expdb);
+  auto ptxn = expdb.value().store->createTransaction(nullptr);
+  RET_IF_ERR_EXPECTED(ptxn);
+  // there is no ttl index of ttl 0, deleting it writes nothing but binlog
+  TTLIndex marker("", RecordType::RT_DATA_META, 0, 0);
+  Status s = ptxn.value()->delKV(marker.encode());
+  RET_IF_ERR(s);
+  auto expCommit = ptxn.value()->commit();
+  RET_IF_ERR_EXPECTED(expCommit);
+  uint64_t binlogId = ptxn.value()->getBinlogId();
+
+  s = saveFullSyncBinlogId(storeId, binlogId);
+  RET_IF_ERR(s);
+  std::lock_guard<std::mutex> lk(_mutex);
+  _logRecycStatus[storeId]->fullSyncBinlogId = binlogId;
+  LOG(INFO) << "store:" << storeId << " slaves behind binlog:" << binlogId
+            << " have to fullsync";
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ReplManager::saveFullSyncBinlogId(uint32_t storeId, uint64_t binlogId) {
+  auto catalog = _svr->getCatalog();
+  auto meta = catalog->getStoreMainMeta(storeId);
+  RET_IF_ERR_EXPECTED(meta);
+  meta.value()->fullSyncBinlogId = binlogId;
+  return catalog->setStoreMainMeta(*meta.value());
+}
+
 // mpov's network communicate procedure
 // send binlogpos low watermark
 // send filelist={filename->filesize}
@@ -381,11 +501,135 @@ bool ReplManager::registerIncrSyncStatus(
 //     send content
 //     read +OK
 // read +OK
+// streaming mode sends the files by the fullsync connection and the ones
+// joined it, each connection repeats
+//     send filename
+//     send the whole content
+//     read +OK
+// until no file is left and sends +DONE. The file goes from the page cache
+// to the socket by sendfile, the slave verifies it by the block checksums.
+Status ReplManager::sendFileStreaming(BlockingTcpClient* client,
+                                      const std::string& dir,
+                                      const std::string& name,
+                                      size_t size) {
+  std::string fname = dir + "/" + name;
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "open file:" + fname + " failed:" + strerror(errno)};
+  }
+  auto guard = MakeGuard([fd]() { ::close(fd); });
+
+  auto s = client->writeLine(name);
+  RET_IF_ERR(s);
+
+  size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
+  uint32_t secs = _cfg->timeoutSecBinlogWaitRsp;
+  uint64_t offset = 0;
+  while (offset < size) {
+    size_t batchSize = std::min(size - offset, fileBatch);
+    _rateLimiter->SetBytesPerSecond((uint64_t)_cfg->binlogRateLimitMB * 1024 *
+                                    1024);
+    _rateLimiter->Request(batchSize);
+    s = client->sendFile(fd, offset, batchSize, std::chrono::seconds(secs));
+    RET_IF_ERR(s);
+    offset += batchSize;
+  }
+
+  auto rpl = client->readLine(std::chrono::seconds(secs));
+  if (!rpl.ok()) {
+    return rpl.status();
+  }
+  if (rpl.value() != "+OK") {
+    return {ErrorCodes::ERR_INTERNAL, "slave reply:" + rpl.value()};
+  }
+  LOG(INFO) << "fulsync send file success:" << fname;
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ReplManager::sendFullSyncFiles(BlockingTcpClient* client,
+                                      std::shared_ptr<FullSyncFiles> files) {
+  while (true) {
+    std::pair<std::string, uint64_t> file;
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      if (files->failed || files->files.empty()) {
+        break;
+      }
+      file = std::move(files->files.front());
+      files->files.pop_front();
+      files->sending++;
+    }
+    auto s = sendFileStreaming(client, files->dir, file.first, file.second);
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      files->sending--;
+      files->failed = files->failed || !s.ok();
+      _cv.notify_all();
+    }
+    if (!s.ok()) {
+      LOG(ERROR) << "fullsync send file:" << file.first
+                 << " to client:" << client->getRemoteRepr()
+                 << " failed:" << s.toString();
+      return s;
+    }
+  }
+  return client->writeLine("+DONE");
+}
+
+bool ReplManager::joinFullSync(std::shared_ptr<BlockingTcpClient> client,
+                               uint32_t storeId,
+                               const std::string& slave_listen_ip,
+                               uint16_t slave_listen_port) {
+  std::shared_ptr<FullSyncFiles> files;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::string slaveNode =
+      slave_listen_ip + ":" + std::to_string(slave_listen_port);
+    if (storeId < _fullPushStatus.size()) {
+      auto iter = _fullPushStatus[storeId].find(slaveNode);
+      if (iter != _fullPushStatus[storeId].end() &&
+          iter->second->state == FullPushState::PUSHING) {
+        files = iter->second->files;
+      }
+    }
+  }
+  if (!files) {
+    client->writeLine("-ERR no streaming fullsync to join");
+    return false;
+  }
+  // NOTE: a join queued behind other fullsyncs might start after the slave
+  // gave up waiting, and fail the whole fullsync on the dead connection.
+  // So it's refused if no pusher is free, and the slave acks the +OK
+  // before any file is taken from the queue.
+  if (_fullPusher->isFull()) {
+    client->writeLine("-ERR no free fullsync pusher");
+    return false;
+  }
+  // NOTE: the fullsync keeps the checkpoint until no connection is sending
+  // a file of it, and the ones joined after that send +DONE only
+  _fullPusher->schedule([this, client(std::move(client)), files]() {
+    if (!client->writeLine("+OK").ok()) {
+      return;
+    }
+    auto ack = client->readLine(std::chrono::seconds(10));
+    if (!ack.ok() || ack.value() != "+OK") {
+      LOG(WARNING) << "fullsync joined connection:"
+                   << client->getRemoteRepr() << " is gone:"
+                   << (ack.ok() ? ack.value() : ack.status().toString());
+      return;
+    }
+    sendFullSyncFiles(client.get(), files);
+  });
+  return true;
+}
+
 void ReplManager::supplyFullSyncRoutine(
   std::shared_ptr<BlockingTcpClient> client,
   uint32_t storeId,
   const std::string& slave_listen_ip,
-  uint16_t slave_listen_port) {
+  uint16_t slave_listen_port,
+  bool streaming) {
   LocalSessionGuard sg(_svr.get());
   sg.getSession()->setArgs(
     {"masterfullsync", client->getRemoteRepr(), std::to_string(storeId)});
@@ -414,6 +658,14 @@ void ReplManager::supplyFullSyncRoutine(
     uint64_t highestBinlogid = store->getHighestBinlogId();
     std::string slaveNode =
       slave_listen_ip + ":" + std::to_string(slave_listen_port);
+    // the checkpoint would miss the records written without binlog
+    if (_logRecycStatus[storeId]->writesWithoutBinlog > 0) {
+      client->writeLine("-ERR store is being written without binlog");
+      LOG(WARNING) << "supplyFullSyncRoutine store:" << storeId
+                   << " is being written without binlog, slave node:"
+                   << slaveNode;
+      return;
+    }
     auto iter = _fullPushStatus[storeId].find(slaveNode);
     if (iter != _fullPushStatus[storeId].end()) {
       LOG(INFO) << "supplyFullSyncRoutine already have _fullPushStatus, "
@@ -530,54 +782,74 @@ void ReplManager::supplyFullSyncRoutine(
   LOG(INFO) << "fullsync " << storeId
             << " send fileList success:" << sb.GetString();
 
-  std::string readBuf;
-  size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
-  readBuf.reserve(fileBatch);
-  for (auto& fileInfo : bkInfo.value().getFileList()) {
-    s = client->writeLine(fileInfo.first);
-    if (!s.ok()) {
-      LOG(ERROR) << "write fname:" << fileInfo.first
-                 << " to client failed:" << s.toString();
-      return;
+  if (streaming) {
+    auto files = std::make_shared<FullSyncFiles>();
+    files->dir = store->dftBackupDir();
+    for (auto& fileInfo : bkInfo.value().getFileList()) {
+      files->files.emplace_back(fileInfo);
     }
-    LOG(INFO) << "fulsync send filename success:" << fileInfo.first;
-    std::string fname = store->dftBackupDir() + "/" + fileInfo.first;
-    auto myfile = std::ifstream(fname, std::ios::binary);
-    if (!myfile.is_open()) {
-      LOG(ERROR) << "open file:" << fname << " for read failed";
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      std::string slaveNode =
+        slave_listen_ip + ":" + std::to_string(slave_listen_port);
+      _fullPushStatus[storeId][slaveNode]->files = files;
+    }
+    s = sendFullSyncFiles(client.get(), files);
+    std::unique_lock<std::mutex> lk(_mutex);
+    _cv.wait(lk, [&files] { return files->sending == 0; });
+    if (!s.ok() || files->failed) {
       return;
     }
-    size_t remain = fileInfo.second;
-    while (remain) {
-      size_t batchSize = std::min(remain, fileBatch);
-      _rateLimiter->SetBytesPerSecond((uint64_t)_cfg->binlogRateLimitMB * 1024 *
-                                      1024);
-      _rateLimiter->Request(batchSize);
-      readBuf.resize(batchSize);
-      remain -= batchSize;
-      myfile.read(&readBuf[0], batchSize);
-      if (!myfile) {
-        LOG(ERROR) << "read file:" << fname
-                   << " failed with err:" << strerror(errno);
-        return;
-      }
-      s = client->writeData(readBuf);
+  } else {
+    std::string readBuf;
+    size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
+    readBuf.reserve(fileBatch);
+    for (auto& fileInfo : bkInfo.value().getFileList()) {
+      s = client->writeLine(fileInfo.first);
       if (!s.ok()) {
-        LOG(ERROR) << "write bulk to client failed:" << s.toString();
+        LOG(ERROR) << "write fname:" << fileInfo.first
+                   << " to client failed:" << s.toString();
         return;
       }
-      secs = _cfg->timeoutSecBinlogWaitRsp;
-      auto rpl = client->readLine(std::chrono::seconds(secs));
-      if (!rpl.ok() || rpl.value() != "+OK") {
-        LOG(ERROR) << "send client:" << client->getRemoteRepr()
-                   << "file:" << fileInfo.first << ",size:" << fileInfo.second
-                   << " failed:"
-                   << (rpl.ok() ? rpl.value()
-                                : rpl.status().toString());  // NOLINT
+      LOG(INFO) << "fulsync send filename success:" << fileInfo.first;
+      std::string fname = store->dftBackupDir() + "/" + fileInfo.first;
+      auto myfile = std::ifstream(fname, std::ios::binary);
+      if (!myfile.is_open()) {
+        LOG(ERROR) << "open file:" << fname << " for read failed";
         return;
       }
+      size_t remain = fileInfo.second;
+      while (remain) {
+        size_t batchSize = std::min(remain, fileBatch);
+        _rateLimiter->SetBytesPerSecond((uint64_t)_cfg->binlogRateLimitMB *
+                                        1024 * 1024);
+        _rateLimiter->Request(batchSize);
+        readBuf.resize(batchSize);
+        remain -= batchSize;
+        myfile.read(&readBuf[0], batchSize);
+        if (!myfile) {
+          LOG(ERROR) << "read file:" << fname
+                     << " failed with err:" << strerror(errno);
+          return;
+        }
+        s = client->writeData(readBuf);
+        if (!s.ok()) {
+          LOG(ERROR) << "write bulk to client failed:" << s.toString();
+          return;
+        }
+        secs = _cfg->timeoutSecBinlogWaitRsp;
+        auto rpl = client->readLine(std::chrono::seconds(secs));
+        if (!rpl.ok() || rpl.value() != "+OK") {
+          LOG(ERROR) << "send client:" << client->getRemoteRepr()
+                     << "file:" << fileInfo.first << ",size:" << fileInfo.second
+                     << " failed:"
+                     << (rpl.ok() ? rpl.value()
+                                  : rpl.status().toString());  // NOLINT
+          return;
+        }
+      }
+      LOG(INFO) << "fulsync send file success:" << fname;
     }
-    LOG(INFO) << "fulsync send file success:" << fname;
   }
   secs = _cfg->timeoutSecBinlogWaitRsp;
   Expected<std::string> reply = client->readLine(std::chrono::seconds(secs));
@@ -853,6 +1125,8 @@ void ReplManager::supplyFullPsyncRoutine(
   uint32_t prevChunkId = CLUSTER_SLOTS;
   uint64_t kvCount = 0;
   std::string sendBuf;
+  std::string versionMetaKey;
+  Expected<RecordValue> versionMeta{ErrorCodes::ERR_NOTFOUND, ""};
   while (true) {
     Expected<Record> exptRcd = cursor->next();
     if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST ||
@@ -897,7 +1171,11 @@ void ReplManager::supplyFullPsyncRoutine(
     auto chunkId = exptRcd.value().getRecordKey().getChunkId();
     auto dbid = exptRcd.value().getRecordKey().getDbId();
     auto valueType = exptRcd.value().getRecordValue().getRecordType();
-    if (!isRealEleType(keyType, valueType)) {
+    // NOTE: a compact hash has no element records, its meta record
+    // carries the fields and is pushed as a whole.
+    if (!isRealEleType(keyType, valueType) &&
+        !(keyType == RecordType::RT_DATA_META &&
+          isCompactHashMeta(exptRcd.value().getRecordValue()))) {
       continue;
     }
 
@@ -907,6 +1185,22 @@ void ReplManager::supplyFullPsyncRoutine(
       continue;
     }
 
+    // NOTE: the subkeys of a deleted or recreated hash/set/zset are left to
+    // the compaction filter, skip them by the version of their meta.
+    if (isVersionedEleType(keyType)) {
+      const RecordKey& rk = exptRcd.value().getRecordKey();
+      RecordKey mk(
+        chunkId, dbid, RecordType::RT_DATA_META, rk.getPrimaryKey(), "");
+      std::string metaKey = mk.encode();
+      if (metaKey != versionMetaKey) {
+        versionMetaKey = std::move(metaKey);
+        versionMeta = store->getKV(mk, txn.get());
+      }
+      if (rcd_util::isStaleSubKey(rk, versionMeta)) {
+        continue;
+      }
+    }
+
     kvCount++;
     if (chunkId != prevChunkId) {
       LOG(INFO) << "full psync. begin chunkId: " << chunkId
@@ -82,6 +82,7 @@ ReplManager::ReplManager(std::shared_ptr<ServerEntry> svr,
     _svr(svr),
     _rateLimiter(
       std::make_unique<RateLimiter>(cfg->binlogRateLimitMB * 1024 * 1024)),
+    _pushWakeup(std::make_shared<ReplWakeup>()),
     _incrPaused(false),
     _clientIdGen(0),
     _dumpPath(cfg->dumpPath),
@@ -90,6 +91,7 @@ ReplManager::ReplManager(std::shared_ptr<ServerEntry> svr,
     _fullReceiveMatrix(std::make_shared<PoolMatrix>()),
     _incrCheckMatrix(std::make_shared<PoolMatrix>()),
     _logRecycleMatrix(std::make_shared<PoolMatrix>()),
+    _binlogApplyMatrix(std::make_shared<PoolMatrix>()),
     _connectMasterTimeoutMs(1000) {
   _cfg->serverParamsVar("incrPushThreadnum")->setUpdate([this]() {
     incrPusherResize(_cfg->incrPushThreadnum);
@@ -184,6 +186,15 @@ Status ReplManager::startup() {
   if (!s.ok()) {
     return s;
   }
+
+  if (_cfg->binlogApplyThreadnum > 0) {
+    _binlogApplier =
+      std::make_unique<WorkerPool>("tx-repl-apply", _binlogApplyMatrix);
+    s = _binlogApplier->startup(_cfg->binlogApplyThreadnum);
+    if (!s.ok()) {
+      return s;
+    }
+  }
   // init _syncStatus/_logRecycStatus run ASAP
   SCLOCK::time_point tp = SCLOCK::time_point::min();
 
@@ -228,6 +239,15 @@ Status ReplManager::startup() {
       std::map<std::string, std::unique_ptr<MPovFullPushStatus>>());
 #endif
 
+    auto notifier = std::make_shared<BinlogPushNotifier>(_pushWakeup);
+    Status obStatus = store->setLogObserver(notifier);
+    if (!obStatus.ok()) {
+      LOG(WARNING) << "store:" << i << " setLogObserver failed:"
+                   << obStatus.toString() << ", binlog push falls back to poll";
+      notifier = nullptr;
+    }
+    _pushNotifiers.emplace_back(std::move(notifier));
+
     Status status;
 
     if (isOpen) {
@@ -263,9 +283,17 @@ Status ReplManager::startup() {
                               0,
                               nullptr,
                               false,
-                              Transaction::TXNID_UNINITED});
+                              Transaction::TXNID_UNINITED,
+                              0,
+                              0});
 
     if (isOpen) {
+      auto mainMeta = _svr->getCatalog()->getStoreMainMeta(i);
+      if (!mainMeta.ok()) {
+        return mainMeta.status();
+      }
+      recBinlogStat->fullSyncBinlogId = mainMeta.value()->fullSyncBinlogId;
+
       auto ptxn = store->createTransaction(nullptr);
       if (!ptxn.ok()) {
         return ptxn.status();
@@ -314,7 +342,17 @@ Status ReplManager::startup() {
     LOG(INFO) << "store:" << i << ",minValidBinlogID:"
               << _logRecycStatus.back()->minValidBinlogID
               << ",timestamp:" << _logRecycStatus.back()->timestamp
-              << ",dumpBinlogID:" << _logRecycStatus.back()->dumpBinlogID;
+              << ",dumpBinlogID:" << _logRecycStatus.back()->dumpBinlogID
+              << ",fullSyncBinlogId:"
+              << _logRecycStatus.back()->fullSyncBinlogId;
+    // the server stopped before endWriteWithoutBinlog()
+    if (_logRecycStatus.back()->fullSyncBinlogId == UINT64_MAX &&
+        _syncMeta[i]->syncFromHost == "") {
+      s = writeFullSyncBarrier(i);
+      if (!s.ok()) {
+        return s;
+      }
+    }
   }
 
   INVARIANT(_logRecycStatus.size() == _svr->getKVStoreCount());
@@ -421,6 +459,15 @@ Status ReplManager::resetRecycleState(uint32_t storeId) {
   }
   auto store = std::move(expdb.value().store);
   INVARIANT(store != nullptr);
+  // the data of the store is replaced by a fullsync or a backup
+  Status s = saveFullSyncBinlogId(storeId, 0);
+  if (!s.ok()) {
+    return s;
+  }
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _logRecycStatus[storeId]->fullSyncBinlogId = 0;
+  }
   auto exptxn = store->createTransaction(nullptr);
   if (!exptxn.ok()) {
     return exptxn.status();
@@ -537,13 +584,23 @@ void ReplManager::controlRoutine() {
 
     bool doSth = false;
     for (size_t i = 0; i < _pushStatus.size(); i++) {
+      uint64_t commitSeq =
+        _pushNotifiers[i] ? _pushNotifiers[i]->getCommitSeq() : 0;
       for (auto& mpov : _pushStatus[i]) {
-        if (mpov.second->isRunning || now < mpov.second->nextSchedTime) {
+        if (mpov.second->isRunning) {
+          continue;
+        }
+        // new binlogs wake it up before nextSchedTime, unless the store
+        // is stopped
+        bool woken = commitSeq != mpov.second->commitSeq &&
+          mpov.second->nextSchedTime != SCLOCK::time_point::max();
+        if (!woken && now < mpov.second->nextSchedTime) {
           continue;
         }
 
         doSth = true;
         mpov.second->isRunning = true;
+        mpov.second->commitSeq = commitSeq;
         uint64_t clientId = mpov.first;
         _incrPusher->schedule(
           [this, i, clientId]() { masterPushRoutine(i, clientId); });
@@ -568,6 +625,7 @@ void ReplManager::controlRoutine() {
 
   while (_isRunning.load(std::memory_order_relaxed)) {
     bool doSth = false;
+    uint64_t wakeups = _pushWakeup->getCount();
     auto now = SCLOCK::now();
     {
       std::lock_guard<std::mutex> lk(_mutex);
@@ -579,12 +637,29 @@ void ReplManager::controlRoutine() {
     if (doSth) {
       std::this_thread::yield();
     } else {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      _pushWakeup->waitFor(wakeups, std::chrono::milliseconds(1));
     }
   }
   LOG(INFO) << "repl controller exits";
 }
 
+void ReplWakeup::notify() {
+  _count.fetch_add(1);
+  // NOTE: _count and _sleeping are seq_cst, either the sleeper sees the
+  // new _count, or we see it sleeping
+  if (_sleeping.load()) {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _cv.notify_one();
+  }
+}
+
+void ReplWakeup::waitFor(uint64_t count, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lk(_mutex);
+  _sleeping.store(true);
+  _cv.wait_for(lk, timeout, [this, count] { return _count.load() != count; });
+  _sleeping.store(false);
+}
+
 void ReplManager::recycleFullPushStatus() {
   auto now = SCLOCK::now();
   for (size_t i = 0; i < _fullPushStatus.size(); i++) {
@@ -1840,6 +1915,9 @@ void ReplManager::stop() {
   _fullReceiver->stop();
   _incrChecker->stop();
   _logRecycler->stop();
+  if (_binlogApplier) {
+    _binlogApplier->stop();
+  }
 
   std::unique_lock<std::mutex> lk(_mutex);
 #if defined(_WIN32) && _MSC_VER > 1900
@@ -5,11 +5,14 @@
 #ifndef SRC_novadbPLUS_REPLICATION_REPL_MANAGER_H_
 #define SRC_novadbPLUS_REPLICATION_REPL_MANAGER_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -31,6 +34,10 @@ using SCLOCK = std::chrono::steady_clock;
 
 const uint32_t gBinlogHeartbeatSecs = 1;
 const uint32_t gBinlogHeartbeatTimeout = 10;
+// the incremental push of an idle store is woken up by the new binlogs,
+// it only polls in case there is no BinlogPushNotifier on the store
+const uint32_t gBinlogPushIdleMs = 100;
+const uint32_t gBinlogPushPollMs = 10;
 
 // slave's pov, sync status
 struct SPovStatus {
@@ -61,6 +68,45 @@ struct MPovStatus {
   std::string slave_listen_ip;
   uint16_t slave_listen_port = 0;
   MPovClientType clientType = MPovClientType::repllogClient;
+  // BinlogPushNotifier::getCommitSeq() when it was scheduled last time
+  uint64_t commitSeq = 0;
+};
+
+// the controlRoutine sleeps on it when it has nothing to do
+class ReplWakeup {
+ public:
+  ReplWakeup() : _count(0), _sleeping(false) {}
+  uint64_t getCount() const {
+    return _count.load();
+  }
+  void notify();
+  // wait until notify() is called after count was taken, or timeout
+  void waitFor(uint64_t count, std::chrono::milliseconds timeout);
+
+ private:
+  std::atomic<uint64_t> _count;
+  std::atomic<bool> _sleeping;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
+// wakes up the incremental push of a store as soon as its highest visible
+// binlog moves forward, rather than waiting for the next poll
+class BinlogPushNotifier : public BinlogObserver {
+ public:
+  explicit BinlogPushNotifier(std::shared_ptr<ReplWakeup> wakeup)
+    : _wakeup(std::move(wakeup)), _commitSeq(0) {}
+  void onCommitted(uint64_t binlogId) final {
+    _commitSeq.fetch_add(1, std::memory_order_relaxed);
+    _wakeup->notify();
+  }
+  uint64_t getCommitSeq() const {
+    return _commitSeq.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::shared_ptr<ReplWakeup> _wakeup;
+  std::atomic<uint64_t> _commitSeq;
 };
 
 enum class FullPushState {
@@ -69,6 +115,17 @@ enum class FullPushState {
   ERR = 2,
 };
 
+// the checkpoint files of a streaming fullsync not sent yet, they are
+// sent by the fullsync connection and the connections joined it.
+// GUARDED_BY(ReplManager::_mutex)
+struct FullSyncFiles {
+  std::string dir;
+  std::list<std::pair<std::string, uint64_t>> files;
+  // the connections sending a file
+  uint32_t sending = 0;
+  bool failed = false;
+};
+
 struct MPovFullPushStatus {
  public:
   std::string toString();
@@ -84,6 +141,8 @@ struct MPovFullPushStatus {
   uint64_t clientId;
   std::string slave_listen_ip;
   uint16_t slave_listen_port;
+  // not nullptr when the fullsync is streaming
+  std::shared_ptr<FullSyncFiles> files;
 };
 
 struct RecycleBinlogStatus {
@@ -99,12 +158,17 @@ struct RecycleBinlogStatus {
   std::unique_ptr<std::ofstream> fs;
   bool needNewFile;
   uint64_t dumpBinlogID;
+  // the slaves that have not applied it have to fullsync
+  uint64_t fullSyncBinlogId;
+  // the running beginWriteWithoutBinlog() calls not ended yet
+  uint32_t writesWithoutBinlog;
   std::string toString() const {
     std::stringstream ss;
     ss << "minValidBinlogID:" << minValidBinlogID
        << ",dumpBinlogID:" << dumpBinlogID
        << ",lastFlushBinlogId:" << lastFlushBinlogId << ",fileSeq:" << fileSeq
-       << ",timestamp:" << timestamp;
+       << ",timestamp:" << timestamp
+       << ",fullSyncBinlogId:" << fullSyncBinlogId;
     return ss.str();
   }
 };
@@ -165,7 +229,8 @@ class ReplManager {
   bool supplyFullSync(asio::ip::tcp::socket sock,
                       const std::string& storeIdArg,
                       const std::string& slaveIpArg,
-                      const std::string& slavePortArg);
+                      const std::string& slavePortArg,
+                      const std::string& modeArg = {});
   bool registerIncrSync(asio::ip::tcp::socket sock,
                         const std::string& storeIdArg,
                         const std::string& dstStoreIdArg,
@@ -199,6 +264,14 @@ class ReplManager {
                         uint32_t storeId,
                         const std::string& logKey,
                         const std::string& logValue);
+  // apply a batch of binlogs by the apply lanes, the binlogs of the same
+  // chunk are applied in order
+  Status applyRepllogsV2(Session* sess,
+                         uint32_t storeId,
+                         const std::vector<ReplLogRawV2>& logs);
+  bool isParallelApply() const {
+    return _binlogApplier != nullptr;
+  }
   bool flushCurBinlogFs(uint32_t storeId);
   void appendJSONStat(rapidjson::PrettyWriter<rapidjson::StringBuffer>&) const;
   void getReplInfo(std::stringstream& ss) const;
@@ -212,6 +285,13 @@ class ReplManager {
   bool isSlaveOfSomeone();
   bool isSlaveFullSyncDone();
   Status resetRecycleState(uint32_t storeId);
+  // the records written without binlog, like the ingested sst files, can't
+  // reach the slaves. beginWriteWithoutBinlog() fails with ERR_BUSY if the
+  // store has slaves, and refuses incrsync and fullsync until the matching
+  // endWriteWithoutBinlog(). The last one writes a binlog and asks the
+  // slaves that have not applied it to fullsync.
+  Status beginWriteWithoutBinlog(uint32_t storeId);
+  Status endWriteWithoutBinlog(uint32_t storeId);
   Expected<uint64_t> getDumpBinlogID(uint32_t storeId, uint32_t fileSeq);
 
   void fullPusherResize(size_t size);
@@ -244,7 +324,18 @@ class ReplManager {
   void supplyFullSyncRoutine(std::shared_ptr<BlockingTcpClient> client,
                              uint32_t storeId,
                              const std::string& slave_listen_ip,
-                             uint16_t slave_listen_port);
+                             uint16_t slave_listen_port,
+                             bool streaming);
+  Status sendFileStreaming(BlockingTcpClient* client,
+                           const std::string& dir,
+                           const std::string& name,
+                           size_t size);
+  Status sendFullSyncFiles(BlockingTcpClient* client,
+                           std::shared_ptr<FullSyncFiles> files);
+  bool joinFullSync(std::shared_ptr<BlockingTcpClient> client,
+                    uint32_t storeId,
+                    const std::string& slave_listen_ip,
+                    uint16_t slave_listen_port);
 
   void supplyFullPsyncRoutine(std::shared_ptr<BlockingTcpClient> client,
                               uint32_t storeId,
@@ -264,12 +355,25 @@ class ReplManager {
                                                   uint64_t timeoutMs = 1000,
                                                   int64_t flags = 0);
   void slaveStartFullsync(const StoreMeta&);
+  // if streaming, the file comes in one piece without per-batch replies
   Status receiveFile(const std::string& fullFileName,
                      std::shared_ptr<BlockingTcpClient> client,
-                     size_t remain);
+                     size_t remain,
+                     bool streaming = false);
   Status receiveFileDirectio(const std::string& fullFileName,
                              std::shared_ptr<BlockingTcpClient> client,
-                             size_t remain);
+                             size_t remain,
+                             bool streaming = false);
+  Status receiveFullSyncFiles(std::shared_ptr<BlockingTcpClient> client,
+                              const std::string& dir,
+                              const std::map<std::string, uint64_t>& flist,
+                              std::mutex* mutex,
+                              std::set<std::string>* finishedFiles);
+  void joinMasterFullSync(const StoreMeta& metaSnapshot,
+                          const std::string& dir,
+                          const std::map<std::string, uint64_t>& flist,
+                          std::mutex* mutex,
+                          std::set<std::string>* finishedFiles);
   void slaveChkSyncStatus(const StoreMeta&);
   std::ofstream* getCurBinlogFs(uint32_t storeid);
   void recycDumpFile(uint32_t storeid);
@@ -295,12 +399,18 @@ class ReplManager {
   void getReplInfoSimple(std::stringstream& ss) const;
   void getReplInfoDetail(std::stringstream& ss) const;
   void recycleFullPushStatus();
+  // persist the fullSyncBinlogId of the store in the catalog
+  Status saveFullSyncBinlogId(uint32_t storeId, uint64_t binlogId);
+  Status writeFullSyncBarrier(uint32_t storeId);
 
  private:
   const std::shared_ptr<ServerParams> _cfg;
   // Variables below is protected by mutex_:
   // _syncMeta _syncStatus _logRecycStatus
   mutable std::mutex _mutex;
+  // serializes beginWriteWithoutBinlog() and endWriteWithoutBinlog(), so
+  // the fullSyncBinlogId is persisted in order
+  std::mutex _writeWithoutBinlogMutex;
   std::condition_variable _recyclCv;
   std::condition_variable _cv;
   std::atomic<bool> _isRunning;
@@ -339,6 +449,11 @@ class ReplManager {
   // master's pov fullsync rate limiter
   std::unique_ptr<RateLimiter> _rateLimiter;
 
+  // master's pov, wakes up the controlRoutine on new binlogs. the notifiers
+  // are shared with the stores, nullptr if the store has another observer
+  std::shared_ptr<ReplWakeup> _pushWakeup;
+  std::vector<std::shared_ptr<BinlogPushNotifier>> _pushNotifiers;
+
   // master's pov, workerpool of pushing incr backup
   std::unique_ptr<WorkerPool> _incrPusher;
 
@@ -354,6 +469,10 @@ class ReplManager {
   // master and slave's pov, log recycler
   std::unique_ptr<WorkerPool> _logRecycler;
 
+  // slave's pov, the apply lanes except the first one, which runs in the
+  // applybinlogsv2 session. nullptr if binlogApplyThreadnum == 0
+  std::unique_ptr<WorkerPool> _binlogApplier;
+
   std::atomic<uint64_t> _clientIdGen;
 
   const std::string _dumpPath;
@@ -365,6 +484,7 @@ class ReplManager {
   std::shared_ptr<PoolMatrix> _fullReceiveMatrix;
   std::shared_ptr<PoolMatrix> _incrCheckMatrix;
   std::shared_ptr<PoolMatrix> _logRecycleMatrix;
+  std::shared_ptr<PoolMatrix> _binlogApplyMatrix;
   std::atomic<uint64_t> _connectMasterTimeoutMs;
 };
 
@@ -80,18 +80,34 @@ Expected<BinlogResult> masterSendBinlogV2(
                             std::to_string(dstStoreId),
                             std::to_string(binlogPos)});
 
-  auto ptxn = store->createTransaction(sg.getSession());
-  if (!ptxn.ok()) {
-    return ptxn.status();
+  // NOTE: the recently committed binlogs are read from memory, the binlog
+  // cursor is only needed when the slave is behind the binlog ring.
+  auto expRecent =
+    store->getRecentBinlogs(binlogPos, suggestBatch, suggestBytes);
+  size_t recentIdx = 0;
+  std::unique_ptr<Transaction> txn;
+  std::unique_ptr<RepllogCursorV2> cursor;
+  if (!expRecent.ok()) {
+    auto ptxn = store->createTransaction(sg.getSession());
+    if (!ptxn.ok()) {
+      return ptxn.status();
+    }
+    txn = std::move(ptxn.value());
+    cursor = txn->createRepllogCursorV2(binlogPos + 1);
   }
-
-  std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-  std::unique_ptr<RepllogCursorV2> cursor =
-    txn->createRepllogCursorV2(binlogPos + 1);
+  auto nextLog = [&]() -> Expected<ReplLogRawV2> {
+    if (cursor) {
+      return cursor->next();
+    }
+    if (recentIdx == expRecent.value().size()) {
+      return {ErrorCodes::ERR_EXHAUST, ""};
+    }
+    return std::move(expRecent.value()[recentIdx++]);
+  };
 
   BinlogWriter writer(suggestBytes, suggestBatch);
   while (true) {
-    Expected<ReplLogRawV2> explog = cursor->next();
+    Expected<ReplLogRawV2> explog = nextLog();
     if (explog.ok()) {
       if (explog.value().getChunkId() == Transaction::CHUNKID_FLUSH) {
         // flush binlog should be alone
@@ -304,6 +320,35 @@ Expected<BinlogResult> masterSendAof(BlockingTcpClient* client,
   return br;
 }
 
+// apply the entries of a binlog, returns the timestamp of the last entry
+static Expected<uint64_t> applyEntriesV2(Transaction* txn,
+                                         const ReplLogValueV2& value) {
+  uint64_t timestamp = 0;
+  size_t offset = value.getHdrSize();
+  auto data = value.getData();
+  size_t dataSize = value.getDataSize();
+  while (offset < dataSize) {
+    size_t size = 0;
+    auto entry = ReplLogValueEntryV2::decode(
+      (const char*)data + offset, dataSize - offset, &size);
+    if (!entry.ok()) {
+      return entry.status();
+    }
+    offset += size;
+
+    timestamp = entry.value().getTimestamp();
+    auto s = txn->applyBinlog(entry.value());
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  if (offset != dataSize) {
+    return {ErrorCodes::ERR_INTERNAL, "bad binlog"};
+  }
+  return timestamp;
+}
+
 Expected<BinlogResult> applySingleTxnV2(Session* sess,
                                         uint32_t storeId,
                                         const std::string& logKey,
@@ -348,29 +393,11 @@ Expected<BinlogResult> applySingleTxnV2(Session* sess,
     return value.status();
   }
 
-  uint64_t timestamp = 0;
-  size_t offset = value.value().getHdrSize();
-  auto data = value.value().getData();
-  size_t dataSize = value.value().getDataSize();
-  while (offset < dataSize) {
-    size_t size = 0;
-    auto entry = ReplLogValueEntryV2::decode(
-      (const char*)data + offset, dataSize - offset, &size);
-    if (!entry.ok()) {
-      return entry.status();
-    }
-    offset += size;
-
-    timestamp = entry.value().getTimestamp();
-    auto s = txn->applyBinlog(entry.value());
-    if (!s.ok()) {
-      return s;
-    }
-  }
-
-  if (offset != dataSize) {
-    return {ErrorCodes::ERR_INTERNAL, "bad binlog"};
+  auto expTs = applyEntriesV2(txn.get(), value.value());
+  if (!expTs.ok()) {
+    return expTs.status();
   }
+  uint64_t timestamp = expTs.value();
 
   uint64_t binlogId = 0;
   if (mode == BinlogApplyMode::KEEP_BINLOG_ID) {
@@ -411,6 +438,90 @@ Expected<BinlogResult> applySingleTxnV2(Session* sess,
   return br;
 }
 
+bool isApplyBarrier(uint32_t chunkId) {
+  return chunkId == Transaction::CHUNKID_UNINITED ||
+    chunkId == Transaction::CHUNKID_MULTI ||
+    chunkId == Transaction::CHUNKID_FLUSH ||
+    chunkId == Transaction::CHUNKID_MIGRATE ||
+    chunkId == Transaction::CHUNKID_DEL_RANGE;
+}
+
+Expected<PreparedBinlogTxn> prepareSlaveTxnV2(
+  Session* sess,
+  const std::vector<Session*>& laneSessions,
+  PStore store,
+  const std::string& logKey,
+  const std::string& logValue) {
+  if (!sess->getCtx()->isReplOnly()) {
+    INVARIANT_D(0);
+    return {ErrorCodes::ERR_INTERNAL, "It is not a slave"};
+  }
+  auto key = ReplLogKeyV2::decode(logKey);
+  if (!key.ok()) {
+    LOG(ERROR) << "ReplLogKeyV2::decode failed:" << key.status().toString();
+    return key.status();
+  }
+  auto value = ReplLogValueV2::decode(logValue);
+  if (!value.ok()) {
+    return value.status();
+  }
+
+  uint64_t binlogId = key.value().getBinlogId();
+  if (binlogId <= store->getHighestBinlogId()) {
+    std::string err = "binlogId:" + std::to_string(binlogId) +
+      " can't be smaller than highestBinlogId:" +
+      std::to_string(store->getHighestBinlogId());
+    LOG(ERROR) << err << " storeid:" << store->dbId();
+    return {ErrorCodes::ERR_MANUAL, err};
+  }
+
+  uint32_t chunkId = value.value().getChunkId();
+  Session* txnSess = sess;
+  if (!isApplyBarrier(chunkId) && !laneSessions.empty()) {
+    txnSess = laneSessions[chunkId % laneSessions.size()];
+  }
+  auto ptxn = store->createTransaction(txnSess);
+  if (!ptxn.ok()) {
+    LOG(ERROR) << "createTransaction failed:" << ptxn.status().toString();
+    return ptxn.status();
+  }
+
+  PreparedBinlogTxn prepared;
+  prepared.txn = std::move(ptxn.value());
+  // NOTE: reserve the binlogId now, so _highestVisible doesn't move beyond
+  // it when the binlogs after it commit first
+  store->setNextBinlogSeq(binlogId, prepared.txn.get());
+  prepared.logKey = logKey;
+  prepared.logValue = logValue;
+  prepared.binlogId = binlogId;
+  prepared.binlogTs = value.value().getTimestamp();
+  prepared.chunkId = chunkId;
+  return std::move(prepared);
+}
+
+Status applyPreparedTxnV2(PreparedBinlogTxn* prepared) {
+  auto value = ReplLogValueV2::decode(prepared->logValue);
+  if (!value.ok()) {
+    return value.status();
+  }
+  auto txn = prepared->txn.get();
+  auto expTs = applyEntriesV2(txn, value.value());
+  if (!expTs.ok()) {
+    return expTs.status();
+  }
+  auto s = txn->setBinlogKV(
+    prepared->binlogId, prepared->logKey, prepared->logValue);
+  if (!s.ok()) {
+    return s;
+  }
+  Expected<uint64_t> expCmit = txn->commit();
+  if (!expCmit.ok()) {
+    return expCmit.status();
+  }
+  prepared->binlogTs = expTs.value();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Status sendWriter(BinlogWriter* writer,
                   BlockingTcpClient* client,
                   uint32_t dstStoreId,
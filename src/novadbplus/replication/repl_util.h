@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "novadbplus/cluster/cluster_manager.h"
 #include "novadbplus/network/blocking_tcp_client.h"
@@ -66,6 +67,33 @@ Expected<BinlogResult> applySingleTxnV2(Session* sess,
                                         const std::string& logValue,
                                         BinlogApplyMode mode);
 
+// a binlog of a slave store, whose binlogId is reserved by
+// prepareSlaveTxnV2() in the binlog order, so that it can be applied and
+// committed out of order by applyPreparedTxnV2(). see
+// ReplManager::applyRepllogsV2()
+struct PreparedBinlogTxn {
+  std::unique_ptr<Transaction> txn;
+  std::string logKey;
+  std::string logValue;
+  uint64_t binlogId = 0;
+  uint64_t binlogTs = 0;
+  uint32_t chunkId = 0;
+};
+
+// the binlogs which may touch more than one chunk, they are applied after
+// all the binlogs before them
+bool isApplyBarrier(uint32_t chunkId);
+// the caller holds the store lock until the txn is applied or destroyed.
+// the txn is created in laneSessions[chunkId % laneSessions.size()], which
+// is only used by the thread applying that lane, the barriers use sess
+Expected<PreparedBinlogTxn> prepareSlaveTxnV2(
+  Session* sess,
+  const std::vector<Session*>& laneSessions,
+  PStore store,
+  const std::string& logKey,
+  const std::string& logValue);
+Status applyPreparedTxnV2(PreparedBinlogTxn* prepared);
+
 Status sendWriter(BinlogWriter* writer,
                   BlockingTcpClient*,
                   uint32_t dstStoreId,
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <limits>
 #include <list>
 #include <map>
@@ -13,11 +14,13 @@
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "rapidjson/document.h"
 #include "rapidjson/error/en.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
+#include "rocksdb/convenience.h"
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/lock/lock.h"
@@ -35,9 +38,13 @@ namespace novadbplus {
 Expected<BackupInfo> getBackupInfo(BlockingTcpClient* client,
                                    const StoreMeta& metaSnapshot,
                                    const std::string& ip,
-                                   uint16_t port) {
+                                   uint16_t port,
+                                   bool streaming) {
   std::stringstream ss;
   ss << "FULLSYNC " << metaSnapshot.syncFromId << " " << ip << " " << port;
+  if (streaming) {
+    ss << " streaming";
+  }
   Status s = client->writeLine(ss.str());
   if (!s.ok()) {
     LOG(WARNING) << "fullSync master failed:" << s.toString();
@@ -91,7 +98,8 @@ Expected<BackupInfo> getBackupInfo(BlockingTcpClient* client,
 
 Status ReplManager::receiveFile(const std::string& fullFileName,
                                 std::shared_ptr<BlockingTcpClient> client,
-                                size_t remain) {
+                                size_t remain,
+                                bool streaming) {
   auto myfile = std::fstream(fullFileName, std::ios::out | std::ios::binary);
   if (!myfile.is_open()) {
     LOG(ERROR) << "open file:" << fullFileName << " for write failed";
@@ -116,6 +124,9 @@ Status ReplManager::receiveFile(const std::string& fullFileName,
       return {ErrorCodes::ERR_INTERNAL, "write file failed"};
       ;
     }
+    if (streaming) {
+      continue;
+    }
     Status s = client->writeLine("+OK");
     if (!s.ok()) {
       LOG(ERROR) << "write file:" << fullFileName
@@ -130,7 +141,8 @@ Status ReplManager::receiveFile(const std::string& fullFileName,
 Status ReplManager::receiveFileDirectio(
   const std::string& fullFileName,
   std::shared_ptr<BlockingTcpClient> client,
-  size_t remain) {
+  size_t remain,
+  bool streaming) {
   filesystem::path dirName = filesystem::path(fullFileName).parent_path();
   auto alignedBuf = newAlignedBuff(dirName.generic_string(), 16);
   if (!alignedBuf) {
@@ -183,6 +195,9 @@ Status ReplManager::receiveFileDirectio(
       writable_file->Close();
     }
 
+    if (streaming) {
+      continue;
+    }
     s = client->writeLine("+OK");
     if (!s.ok()) {
       LOG(ERROR) << "write file:" << fullFileName
@@ -194,6 +209,105 @@ Status ReplManager::receiveFileDirectio(
   return {ErrorCodes::ERR_OK, ""};
 }
 
+Status ReplManager::receiveFullSyncFiles(
+  std::shared_ptr<BlockingTcpClient> client,
+  const std::string& dir,
+  const std::map<std::string, uint64_t>& flist,
+  std::mutex* mutex,
+  std::set<std::string>* finishedFiles) {
+  while (true) {
+    Expected<std::string> s = client->readLine(std::chrono::seconds(10));
+    if (!s.ok()) {
+      return s.status();
+    }
+    if (s.value() == "+DONE") {
+      return {ErrorCodes::ERR_OK, ""};
+    }
+    if (flist.find(s.value()) == flist.end()) {
+      LOG(ERROR) << "fullsync invalid file:" << s.value();
+      return {ErrorCodes::ERR_INTERNAL, "invalid file:" + s.value()};
+    }
+    {
+      std::lock_guard<std::mutex> lk(*mutex);
+      if (finishedFiles->count(s.value())) {
+        LOG(FATAL) << "BUG: fullsync " << s.value() << " retransfer";
+      }
+    }
+    std::string fullFileName = dir + "/" + s.value();
+    LOG(INFO) << "fullsync file:" << fullFileName << " transfer begin";
+
+    filesystem::path fileDir = filesystem::path(fullFileName).parent_path();
+    std::error_code ec;
+    filesystem::create_directories(fileDir, ec);
+    if (ec) {
+      return {ErrorCodes::ERR_INTERNAL, ec.message()};
+    }
+    size_t fLength = flist.at(s.value());
+    Status ret;
+    if (_cfg->directIo) {
+      ret = receiveFileDirectio(fullFileName, client, fLength, true);
+    } else {
+      ret = receiveFile(fullFileName, client, fLength, true);
+    }
+    RET_IF_ERR(ret);
+    // NOTE: the sst files carry a checksum per block, the other files of
+    // a checkpoint are checked by their own records when the store opens
+    if (filesystem::path(fullFileName).extension() == ".sst") {
+      auto rs = rocksdb::VerifySstFileChecksum(
+        rocksdb::Options(), rocksdb::EnvOptions(), fullFileName);
+      if (!rs.ok()) {
+        LOG(ERROR) << "fullsync file:" << fullFileName
+                   << " verify checksum failed:" << rs.ToString();
+        client->writeLine("-ERR checksum mismatch");
+        return {ErrorCodes::ERR_INTERNAL, rs.ToString()};
+      }
+    }
+    RET_IF_ERR(client->writeLine("+OK"));
+    LOG(INFO) << "fullsync file:" << fullFileName << " transfer done";
+    std::lock_guard<std::mutex> lk(*mutex);
+    finishedFiles->insert(s.value());
+  }
+}
+
+void ReplManager::joinMasterFullSync(
+  const StoreMeta& metaSnapshot,
+  const std::string& dir,
+  const std::map<std::string, uint64_t>& flist,
+  std::mutex* mutex,
+  std::set<std::string>* finishedFiles) {
+  auto client =
+    createClient(metaSnapshot,
+                 _connectMasterTimeoutMs.load(std::memory_order_relaxed),
+                 CLIENT_MASTER);
+  if (client == nullptr) {
+    return;
+  }
+  std::string myip =
+    _svr->getParams()->domainEnabled ? _cfg->bindIp : client->getLocalIp();
+  std::stringstream ss;
+  ss << "FULLSYNC " << metaSnapshot.syncFromId << " " << myip << " "
+     << _svr->getParams()->port << " join";
+  if (!client->writeLine(ss.str()).ok()) {
+    return;
+  }
+  auto rpl = client->readLine(std::chrono::seconds(10));
+  // the fullsync connection sends the files left if it can't join
+  if (!rpl.ok() || rpl.value() != "+OK") {
+    LOG(WARNING) << "store:" << metaSnapshot.id << " join fullsync failed:"
+                 << (rpl.ok() ? rpl.value() : rpl.status().toString());
+    return;
+  }
+  // the master takes no file for this connection until it's acked
+  if (!client->writeLine("+OK").ok()) {
+    return;
+  }
+  auto s = receiveFullSyncFiles(client, dir, flist, mutex, finishedFiles);
+  if (!s.ok()) {
+    LOG(ERROR) << "store:" << metaSnapshot.id
+               << " fullsync joined connection failed:" << s.toString();
+  }
+}
+
 // spov's network communicate procedure
 // read binlogpos low watermark
 // read filelist={filename->filesize}
@@ -202,6 +316,12 @@ Status ReplManager::receiveFileDirectio(
 //     read content
 //     send +OK
 // send +OK
+// in streaming mode, fullSyncStreams - 1 more connections join the
+// fullsync, each one reads +OK and sends +OK back, then repeats
+//     read filename
+//     read the whole content
+//     send +OK if the sst checksums match
+// until it reads +DONE
 void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   LOG(INFO) << "store:" << metaSnapshot.id << " fullsync start";
   /* NOTE(raffertyyu@tencent.com)
@@ -292,8 +412,9 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   // get binlogPos and filelist, other messages get from "backup_meta" file
   std::string myip =
     _svr->getParams()->domainEnabled ? _cfg->bindIp : client->getLocalIp();
-  auto ebkInfo =
-    getBackupInfo(client.get(), metaSnapshot, myip, _svr->getParams()->port);
+  bool streaming = _cfg->fullSyncStreaming;
+  auto ebkInfo = getBackupInfo(
+    client.get(), metaSnapshot, myip, _svr->getParams()->port, streaming);
   if (!ebkInfo.ok()) {
     LOG(WARNING) << "storeId:" << metaSnapshot.id
                  << ",syncMaster:" << metaSnapshot.syncFromHost << ":"
@@ -322,6 +443,31 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   auto flist = ebkInfo.value().getFileList();
 
   std::set<std::string> finishedFiles;
+  if (streaming) {
+    std::mutex mutex;
+    std::vector<std::thread> joined;
+    for (uint32_t i = 1; i < _cfg->fullSyncStreams; i++) {
+      joined.emplace_back(
+        [this, &metaSnapshot, &store, &flist, &mutex, &finishedFiles]() {
+          joinMasterFullSync(metaSnapshot,
+                             store->dftBackupDir(),
+                             flist,
+                             &mutex,
+                             &finishedFiles);
+        });
+    }
+    auto s = receiveFullSyncFiles(
+      client, store->dftBackupDir(), flist, &mutex, &finishedFiles);
+    for (auto& t : joined) {
+      t.join();
+    }
+    if (!s.ok() || finishedFiles.size() != flist.size()) {
+      LOG(ERROR) << "store:" << metaSnapshot.id << " fullsync received "
+                 << finishedFiles.size() << " of " << flist.size()
+                 << " files:" << s.toString();
+      return;
+    }
+  }
   while (true) {
     if (finishedFiles.size() == flist.size()) {
       break;
@@ -488,13 +634,22 @@ void ReplManager::slaveChkSyncStatus(const StoreMeta& metaSnapshot) {
             << metaSnapshot.syncFromPort << "," << metaSnapshot.syncFromId;
 
   bool has_error = true;
+  bool needFullSync = false;
   std::string errStr = "";
   std::string errPrefix = "store:" + std::to_string(metaSnapshot.id) + " ";
-  auto guard = MakeGuard([this, &metaSnapshot, &has_error, &errStr] {
+  auto guard = MakeGuard([this,
+                          &metaSnapshot,
+                          &has_error,
+                          &needFullSync,
+                          &errStr] {
     if (has_error) {
       auto newMeta = metaSnapshot.copy();
       newMeta->replState = ReplState::REPL_ERR;
       newMeta->replErr = errStr;
+      if (needFullSync) {
+        newMeta->replState = ReplState::REPL_CONNECT;
+        newMeta->binlogId = Transaction::TXNID_UNINITED;
+      }
       auto oldSessId = _syncStatus[metaSnapshot.id]->sessionId;
       _syncStatus[metaSnapshot.id]->sessionId =
         std::numeric_limits<uint64_t>::max();
@@ -535,6 +690,8 @@ void ReplManager::slaveChkSyncStatus(const StoreMeta& metaSnapshot) {
   }
   if (s.value().size() == 0 || s.value()[0] != '+') {
     errStr = errPrefix + "incrsync master bad return:" + s.value();
+    // see ReplManager::beginWriteWithoutBinlog()
+    needFullSync = s.value().find("-ERR fullsync required") == 0;
     return;
   }
 
@@ -687,6 +844,168 @@ Status ReplManager::applyRepllogV2(Session* sess,
   return {ErrorCodes::ERR_OK, ""};
 }
 
+// NOTE: the binlogIds are reserved in order by prepareSlaveTxnV2(), then
+// the binlogs up to the next barrier are applied by the lanes, the lane 0
+// runs in this session. When a binlog fails, the lanes roll back the
+// binlogs after it. But if one of them is committed already, the store has
+// a hole which can only be repaired by a fullsync.
+Status ReplManager::applyRepllogsV2(Session* sess,
+                                    uint32_t storeId,
+                                    const std::vector<ReplLogRawV2>& logs) {
+  [this, storeId]() {
+    std::unique_lock<std::mutex> lk(_mutex);
+    _cv.wait(lk, [this, storeId] { return !_syncStatus[storeId]->isRunning; });
+    _syncStatus[storeId]->isRunning = true;
+  }();
+
+  uint64_t sessionId = sess->id();
+  // the contiguous applied watermark
+  BinlogResult applied;
+  bool idMatch = [this, storeId, sessionId]() {
+    std::unique_lock<std::mutex> lk(_mutex);
+    return (sessionId == _syncStatus[storeId]->sessionId);
+  }();
+  auto guard = MakeGuard([this, storeId, &applied, &idMatch] {
+    std::unique_lock<std::mutex> lk(_mutex);
+    INVARIANT_D(_syncStatus[storeId]->isRunning);
+    _syncStatus[storeId]->isRunning = false;
+    if (idMatch) {
+      _syncStatus[storeId]->lastSyncTime = SCLOCK::now();
+      if (applied.binlogTs > _syncStatus[storeId]->lastBinlogTs) {
+        _syncStatus[storeId]->lastBinlogTs = applied.binlogTs;
+      }
+      if (applied.binlogId != 0) {
+        _syncMeta[storeId]->binlogId = applied.binlogId;
+      }
+    }
+    _cv.notify_all();
+  });
+
+  if (!idMatch) {
+    return {ErrorCodes::ERR_NOTFOUND, "sessionId not match"};
+  }
+
+  auto expdb =
+    _svr->getSegmentMgr()->getDb(sess, storeId, mgl::LockMode::LOCK_IX);
+  if (!expdb.ok()) {
+    return expdb.status();
+  }
+  auto store = expdb.value().store;
+  size_t laneNum = _binlogApplier ? _cfg->binlogApplyThreadnum + 1 : 1;
+  // NOTE: a txn keeps its session, which isn't thread safe, so the lanes
+  // running in _binlogApplier have their own sessions
+  std::vector<std::unique_ptr<LocalSessionGuard>> laneGuards;
+  std::vector<Session*> laneSessions{sess};
+  for (size_t l = 1; l < laneNum; l++) {
+    laneGuards.emplace_back(
+      std::make_unique<LocalSessionGuard>(_svr.get(), sess));
+    laneGuards.back()->getSession()->getCtx()->setReplOnly(true);
+    laneSessions.push_back(laneGuards.back()->getSession());
+  }
+
+  size_t next = 0;
+  while (next < logs.size()) {
+    std::vector<PreparedBinlogTxn> txns;
+    Status prepared;
+    while (next < logs.size()) {
+      auto exptxn = prepareSlaveTxnV2(sess,
+                                      laneSessions,
+                                      store,
+                                      logs[next].getReplLogKey(),
+                                      logs[next].getReplLogValue());
+      if (!exptxn.ok()) {
+        prepared = exptxn.status();
+        break;
+      }
+      next++;
+      txns.emplace_back(std::move(exptxn.value()));
+      if (isApplyBarrier(txns.back().chunkId)) {
+        break;
+      }
+    }
+    bool barrier = !txns.empty() && isApplyBarrier(txns.back().chunkId);
+
+    std::vector<std::vector<size_t>> lanes(laneNum);
+    for (size_t i = 0; i < txns.size() - (barrier ? 1 : 0); i++) {
+      lanes[txns[i].chunkId % laneNum].push_back(i);
+    }
+    std::vector<Status> results(txns.size(),
+                                {ErrorCodes::ERR_INTERNAL, "not applied"});
+    std::atomic<uint64_t> failedId{std::numeric_limits<uint64_t>::max()};
+    auto runLane = [&txns, &results, &failedId](
+                     const std::vector<size_t>& lane) {
+      for (auto i : lane) {
+        if (txns[i].binlogId > failedId.load()) {
+          break;
+        }
+        results[i] = applyPreparedTxnV2(&txns[i]);
+        if (!results[i].ok()) {
+          uint64_t cur = failedId.load();
+          while (txns[i].binlogId < cur &&
+                 !failedId.compare_exchange_weak(cur, txns[i].binlogId)) {
+          }
+          break;
+        }
+      }
+    };
+    std::vector<std::future<void>> pending;
+    for (size_t l = 1; l < laneNum; l++) {
+      if (lanes[l].empty()) {
+        continue;
+      }
+      auto done = std::make_shared<std::promise<void>>();
+      pending.emplace_back(done->get_future());
+      const std::vector<size_t>* lane = &lanes[l];
+      _binlogApplier->schedule([&runLane, lane, done]() {
+        const auto guard = MakeGuard([&done] { done->set_value(); });
+        runLane(*lane);
+      });
+    }
+    runLane(lanes[0]);
+    for (auto& f : pending) {
+      f.wait();
+    }
+    if (barrier && failedId.load() == std::numeric_limits<uint64_t>::max()) {
+      results.back() = applyPreparedTxnV2(&txns.back());
+    }
+
+    size_t firstFailed = 0;
+    while (firstFailed < txns.size() && results[firstFailed].ok()) {
+      firstFailed++;
+    }
+    if (firstFailed > 0) {
+      applied.binlogId = txns[firstFailed - 1].binlogId;
+      applied.binlogTs = txns[firstFailed - 1].binlogTs;
+      store->setBinlogTime(applied.binlogTs);
+    }
+    bool hole = false;
+    for (size_t i = firstFailed + 1; i < txns.size(); i++) {
+      hole = hole || results[i].ok();
+    }
+    // roll back the ones not applied
+    txns.clear();
+
+    if (hole) {
+      LOG(ERROR) << "store:" << storeId << " apply binlog failed after binlog:"
+                 << applied.binlogId << " with later binlogs committed:"
+                 << results[firstFailed].toString() << ", need fullsync";
+      applied.binlogId = 0;
+      std::lock_guard<std::mutex> lk(_mutex);
+      auto newMeta = _syncMeta[storeId]->copy();
+      newMeta->replState = ReplState::REPL_CONNECT;
+      newMeta->binlogId = Transaction::TXNID_UNINITED;
+      changeReplStateInLock(*newMeta, true);
+    }
+    if (firstFailed < results.size()) {
+      return results[firstFailed];
+    }
+    if (!prepared.ok()) {
+      return prepared;
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 std::ofstream* ReplManager::getCurBinlogFs(uint32_t storeId) {
   std::ofstream* fs = nullptr;
   uint32_t currentId = 0;
@@ -50,6 +50,15 @@ static int FLAGS_sleepAfterBenchmark = 0;
 
 static int FLAGS_rocksTransactionMode = 1;
 
+// Comma-separated list of benchmarks to run: kvwrite, lrange
+static const char* FLAGS_benchmarks = "kvwrite";
+
+// Number of elements of the list each lrange thread reads
+static int FLAGS_listLen = 10000;
+
+// Number of full LRANGE calls each lrange thread does
+static int FLAGS_lrangeNum = 100;
+
 namespace novadbplus {
 rocksdb::Env* g_env = nullptr;
 std::shared_ptr<ServerEntry> g_server = nullptr;
@@ -503,6 +512,44 @@ void DoWriteKVToRocksdb(ThreadState* thread) {
   }
 }
 
+void DoLRange(ThreadState* thread) {
+  std::fprintf(stdout,
+               "Thread %d lrange (%d ops, %d elements) \n",
+               thread->tid,
+               FLAGS_lrangeNum,
+               FLAGS_listLen);
+  auto ctx = std::make_shared<asio::io_context>();
+  asio::ip::tcp::socket socket(*ctx);
+  auto sess = std::make_shared<NetSession>(
+    g_server, std::move(socket), 0, false, nullptr, nullptr);
+
+  auto listKey = "lrange_" + std::to_string(thread->tid);
+  sess->setArgs({"del", listKey});
+  EXPECT_TRUE(Command::runSessionCmd(sess.get()).ok());
+  for (int i = 0; i < FLAGS_listLen;) {
+    std::vector<std::string> args = {"rpush", listKey};
+    for (int j = 0; j < 1000 && i < FLAGS_listLen; ++j, ++i) {
+      KeyBuffer value;
+      value.Set(i);
+      args.emplace_back(value.slice().ToString());
+    }
+    sess->setArgs(args);
+    EXPECT_TRUE(Command::runSessionCmd(sess.get()).ok());
+  }
+
+  // only the reads are timed
+  thread->stats.Start();
+  for (int i = 0; i < FLAGS_lrangeNum; ++i) {
+    sess->setArgs({"lrange", listKey, "0", "-1"});
+    auto expect = Command::runSessionCmd(sess.get());
+    EXPECT_TRUE(expect.status().ok());
+    if (expect.status().ok()) {
+      thread->stats.AddBytes(expect.value().size());
+    }
+    thread->stats.FinishedSingleOp();
+  }
+}
+
 static void ThreadBody(void* v) {
   ThreadArg* arg = reinterpret_cast<ThreadArg*>(v);
   SharedState* shared = arg->shared;
@@ -573,17 +620,28 @@ void RunBenchmark(int n, Slice name, void (*method)(ThreadState*)) {
 
 void Run() {
   Open();
-  auto method = &DoWriteKV;
-  if (FLAGS_directWriteRocksdb) {
-    method = &DoWriteKVToRocksdb;
-  }
-  rocksdb::Slice name("kvwrite");
-  LOG(INFO) << "Start benchmark :" << name.data();
-  auto start = g_env->NowMicros();
-  RunBenchmark(FLAGS_threads, name, method);
-  auto end = g_env->NowMicros();
-  LOG(INFO) << "End benchmark :" << name.data()
-            << "QPS:" << (FLAGS_num * FLAGS_threads * 1e6) / (end - start);
+  std::stringstream benchmarks(FLAGS_benchmarks);
+  std::string name;
+  while (std::getline(benchmarks, name, ',')) {
+    void (*method)(ThreadState*) = nullptr;
+    int num = 0;
+    if (name == "kvwrite") {
+      method = FLAGS_directWriteRocksdb ? &DoWriteKVToRocksdb : &DoWriteKV;
+      num = FLAGS_num;
+    } else if (name == "lrange") {
+      method = &DoLRange;
+      num = FLAGS_lrangeNum;
+    } else {
+      std::fprintf(stderr, "unknown benchmark '%s'\n", name.c_str());
+      continue;
+    }
+    LOG(INFO) << "Start benchmark :" << name;
+    auto start = g_env->NowMicros();
+    RunBenchmark(FLAGS_threads, name, method);
+    auto end = g_env->NowMicros();
+    LOG(INFO) << "End benchmark :" << name
+              << "QPS:" << (num * FLAGS_threads * 1e6) / (end - start);
+  }
   g_env->SleepForMicroseconds(FLAGS_sleepAfterBenchmark * 1000000);
 #ifndef _WIN32
   g_server->stop();
@@ -617,6 +675,10 @@ void printHelpInfo() {
       --sleepAfterBenchmark=seconds sleepping time after test.
       --num=n                       kvwrite options number
       --thread=n                    work thread number
+      --benchmarks=list             comma-separated benchmarks to run,
+                                    kvwrite (default) and lrange
+      --listLen=n                   list length for lrange
+      --lrangeNum=n                 lrange (0 -1) calls per thread
       --rocksTransactionMode=mode   txn mode for novadbplus.
                                       0 for Optimistic Transaction.
                                       1 for Pessimistic Transaction.
@@ -644,6 +706,14 @@ void printHelpInfo() {
             << "kvwrite options number" << std::endl;
   std::cout << "    --thread=n                    "
             << "work thread number" << std::endl;
+  std::cout << "    --benchmarks=list             "
+            << "comma-separated benchmarks to run," << std::endl;
+  std::cout << "                                  "
+            << "kvwrite (default) and lrange" << std::endl;
+  std::cout << "    --listLen=n                   "
+            << "list length for lrange" << std::endl;
+  std::cout << "    --lrangeNum=n                 "
+            << "lrange (0 -1) calls per thread" << std::endl;
   std::cout << "    --rocksTransactionMode=mode   "
             << "txn mode for novadbplus." << std::endl;
   std::cout << "                                  "
@@ -689,6 +759,13 @@ int main(int argc, char** argv) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--thread=%d%c", &n, &junk) == 1) {
       FLAGS_threads = n;
+    } else if (strncmp(argv[i], "--benchmarks=", strlen("--benchmarks=")) ==
+               0) {
+      FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
+    } else if (sscanf(argv[i], "--listLen=%d%c", &n, &junk) == 1) {
+      FLAGS_listLen = n;
+    } else if (sscanf(argv[i], "--lrangeNum=%d%c", &n, &junk) == 1) {
+      FLAGS_lrangeNum = n;
     } else if (strncmp(argv[i], "-v", strlen("-v")) == 0) {
       printVersionInfo();
       std::exit(0);
@@ -4,7 +4,9 @@
 
 #include "novadbplus/server/index_manager.h"
 
+#include <algorithm>
 #include <chrono>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -13,6 +15,7 @@
 #include "novadbplus/commands/command.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/portable.h"
+#include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/scopeguard.h"
 #include "novadbplus/utils/string.h"
 #include "novadbplus/utils/sync_point.h"
@@ -27,7 +30,10 @@ IndexManager::IndexManager(std::shared_ptr<ServerEntry> svr,
     _scannerMatrix(std::make_shared<PoolMatrix>()),
     _deleterMatrix(std::make_shared<PoolMatrix>()),
     _totalDequeue(0),
-    _totalEnqueue(0) {
+    _totalEnqueue(0),
+    _totalDelBatches(0),
+    _totalDelRangeKeys(0),
+    _totalDelCostUs(0) {
   _scanPonitsTtl.resize(svr->getKVStoreCount());
   for (size_t storeId = 0; storeId < svr->getKVStoreCount(); ++storeId) {
     _scanPoints[storeId] = std::move(std::string());
@@ -105,6 +111,15 @@ std::string IndexManager::getInfoString() {
   std::stringstream ss;
   ss << "total_expire_keys:" << _totalDequeue << "\r\n";
   ss << "deleting_expire_keys:" << _totalEnqueue - _totalDequeue << "\r\n";
+  uint64_t batches = _totalDelBatches;
+  uint64_t costUs = _totalDelCostUs;
+  ss << "expire_del_batches:" << batches << "\r\n";
+  ss << "expire_del_avg_batch_keys:"
+     << (batches ? _totalDequeue / batches : 0) << "\r\n";
+  ss << "expire_del_range_keys:" << _totalDelRangeKeys << "\r\n";
+  // keys per second of the deleters' busy time
+  ss << "expire_del_keys_per_sec:"
+     << (costUs ? _totalDequeue * 1000000 / costUs : 0) << "\r\n";
   ss << "scanner_matrix:" << _scannerMatrix->getInfoString() << "\r\n";
   ss << "deleter_matrix:" << _deleterMatrix->getInfoString() << "\r\n";
   uint64_t minttl = -1;
@@ -273,34 +288,37 @@ int IndexManager::tryDelExpiredKeysJob(uint32_t storeId) {
   uint32_t deletes = 0;
 
   auto delBatch = _cfg->delCntIndexMgr;
-  while (true) {
-    TTLIndex index;
+  while (deletes < delBatch) {
+    std::vector<TTLIndex> indexes;
+    uint32_t batchSize = delBatch - deletes;
 
     {
       std::lock_guard<std::mutex> lk(_mutex);
-      if (_expiredKeys[storeId].empty()) {
-        break;
+      for (const auto& index : _expiredKeys[storeId]) {
+        if (indexes.size() >= batchSize) {
+          break;
+        }
+        indexes.push_back(index);
       }
-      index = _expiredKeys[storeId].front();
     }
-    LocalSessionGuard sg(_svr.get());
-    auto sess = sg.getSession();
-    sess->getCtx()->setAuthed();
-    sess->getCtx()->setDbId(index.getDbId());
-    Command::expireKeyIfNeeded(
-      sg.getSession(), index.getPriKey(), index.getType());
+    if (indexes.empty()) {
+      break;
+    }
+
+    auto start = nsSinceEpoch();
+    uint32_t batches = delExpiredKeys(indexes);
+    _totalDelCostUs += (nsSinceEpoch() - start) / 1000;
+    _totalDelBatches += batches;
 
     {
       std::lock_guard<std::mutex> lk(_mutex);
-      INVARIANT(!_expiredKeys[storeId].empty());
-      _expiredKeys[storeId].pop_front();
-      _totalDequeue++;
-      deletes++;
-    }
-
-    // break if delete a number of keys in the current store
-    if (deletes >= delBatch) {
-      break;
+      // stopStore() may have cleared the list
+      auto& expired = _expiredKeys[storeId];
+      for (size_t i = 0; i < indexes.size() && !expired.empty(); ++i) {
+        expired.pop_front();
+      }
+      _totalDequeue += indexes.size();
+      deletes += indexes.size();
     }
 
     TEST_SYNC_POINT_CALLBACK("InspectTotalDequeue", &_totalDequeue);
@@ -312,6 +330,61 @@ int IndexManager::tryDelExpiredKeysJob(uint32_t storeId) {
   return deletes;
 }
 
+// delete the expired keys of a store in batches of delBatchIndexMgr keys of
+// the same db, return the number of batches.
+// NOTE: the slot migration doesn't send the binlog of a batch over several
+// chunks, so the batches are of the same chunk when cluster is enabled.
+uint32_t IndexManager::delExpiredKeys(const std::vector<TTLIndex>& indexes) {
+  // (chunkId, dbId) -> indexes
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<TTLIndex>> groups;
+  auto segMgr = _svr->getSegmentMgr();
+  bool byChunk = _svr->getParams()->clusterEnabled;
+  for (const auto& index : indexes) {
+    const auto& key = index.getPriKey();
+    uint32_t chunkId = byChunk
+      ? redis_port::keyHashSlot(key.c_str(), key.size()) %
+        segMgr->getChunkSize()
+      : 0;
+    groups[{chunkId, index.getDbId()}].push_back(index);
+  }
+
+  uint32_t batches = 0;
+  size_t batchSize = _cfg->delBatchIndexMgr;
+  for (const auto& group : groups) {
+    const auto& keys = group.second;
+    for (size_t i = 0; i < keys.size(); i += batchSize) {
+      std::vector<TTLIndex> batch(
+        keys.begin() + i, keys.begin() + std::min(keys.size(), i + batchSize));
+      delExpiredBatch(batch);
+      batches++;
+    }
+  }
+  return batches;
+}
+
+void IndexManager::delExpiredBatch(const std::vector<TTLIndex>& batch) {
+  LocalSessionGuard sg(_svr.get());
+  auto sess = sg.getSession();
+  sess->getCtx()->setAuthed();
+  uint32_t rangeDeletes = 0;
+  auto eDel = Command::expireKeysInStore(sess, batch, &rangeDeletes);
+  _totalDelRangeKeys += rangeDeletes;
+  if (eDel.ok()) {
+    return;
+  }
+
+  // fall back to deleting them one by one
+  LOG(WARNING) << "expire " << batch.size()
+               << " keys failed:" << eDel.status().toString();
+  for (const auto& index : batch) {
+    LocalSessionGuard keySg(_svr.get());
+    auto keySess = keySg.getSession();
+    keySess->getCtx()->setAuthed();
+    keySess->getCtx()->setDbId(index.getDbId());
+    Command::expireKeyIfNeeded(keySess, index.getPriKey(), index.getType());
+  }
+}
+
 // call this in a forever loop
 Status IndexManager::run() {
   auto scheScanExpired = [this]() {
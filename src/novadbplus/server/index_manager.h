@@ -43,6 +43,9 @@ class IndexManager {
   std::string getInfoString();
 
  private:
+  uint32_t delExpiredKeys(const std::vector<TTLIndex>& indexes);
+  void delExpiredBatch(const std::vector<TTLIndex>& batch);
+
   std::unique_ptr<WorkerPool> _indexScanner;
   std::unique_ptr<WorkerPool> _keyDeleter;
   std::unordered_map<std::size_t, std::list<TTLIndex>> _expiredKeys;
@@ -66,6 +69,11 @@ class IndexManager {
 
   std::atomic<uint64_t> _totalDequeue;
   std::atomic<uint64_t> _totalEnqueue;
+  // the batches committed by the deleters, the keys deleted by deleteRange
+  // and the time(us) spent in deleting
+  std::atomic<uint64_t> _totalDelBatches;
+  std::atomic<uint64_t> _totalDelRangeKeys;
+  std::atomic<uint64_t> _totalDelCostUs;
 };
 
 }  // namespace novadbplus
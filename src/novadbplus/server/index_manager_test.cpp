@@ -413,4 +413,44 @@ TEST(IndexManager, singleJobRunning) {
   SyncPoint::GetInstance()->DisableProcessing();
   SyncPoint::GetInstance()->ClearAllCallBacks();
 }
+
+TEST(IndexManager, batchDelete) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+
+  auto cfg = makeServerParam();
+  cfg->delBatchIndexMgr = 100;
+  auto server = std::make_shared<ServerEntry>(cfg);
+  auto s = server->startup(cfg);
+  ASSERT_TRUE(s.ok());
+
+  // the keys spread over the slots, a batch deletes the keys of a store
+  uint32_t count = 1000;
+  for (uint32_t i = 0; i < count; i++) {
+    auto key = "batch" + std::to_string(i);
+    runCommand(server, {"sadd", key, "a", "b", "c"});
+    runCommand(server, {"pexpire", key, "1"});
+  }
+
+  for (uint32_t i = 0; i < 60; i++) {
+    if (server->getIndexMgr()->delExpiredCount() >= count) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+  EXPECT_EQ(server->getIndexMgr()->delExpiredCount(), count);
+  EXPECT_EQ(runCommand(server, {"exists", "batch0"}), Command::fmtZero());
+
+  auto info = server->getIndexMgr()->getInfoString();
+  auto pos = info.find("expire_del_batches:");
+  ASSERT_NE(pos, std::string::npos);
+  auto batches = std::stoul(info.substr(pos + strlen("expire_del_batches:")));
+  EXPECT_GT(batches, 0u);
+  EXPECT_LT(batches, count / 10);
+
+  server->stop();
+  ASSERT_EQ(server.use_count(), 1);
+}
+
 }  // namespace novadbplus
@@ -832,6 +832,91 @@ TEST(Repl, slaveofBenchmarkingMaster) {
     LOG(INFO) << ">>>>>> test store count:" << i << " end;";
   }
 }
+TEST(Repl, ParallelApply) {
+  size_t i = 0;
+  {
+    const auto guard = MakeGuard([] {
+      destroyEnv(master_dir);
+      destroyEnv(slave_dir);
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+    });
+
+    EXPECT_TRUE(setupEnv(master_dir));
+    EXPECT_TRUE(setupEnv(slave_dir));
+
+    auto cfg1 = makeServerParam(master_port, i, master_dir, false);
+    auto cfg2 = makeServerParam(slave_port, i, slave_dir, false);
+    cfg2->binlogApplyThreadnum = 4;
+
+    auto master = std::make_shared<ServerEntry>(cfg1);
+    auto s = master->startup(cfg1);
+    INVARIANT(s.ok());
+
+    auto slave = std::make_shared<ServerEntry>(cfg2);
+    s = slave->startup(cfg2);
+    INVARIANT(s.ok());
+    EXPECT_TRUE(slave->getReplManager()->isParallelApply());
+
+    runCmd(slave, {"slaveof", "127.0.0.1", std::to_string(master_port)});
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+
+    // the incremental binlogs, single chunk and multi chunk ones
+    auto allKeys =
+      writeComplexDataToServer(master, recordSize, 50, nullptr, true);
+    auto thread = std::thread([master]() { testAll(master); });
+    thread.join();
+
+    waitSlaveCatchup(master, slave);
+    compareData(master, slave);
+#ifndef _WIN32
+    master->stop();
+    slave->stop();
+    ASSERT_EQ(slave.use_count(), 1);
+#endif
+  }
+}
+
+TEST(Repl, StreamingFullSync) {
+  size_t i = 0;
+  {
+    const auto guard = MakeGuard([] {
+      destroyEnv(master_dir);
+      destroyEnv(slave_dir);
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+    });
+
+    EXPECT_TRUE(setupEnv(master_dir));
+    EXPECT_TRUE(setupEnv(slave_dir));
+
+    auto cfg1 = makeServerParam(master_port, i, master_dir, false);
+    auto cfg2 = makeServerParam(slave_port, i, slave_dir, false);
+    cfg2->fullSyncStreaming = true;
+    cfg2->fullSyncStreams = 3;
+
+    auto master = std::make_shared<ServerEntry>(cfg1);
+    auto s = master->startup(cfg1);
+    INVARIANT(s.ok());
+
+    // the data before slaveof goes by the fullsync files
+    auto allKeys = writeComplexDataToServer(master, recordSize, 50, nullptr);
+
+    auto slave = std::make_shared<ServerEntry>(cfg2);
+    s = slave->startup(cfg2);
+    INVARIANT(s.ok());
+
+    runCmd(slave, {"slaveof", "127.0.0.1", std::to_string(master_port)});
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+
+    waitSlaveCatchup(master, slave);
+    compareData(master, slave);
+#ifndef _WIN32
+    master->stop();
+    slave->stop();
+    ASSERT_EQ(slave.use_count(), 1);
+#endif
+  }
+}
+
 // TODO(wayenchen) test again when psynenable finish
 TEST(Repl, slaveofBenchmarkingMasterAOF) {
   size_t i = 0;
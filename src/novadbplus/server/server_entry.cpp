@@ -20,6 +20,7 @@
 
 #include "novadbplus/commands/command.h"
 #include "novadbplus/lock/lock.h"
+#include "novadbplus/lock/mgl/sharded_mgl_mgr.h"
 #include "novadbplus/network/latency_record.h"
 #include "novadbplus/server/server_params.h"
 #include "novadbplus/storage/rocks/rocks_kvstore.h"
@@ -175,6 +176,10 @@ void SlowlogStat::slowlogDataPushEntryIfNeeded(
         slowLog << "# " << rocksdbRecord << "\n";
       }
     }
+    auto scanRecord = sess->getCtx()->generateScanRecordLogIfNeeded();
+    if (!scanRecord.empty()) {
+      slowLog << "# " << scanRecord << "\n";
+    }
 
     uint64_t args_total_length = 0;
     uint64_t args_output_length = 0;
@@ -620,7 +625,16 @@ Status ServerEntry::startup(const std::shared_ptr<ServerParams>& cfg) {
   auto tmpPessimisticMgr = std::make_unique<PessimisticMgr>(kvStoreCount);
   installPessimisticMgrInLock(std::move(tmpPessimisticMgr));
 
-  auto tmpMGLockMgr = std::make_unique<mgl::MGLockMgr>();
+  std::unique_ptr<mgl::MGLockMgr> tmpMGLockMgr;
+  if (cfg->lockMgrSharded) {
+    auto shardedMgr =
+      std::make_unique<mgl::ShardedMGLockMgr>(cfg->lockMgrShardNum);
+    LOG(INFO) << "sharded lock manager with " << shardedMgr->getShardNum()
+              << " shards";
+    tmpMGLockMgr = std::move(shardedMgr);
+  } else {
+    tmpMGLockMgr = std::make_unique<mgl::MGLockMgr>();
+  }
   installMGLockMgrInLock(std::move(tmpMGLockMgr));
 
   // FIXME: we may should move these function's static variable to global
@@ -657,6 +671,28 @@ Status ServerEntry::startup(const std::shared_ptr<ServerParams>& cfg) {
     _cfg->executorThreadNum += pool->size();
   }
 
+  if (_cfg->batchReadThreadNum > 0) {
+    _batchReadPool = std::make_unique<WorkerPool>(
+      "tx-batchread", std::make_shared<PoolMatrix>());
+    Status s = _batchReadPool->startup(_cfg->batchReadThreadNum);
+    if (!s.ok()) {
+      LOG(ERROR) << "ServerEntry::startup failed, _batchReadPool->startup:"
+                 << s.toString();
+      return s;
+    }
+  }
+
+  if (_cfg->scanThreadNum > 0) {
+    _scanPool =
+      std::make_unique<WorkerPool>("tx-scan", std::make_shared<PoolMatrix>());
+    Status s = _scanPool->startup(_cfg->scanThreadNum);
+    if (!s.ok()) {
+      LOG(ERROR) << "ServerEntry::startup failed, _scanPool->startup:"
+                 << s.toString();
+      return s;
+    }
+  }
+
   _network = std::make_unique<NetworkAsio>(
     shared_from_this(), _netMatrix, _reqMatrix, cfg);
   Status s = _network->prepare(
@@ -768,6 +804,14 @@ NetworkAsio* ServerEntry::getNetwork() {
   return _network.get();
 }
 
+WorkerPool* ServerEntry::getBatchReadPool() {
+  return _batchReadPool.get();
+}
+
+WorkerPool* ServerEntry::getScanPool() {
+  return _scanPool.get();
+}
+
 ReplManager* ServerEntry::getReplManager() {
   return _replMgr.get();
 }
@@ -1112,10 +1156,15 @@ bool ServerEntry::processRequest(Session* sess) {
       NetSession* ns = dynamic_cast<NetSession*>(sess);
       INVARIANT(ns != nullptr);
       std::vector<std::string> args = ns->getArgs();
-      // we have called precheck, it should have 4 args
-      INVARIANT(args.size() == 4);
-      _replMgr->supplyFullSync(ns->borrowConn(), args[1], args[2], args[3]);
-      ++_serverStat.syncFull;
+      // we have called precheck, it should have 4 or 5 args
+      INVARIANT(args.size() >= 4);
+      std::string mode = args.size() > 4 ? toLower(args[4]) : "";
+      _replMgr->supplyFullSync(
+        ns->borrowConn(), args[1], args[2], args[3], mode);
+      // a joined connection is a part of another fullsync
+      if (mode != "join") {
+        ++_serverStat.syncFull;
+      }
       return false;
     } else if (expCmdName == "incrsync") {
       LOG(WARNING) << "[master] session id:" << sess->id()
@@ -1141,8 +1190,21 @@ bool ServerEntry::processRequest(Session* sess) {
       std::vector<std::string> args = ns->getArgs();
       // we have called precheck, it should have 2 args
       // INVARIANT(args.size() == 4);
-      _migrateMgr->dstReadyMigrate(
-        ns->borrowConn(), args[1], args[2], args[3], args[4]);
+      // the receiver appends "sst" if it wants the snapshot as sst files,
+      // "lz4" if it wants the batches compressed
+      bool sstMode = false;
+      bool compress = false;
+      for (size_t i = 5; i < args.size(); i++) {
+        sstMode |= args[i] == "sst";
+        compress |= args[i] == "lz4";
+      }
+      _migrateMgr->dstReadyMigrate(ns->borrowConn(),
+                                   args[1],
+                                   args[2],
+                                   args[3],
+                                   args[4],
+                                   sstMode,
+                                   compress);
       return false;
     } else if (expCmdName == "preparemigrate") {
       LOG(INFO) << "prepare migrate command";
@@ -1223,7 +1285,7 @@ bool ServerEntry::processRequest(Session* sess) {
                 << " err:" << expect.status().toString();
     return true;
   }
-  auto s = sess->setResponse(expect.value());
+  auto s = sess->takeResponse(std::move(expect.value()));
   if (!s.ok()) {
     return false;
   }
@@ -1270,6 +1332,7 @@ void ServerEntry::getStatInfo(std::stringstream& ss) const {
 
   ss << "total_stricky_packets:" << _netMatrix->stickyPackets.get() << "\r\n";
   ss << "total_invalid_packets:" << _netMatrix->invalidPackets.get() << "\r\n";
+  ss << "total_inline_commands:" << _netMatrix->inlineCommands.get() << "\r\n";
 
   ss << "total_net_input_bytes:" << _serverStat.netInputBytes.get() << "\r\n";
   ss << "total_net_output_bytes:" << _serverStat.netOutputBytes.get() << "\r\n";
@@ -1313,6 +1376,8 @@ void ServerEntry::appendJSONStat(
     w.Uint64(_netMatrix->connReleased.get());
     w.Key("invalid_packets");
     w.Uint64(_netMatrix->invalidPackets.get());
+    w.Key("inline_commands");
+    w.Uint64(_netMatrix->inlineCommands.get());
     w.EndObject();
   }
   if (sections.find("request") != sections.end()) {
@@ -1827,6 +1892,12 @@ void ServerEntry::stop() {
   for (auto& executor : _executorRecycleSet) {
     executor->stop();
   }
+  if (_batchReadPool) {
+    _batchReadPool->stop();
+  }
+  if (_scanPool) {
+    _scanPool->stop();
+  }
   _indexMgr->stop();
 
   // 1 second is considered to be enough for all packages sended back to client
@@ -1854,6 +1925,8 @@ void ServerEntry::stop() {
     for (auto& executor : _executorList) {
       executor.reset();
     }
+    _batchReadPool.reset();
+    _scanPool.reset();
     _indexMgr.reset();
     _gcMgr.reset();
     _migrateMgr.reset();
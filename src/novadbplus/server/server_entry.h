@@ -230,6 +230,10 @@ class ServerEntry : public std::enable_shared_from_this<ServerEntry> {
   ClusterManager* getClusterMgr();
   GCManager* getGcMgr();
   ScriptManager* getScriptMgr();
+  // may be nullptr if batchReadThreadNum == 0
+  WorkerPool* getBatchReadPool();
+  // may be nullptr if scanThreadNum == 0
+  WorkerPool* getScanPool();
 
   // TODO(takenliu) : args exist at two places, has better way?
   std::string requirepass() const;
@@ -417,6 +421,8 @@ class ServerEntry : public std::enable_shared_from_this<ServerEntry> {
   mutable std::shared_timed_mutex _exeThreadMutex;
   std::vector<std::unique_ptr<WorkerPool>> _executorList;
   std::set<std::unique_ptr<WorkerPool>> _executorRecycleSet;
+  std::unique_ptr<WorkerPool> _batchReadPool;
+  std::unique_ptr<WorkerPool> _scanPool;
   std::unique_ptr<SegmentMgr> _segmentMgr;
   std::unique_ptr<ReplManager> _replMgr;
   std::unique_ptr<MigrateManager> _migrateMgr;
@@ -129,6 +129,16 @@ bool compressTypeParamCheck(const std::string& val,
   return false;
 }
 
+bool zsetEncodingCheck(const std::string& val,
+                       bool startup,
+                       std::string* errinfo) {
+  auto v = toLower(val);
+  if (v == "skiplist" || v == "ordered") {
+    return true;
+  }
+  return false;
+}
+
 bool executorThreadNumCheck(const std::string& val,
                             bool startup,
                             std::string* errinfo) {
@@ -356,6 +366,7 @@ ServerParams::ServerParams() {
   REGISTER_VARS_SAME_NAME(scanCntIndexMgr, nullptr, nullptr, 1, 1000000, true);
   REGISTER_VARS_SAME_NAME(scanJobCntIndexMgr, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(delCntIndexMgr, nullptr, nullptr, 1, 1000000, true);
+  REGISTER_VARS_SAME_NAME(delBatchIndexMgr, nullptr, nullptr, 1, 10000, true);
   REGISTER_VARS_SAME_NAME(delJobCntIndexMgr, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(
     pauseTimeIndexMgr, nullptr, nullptr, 1, INT_MAX, true);
@@ -363,12 +374,15 @@ ServerParams::ServerParams() {
                                   elementLimitForSingleDelete);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("element-limit-for-single-delete-zset",
                                   elementLimitForSingleDeleteZset);
+  REGISTER_VARS_DIFF_NAME("versioned-keys", versionedKeys);
 
   REGISTER_VARS_DIFF_NAME("proto-max-bulk-len", protoMaxBulkLen);
   REGISTER_VARS_DIFF_NAME("databases", dbNum);
 
   REGISTER_VARS_ALLOW_DYNAMIC_SET(noexpire);
   REGISTER_VARS_ALLOW_DYNAMIC_SET(noexpireBlob);
+  REGISTER_VARS_DIFF_NAME("key-count-enabled", keyCountEnabled);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("dbsize-by-keycount", dbsizeByKeyCount);
   REGISTER_VARS_SAME_NAME(
     maxBinlogKeepNum, nullptr, nullptr, 1, INT64_MAX, true);
   REGISTER_VARS_ALLOW_DYNAMIC_SET(minBinlogKeepSec);
@@ -385,6 +399,7 @@ ServerParams::ServerParams() {
   REGISTER_VARS_NOUSE("slowlog-flush-interval");
   REGISTER_VARS_DIFF_NAME_DYNAMIC("slowlog-file-enabled", slowlogFileEnabled);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("novadb-latency-limit", novadbLatencyLimit);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("latency-tracking", latencyTracking);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("rocks.latency-limit", rocksdbLatencyLimit);
 
   // NOTE(pecochen): this two params should provide their own interface to
@@ -398,6 +413,8 @@ ServerParams::ServerParams() {
     executorWorkPoolSize, nullptr, nullptr, 1, 200, false);
 
   REGISTER_VARS(simpleWorkPoolName);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(pipelineBatchEnabled);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(inlineReadEnabled);
 
   REGISTER_VARS_ALLOW_DYNAMIC_SET(binlogRateLimitMB);
   // Only works on newly created connections(BlockingTcpClient)
@@ -406,8 +423,12 @@ ServerParams::ServerParams() {
   REGISTER_VARS_ALLOW_DYNAMIC_SET(timeoutSecBinlogWaitRsp);
   REGISTER_VARS_SAME_NAME(incrPushThreadnum, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(fullPushThreadnum, nullptr, nullptr, 1, 200, true);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(fullSyncStreaming);
+  REGISTER_VARS_SAME_NAME(fullSyncStreams, nullptr, nullptr, 1, 16, true);
   REGISTER_VARS_SAME_NAME(fullReceiveThreadnum, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(logRecycleThreadnum, nullptr, nullptr, 1, 200, true);
+  REGISTER_VARS_SAME_NAME(
+    binlogApplyThreadnum, nullptr, nullptr, 0, 200, false);
 
   REGISTER_VARS_FULL("truncateBinlogIntervalMs",
                      truncateBinlogIntervalMs,
@@ -424,10 +445,22 @@ ServerParams::ServerParams() {
   REGISTER_VARS_DIFF_NAME_DYNAMIC("binlog-send-batch", binlogSendBatch);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("binlog-send-bytes", binlogSendBytes);
 
+  REGISTER_VARS_SAME_NAME(
+    batchReadThreadNum, nullptr, nullptr, 0, 200, false);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(batchReadParallelKeys);
+  REGISTER_VARS_SAME_NAME(scanThreadNum, nullptr, nullptr, 0, 200, false);
+  REGISTER_VARS(valueCacheMB);
+  REGISTER_VARS(compactionMetaCacheMB);
+  REGISTER_VARS(binlogRingMB);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(hashMaxCompactEntries);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(hashMaxCompactValue);
+
   REGISTER_VARS_ALLOW_DYNAMIC_SET(keysDefaultLimit);
   REGISTER_VARS_ALLOW_DYNAMIC_SET(lockWaitTimeOut);
   REGISTER_VARS_ALLOW_DYNAMIC_SET(lockDbXWaitTimeout);
   REGISTER_VARS(ignoreKeyLock);
+  REGISTER_VARS(lockMgrSharded);
+  REGISTER_VARS(lockMgrShardNum);
   REGISTER_VARS_DIFF_NAME("binlog-using-defaultCF", binlogUsingDefaultCF);
   REGISTER_VARS_DIFF_NAME("binlog-enabled", binlogEnabled);
   REGISTER_VARS_DIFF_NAME("binlog-save-logs", binlogSaveLogs);
@@ -571,6 +604,12 @@ ServerParams::ServerParams() {
                                   migrateSnapshotBatchSizeKB);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-timeout",
                                   migrateNetworkTimeout);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-sst",
+                                  migrateSnapshotSst);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-compress",
+                                  migrateSnapshotCompress);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-window",
+                                  migrateSnapshotWindow);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("migrate-snapshot-retry-num",
                                   snapShotRetryCnt);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-barrier",
@@ -596,6 +635,13 @@ ServerParams::ServerParams() {
   REGISTER_VARS_NOUSE("save-min-binlogid");
   REGISTER_VARS_NOUSE("deletefilesinrange-for-binlog");
   REGISTER_VARS_DIFF_NAME_DYNAMIC("log-error", logError);
+  REGISTER_VARS_FULL("zset-encoding",
+                     zsetEncoding,
+                     zsetEncodingCheck,
+                     removeQuotesAndToLower,
+                     -1,
+                     -1,
+                     true);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("direct-io", directIo);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("allow-cross-slot", allowCrossSlot);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("generate-heartbeat-binlog-interval",
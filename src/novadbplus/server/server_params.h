@@ -470,16 +470,35 @@ class ServerParams {
   uint32_t scanCntIndexMgr = 1000;
   uint32_t scanJobCntIndexMgr = 1;
   uint32_t delCntIndexMgr = 10000;
+  // expired keys of a store deleted in one transaction, they are of the
+  // same chunk when cluster is enabled
+  uint32_t delBatchIndexMgr = 100;
   uint32_t delJobCntIndexMgr = 1;
   uint32_t pauseTimeIndexMgr = 1;
   uint64_t elementLimitForSingleDelete = 2048;
   uint64_t elementLimitForSingleDeleteZset = 1024;
+  // a new hash/set/zset takes a version which is embedded in the keys of
+  // its elements, deleting a big one then deletes only its meta, and the
+  // elements are dropped by the compaction filter. Off, the elements keep
+  // the old layout(version 0). The versioned keys are read either way, so
+  // it can be turned off again, but a binary without versioning can't read
+  // them: rolling back to it, or replicating to it, needs them rewritten
+  // first. ZCONVERT needs it.
+  bool versionedKeys = false;
 
   uint32_t protoMaxBulkLen = CONFIG_DEFAULT_PROTO_MAX_BULK_LEN;
   uint32_t dbNum = CONFIG_DEFAULT_DBNUM;
 
   bool noexpire = false;
   bool noexpireBlob = false;
+  // The txns maintain the key counters of the data chunks, see
+  // KVStore::isKeyCountReady(). NOTE: the counters are written by a merge
+  // operator, the versions before it can't compact them. To downgrade,
+  // disable it, restart and compact the stores fully first.
+  bool keyCountEnabled = false;
+  // DBSIZE reads the key counters instead of scanning the keys, the
+  // expired keys not deleted yet are counted as redis does.
+  bool dbsizeByKeyCount = false;
   uint64_t maxBinlogKeepNum = 1;
   uint32_t minBinlogKeepSec = 3600;
   uint64_t slaveBinlogKeepNum = 1;
@@ -492,6 +511,9 @@ class ServerParams {
   uint64_t slowlogLogSlowerThan = CONFIG_DEFAULT_SLOWLOG_LOG_SLOWER_THAN;
   uint64_t slowlogMaxLen = CONFIG_DEFAULT_SLOWLOG_LOG_MAX_LEN;
   uint64_t novadbLatencyLimit = 0;   // us
+  // keep latency histograms of the commands, locks, rocksdb ops, worker
+  // pool queues and replies, see INFO latencystats and LATENCY HISTOGRAM
+  bool latencyTracking = true;
   uint64_t rocksdbLatencyLimit = 0;  // us
   bool slowlogFileEnabled = true;
   bool binlogUsingDefaultCF = false;
@@ -510,6 +532,14 @@ class ServerParams {
   uint32_t executorThreadNum = 0;
   uint32_t executorWorkPoolSize = 0;
   bool simpleWorkPoolName = false;
+  // the buffered commands of a client pipeline are executed as one batch,
+  // with their replies flushed by one write. Consecutive readonly commands
+  // of a batch reuse their transactions.
+  bool pipelineBatchEnabled = true;
+  // run the cheap single-key reads(CMD_INLINE) on the network io thread
+  // if their keys are in the memtables or the block cache, skipping the
+  // hops to and from the worker pool.
+  bool inlineReadEnabled = false;
 
   uint32_t binlogRateLimitMB = 64;
   uint32_t netBatchSize = 1024 * 1024;
@@ -517,17 +547,57 @@ class ServerParams {
   uint32_t timeoutSecBinlogWaitRsp = 3;
   uint32_t incrPushThreadnum = 10;
   uint32_t fullPushThreadnum = 5;
+  // fullsync sends each file in one piece by sendfile instead of waiting
+  // for a reply per batch, the slave verifies the sst files by their block
+  // checksums. The master must support it.
+  bool fullSyncStreaming = false;
+  // the connections a streaming fullsync sends the files concurrently by
+  uint32_t fullSyncStreams = 4;
   uint32_t fullReceiveThreadnum = 5;
   uint32_t logRecycleThreadnum = 5;
+  // a slave applies the binlogs of a store by binlogApplyThreadnum + 1
+  // lanes keyed by chunk id, 0 applies them one by one
+  uint32_t binlogApplyThreadnum = 0;
   uint32_t truncateBinlogIntervalMs = 1000;
   uint32_t truncateBinlogNum = 10000;
   uint32_t binlogFileSizeMB = 64;
   uint32_t binlogFileSecs = 20 * 60;
 
+  // multi-key reads(mget, exists...) fan out their per-kvstore batched
+  // lookups to a dedicated pool if there are at least
+  // batchReadParallelKeys keys. batchReadThreadNum = 0 disables it.
+  uint32_t batchReadThreadNum = 4;
+  uint32_t batchReadParallelKeys = 64;
+  // KEYS and SCAN scan the kvstores in parallel on a dedicated pool,
+  // scanThreadNum = 0 scans them one by one in the worker thread.
+  uint32_t scanThreadNum = 4;
+  // decoded-value cache of the hot keys in front of rocksdb, shared by all
+  // the kvstores, 0 disables it
+  uint32_t valueCacheMB = 0;
+  // the metas looked up by the ttl compaction filter for the subkeys,
+  // shared by all the kvstores, 0 makes every lookup read rocksdb
+  uint32_t compactionMetaCacheMB = 16;
+  // the recently committed binlogs kept in memory for pushing them to the
+  // slaves, shared by all the kvstores, 0 disables it
+  uint32_t binlogRingMB = 64;
+  // a new hash keeps its fields inline in its meta record until it has
+  // more than hashMaxCompactEntries fields or a field or value longer than
+  // hashMaxCompactValue bytes. hashMaxCompactEntries = 0 disables it.
+  uint32_t hashMaxCompactEntries = 0;
+  uint32_t hashMaxCompactValue = 64;
+
   uint32_t keysDefaultLimit = 100;
   uint32_t lockWaitTimeOut = 3600;
   uint32_t lockDbXWaitTimeout = 1;
   bool ignoreKeyLock = false;  // only for test
+  // use mgl::ShardedMGLockMgr instead of mgl::MGLockMgr,
+  // lockMgrShardNum = 0 means 16 shards per core
+  bool lockMgrSharded = false;
+  uint32_t lockMgrShardNum = 0;
+
+  // the encoding of the new zsets, "skiplist" or "ordered", see
+  // ZSlMetaValue::Encoding. ZCONVERT rewrites an existing zset with it.
+  std::string zsetEncoding = "skiplist";
 
   // parameter for scan command
   uint32_t scanDefaultLimit = 10;
@@ -609,6 +679,22 @@ class ServerParams {
   // Dynamically changeable through 'config set cluster-migration-timeout'
   uint32_t migrateNetworkTimeout = 5;  // second
 
+  // The destination node asks the source node to send the snapshot as sst
+  // files, which are ingested without binlog. It's refused while the
+  // destination store has slaves, the snapshot is sent by batches then.
+  // Dynamically changeable through 'config set cluster-migration-sst'
+  bool migrateSnapshotSst = false;
+
+  // The destination node asks the source node to compress the snapshot
+  // batches by lz4.
+  // Dynamically changeable through 'config set cluster-migration-compress'
+  bool migrateSnapshotCompress = false;
+
+  // The number of slots the source node sends ahead of the destination's
+  // acknowledgements, 0 waits for each slot.
+  // Dynamically changeable through 'config set cluster-migration-window'
+  uint32_t migrateSnapshotWindow = 16;
+
   uint32_t clusterNodeTimeout = 15000;
   bool clusterRequireFullCoverage = true;
   bool clusterSlaveNoFailover = false;
@@ -33,6 +33,20 @@ class Session : public std::enable_shared_from_this<Session> {
   virtual ~Session();
   uint64_t id() const;
   virtual Status setResponse(const std::string& s) = 0;
+  // same as setResponse(), but the session may take over s instead of
+  // copying it, s is left in a valid but unspecified state
+  virtual Status takeResponse(std::string&& s) {
+    return setResponse(s);
+  }
+  // same as takeResponse() for the concatenation of pieces: the pieces are
+  // taken all or none, so a reply split into pieces is never cut short
+  virtual Status takeResponses(std::vector<std::string>&& pieces) {
+    std::string s;
+    for (const auto& piece : pieces) {
+      s.append(piece);
+    }
+    return setResponse(s);
+  }
   // only for unittest
   virtual std::vector<std::string> getResponse() {
     return std::vector<std::string>();
@@ -80,6 +94,10 @@ class Session : public std::enable_shared_from_this<Session> {
   bool isInLua() {
     return _inLua;
   }
+  // running a command on the network io thread, see NetSession
+  virtual bool isOnIoThread() const {
+    return false;
+  }
 
   virtual Status memLimitRequest(uint64_t sizeUsed) {
     return {};
@@ -303,6 +303,9 @@ Status Catalog::setStoreMainMeta(const StoreMainMeta& meta) {
   writer.Key("id");
   writer.Uint64(meta.id);
 
+  writer.Key("fullSyncBinlogId");
+  writer.Uint64(meta.fullSyncBinlogId);
+
   writer.EndObject();
 
   RecordValue rv(sb.GetString(), RecordType::RT_META, -1);
@@ -359,6 +362,11 @@ Expected<std::unique_ptr<StoreMainMeta>> Catalog::getStoreMainMeta(
   result->storeMode =
     static_cast<KVStore::StoreMode>(doc["storeMode"].GetUint64());
 
+  if (doc.HasMember("fullSyncBinlogId")) {
+    INVARIANT(doc["fullSyncBinlogId"].IsUint64());
+    result->fullSyncBinlogId = doc["fullSyncBinlogId"].GetUint64();
+  }
+
   return result;
 }
 
@@ -78,11 +78,14 @@ class StoreMainMeta {
   StoreMainMeta(const StoreMainMeta&) = default;
   StoreMainMeta(StoreMainMeta&&) = delete;
   StoreMainMeta(uint32_t id_, KVStore::StoreMode mode_)
-    : id(id_), storeMode(mode_) {}
+    : id(id_), storeMode(mode_), fullSyncBinlogId(0) {}
   std::unique_ptr<StoreMainMeta> copy() const;
 
   uint32_t id;
   KVStore::StoreMode storeMode;
+  // the slaves that have not applied this binlog can't incrsync, see
+  // ReplManager::beginWriteWithoutBinlog()
+  uint64_t fullSyncBinlogId;
 };
 
 // store meta
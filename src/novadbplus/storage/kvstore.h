@@ -239,6 +239,9 @@ class Transaction {
   virtual std::string getKVStoreId() const = 0;
   virtual void setChunkId(uint32_t chunkId) = 0;
   virtual void SetSnapshot() = 0;
+  // re-take the read view of a txn which has written nothing, so that it
+  // can be reused later as if it was newly created.
+  virtual void refreshSnapshot() = 0;
 
   virtual std::unique_ptr<TTLIndexCursor> createTTLIndexCursor(
     std::uint64_t until) = 0;
@@ -247,10 +250,19 @@ class Transaction {
                                                          uint32_t end) = 0;
   virtual std::unique_ptr<VersionMetaCursor> createVersionMetaCursor() = 0;
   virtual std::unique_ptr<BasicDataCursor> createDataCursor() = 0;
+  // a data cursor which stops before upperBound, for reading a short,
+  // known key range with one seek; readaheadSize 0 keeps the default.
+  // NOTE: a txn keeps only one upper bound, don't hold two of them.
+  virtual std::unique_ptr<BasicDataCursor> createRangeDataCursor(
+    const std::string& upperBound, size_t readaheadSize = 0) = 0;
   virtual std::unique_ptr<AllDataCursor> createAllDataCursor() = 0;
   virtual std::unique_ptr<BinlogCursor> createBinlogCursor() = 0;
 
   virtual Expected<std::string> getKV(const std::string& key) = 0;
+  // batched getKV() on the data column family, the result of keys[i]
+  // is returned at index i
+  virtual std::vector<Expected<std::string>> multiGetKV(
+    const std::vector<std::string>& keys) = 0;
   virtual Status setKV(const std::string& key,
                        const std::string& val,
                        const uint64_t ts = 0) = 0;
@@ -267,7 +279,9 @@ class Transaction {
 
  protected:
   virtual std::unique_ptr<Cursor> createCursor(
-    ColumnFamilyNumber cf, const std::string* iterate_upper_bound = NULL) = 0;
+    ColumnFamilyNumber cf,
+    const std::string* iterate_upper_bound = NULL,
+    size_t readahead_size = 0) = 0;
 
  public:
   static constexpr uint64_t MAX_VALID_TXNID =
@@ -314,17 +328,24 @@ class BackupInfo {
 class BinlogObserver {
  public:
   virtual ~BinlogObserver() = default;
+  // called when the highest visible binlogId of the store moves forward.
+  // the store's mutex is held, so it should be cheap and never call back
+  // into the store.
+  virtual void onCommitted(uint64_t binlogId) = 0;
 };
 
 struct KVStoreStat {
   KVStoreStat()
     : compactFilterCount(0),
       compactKvExpiredCount(0),
+      compactSubKeyExpiredCount(0),
       pausedErrorCount(0),
       destroyedErrorCount(0) {}
 
   std::atomic<uint64_t> compactFilterCount;
   std::atomic<uint64_t> compactKvExpiredCount;
+  // subkeys dropped because their meta is deleted, expired or rewritten
+  std::atomic<uint64_t> compactSubKeyExpiredCount;
   // number of request when store is paused
   std::atomic<uint64_t> pausedErrorCount;
   // number of request when store is destroyed
@@ -375,9 +396,20 @@ class KVStore {
   const std::string dftBackupDir() const {
     return _backupDir;
   }
+  // the sst files of slot migration are created here, on the same
+  // filesystem as the db, so that they can be moved into it.
+  const std::string migrateSstDir() const {
+    return _dbPath + "/" + _id + "_migrate";
+  }
   virtual Expected<std::unique_ptr<Transaction>> createTransaction(
     Session* sess) = 0;
   virtual Expected<RecordValue> getKV(const RecordKey&, Transaction* txn) = 0;
+  virtual std::vector<Expected<RecordValue>> multiGetKV(
+    const std::vector<RecordKey>& keys, Transaction* txn) = 0;
+  // whether key can be looked up(found or not) without any disk io, it
+  // never blocks on io itself. value is set to the value of key, or
+  // ERR_NOTFOUND.
+  virtual bool probeKV(const RecordKey& key, Expected<RecordValue>* value) = 0;
   virtual Status setKV(const RecordKey&, const RecordValue&, Transaction*) = 0;
   virtual Status delKV(const RecordKey&, Transaction*) = 0;
 
@@ -410,6 +442,35 @@ class KVStore {
     const std::string& end,
     bool include_end = false) = 0;
 
+  // write the records of slots [begin, end) seen by txn into the sst file
+  // fname, return the number of records. the file is not created if there
+  // is no record.
+  virtual Expected<uint64_t> createSlotsSstFile(Transaction* txn,
+                                                uint32_t begin,
+                                                uint32_t end,
+                                                const std::string& fname) = 0;
+  // verify the checksums of the sst files and move them into the data
+  // column family. NOTE: the records are not written into binlog.
+  virtual Status ingestSstFiles(const std::vector<std::string>& files) = 0;
+
+  // the keys of the data chunks are counted per (chunk, dbid) in the txns
+  // writing them. the expired keys not deleted yet are counted too. the
+  // counters can't be trusted before isKeyCountReady(), e.g. the store was
+  // written by an older version.
+  virtual bool isKeyCountReady() const = 0;
+  // chunkid -> the number of keys in dbId, the empty chunks are omitted
+  virtual Expected<std::map<uint32_t, uint64_t>> getKeyCounts(
+    uint32_t dbId) = 0;
+  // the number of keys in chunkId of all the dbs
+  virtual Expected<uint64_t> getChunkKeyCount(uint32_t chunkId) = 0;
+  // the txns count the keys from now on, call it before recounting all the
+  // chunks of a store which is not ready.
+  virtual void startKeyCount() = 0;
+  // count the keys of chunkId again, the caller should make sure nobody
+  // writes the chunk meanwhile.
+  virtual Status recountKeys(uint32_t chunkId) = 0;
+  virtual Status setKeyCountReady() = 0;
+
   // [begin, end]
   // [nullptr, nullptr] -> [-inf, +inf]
   virtual Status compactRange(ColumnFamilyNumber cf,
@@ -426,6 +487,11 @@ class KVStore {
   virtual Status assignBinlogIdIfNeeded(Transaction* txn) = 0;
   virtual void setNextBinlogSeq(uint64_t binlogId, Transaction* txn) = 0;
   virtual uint64_t getNextBinlogSeq() const = 0;
+  // the committed binlogs in (binlogPos, getHighestBinlogId()] which are
+  // kept in memory, at most maxCount of them or about maxBytes.
+  // ERR_NOTFOUND if they have to be read from the binlog cursor.
+  virtual Expected<std::vector<ReplLogRawV2>> getRecentBinlogs(
+    uint64_t binlogPos, uint32_t maxCount, size_t maxBytes) = 0;
   static std::unique_ptr<std::ofstream> createBinlogFile(
     const std::string& name, uint32_t storeId);
   virtual Expected<TruncateBinlogResult> truncateBinlogV2(
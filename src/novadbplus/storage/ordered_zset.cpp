@@ -0,0 +1,872 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "novadbplus/storage/ordered_zset.h"
+#include "novadbplus/storage/varint.h"
+#include "novadbplus/utils/invariant.h"
+
+namespace novadbplus {
+
+static const char SCORE_TAG = 's';
+static const char INDEX_TAG = 'r';
+// a bound is BOUND_KEY + score + member, BOUND_MIN and BOUND_MAX sort
+// before and after all of them
+static const char BOUND_MIN = '\x00';
+static const char BOUND_KEY = '\x01';
+static const char BOUND_MAX = '\x02';
+
+// the doubles sort as the unsigned integers they are mapped to
+static uint64_t sortableScore(double score) {
+  // -0 equals 0
+  if (score == 0) {
+    score = 0;
+  }
+  uint64_t u;
+  memcpy(&u, &score, sizeof(u));
+  return (u >> 63) ? ~u : (u | (1ULL << 63));
+}
+
+static double scoreFromSortable(uint64_t u) {
+  u = (u >> 63) ? (u & ~(1ULL << 63)) : ~u;
+  double score;
+  memcpy(&score, &u, sizeof(score));
+  return score;
+}
+
+// the bound before all the members of score, or after them if after is true
+static std::string scoreBound(double score, bool after) {
+  std::string bound(1 + sizeof(uint64_t), BOUND_KEY);
+  int64Encode(&bound[1], sortableScore(score) + (after ? 1 : 0));
+  return bound;
+}
+
+// the member is escaped and terminated by "\x00\x00", so the bounds keep the
+// order of the members and none of them is a prefix of another one
+static std::string memberBound(double score, const std::string& member) {
+  std::string bound = scoreBound(score, false);
+  bound.reserve(bound.size() + member.size() + 2);
+  for (char c : member) {
+    bound.push_back(c);
+    if (c == '\x00') {
+      bound.push_back('\xff');
+    }
+  }
+  bound.append(2, '\x00');
+  return bound;
+}
+
+static Expected<std::pair<double, std::string>> decodeMemberBound(
+  const std::string& bound) {
+  if (bound.size() < 1 + sizeof(uint64_t) + 2 || bound[0] != BOUND_KEY) {
+    return {ErrorCodes::ERR_DECODE, "invalid zset member bound"};
+  }
+  double score = scoreFromSortable(int64Decode(bound.data() + 1));
+  std::string member;
+  member.reserve(bound.size() - 1 - sizeof(uint64_t) - 2);
+  for (size_t i = 1 + sizeof(uint64_t); i < bound.size() - 2; ++i) {
+    member.push_back(bound[i]);
+    if (bound[i] == '\x00') {
+      ++i;
+    }
+  }
+  return std::make_pair(score, std::move(member));
+}
+
+static std::string levelTag(uint8_t level) {
+  if (level == 0) {
+    return std::string(1, SCORE_TAG);
+  }
+  return std::string{INDEX_TAG, static_cast<char>(level)};
+}
+
+OrderedZset::OrderedZset(uint32_t chunkId,
+                         uint32_t dbId,
+                         const std::string& pk,
+                         const ZSlMetaValue& meta,
+                         PStore store,
+                         uint64_t version)
+  : _count(meta.getCount()),
+    _height(meta.getIndexHeight()),
+    _topCount(meta.getIndexTopCount()),
+    _chunkId(chunkId),
+    _dbId(dbId),
+    _pk(pk),
+    _version(version),
+    _store(store) {
+  INVARIANT_D(meta.getEncoding() == ZSlMetaValue::Encoding::ENCODING_ORDERED);
+  INVARIANT_D(_height >= 1 && _topCount >= 1);
+}
+
+Expected<ZSlMetaValue> OrderedZset::init(const RecordKey& mk,
+                                         uint64_t version,
+                                         PStore store,
+                                         Transaction* txn) {
+  Block block{0, 0, std::string(1, BOUND_MIN), std::string(1, BOUND_MAX)};
+  RecordKey rk(mk.getChunkId(),
+               mk.getDbId(),
+               RecordType::RT_ZSET_S_ELE,
+               mk.getPrimaryKey(),
+               levelTag(1) + block.bound,
+               version);
+  RecordValue rv(encodeBlock(block), RecordType::RT_ZSET_S_ELE, -1);
+  Status s = store->setKV(rk, rv, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return ZSlMetaValue(ZSlMetaValue::Encoding::ENCODING_ORDERED, 1, 1, 1);
+}
+
+std::string OrderedZset::encodeBlock(const Block& block) {
+  std::string value = varintEncodeStr(block.count);
+  value.append(varintEncodeStr(block.children));
+  value.append(block.lower);
+  return value;
+}
+
+Expected<OrderedZset::Block> OrderedZset::decodeBlock(
+  const std::string& bound, const std::string& value) {
+  auto p = reinterpret_cast<const uint8_t*>(value.data());
+  size_t size = value.size();
+  auto eCount = varintDecodeFwd(p, size);
+  if (!eCount.ok()) {
+    return eCount.status();
+  }
+  p += eCount.value().second;
+  size -= eCount.value().second;
+  auto eChildren = varintDecodeFwd(p, size);
+  if (!eChildren.ok()) {
+    return eChildren.status();
+  }
+  size -= eChildren.value().second;
+  return Block{eCount.value().first,
+               eChildren.value().first,
+               value.substr(value.size() - size),
+               bound};
+}
+
+Status OrderedZset::scanLevel(uint8_t level,
+                              const std::string& from,
+                              const Visitor& fn,
+                              Transaction* txn) {
+  const std::string tag = levelTag(level);
+  const std::string start = tag + from;
+  RecordKey fake(
+    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, "", _version);
+  const std::string prefix = fake.prefixPk();
+  auto cursor = txn->createDataCursor();
+  cursor->seek(prefix + start);
+
+  std::string storeKey;
+  std::string storeValue;
+  // read the next subkey of the level from the store, false if none
+  auto readStore = [&]() -> Expected<bool> {
+    while (true) {
+      Expected<Record> eRcd = cursor->next();
+      if (eRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+        return false;
+      }
+      if (!eRcd.ok()) {
+        return eRcd.status();
+      }
+      const RecordKey& rk = eRcd.value().getRecordKey();
+      if (rk.prefixPk() != prefix) {
+        return false;
+      }
+      const std::string& subkey = rk.getSecondaryKey();
+      if (subkey.compare(0, tag.size(), tag) != 0) {
+        return false;
+      }
+      // NOTE: the trailer of the keys may put a smaller subkey after the
+      // seek position
+      if (subkey < start) {
+        continue;
+      }
+      storeKey = subkey;
+      storeValue = eRcd.value().getRecordValue().getValue();
+      return true;
+    }
+  };
+
+  auto eHasStore = readStore();
+  if (!eHasStore.ok()) {
+    return eHasStore.status();
+  }
+  bool hasStore = eHasStore.value();
+  auto it = _changes.lower_bound(start);
+  while (true) {
+    bool hasChange =
+      it != _changes.end() && it->first.compare(0, tag.size(), tag) == 0;
+    if (!hasStore && !hasChange) {
+      break;
+    }
+    // the unsaved change of a subkey takes the place of the store
+    bool fromStore = hasStore && (!hasChange || storeKey < it->first);
+    if (fromStore || !it->second.deleted) {
+      const std::string& subkey = fromStore ? storeKey : it->first;
+      const std::string& value = fromStore ? storeValue : it->second.value;
+      auto eMore = fn(subkey.substr(tag.size()), value);
+      if (!eMore.ok()) {
+        return eMore.status();
+      }
+      if (!eMore.value()) {
+        break;
+      }
+    }
+    if (!fromStore) {
+      if (hasStore && storeKey == it->first) {
+        fromStore = true;
+      }
+      ++it;
+    }
+    if (fromStore) {
+      eHasStore = readStore();
+      if (!eHasStore.ok()) {
+        return eHasStore.status();
+      }
+      hasStore = eHasStore.value();
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<OrderedZset::Block> OrderedZset::findBlock(uint8_t level,
+                                                    const std::string& bound,
+                                                    Transaction* txn) {
+  Expected<Block> found = {ErrorCodes::ERR_INTERNAL,
+                           "zset index record not found"};
+  Status s = scanLevel(
+    level,
+    bound,
+    [&found](const std::string& b, const std::string& v) -> Expected<bool> {
+      found = decodeBlock(b, v);
+      return false;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return found;
+}
+
+void OrderedZset::putRecord(uint8_t level,
+                            const std::string& bound,
+                            const std::string& value) {
+  _changes[levelTag(level) + bound] = Change{false, value};
+}
+
+void OrderedZset::delRecord(uint8_t level, const std::string& bound) {
+  _changes[levelTag(level) + bound] = Change{true, ""};
+}
+
+Status OrderedZset::updateIndex(const std::string& bound,
+                                int64_t delta,
+                                Transaction* txn) {
+  const std::string maxBound(1, BOUND_MAX);
+  // the change of the children of the record of the next level, the
+  // children of level 1 are the members
+  int64_t childDelta = delta;
+  // the bound of an empty record of the previous level
+  std::string empty;
+  for (uint8_t level = 1; level <= _height; ++level) {
+    auto eBlock = findBlock(level, bound, txn);
+    if (!eBlock.ok()) {
+      return eBlock.status();
+    }
+    Block& block = eBlock.value();
+    // the last child of a record keeps its bound, so it is left to the
+    // parent, and deleted with it
+    if (!empty.empty() && empty != block.bound) {
+      Status s = delEmptyBlock(level - 1, empty, txn);
+      if (!s.ok()) {
+        return s;
+      }
+      childDelta -= 1;
+    }
+    empty.clear();
+
+    block.count += delta;
+    block.children += childDelta;
+    childDelta = 0;
+    if (block.children > MAX_CHILDREN) {
+      Status s = splitBlock(level, &block, txn);
+      if (!s.ok()) {
+        return s;
+      }
+      childDelta = 1;
+    } else {
+      putRecord(level, block.bound, encodeBlock(block));
+      if (block.count == 0 && block.bound != maxBound) {
+        empty = block.bound;
+      }
+    }
+  }
+
+  if (!empty.empty()) {
+    Status s = delEmptyBlock(_height, empty, txn);
+    if (!s.ok()) {
+      return s;
+    }
+    --_topCount;
+  }
+  if (childDelta > 0) {
+    ++_topCount;
+    if (_topCount > MAX_CHILDREN) {
+      Block top{_count - 1,
+                _topCount,
+                std::string(1, BOUND_MIN),
+                std::string(1, BOUND_MAX)};
+      ++_height;
+      Status s = splitBlock(_height, &top, txn);
+      if (!s.ok()) {
+        return s;
+      }
+      _topCount = 2;
+    }
+  }
+  while (_height > 1 && _topCount == 1) {
+    auto eTop = findBlock(_height, maxBound, txn);
+    if (!eTop.ok()) {
+      return eTop.status();
+    }
+    delRecord(_height, maxBound);
+    --_height;
+    _topCount = eTop.value().children;
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status OrderedZset::splitBlock(uint8_t level, Block* block, Transaction* txn) {
+  const uint64_t half = block->children / 2;
+  uint64_t seen = 0;
+  uint64_t count = 0;
+  std::string mid;
+  Status s = scanLevel(
+    level - 1,
+    block->lower,
+    [&](const std::string& b, const std::string& v) -> Expected<bool> {
+      if (b == block->lower) {
+        return true;
+      }
+      if (level == 1) {
+        ++count;
+      } else {
+        auto eChild = decodeBlock(b, v);
+        if (!eChild.ok()) {
+          return eChild.status();
+        }
+        count += eChild.value().count;
+      }
+      mid = b;
+      return ++seen < half;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  INVARIANT_D(seen == half);
+
+  Block left{count, half, block->lower, mid};
+  block->count -= count;
+  block->children -= half;
+  block->lower = mid;
+  putRecord(level, left.bound, encodeBlock(left));
+  putRecord(level, block->bound, encodeBlock(*block));
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+// The record is not the last child of its parent, so its successor is a
+// sibling and takes over its range. The only child left of an empty record
+// is its last one, which has the same bound, and goes away the same way.
+Status OrderedZset::delEmptyBlock(uint8_t level,
+                                  const std::string& bound,
+                                  Transaction* txn) {
+  for (; level >= 1; --level) {
+    auto eBlock = findBlock(level, bound, txn);
+    if (!eBlock.ok()) {
+      return eBlock.status();
+    }
+    INVARIANT_D(eBlock.value().bound == bound &&
+                eBlock.value().count == 0 && eBlock.value().children <= 1);
+    delRecord(level, bound);
+    auto eNext = findBlock(level, bound, txn);
+    if (!eNext.ok()) {
+      return eNext.status();
+    }
+    eNext.value().lower = eBlock.value().lower;
+    putRecord(level, eNext.value().bound, encodeBlock(eNext.value()));
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status OrderedZset::insert(double score,
+                           const std::string& subkey,
+                           Transaction* txn) {
+  if (_count >= std::numeric_limits<int32_t>::max() / 2) {
+    return {ErrorCodes::ERR_INTERNAL, "zset count reach limit"};
+  }
+  const std::string bound = memberBound(score, subkey);
+  putRecord(0, bound, "");
+  ++_count;
+  return updateIndex(bound, 1, txn);
+}
+
+Status OrderedZset::insertBatch(
+  const std::vector<std::pair<double, std::string>>& members,
+  Transaction* txn) {
+  for (const auto& member : members) {
+    Status s = insert(member.first, member.second, txn);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status OrderedZset::remove(double score,
+                           const std::string& subkey,
+                           Transaction* txn) {
+  INVARIANT_D(_count > 1);
+  const std::string bound = memberBound(score, subkey);
+  delRecord(0, bound);
+  --_count;
+  return updateIndex(bound, -1, txn);
+}
+
+Expected<uint32_t> OrderedZset::countBefore(const std::string& bound,
+                                            Transaction* txn) {
+  uint32_t count = 0;
+  std::string lower(1, BOUND_MIN);
+  for (uint8_t level = _height; level >= 1; --level) {
+    std::string next;
+    Status s = scanLevel(
+      level,
+      lower,
+      [&](const std::string& b, const std::string& v) -> Expected<bool> {
+        if (b == lower) {
+          return true;
+        }
+        auto eBlock = decodeBlock(b, v);
+        if (!eBlock.ok()) {
+          return eBlock.status();
+        }
+        if (b < bound) {
+          count += eBlock.value().count;
+          return true;
+        }
+        next = eBlock.value().lower;
+        return false;
+      },
+      txn);
+    if (!s.ok()) {
+      return s;
+    }
+    // the record of BOUND_MAX covers any bound
+    INVARIANT_D(!next.empty());
+    lower = next;
+  }
+  Status s = scanLevel(
+    0,
+    lower,
+    [&](const std::string& b, const std::string&) -> Expected<bool> {
+      if (b == lower) {
+        return true;
+      }
+      if (b < bound) {
+        ++count;
+        return true;
+      }
+      return false;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return count;
+}
+
+Expected<std::list<std::pair<double, std::string>>> OrderedZset::scanFromRank(
+  uint64_t rank, uint64_t cnt, Transaction* txn) {
+  std::list<std::pair<double, std::string>> result;
+  if (rank >= _count - 1 || cnt == 0) {
+    return result;
+  }
+  uint64_t skipped = 0;
+  std::string lower(1, BOUND_MIN);
+  for (uint8_t level = _height; level >= 1; --level) {
+    std::string next;
+    Status s = scanLevel(
+      level,
+      lower,
+      [&](const std::string& b, const std::string& v) -> Expected<bool> {
+        if (b == lower) {
+          return true;
+        }
+        auto eBlock = decodeBlock(b, v);
+        if (!eBlock.ok()) {
+          return eBlock.status();
+        }
+        if (skipped + eBlock.value().count <= rank) {
+          skipped += eBlock.value().count;
+          return true;
+        }
+        next = eBlock.value().lower;
+        return false;
+      },
+      txn);
+    if (!s.ok()) {
+      return s;
+    }
+    INVARIANT_D(!next.empty());
+    lower = next;
+  }
+  Status s = scanLevel(
+    0,
+    lower,
+    [&](const std::string& b, const std::string&) -> Expected<bool> {
+      if (b == lower) {
+        return true;
+      }
+      if (skipped < rank) {
+        ++skipped;
+        return true;
+      }
+      auto eMember = decodeMemberBound(b);
+      if (!eMember.ok()) {
+        return eMember.status();
+      }
+      result.emplace_back(std::move(eMember.value()));
+      return result.size() < cnt;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return result;
+}
+
+Expected<std::list<std::pair<double, std::string>>> OrderedZset::scanBetween(
+  const std::string& from,
+  const std::string& to,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  std::list<std::pair<double, std::string>> result;
+  if (from >= to || limit == 0) {
+    return result;
+  }
+  if (rev) {
+    // count the range, and read it forward from its rank
+    auto eFirst = countBefore(from, txn);
+    if (!eFirst.ok()) {
+      return eFirst.status();
+    }
+    auto eLast = countBefore(to, txn);
+    if (!eLast.ok()) {
+      return eLast.status();
+    }
+    uint64_t n = eLast.value() - eFirst.value();
+    if (offset >= n) {
+      return result;
+    }
+    uint64_t cnt = std::min(limit, n - offset);
+    auto eResult = scanFromRank(eLast.value() - offset - cnt, cnt, txn);
+    if (!eResult.ok()) {
+      return eResult.status();
+    }
+    result = std::move(eResult.value());
+    result.reverse();
+    return result;
+  }
+  Status s = scanLevel(
+    0,
+    from,
+    [&](const std::string& b, const std::string&) -> Expected<bool> {
+      if (b >= to) {
+        return false;
+      }
+      if (offset > 0) {
+        --offset;
+        return true;
+      }
+      auto eMember = decodeMemberBound(b);
+      if (!eMember.ok()) {
+        return eMember.status();
+      }
+      result.emplace_back(std::move(eMember.value()));
+      return result.size() < limit;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return result;
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+OrderedZset::removeBetween(const std::string& from,
+                           const std::string& to,
+                           Transaction* txn) {
+  auto eResult = scanBetween(
+    from, to, 0, std::numeric_limits<uint64_t>::max(), false, txn);
+  if (!eResult.ok()) {
+    return eResult.status();
+  }
+  for (const auto& member : eResult.value()) {
+    Status s = remove(member.first, member.second, txn);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return eResult;
+}
+
+// Like redis, the members of a lex range are expected to have the same
+// score, which is taken from the first member.
+Expected<bool> OrderedZset::lexBounds(const Zlexrangespec& range,
+                                      std::string* from,
+                                      std::string* to,
+                                      Transaction* txn) {
+  std::string first;
+  Status s = scanLevel(
+    0,
+    std::string(1, BOUND_MIN),
+    [&first](const std::string& b, const std::string&) -> Expected<bool> {
+      first = b;
+      return false;
+    },
+    txn);
+  if (!s.ok()) {
+    return s;
+  }
+  if (first.empty()) {
+    return false;
+  }
+  auto eFirst = decodeMemberBound(first);
+  if (!eFirst.ok()) {
+    return eFirst.status();
+  }
+  double score = eFirst.value().first;
+
+  if (range.min == ZLEXMIN) {
+    *from = scoreBound(score, false);
+  } else if (range.min == ZLEXMAX) {
+    *from = scoreBound(score, true);
+  } else {
+    *from = memberBound(score, range.min);
+    if (range.minex) {
+      from->push_back('\x00');
+    }
+  }
+  if (range.max == ZLEXMAX) {
+    *to = scoreBound(score, true);
+  } else if (range.max == ZLEXMIN) {
+    *to = scoreBound(score, false);
+  } else {
+    *to = memberBound(score, range.max);
+    if (!range.maxex) {
+      to->push_back('\x00');
+    }
+  }
+  return *from < *to;
+}
+
+Expected<uint32_t> OrderedZset::rank(double score,
+                                     const std::string& subkey,
+                                     Transaction* txn) {
+  auto eCount = countBefore(memberBound(score, subkey), txn);
+  if (!eCount.ok()) {
+    return eCount.status();
+  }
+  return eCount.value() + 1;
+}
+
+Expected<uint32_t> OrderedZset::countInRange(const Zrangespec& range,
+                                             Transaction* txn) {
+  std::string from = scoreBound(range.min, range.minex);
+  std::string to = scoreBound(range.max, !range.maxex);
+  if (from >= to) {
+    return 0;
+  }
+  auto eFirst = countBefore(from, txn);
+  if (!eFirst.ok()) {
+    return eFirst.status();
+  }
+  auto eLast = countBefore(to, txn);
+  if (!eLast.ok()) {
+    return eLast.status();
+  }
+  return eLast.value() - eFirst.value();
+}
+
+Expected<uint32_t> OrderedZset::countInLexRange(const Zlexrangespec& range,
+                                                Transaction* txn) {
+  std::string from, to;
+  auto eBounds = lexBounds(range, &from, &to, txn);
+  if (!eBounds.ok()) {
+    return eBounds.status();
+  }
+  if (!eBounds.value()) {
+    return 0;
+  }
+  auto eFirst = countBefore(from, txn);
+  if (!eFirst.ok()) {
+    return eFirst.status();
+  }
+  auto eLast = countBefore(to, txn);
+  if (!eLast.ok()) {
+    return eLast.status();
+  }
+  return eLast.value() - eFirst.value();
+}
+
+Expected<std::list<std::pair<double, std::string>>> OrderedZset::scanByLex(
+  const Zlexrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  std::string from, to;
+  auto eBounds = lexBounds(range, &from, &to, txn);
+  if (!eBounds.ok()) {
+    return eBounds.status();
+  }
+  if (!eBounds.value()) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  return scanBetween(from, to, offset, limit, rev, txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>> OrderedZset::scanByRank(
+  int64_t start, int64_t len, bool rev, Transaction* txn) {
+  INVARIANT_D(start >= 0 && len >= 0 && start + len <= _count - 1);
+  if (!rev) {
+    return scanFromRank(start, len, txn);
+  }
+  auto eResult = scanFromRank(_count - 1 - start - len, len, txn);
+  if (!eResult.ok()) {
+    return eResult.status();
+  }
+  eResult.value().reverse();
+  return eResult;
+}
+
+Expected<std::list<std::pair<double, std::string>>> OrderedZset::scanByScore(
+  const Zrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  return scanBetween(scoreBound(range.min, range.minex),
+                     scoreBound(range.max, !range.maxex),
+                     offset,
+                     limit,
+                     rev,
+                     txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+OrderedZset::removeRangeByScore(const Zrangespec& range, Transaction* txn) {
+  return removeBetween(scoreBound(range.min, range.minex),
+                       scoreBound(range.max, !range.maxex),
+                       txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+OrderedZset::removeRangeByLex(const Zlexrangespec& range, Transaction* txn) {
+  std::string from, to;
+  auto eBounds = lexBounds(range, &from, &to, txn);
+  if (!eBounds.ok()) {
+    return eBounds.status();
+  }
+  if (!eBounds.value()) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  return removeBetween(from, to, txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+OrderedZset::removeRangeByRank(uint32_t start,
+                               uint32_t end,
+                               Transaction* txn) {
+  INVARIANT_D(start >= 1 && start <= end);
+  auto eResult = scanFromRank(start - 1, end - start + 1, txn);
+  if (!eResult.ok()) {
+    return eResult.status();
+  }
+  for (const auto& member : eResult.value()) {
+    Status s = remove(member.first, member.second, txn);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return eResult;
+}
+
+Status OrderedZset::saveChanges(Transaction* txn) {
+  for (const auto& change : _changes) {
+    RecordKey rk(_chunkId,
+                 _dbId,
+                 RecordType::RT_ZSET_S_ELE,
+                 _pk,
+                 change.first,
+                 _version);
+    Status s;
+    if (change.second.deleted) {
+      s = _store->delKV(rk, txn);
+    } else {
+      RecordValue rv(change.second.value, RecordType::RT_ZSET_S_ELE, -1);
+      s = _store->setKV(rk, rv, txn);
+    }
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  _changes.clear();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status OrderedZset::save(Transaction* txn,
+                         const Expected<RecordValue>& oldValue,
+                         uint64_t versionEP) {
+  Status s = saveChanges(txn);
+  if (!s.ok()) {
+    return s;
+  }
+
+  RecordKey rk(_chunkId, _dbId, RecordType::RT_ZSET_META, _pk, "");
+  ZSlMetaValue mv(
+    ZSlMetaValue::Encoding::ENCODING_ORDERED, _count, _height, _topCount);
+  uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
+  RecordValue rv(
+    mv.encode(), RecordType::RT_ZSET_META, versionEP, ttl, oldValue);
+  rv.setVersion(_version);
+  return _store->setKV(rk, rv, txn);
+}
+
+Status OrderedZset::drop(Transaction* txn) {
+  INVARIANT_D(_count == 1);
+  for (uint8_t level = 1; level <= _height; ++level) {
+    delRecord(level, std::string(1, BOUND_MAX));
+  }
+  return saveChanges(txn);
+}
+
+uint32_t OrderedZset::getCount() const {
+  return _count;
+}
+
+uint8_t OrderedZset::getHeight() const {
+  return _height;
+}
+
+}  // namespace novadbplus
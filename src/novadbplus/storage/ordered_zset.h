@@ -0,0 +1,178 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_STORAGE_ORDERED_ZSET_H_
+#define SRC_novadbPLUS_STORAGE_ORDERED_ZSET_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "novadbplus/storage/kvstore.h"
+#include "novadbplus/storage/record.h"
+#include "novadbplus/storage/zset_index.h"
+
+namespace novadbplus {
+
+// OrderedZset is the ZSlMetaValue::Encoding::ENCODING_ORDERED index of a
+// zset. Its RT_ZSET_S_ELE subkeys sort as the members, so a range is read
+// by one seek of the store instead of a walk over the skiplist nodes.
+//
+// A bound is the order-preserving encoding of (score, member), see
+// memberBound(). The subkeys are:
+//   's' + bound          -> ""                      the members (level 0)
+//   'r' + level + bound  -> count|children|lower     the index (level >= 1)
+// An index record of level l covers the records of level l - 1 whose bound
+// is in (lower, bound], count is the number of members below it. Each level
+// ends with a record of BOUND_MAX, which lives as long as the zset. A
+// record is split into two when it has more than MAX_CHILDREN children,
+// and deleted when it becomes empty, unless it is the last child of its
+// parent. The meta keeps the height and the number of records of the top
+// level, so a level is added or removed as the top level grows or shrinks.
+//
+// ZADD writes the member and one counter on each level, and the levels are
+// few as the fanout is large. Ranks are computed from the counters.
+class OrderedZset : public ZsetIndex {
+ public:
+  static constexpr uint64_t MAX_CHILDREN = 128;
+
+  // version is the version of the subkeys, see Command::getSubKeyVersion()
+  OrderedZset(uint32_t chunkId,
+              uint32_t dbId,
+              const std::string& pk,
+              const ZSlMetaValue& meta,
+              PStore store,
+              uint64_t version);
+  // write the index of a new, empty zset, and return its meta
+  static Expected<ZSlMetaValue> init(const RecordKey& mk,
+                                     uint64_t version,
+                                     PStore store,
+                                     Transaction* txn);
+
+  Status insert(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  Status insertBatch(const std::vector<std::pair<double, std::string>>& members,
+                     Transaction* txn) override;
+  Status remove(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  Expected<uint32_t> rank(double score,
+                          const std::string& subkey,
+                          Transaction* txn) override;
+  Expected<uint32_t> countInRange(const Zrangespec& range,
+                                  Transaction* txn) override;
+  Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                     Transaction* txn) override;
+
+  Expected<std::list<std::pair<double, std::string>>> scanByLex(
+    const Zlexrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByRank(
+    int64_t start, int64_t len, bool rev, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByScore(
+    const Zrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByScore(
+    const Zrangespec& range, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByLex(
+    const Zlexrangespec& range, Transaction* txn) override;
+  // 1-based index
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByRank(
+    uint32_t start, uint32_t end, Transaction* txn) override;
+
+  Status save(Transaction* txn,
+              const Expected<RecordValue>& oldValue,
+              uint64_t versionEP) override;
+  // delete the BOUND_MAX record of each level
+  Status drop(Transaction* txn) override;
+  uint32_t getCount() const override;
+  uint8_t getHeight() const;
+
+ private:
+  struct Block {
+    uint64_t count;
+    uint64_t children;
+    std::string lower;
+    std::string bound;
+  };
+  // the subkey of an unsaved record, deleted or not
+  struct Change {
+    bool deleted;
+    std::string value;
+  };
+  // visit (bound, value) of a level in order, stop when it returns false
+  using Visitor = std::function<Expected<bool>(const std::string& bound,
+                                               const std::string& value)>;
+
+  static std::string encodeBlock(const Block& block);
+  static Expected<Block> decodeBlock(const std::string& bound,
+                                     const std::string& value);
+
+  // visit the records of level from the first one whose bound >= from, the
+  // unsaved changes take the place of the store.
+  Status scanLevel(uint8_t level,
+                   const std::string& from,
+                   const Visitor& fn,
+                   Transaction* txn);
+  // the first record of level whose bound >= bound
+  Expected<Block> findBlock(uint8_t level,
+                            const std::string& bound,
+                            Transaction* txn);
+  void putRecord(uint8_t level,
+                 const std::string& bound,
+                 const std::string& value);
+  void delRecord(uint8_t level, const std::string& bound);
+  // add delta to the records covering bound, and split or delete them
+  Status updateIndex(const std::string& bound, int64_t delta, Transaction* txn);
+  Status splitBlock(uint8_t level, Block* block, Transaction* txn);
+  Status delEmptyBlock(uint8_t level,
+                       const std::string& bound,
+                       Transaction* txn);
+  // the number of members whose bound < bound
+  Expected<uint32_t> countBefore(const std::string& bound, Transaction* txn);
+  // cnt members from the 0-based rank
+  Expected<std::list<std::pair<double, std::string>>> scanFromRank(
+    uint64_t rank, uint64_t cnt, Transaction* txn);
+  // the members whose bound is in [from, to)
+  Expected<std::list<std::pair<double, std::string>>> scanBetween(
+    const std::string& from,
+    const std::string& to,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn);
+  Expected<std::list<std::pair<double, std::string>>> removeBetween(
+    const std::string& from, const std::string& to, Transaction* txn);
+  // [from, to) of a range, return false if it is empty
+  Expected<bool> lexBounds(const Zlexrangespec& range,
+                           std::string* from,
+                           std::string* to,
+                           Transaction* txn);
+  Status saveChanges(Transaction* txn);
+
+  uint32_t _count;
+  uint8_t _height;
+  uint32_t _topCount;
+  uint32_t _chunkId;
+  uint32_t _dbId;
+  std::string _pk;
+  uint64_t _version;
+  PStore _store;
+  // subkey -> change
+  std::map<std::string, Change> _changes;
+};
+
+}  // namespace novadbplus
+#endif  // SRC_novadbPLUS_STORAGE_ORDERED_ZSET_H_
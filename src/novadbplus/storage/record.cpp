@@ -4,6 +4,8 @@
 
 #include "novadbplus/storage/record.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -21,6 +23,7 @@
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/status.h"
 #include "novadbplus/utils/string.h"
+#include "novadbplus/utils/time.h"
 
 namespace novadbplus {
 
@@ -84,6 +87,29 @@ bool isRealEleType(RecordType keyType, RecordType valueType) {
   }
 }
 
+bool isVersionedType(RecordType valueType) {
+  switch (valueType) {
+    case RecordType::RT_HASH_META:
+    case RecordType::RT_SET_META:
+    case RecordType::RT_ZSET_META:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool isVersionedEleType(RecordType keyType) {
+  switch (keyType) {
+    case RecordType::RT_HASH_ELE:
+    case RecordType::RT_SET_ELE:
+    case RecordType::RT_ZSET_S_ELE:
+    case RecordType::RT_ZSET_H_ELE:
+      return true;
+    default:
+      return false;
+  }
+}
+
 uint8_t rt2Char(RecordType t) {
   switch (t) {
     case RecordType::RT_META:
@@ -288,9 +314,9 @@ void RecordKey::encodePrefixPk(std::vector<uint8_t>* arr) const {
   // each other in physical space
   arr->push_back(0);
 
-  // NOTE(vinchen): version of key, temporarily useless
+  // NOTE: version of the subkeys, the same as the version of the meta for
+  // the versioned types, see rcd_util::isVersionedType().
   // delSubkeysRange use _version=UINT64_MAX as upper_bound
-  INVARIANT_D(_version == 0 || _version == UINT64_MAX);
   auto v = varintEncode(_version);
   arr->insert(arr->end(), v.begin(), v.end());
 }
@@ -500,7 +526,6 @@ Expected<RecordKey> RecordKey::decode(const std::string& key) {
   }
   size_t versionLen = v.value().second;
   auto version = v.value().first;
-  INVARIANT_D(version == 0);
 
   // sk
   skLen = left - versionLen;
@@ -559,8 +584,7 @@ Expected<bool> RecordKey::validate(const std::string& key, RecordType type) {
   if (!v.ok()) {
     return {ErrorCodes::ERR_DECODE, "invalid version len"};
   }
-  auto version = v.value().first;
-  if (version != 0) {
+  if (v.value().first != 0 && !isVersionedEleType(thisType)) {
     return {ErrorCodes::ERR_DECODE, "invalid version in record key"};
   }
 
@@ -744,7 +768,6 @@ std::string RecordValue::encode() const {
 
     // version
     offset += varintEncodeBuf(ptr + offset, size - offset, _version);
-    INVARIANT_D(_version == (uint64_t)0);
 
     // versionEP
     offset += varintEncodeBuf(ptr + offset, size - offset, _versionEP + 1);
@@ -822,7 +845,6 @@ Expected<RecordValue> RecordValue::decode(const std::string& value) {
     }
     offset += expt.value().second;
     version = expt.value().first;
-    INVARIANT_D(version == 0);
 
     // versionEP
     expt = varintDecodeFwd(valueCstr + offset, value.size() - offset);
@@ -1224,10 +1246,16 @@ std::string Record::toString() const {
 
 HashMetaValue::HashMetaValue() : HashMetaValue(0) {}
 
-HashMetaValue::HashMetaValue(uint64_t count) : _count(count) {}
+HashMetaValue::HashMetaValue(uint64_t count)
+  : _count(count), _encoding(Encoding::ENCODING_PLAIN) {}
 
-HashMetaValue::HashMetaValue(HashMetaValue&& o) : _count(o._count) {
+HashMetaValue::HashMetaValue(HashMetaValue&& o)
+  : _count(o._count),
+    _encoding(o._encoding),
+    _fields(std::move(o._fields)) {
   o._count = 0;
+  o._encoding = Encoding::ENCODING_PLAIN;
+  o._fields.clear();
 }
 
 std::string HashMetaValue::encode() const {
@@ -1235,6 +1263,18 @@ std::string HashMetaValue::encode() const {
   value.reserve(128);
   auto countBytes = varintEncode(_count);
   value.insert(value.end(), countBytes.begin(), countBytes.end());
+  if (isCompact()) {
+    INVARIANT_D(_count == _fields.size());
+    value.push_back(static_cast<uint8_t>(_encoding));
+    for (const auto& field : _fields) {
+      auto lenBytes = varintEncode(field.first.size());
+      value.insert(value.end(), lenBytes.begin(), lenBytes.end());
+      value.insert(value.end(), field.first.begin(), field.first.end());
+      lenBytes = varintEncode(field.second.size());
+      value.insert(value.end(), lenBytes.begin(), lenBytes.end());
+      value.insert(value.end(), field.second.begin(), field.second.end());
+    }
+  }
   return std::string(reinterpret_cast<const char*>(value.data()), value.size());
 }
 
@@ -1249,7 +1289,45 @@ Expected<HashMetaValue> HashMetaValue::decode(const std::string& val) {
   offset += expt.value().second;
   count = expt.value().first;
 
-  return HashMetaValue(count);
+  HashMetaValue meta(count);
+  if (offset == val.size()) {
+    return meta;
+  }
+  if (valCstr[offset] != static_cast<uint8_t>(Encoding::ENCODING_COMPACT)) {
+    return {ErrorCodes::ERR_DECODE, "invalid hash meta encoding"};
+  }
+  offset++;
+  meta._encoding = Encoding::ENCODING_COMPACT;
+  meta._fields.reserve(count);
+  auto decodeString = [&val, valCstr, &offset]() -> Expected<std::string> {
+    auto eLen = varintDecodeFwd(valCstr + offset, val.size() - offset);
+    if (!eLen.ok()) {
+      return eLen.status();
+    }
+    offset += eLen.value().second;
+    if (eLen.value().first > val.size() - offset) {
+      return {ErrorCodes::ERR_DECODE, "invalid hash meta field length"};
+    }
+    std::string str(val.c_str() + offset, eLen.value().first);
+    offset += eLen.value().first;
+    return str;
+  };
+  for (uint64_t i = 0; i < count; i++) {
+    auto eField = decodeString();
+    if (!eField.ok()) {
+      return eField.status();
+    }
+    auto eValue = decodeString();
+    if (!eValue.ok()) {
+      return eValue.status();
+    }
+    meta._fields.emplace_back(std::move(eField.value()),
+                              std::move(eValue.value()));
+  }
+  if (offset != val.size()) {
+    return {ErrorCodes::ERR_DECODE, "invalid hash meta length"};
+  }
+  return meta;
 }
 
 HashMetaValue& HashMetaValue::operator=(HashMetaValue&& o) {
@@ -1257,11 +1335,16 @@ HashMetaValue& HashMetaValue::operator=(HashMetaValue&& o) {
     return *this;
   }
   _count = o._count;
+  _encoding = o._encoding;
+  _fields = std::move(o._fields);
   o._count = 0;
+  o._encoding = Encoding::ENCODING_PLAIN;
+  o._fields.clear();
   return *this;
 }
 
 void HashMetaValue::setCount(uint64_t count) {
+  INVARIANT_D(!isCompact());
   _count = count;
 }
 
@@ -1269,6 +1352,58 @@ uint64_t HashMetaValue::getCount() const {
   return _count;
 }
 
+void HashMetaValue::setCompact(bool compact) {
+  if (compact) {
+    INVARIANT_D(_count == 0);
+    _encoding = Encoding::ENCODING_COMPACT;
+  } else {
+    _encoding = Encoding::ENCODING_PLAIN;
+    _fields.clear();
+    _fields.shrink_to_fit();
+  }
+}
+
+size_t HashMetaValue::findField(const std::string& field) const {
+  auto it = std::lower_bound(
+    _fields.begin(),
+    _fields.end(),
+    field,
+    [](const Field& a, const std::string& b) { return a.first < b; });
+  return it - _fields.begin();
+}
+
+const std::string* HashMetaValue::getField(const std::string& field) const {
+  size_t i = findField(field);
+  if (i == _fields.size() || _fields[i].first != field) {
+    return nullptr;
+  }
+  return &_fields[i].second;
+}
+
+bool HashMetaValue::setField(const std::string& field,
+                             const std::string& value) {
+  INVARIANT_D(isCompact());
+  size_t i = findField(field);
+  if (i < _fields.size() && _fields[i].first == field) {
+    _fields[i].second = value;
+    return false;
+  }
+  _fields.emplace(_fields.begin() + i, field, value);
+  _count++;
+  return true;
+}
+
+bool HashMetaValue::delField(const std::string& field) {
+  INVARIANT_D(isCompact());
+  size_t i = findField(field);
+  if (i == _fields.size() || _fields[i].first != field) {
+    return false;
+  }
+  _fields.erase(_fields.begin() + i);
+  _count--;
+  return true;
+}
+
 ListMetaValue::ListMetaValue(uint64_t head, uint64_t tail)
   : _head(head), _tail(tail) {}
 
@@ -1533,7 +1668,10 @@ ZSlMetaValue::ZSlMetaValue(uint8_t lvl, uint32_t count, uint64_t tail)
     _maxLevel(MAX_LAYER),
     _count(count),
     _tail(tail),
-    _posAlloc(ZSlMetaValue::MIN_POS) {
+    _posAlloc(ZSlMetaValue::MIN_POS),
+    _encoding(Encoding::ENCODING_SKIPLIST),
+    _indexHeight(0),
+    _indexTopCount(0) {
   // NOTE(vinchen): _maxLevel can't change. If you want to
   // change it, the constructor of ZSlEleValue should add new
   // parameter of it.
@@ -1547,6 +1685,16 @@ ZSlMetaValue::ZSlMetaValue(uint8_t lvl,
   _posAlloc = alloc;
 }
 
+ZSlMetaValue::ZSlMetaValue(Encoding encoding,
+                           uint32_t count,
+                           uint8_t height,
+                           uint32_t topCount)
+  : ZSlMetaValue(0, count, 0) {
+  _encoding = encoding;
+  _indexHeight = height;
+  _indexTopCount = topCount;
+}
+
 std::string ZSlMetaValue::encode() const {
   std::vector<uint8_t> value;
   value.reserve(128);
@@ -1567,6 +1715,14 @@ std::string ZSlMetaValue::encode() const {
   bytes = varintEncode(_posAlloc);
   value.insert(value.end(), bytes.begin(), bytes.end());
 
+  if (_encoding == Encoding::ENCODING_ORDERED) {
+    value.push_back(static_cast<uint8_t>(_encoding));
+    bytes = varintEncode(_indexHeight);
+    value.insert(value.end(), bytes.begin(), bytes.end());
+    bytes = varintEncode(_indexTopCount);
+    value.insert(value.end(), bytes.begin(), bytes.end());
+  }
+
   return std::string(reinterpret_cast<const char*>(value.data()), value.size());
 }
 
@@ -1616,6 +1772,31 @@ Expected<ZSlMetaValue> ZSlMetaValue::decode(const std::string& val) {
   offset += expt.value().second;
   result._posAlloc = expt.value().first;
 
+  if (offset == val.size()) {
+    return result;
+  }
+  if (keyCstr[offset] != static_cast<uint8_t>(Encoding::ENCODING_ORDERED)) {
+    return {ErrorCodes::ERR_DECODE, "invalid zset meta encoding"};
+  }
+  offset++;
+  result._encoding = Encoding::ENCODING_ORDERED;
+
+  // _indexHeight
+  expt = varintDecodeFwd(keyCstr + offset, val.size() - offset);
+  if (!expt.ok()) {
+    return expt.status();
+  }
+  offset += expt.value().second;
+  result._indexHeight = expt.value().first;
+
+  // _indexTopCount
+  expt = varintDecodeFwd(keyCstr + offset, val.size() - offset);
+  if (!expt.ok()) {
+    return expt.status();
+  }
+  offset += expt.value().second;
+  result._indexTopCount = expt.value().first;
+
   return result;
 }
 
@@ -1639,6 +1820,18 @@ uint64_t ZSlMetaValue::getPosAlloc() const {
   return _posAlloc;
 }
 
+ZSlMetaValue::Encoding ZSlMetaValue::getEncoding() const {
+  return _encoding;
+}
+
+uint8_t ZSlMetaValue::getIndexHeight() const {
+  return _indexHeight;
+}
+
+uint32_t ZSlMetaValue::getIndexTopCount() const {
+  return _indexTopCount;
+}
+
 /*
 ZslEleSubKey::ZslEleSubKey()
     :ZslEleSubKey(0, "") {
@@ -1686,14 +1879,8 @@ ZSlEleValue::ZSlEleValue(double score,
                          uint32_t maxLevel)
   : _score(score), _backward(0), _changed(false), _subKey(subkey) {
   INVARIANT_D(maxLevel == ZSlMetaValue::MAX_LAYER);
-  _forward.resize(maxLevel + 1);
-  _span.resize(maxLevel + 1);
-  for (size_t i = 0; i < _forward.size(); ++i) {
-    _forward[i] = 0;
-  }
-  for (size_t i = 0; i < _span.size(); ++i) {
-    _span[i] = 0;
-  }
+  _forward.fill(0);
+  _span.fill(0);
 }
 
 uint64_t ZSlEleValue::getBackward() const {
@@ -1998,6 +2185,26 @@ Expected<uint64_t> getSubKeyCount(const RecordKey& key,
   }
 }
 
+uint64_t newKeyVersion() {
+  static std::atomic<uint64_t> lastVersion(0);
+  uint64_t last = lastVersion.load(std::memory_order_relaxed);
+  uint64_t version;
+  do {
+    version = std::max(last + 1, usSinceEpoch());
+  } while (!lastVersion.compare_exchange_weak(last, version));
+  return version;
+}
+
+bool isStaleSubKey(const RecordKey& rk, const Expected<RecordValue>& eMeta) {
+  if (!isVersionedEleType(rk.getRecordType()) || rk.getVersion() == 0) {
+    return false;
+  }
+  if (eMeta.ok()) {
+    return eMeta.value().getVersion() != rk.getVersion();
+  }
+  return eMeta.status().code() == ErrorCodes::ERR_NOTFOUND;
+}
+
 std::string makeInvalidErrStr(RecordType type,
                               const std::string& key,
                               uint64_t metaCnt,
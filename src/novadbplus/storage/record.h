@@ -5,6 +5,7 @@
 #ifndef SRC_novadbPLUS_STORAGE_RECORD_H_
 #define SRC_novadbPLUS_STORAGE_RECORD_H_
 
+#include <array>
 #include <limits>
 #include <memory>
 #include <sstream>
@@ -24,6 +25,7 @@ namespace novadbplus {
 const uint32_t LUASCRIPT_CHUNKID = 0XFFFD0000U;
 const uint32_t VERSIONMETA_CHUNKID = 0XFFFE0000U;
 const uint32_t ADMINCMD_CHUNKID = 0XFFFE0001U;
+const uint32_t KEYCOUNT_CHUNKID = 0XFFFE0002U;
 const uint32_t TTLINDEX_CHUNKID = 0XFFFF0000U;
 // NOTE(takenliu) data chunkid must smaller than REPLLOGKEYV2_META_CHUNKID
 const uint32_t REPLLOGKEYV2_META_CHUNKID = 0XFFFFFE01U;
@@ -33,6 +35,7 @@ const uint32_t REPLLOGKEYV2_CHUNKID = 0XFFFFFF01U;
 const uint32_t LUASCRIPT_DBID = 0XFFFD0000U;
 const uint32_t VERSIONMETA_DBID = 0XFFFE0000U;
 const uint32_t ADMINCMD_DBID = 0XFFFE0001U;
+const uint32_t KEYCOUNT_DBID = 0XFFFE0002U;
 const uint32_t TTLINDEX_DBID = 0XFFFF0000U;
 // NOTE(takenliu) data dbid must smaller than REPLLOGKEYV2_META_DBID
 const uint32_t REPLLOGKEYV2_META_DBID = 0XFFFFFE01U;
@@ -75,6 +78,11 @@ bool isDataMetaType(RecordType t);
 bool isKeyType(RecordType t);
 RecordType getRealKeyType(RecordType t);
 bool isRealEleType(RecordType keyType, RecordType valueType);
+// the subkeys of hash, set and zset carry the version of their meta, it
+// makes deleting them O(1): only the meta is deleted, and the stale subkeys
+// are dropped by the compaction filter later.
+bool isVersionedType(RecordType valueType);
+bool isVersionedEleType(RecordType keyType);
 
 // ********************* key format ***********************************
 // ChunkId + DBID + Type + PK + 0 + VERSION + SK + len(PK) + 1B reserved
@@ -86,7 +94,8 @@ bool isRealEleType(RecordType keyType, RecordType valueType);
 // PK is primarykey, its length is described in len(PK)
 // 0
 // VERSION is varint, it means multi-version of record. For *_META, it
-//   always 0. Maybe it would be useful for _ELE. It would be always 0 now.
+//   always 0. For _ELE of the versioned types, it is the version of the
+//   meta, see isVersionedType(). Otherwise it is always 0.
 // SK is secondarykey, its length is not stored
 // len(PK) is varint32 stored in bigendian, so we can read from the end
 // backwards. the last 1B are reserved.
@@ -126,6 +135,9 @@ class RecordKey {
             uint64_t version = 0);
   const std::string& getPrimaryKey() const;
   const std::string& getSecondaryKey() const;
+  uint64_t getVersion() const {
+    return _version;
+  }
   uint32_t getChunkId() const;
   uint32_t getDbId() const;
 
@@ -278,7 +290,8 @@ class RecordValue {
   // meta type. For other RecordKey._type, it's useless.
   RecordType _type;
   uint64_t _ttl;
-  // version for subkey, maybe it useful for big key deletion, reversed
+  // version for subkey, 0 for the keys written before versioning and the
+  // types not versioned, see isVersionedType()
   uint64_t _version;
   // version for extended protocol, reversed
   uint64_t _versionEP;
@@ -624,8 +637,18 @@ class ListMetaValue {
   uint64_t _tail;
 };
 
+// NOTE: a small hash keeps its fields inline in the meta value
+// (compact encoding) instead of one RT_HASH_ELE record per field.
+// The encoding byte and the fields follow the count, so the meta
+// values written before keep decoding as the plain encoding.
 class HashMetaValue {
  public:
+  enum class Encoding : uint8_t {
+    ENCODING_PLAIN = 0,
+    ENCODING_COMPACT = 1,
+  };
+  using Field = std::pair<std::string, std::string>;
+
   HashMetaValue();
   explicit HashMetaValue(uint64_t count);
   HashMetaValue(HashMetaValue&&);
@@ -637,8 +660,30 @@ class HashMetaValue {
   uint64_t getCount() const;
   // uint64_t getCas() const;
 
+  bool isCompact() const {
+    return _encoding == Encoding::ENCODING_COMPACT;
+  }
+  // only an empty hash can switch to the compact encoding, switching to
+  // the plain encoding drops the inline fields
+  void setCompact(bool compact);
+  // the inline fields sorted by name, empty for the plain encoding
+  const std::vector<Field>& getFields() const {
+    return _fields;
+  }
+  // nullptr if the field doesn't exist
+  const std::string* getField(const std::string& field) const;
+  // return true if the field is new
+  bool setField(const std::string& field, const std::string& value);
+  // return false if the field doesn't exist
+  bool delField(const std::string& field);
+
  private:
+  // the position of the first field not less than field
+  size_t findField(const std::string& field) const;
+
   uint64_t _count;
+  Encoding _encoding;
+  std::vector<Field> _fields;
 };
 
 class SetMetaValue {
@@ -709,14 +754,30 @@ H_ELE: *(COUNT)
 CHUNK|DBID|H_ELE|KEY|SUBKEY|
 score
 
+The meta of ENCODING_ORDERED appends ENCODING|HEIGHT|TOPCOUNT|, its
+S_ELE records are described in ordered_zset.h.
+
 */
 
 // ZsetSkipListMetaValue
 class ZSlMetaValue {
  public:
+  // how the members are kept in the S_ELE records, see ZsetIndex. The
+  // encoding byte follows _posAlloc only for ENCODING_ORDERED, so the meta
+  // values written before keep decoding as the skiplist.
+  enum class Encoding : uint8_t {
+    ENCODING_SKIPLIST = 0,
+    ENCODING_ORDERED = 1,
+  };
+
   ZSlMetaValue();
   ZSlMetaValue(uint8_t lvl, uint32_t count, uint64_t tail);
   ZSlMetaValue(uint8_t lvl, uint32_t count, uint64_t tail, uint64_t alloc);
+  // ENCODING_ORDERED, height and topCount describe its rank index
+  ZSlMetaValue(Encoding encoding,
+               uint32_t count,
+               uint8_t height,
+               uint32_t topCount);
   static Expected<ZSlMetaValue> decode(const std::string&);
   std::string encode() const;
   uint8_t getMaxLevel() const;
@@ -724,6 +785,9 @@ class ZSlMetaValue {
   uint32_t getCount() const;
   uint64_t getTail() const;
   uint64_t getPosAlloc() const;
+  Encoding getEncoding() const;
+  uint8_t getIndexHeight() const;
+  uint32_t getIndexTopCount() const;
   // can not dynamicly change
   static constexpr int8_t MAX_LAYER = ZSKIPLIST_MAXLEVEL;
   static constexpr uint32_t MAX_NUM = (1 << 31);
@@ -739,6 +803,9 @@ class ZSlMetaValue {
   uint32_t _count;
   uint64_t _tail;
   uint64_t _posAlloc;
+  Encoding _encoding;
+  uint8_t _indexHeight;
+  uint32_t _indexTopCount;
 };
 
 class ZSlEleValue {
@@ -767,10 +834,11 @@ class ZSlEleValue {
   }
 
  private:
-  // forward elements index in each level
-  std::vector<uint64_t> _forward;
+  // forward elements index in each level, they are inline so a node
+  // needs no allocation besides the subkey.
+  std::array<uint64_t, ZSlMetaValue::MAX_LAYER + 1> _forward;
   // step to forward element in each level
-  std::vector<uint32_t> _span;
+  std::array<uint32_t, ZSlMetaValue::MAX_LAYER + 1> _span;
   double _score;
   // backward element index in level 1
   uint64_t _backward;
@@ -934,6 +1002,15 @@ class LuaScript {
 namespace rcd_util {
 Expected<uint64_t> getSubKeyCount(const RecordKey& key, const RecordValue& val);
 
+// a new version for the versioned types, it is the microseconds since epoch
+// and never repeats in the process.
+uint64_t newKeyVersion();
+
+// whether rk is a subkey of a deleted or recreated hash/set/zset, eMeta is
+// the meta of its primary key. The subkeys without version are never stale
+// here, as they are deleted together with their meta.
+bool isStaleSubKey(const RecordKey& rk, const Expected<RecordValue>& eMeta);
+
 std::string makeInvalidErrStr(RecordType type,
                               const std::string& key,
                               uint64_t metaCnt,
@@ -388,6 +388,20 @@ TEST(ZSl, Common) {
     EXPECT_EQ(expm.value().getLevel(), lvl);
     EXPECT_EQ(expm.value().getCount(), count);
     EXPECT_EQ(expm.value().getTail(), tail);
+    EXPECT_EQ(expm.value().getEncoding(),
+              ZSlMetaValue::Encoding::ENCODING_SKIPLIST);
+
+    uint8_t height = genRand() % 8 + 1;
+    uint32_t topCount = static_cast<uint32_t>(genRand());
+    ZSlMetaValue om(
+      ZSlMetaValue::Encoding::ENCODING_ORDERED, count, height, topCount);
+    expm = ZSlMetaValue::decode(om.encode());
+    EXPECT_TRUE(expm.ok());
+    EXPECT_EQ(expm.value().getEncoding(),
+              ZSlMetaValue::Encoding::ENCODING_ORDERED);
+    EXPECT_EQ(expm.value().getCount(), count);
+    EXPECT_EQ(expm.value().getIndexHeight(), height);
+    EXPECT_EQ(expm.value().getIndexTopCount(), topCount);
   }
 
   for (size_t i = 0; i < num; i++) {
@@ -471,4 +485,49 @@ TEST(SetMetaValue, encode) {
   EXPECT_EQ(strEncode3, strEncode5);
 }
 
+TEST(HashMetaValue, Compact) {
+  // the plain encoding is the same as before
+  HashMetaValue plain(100);
+  EXPECT_FALSE(plain.isCompact());
+  EXPECT_EQ(plain.encode(), HashMetaValue(100).encode());
+  auto ePlain = HashMetaValue::decode(plain.encode());
+  EXPECT_TRUE(ePlain.ok());
+  EXPECT_FALSE(ePlain.value().isCompact());
+  EXPECT_EQ(ePlain.value().getCount(), 100U);
+
+  HashMetaValue meta;
+  meta.setCompact(true);
+  EXPECT_TRUE(meta.setField("f2", "v2"));
+  EXPECT_TRUE(meta.setField("f1", "v1"));
+  EXPECT_TRUE(meta.setField("", ""));
+  EXPECT_TRUE(meta.setField("f3", std::string(300, 'a')));
+  EXPECT_FALSE(meta.setField("f1", "v11"));
+  EXPECT_TRUE(meta.delField("f2"));
+  EXPECT_FALSE(meta.delField("f2"));
+  EXPECT_EQ(meta.getCount(), 3U);
+
+  auto eMeta = HashMetaValue::decode(meta.encode());
+  EXPECT_TRUE(eMeta.ok());
+  const auto& decoded = eMeta.value();
+  EXPECT_TRUE(decoded.isCompact());
+  EXPECT_EQ(decoded.getCount(), 3U);
+  std::vector<HashMetaValue::Field> expected = {
+    {"", ""}, {"f1", "v11"}, {"f3", std::string(300, 'a')}};
+  EXPECT_EQ(decoded.getFields(), expected);
+  EXPECT_EQ(*decoded.getField("f1"), "v11");
+  EXPECT_EQ(decoded.getField("f2"), nullptr);
+
+  // truncated values are rejected
+  std::string encoded = meta.encode();
+  EXPECT_FALSE(
+    HashMetaValue::decode(encoded.substr(0, encoded.size() - 1)).ok());
+
+  // back to the plain encoding, the count is kept
+  HashMetaValue moved(std::move(eMeta.value()));
+  moved.setCompact(false);
+  EXPECT_FALSE(moved.isCompact());
+  EXPECT_TRUE(moved.getFields().empty());
+  EXPECT_EQ(moved.encode(), HashMetaValue(3).encode());
+}
+
 }  // namespace novadbplus
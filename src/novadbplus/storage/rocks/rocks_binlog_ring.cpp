@@ -0,0 +1,88 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include "novadbplus/storage/rocks/rocks_binlog_ring.h"
+
+#include <limits>
+#include <utility>
+
+namespace novadbplus {
+
+// NOTE: the memory of the map node
+static constexpr size_t ENTRY_OVERHEAD = 64;
+
+RocksBinlogRing::RocksBinlogRing(uint64_t capacity)
+  : _capacity(capacity),
+    _usage(0),
+    _floor(std::numeric_limits<uint64_t>::max()),
+    _hits(0),
+    _misses(0) {}
+
+void RocksBinlogRing::insert(uint64_t binlogId,
+                             const std::string& key,
+                             const std::string& val) {
+  size_t charge = key.size() + val.size() + ENTRY_OVERHEAD;
+  std::lock_guard<std::mutex> lk(_mutex);
+  if (binlogId < _floor || charge > _capacity) {
+    // its position was dropped already, or it could never fit
+    if (binlogId >= _floor) {
+      _floor = binlogId + 1;
+      _logs.clear();
+      _usage = 0;
+    }
+    return;
+  }
+  auto ret = _logs.emplace(binlogId, std::make_pair(key, val));
+  if (!ret.second) {
+    return;
+  }
+  _usage += charge;
+  while (_usage > _capacity) {
+    auto it = _logs.begin();
+    _usage -= it->second.first.size() + it->second.second.size() +
+      ENTRY_OVERHEAD;
+    _floor = it->first + 1;
+    _logs.erase(it);
+  }
+}
+
+void RocksBinlogRing::reset(uint64_t floor) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _logs.clear();
+  _usage = 0;
+  _floor = floor;
+}
+
+Expected<std::vector<ReplLogRawV2>> RocksBinlogRing::read(
+  uint64_t binlogPos,
+  uint64_t highestVisible,
+  uint32_t maxCount,
+  size_t maxBytes) {
+  std::vector<ReplLogRawV2> logs;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    if (binlogPos + 1 < _floor) {
+      _misses.fetch_add(1, std::memory_order_relaxed);
+      return {ErrorCodes::ERR_NOTFOUND, "behind the binlog ring"};
+    }
+    size_t bytes = 0;
+    for (auto it = _logs.upper_bound(binlogPos);
+         it != _logs.end() && it->first <= highestVisible; ++it) {
+      if (logs.size() >= maxCount || bytes >= maxBytes) {
+        break;
+      }
+      bytes += it->second.first.size() + it->second.second.size();
+      logs.emplace_back(it->second.first, it->second.second);
+    }
+  }
+  _hits.fetch_add(1, std::memory_order_relaxed);
+  return std::move(logs);
+}
+
+uint64_t RocksBinlogRing::getUsage() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _usage;
+}
+
+}  // namespace novadbplus
@@ -0,0 +1,71 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_BINLOG_RING_H_
+#define SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_BINLOG_RING_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "novadbplus/storage/record.h"
+#include "novadbplus/utils/status.h"
+
+namespace novadbplus {
+
+// The recently committed binlogs of one RocksKVStore, so that pushing
+// binlogs to the slaves reads them from memory instead of seeking the
+// binlog column family. It is bounded by the approximate memory of the
+// binlogs, the oldest ones are dropped first.
+//
+// The binlogs are inserted before they are marked committed, which is not
+// in binlogId order, so readers only read up to the highest visible
+// binlogId. Every committed binlog whose id >= _floor is in the ring, the
+// ones below _floor have to be read from rocksdb.
+class RocksBinlogRing {
+ public:
+  // capacity is in bytes
+  explicit RocksBinlogRing(uint64_t capacity);
+  RocksBinlogRing(const RocksBinlogRing&) = delete;
+  RocksBinlogRing& operator=(const RocksBinlogRing&) = delete;
+
+  void insert(uint64_t binlogId,
+              const std::string& key,
+              const std::string& val);
+  // drop all the binlogs, the ones >= floor will be inserted from now on
+  void reset(uint64_t floor);
+  // copy the binlogs in (binlogPos, highestVisible], at most maxCount of
+  // them or about maxBytes. ERR_NOTFOUND if binlogPos is behind the ring.
+  Expected<std::vector<ReplLogRawV2>> read(uint64_t binlogPos,
+                                           uint64_t highestVisible,
+                                           uint32_t maxCount,
+                                           size_t maxBytes);
+
+  uint64_t getCapacity() const {
+    return _capacity;
+  }
+  uint64_t getUsage() const;
+  uint64_t getHits() const {
+    return _hits.load(std::memory_order_relaxed);
+  }
+  uint64_t getMisses() const {
+    return _misses.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const uint64_t _capacity;
+  mutable std::mutex _mutex;
+  // binlogId -> <key, value>
+  std::map<uint64_t, ReplLogRawV2::KV> _logs;
+  size_t _usage;
+  uint64_t _floor;
+  std::atomic<uint64_t> _hits;
+  std::atomic<uint64_t> _misses;
+};
+
+}  // namespace novadbplus
+
+#endif  // SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_BINLOG_RING_H_
@@ -9,6 +9,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -23,15 +24,18 @@
 #include "rocksdb/db.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/iostats_context.h"
+#include "rocksdb/merge_operator.h"
 #include "rocksdb/options.h"
 #include "rocksdb/perf_context.h"
 #include "rocksdb/slice.h"
+#include "rocksdb/sst_file_writer.h"
 #include "rocksdb/statistics.h"
 #include "rocksdb/table.h"
 #include "rocksdb/table_properties.h"
 #include "rocksdb/utilities/backup_engine.h"
 #include "rocksdb/utilities/checkpoint.h"
 #include "rocksdb/utilities/table_properties_collectors.h"
+#include "rocksdb/write_batch.h"
 
 #include "novadbplus/server/server_entry.h"
 #include "novadbplus/server/session.h"
@@ -221,6 +225,13 @@ std::unique_ptr<BasicDataCursor> RocksTxn::createDataCursor() {
   return std::make_unique<BasicDataCursor>(std::move(cursor));
 }
 
+std::unique_ptr<BasicDataCursor> RocksTxn::createRangeDataCursor(
+  const std::string& upperBound, size_t readaheadSize) {
+  auto cursor = createCursor(
+    ColumnFamilyNumber::ColumnFamily_Default, &upperBound, readaheadSize);
+  return std::make_unique<BasicDataCursor>(std::move(cursor));
+}
+
 std::unique_ptr<AllDataCursor> RocksTxn::createAllDataCursor() {
   auto cursor = createCursor(ColumnFamilyNumber::ColumnFamily_Default);
   return std::make_unique<AllDataCursor>(std::move(cursor));
@@ -233,7 +244,8 @@ std::unique_ptr<BinlogCursor> RocksTxn::createBinlogCursor() {
 
 std::unique_ptr<Cursor> RocksTxn::createCursor(
   ColumnFamilyNumber column_family_num,
-  const std::string* iterate_upper_bound) {
+  const std::string* iterate_upper_bound,
+  size_t readahead_size) {
   rocksdb::ReadOptions readOpts;
 
   // NOTE: If force_recovery != 0, ignore verify checksums
@@ -247,6 +259,9 @@ std::unique_ptr<Cursor> RocksTxn::createCursor(
     _upperBound = rocksdb::Slice(_strUpperBound);
     readOpts.iterate_upper_bound = &_upperBound;
   }
+  if (readahead_size != 0) {
+    readOpts.readahead_size = readahead_size;
+  }
   // create iterator corresponding to chosen column family
   rocksdb::Iterator* iter;
   rocksdb::ColumnFamilyHandle* handle =
@@ -264,13 +279,18 @@ Expected<uint64_t> RocksTxn::commit() {
   _done = true;
 
   uint64_t binlogTxnId = Transaction::TXNID_UNINITED;
-  const auto guard = MakeGuard([this, &binlogTxnId] {
+  bool committed = false;
+  const auto guard = MakeGuard([this, &binlogTxnId, &committed] {
     _txn.reset();
     // for non-replonly mode, we should have binlogTxnId == _txnId
     if (!_replOnly) {
       INVARIANT_D(binlogTxnId == _txnId ||
                   binlogTxnId == Transaction::TXNID_UNINITED);
     }
+    // NOTE: the binlog must be in the ring before it becomes visible
+    if (committed && !_binlog.first.empty()) {
+      _store->getBinlogRing()->insert(_binlogId, _binlog.first, _binlog.second);
+    }
     _store->markCommitted(_txnId, binlogTxnId);
 
 #ifdef novadb_DEBUG
@@ -336,21 +356,40 @@ Expected<uint64_t> RocksTxn::commit() {
     binlogTxnId = _txnId;
     // put binlog into binlog_column_family
     rocksdb::ColumnFamilyHandle* handle = _store->getBinlogColumnFamilyHandle();
-    auto s = put(handle, key.encode(), val.encode(_replLogValues));
+    std::string logKey = key.encode();
+    std::string logValue = val.encode(_replLogValues);
+    auto s = put(handle, logKey, logValue);
     if (!s.ok()) {
       binlogTxnId = Transaction::TXNID_UNINITED;
       return _store->handleRocksdbError(s);
     }
+    if (_store->getBinlogRing()) {
+      _binlog = {std::move(logKey), std::move(logValue)};
+    }
+  }
+  auto ks = mergeKeyCounts();
+  if (!ks.ok()) {
+    binlogTxnId = Transaction::TXNID_UNINITED;
+    return ks;
   }
   if (isReplOnly() && _binlogId != Transaction::TXNID_UNINITED) {
     // NOTE(vinchen): for slave, binlog form master store directly
     binlogTxnId = _txnId;
   }
 
+  // NOTE: the keys are taken before the commit, which clears the batch
+  // of a rocksdb txn.
+  CacheKeys cacheKeys;
+  if (_store->hasKeyCache() && getPendingBatch()) {
+    _store->collectCacheKeys(*getPendingBatch(), &cacheKeys);
+  }
+
   TEST_SYNC_POINT("RocksTxn::commit()::1");
   TEST_SYNC_POINT("RocksTxn::commit()::2");
   auto s = txnCommit();
   if (s.ok()) {
+    committed = true;
+    _store->invalidateValueCache(cacheKeys);
     return _txnId;
   } else {
     binlogTxnId = Transaction::TXNID_UNINITED;
@@ -390,6 +429,83 @@ std::string RocksTxn::getKVStoreId() const {
   return _store->dbId();
 }
 
+rocksdb::WriteBatch* RocksTxn::getPendingBatch() {
+  return _txn ? _txn->GetWriteBatch()->GetWriteBatch() : nullptr;
+}
+
+bool RocksTxn::canUseValueCache() {
+  if (_done) {
+    return false;
+  }
+  auto batch = getPendingBatch();
+  return batch == nullptr || batch->Count() == 0;
+}
+
+static bool isCountedKey(const std::string& key) {
+  return RecordKey::decodeType(key) == RecordType::RT_DATA_META &&
+    RecordKey::decodeChunkId(key) < CLUSTER_SLOTS;
+}
+
+void RocksTxn::noteKeyExists(const std::string& key, bool exists) {
+  // NOTE: a snapshot may not see the latest version
+  if (!_store->isKeyCounting() || getSnapshot() || !isCountedKey(key)) {
+    return;
+  }
+  _keyExists[key] = exists;
+}
+
+Status RocksTxn::countKey(const std::string& key, bool put) {
+  if (!_store->isKeyCounting() || !isCountedKey(key)) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  // NOTE: the keylock guarantees nobody else is writing the key, the meta
+  // read by the command or written by this txn is the latest version.
+  auto it = _keyExists.find(key);
+  bool exists = false;
+  if (it != _keyExists.end()) {
+    exists = it->second;
+  } else {
+    rocksdb::ReadOptions readOpts;
+    std::string value;
+    auto s = get(readOpts, _store->getDataColumnFamilyHandle(), key, &value);
+    if (!s.ok() && !s.IsNotFound()) {
+      return _store->handleRocksdbError(s);
+    }
+    exists = s.ok();
+  }
+  if (exists != put) {
+    auto id = std::make_pair(RecordKey::decodeChunkId(key),
+                             RecordKey::decodeDbId(key));
+    _keyCountDeltas[id] += put ? 1 : -1;
+  }
+  _keyExists[key] = put;
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+// NOTE: the counters are merged without conflict checking, the txns
+// writing different keys of a chunk don't conflict with each other.
+Status RocksTxn::mergeKeyCounts() {
+  for (const auto& kv : _keyCountDeltas) {
+    if (kv.second == 0) {
+      continue;
+    }
+    auto s = merge(_store->getDataColumnFamilyHandle(),
+                   RocksKVStore::keyCountKey(kv.first.first, kv.first.second),
+                   RocksKVStore::keyCountValue(kv.second));
+    if (!s.ok()) {
+      return _store->handleRocksdbError(s);
+    }
+  }
+  _keyCountDeltas.clear();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+uint64_t RocksTxn::getReadSeq() {
+  auto snapshot = getSnapshot();
+  return snapshot ? snapshot->GetSequenceNumber()
+                  : RocksValueCache::READ_LATEST;
+}
+
 void RocksTxn::setChunkId(uint32_t chunkId) {
   if (_chunkId == Transaction::CHUNKID_UNINITED) {
     _chunkId = chunkId;
@@ -424,14 +540,69 @@ Expected<std::string> RocksTxn::getKV(const std::string& key) {
     _store->getColumnFamilyHandleByRecordType(RecordKey::decodeType(key));
   s = get(readOpts, handle, key, &value);
   if (s.ok()) {
+    noteKeyExists(key, true);
     return value;
   }
   if (s.IsNotFound()) {
+    noteKeyExists(key, false);
     return {ErrorCodes::ERR_NOTFOUND, s.ToString()};
   }
   return _store->handleRocksdbError(s);
 }
 
+std::vector<Expected<std::string>> RocksTxn::multiGetKV(
+  const std::vector<std::string>& keys) {
+  std::vector<Expected<std::string>> result(
+    keys.size(), Expected<std::string>(ErrorCodes::ERR_NOTFOUND, ""));
+  if (keys.empty()) {
+    return result;
+  }
+
+  rocksdb::ReadOptions readOpts;
+  // NOTE: If force_recovery != 0, ignore verify checksums
+  if (_store->recoveryMode()) {
+    readOpts.verify_checksums = false;
+  }
+  readOpts.snapshot = getSnapshot();
+
+  // NOTE: rocksdb's batched lookup works best on sorted keys, it
+  // can share the memtable/sst seeks between neighbours. Sort a permutation
+  // so the results can be handed back in the caller's order.
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    return keys[a] < keys[b];
+  });
+  std::vector<rocksdb::Slice> sortedKeys;
+  sortedKeys.reserve(keys.size());
+  for (auto idx : order) {
+    INVARIANT_D(RecordKey::decodeType(keys[idx]) != RecordType::RT_BINLOG);
+    sortedKeys.emplace_back(keys[idx]);
+  }
+
+  RESET_PERFCONTEXT();
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses;
+  recordMultiGet(readOpts,
+                 _store->getDataColumnFamilyHandle(),
+                 sortedKeys,
+                 &values,
+                 &statuses);
+  INVARIANT_D(statuses.size() == keys.size() && values.size() == keys.size());
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    const auto& s = statuses[i];
+    if (s.ok()) {
+      result[order[i]] = std::move(values[i]);
+    } else if (s.IsNotFound()) {
+      result[order[i]] = {ErrorCodes::ERR_NOTFOUND, s.ToString()};
+    } else {
+      result[order[i]] = _store->handleRocksdbError(s);
+    }
+  }
+  return result;
+}
+
 Status RocksTxn::setKV(const std::string& key,
                        const std::string& val,
                        const uint64_t ts) {
@@ -439,6 +610,9 @@ Status RocksTxn::setKV(const std::string& key,
     return {ErrorCodes::ERR_INTERNAL, "txn is replOnly"};
   }
 
+  auto cs = countKey(key, true);
+  RET_IF_ERR(cs);
+
   RESET_PERFCONTEXT();
   // put data into default column family
   auto s = put(key, val);
@@ -471,6 +645,8 @@ Status RocksTxn::setKV(const std::string& key,
 
 Status RocksTxn::setKVWithoutBinlog(const std::string& key,
                                     const std::string& val) {
+  auto cs = countKey(key, true);
+  RET_IF_ERR(cs);
   RESET_PERFCONTEXT();
   rocksdb::Status s;
   // put data into default column family
@@ -485,6 +661,8 @@ Status RocksTxn::delKV(const std::string& key, const uint64_t ts) {
   if (_replOnly) {
     return {ErrorCodes::ERR_INTERNAL, "txn is replOnly"};
   }
+  auto cs = countKey(key, false);
+  RET_IF_ERR(cs);
   RESET_PERFCONTEXT();
   rocksdb::Status s;
   rocksdb::ColumnFamilyHandle* handle =
@@ -610,6 +788,8 @@ Status RocksTxn::applyBinlog(const ReplLogValueEntryV2& logEntry) {
   RESET_PERFCONTEXT();
   switch (logEntry.getOp()) {
     case ReplOp::REPL_OP_SET: {
+      auto cs = countKey(logEntry.getOpKey(), true);
+      RET_IF_ERR(cs);
       s = put(handle, logEntry.getOpKey(), logEntry.getOpValue());
       if (!s.ok()) {
         return _store->handleRocksdbError(s);
@@ -617,6 +797,8 @@ Status RocksTxn::applyBinlog(const ReplLogValueEntryV2& logEntry) {
       break;
     }
     case ReplOp::REPL_OP_DEL: {
+      auto cs = countKey(logEntry.getOpKey(), false);
+      RET_IF_ERR(cs);
       s = del(handle, logEntry.getOpKey());
       if (!s.ok()) {
         return _store->handleRocksdbError(s);
@@ -671,14 +853,20 @@ Status RocksTxn::setBinlogKV(uint64_t binlogId,
   // NOTE(vinchen): Because the (logKey, logValue) from the master store in
   // slave's rocksdb directly, we should change the _nextBinlogSeq.
   // BTW, the txnid of logValue is different from _txnId. But it's ok.
-  _store->setNextBinlogSeq(binlogId, this);
-  INVARIANT_D(_binlogId != Transaction::TXNID_UNINITED);
+  // NOTE: the parallel applier has reserved the binlogId already
+  if (_binlogId == Transaction::TXNID_UNINITED) {
+    _store->setNextBinlogSeq(binlogId, this);
+  }
+  INVARIANT_D(_binlogId == binlogId);
   rocksdb::ColumnFamilyHandle* handle = _store->getBinlogColumnFamilyHandle();
   RESET_PERFCONTEXT();
   auto s = put(handle, logKey, logValue);
   if (!s.ok()) {
     return _store->handleRocksdbError(s);
   }
+  if (_store->getBinlogRing()) {
+    _binlog = {logKey, logValue};
+  }
 
   return {ErrorCodes::ERR_OK, ""};
 }
@@ -696,10 +884,14 @@ Status RocksTxn::setBinlogKV(const std::string& key, const std::string& value) {
   logkey.value().setBinlogId(_binlogId);
 
   rocksdb::ColumnFamilyHandle* handle = _store->getBinlogColumnFamilyHandle();
-  auto s = put(handle, logkey.value().encode(), value);
+  std::string newKey = logkey.value().encode();
+  auto s = put(handle, newKey, value);
   if (!s.ok()) {
     return _store->handleRocksdbError(s);
   }
+  if (_store->getBinlogRing()) {
+    _binlog = {std::move(newKey), value};
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -746,6 +938,42 @@ rocksdb::Status RocksTxn::get(const rocksdb::ReadOptions& options,
                                 RocksdbLatencyType::RLT_GET);
 }
 
+std::vector<rocksdb::Status> RocksTxn::multiGet(
+  const rocksdb::ReadOptions& options,
+  rocksdb::ColumnFamilyHandle* columnFamily,
+  const std::vector<rocksdb::Slice>& keys,
+  std::vector<std::string>* values) {
+  std::vector<rocksdb::ColumnFamilyHandle*> handles(keys.size(), columnFamily);
+  return _txn->MultiGet(options, handles, keys, values);
+}
+
+static rocksdb::Status firstMultiGetError(
+  const std::vector<rocksdb::Status>& statuses) {
+  for (const auto& s : statuses) {
+    if (!s.ok() && !s.IsNotFound()) {
+      return s;
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status RocksTxn::recordMultiGet(
+  const rocksdb::ReadOptions& options,
+  rocksdb::ColumnFamilyHandle* columnFamily,
+  const std::vector<rocksdb::Slice>& keys,
+  std::vector<std::string>* values,
+  std::vector<rocksdb::Status>* statuses) {
+  size_t size = 0;
+  for (const auto& key : keys) {
+    size += key.size();
+  }
+  novadb_ROCKSDB_LATENCY_RECORD(
+    firstMultiGetError(
+      *statuses = multiGet(options, columnFamily, keys, values)),
+    size,
+    RocksdbLatencyType::RLT_GET);
+}
+
 rocksdb::Status RocksTxn::del(rocksdb::ColumnFamilyHandle* columnFamily,
                               const std::string& key) {
   novadb_ROCKSDB_LATENCY_RECORD(_txn->Delete(columnFamily, key),
@@ -753,6 +981,12 @@ rocksdb::Status RocksTxn::del(rocksdb::ColumnFamilyHandle* columnFamily,
                                 RocksdbLatencyType::RLT_DELETE);
 }
 
+rocksdb::Status RocksTxn::merge(rocksdb::ColumnFamilyHandle* columnFamily,
+                                const std::string& key,
+                                const std::string& val) {
+  return _txn->MergeUntracked(columnFamily, key, val);
+}
+
 rocksdb::Status RocksTxn::txnCommit() {
   novadb_ROCKSDB_LATENCY_RECORD(
     _txn->Commit(), size_t(0), RocksdbLatencyType::RLT_COMMIT);
@@ -762,6 +996,15 @@ const rocksdb::Snapshot* RocksTxn::getSnapshot() {
   return _txn->GetSnapshot();
 }
 
+void RocksTxn::refreshSnapshot() {
+  INVARIANT_D(!_done && _replLogValues.empty());
+  // NOTE: only the txns with a snapshot (RocksOptTxn) need to re-take it,
+  // the others read the latest data anyway.
+  if (_txn != nullptr && _txn->GetSnapshot() != nullptr) {
+    _txn->SetSnapshot();
+  }
+}
+
 rocksdb::Iterator* RocksTxn::getIterator(
   rocksdb::ReadOptions readOpts, rocksdb::ColumnFamilyHandle* columnFamily) {
   return _txn->GetIterator(readOpts, columnFamily);
@@ -879,6 +1122,10 @@ RocksWBTxn::RocksWBTxn(RocksKVStore* store,
     new rocksdb::WriteBatchWithIndex(rocksdb::BytewiseComparator(), 0, true);
 }
 
+rocksdb::WriteBatch* RocksWBTxn::getPendingBatch() {
+  return _writeBatch->GetWriteBatch();
+}
+
 RocksWBTxn::~RocksWBTxn() {
   delete _writeBatch;
   if (_snapshot) {
@@ -901,6 +1148,15 @@ void RocksWBTxn::SetSnapshot() {
   }
 }
 
+void RocksWBTxn::refreshSnapshot() {
+  INVARIANT_D(!_done && _replLogValues.empty());
+  if (_snapshot) {
+    _store->getBaseDB()->ReleaseSnapshot(_snapshot);
+    _snapshot = const_cast<rocksdb::Snapshot*>(_store->getSnapshot());
+    INVARIANT_D(_snapshot != nullptr);
+  }
+}
+
 Status RocksWBTxn::rollback() {
   INVARIANT_D(!_done);
   _done = true;
@@ -940,6 +1196,37 @@ rocksdb::Status RocksWBTxn::get(const rocksdb::ReadOptions& options,
     RocksdbLatencyType::RLT_GET);
 }
 
+std::vector<rocksdb::Status> RocksWBTxn::multiGet(
+  const rocksdb::ReadOptions& options,
+  rocksdb::ColumnFamilyHandle* columnFamily,
+  const std::vector<rocksdb::Slice>& keys,
+  std::vector<std::string>* values) {
+  std::vector<rocksdb::Status> statuses(keys.size());
+  values->resize(keys.size());
+#if ROCKSDB_MAJOR > 6 || (ROCKSDB_MAJOR == 6 && ROCKSDB_MINOR > 14)
+  std::vector<rocksdb::PinnableSlice> pinned(keys.size());
+  _writeBatch->MultiGetFromBatchAndDB(_store->getBaseDB(),
+                                      options,
+                                      columnFamily,
+                                      keys.size(),
+                                      keys.data(),
+                                      pinned.data(),
+                                      statuses.data(),
+                                      true /* sorted_input */);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (statuses[i].ok()) {
+      (*values)[i].assign(pinned[i].data(), pinned[i].size());
+    }
+  }
+#else
+  for (size_t i = 0; i < keys.size(); ++i) {
+    statuses[i] = _writeBatch->GetFromBatchAndDB(
+      _store->getBaseDB(), options, columnFamily, keys[i], &(*values)[i]);
+  }
+#endif
+  return statuses;
+}
+
 rocksdb::Status RocksWBTxn::del(rocksdb::ColumnFamilyHandle* columnFamily,
                                 const std::string& key) {
   novadb_ROCKSDB_LATENCY_RECORD(_writeBatch->Delete(columnFamily, key),
@@ -947,6 +1234,12 @@ rocksdb::Status RocksWBTxn::del(rocksdb::ColumnFamilyHandle* columnFamily,
                                 RocksdbLatencyType::RLT_DELETE);
 }
 
+rocksdb::Status RocksWBTxn::merge(rocksdb::ColumnFamilyHandle* columnFamily,
+                                  const std::string& key,
+                                  const std::string& val) {
+  return _writeBatch->Merge(columnFamily, key, val);
+}
+
 rocksdb::Status RocksWBTxn::txnCommit() {
   novadb_ROCKSDB_LATENCY_RECORD(
     _store->getBaseDB()->Write(_writeOpts, _writeBatch->GetWriteBatch()),
@@ -1316,7 +1609,26 @@ RocksKVStore::RocksKVStore(
     _nextTxnSeq(0),
     _highestVisible(Transaction::TXNID_UNINITED),
     _logOb(nullptr),
-    _env(std::make_shared<RocksdbEnv>()) {
+    _env(std::make_shared<RocksdbEnv>()),
+    _valueCache(cfg->valueCacheMB && id != CATALOG_NAME
+                  ? std::make_unique<RocksValueCache>(
+                      cfg->valueCacheMB * 1024 * 1024LL /
+                        std::max(cfg->kvStoreCount, 1U),
+                      RocksValueCache::DEFAULT_SHARD_BITS)
+                  : nullptr),
+    _metaCache(cfg->compactionMetaCacheMB && id != CATALOG_NAME
+                 ? std::make_unique<RocksValueCache>(
+                     cfg->compactionMetaCacheMB * 1024 * 1024LL /
+                       std::max(cfg->kvStoreCount, 1U),
+                     RocksValueCache::DEFAULT_SHARD_BITS)
+                 : nullptr),
+    _binlogRing(cfg->binlogRingMB && id != CATALOG_NAME
+                  ? std::make_unique<RocksBinlogRing>(
+                      cfg->binlogRingMB * 1024 * 1024LL /
+                        std::max(cfg->kvStoreCount, 1U))
+                  : nullptr),
+    _keyCountReady(false),
+    _keyCounting(false) {
   Expected<uint64_t> s =
     restart(false, Transaction::MIN_VALID_TXNID, UINT64_MAX, flag);
   if (!s.ok()) {
@@ -1327,6 +1639,39 @@ RocksKVStore::RocksKVStore(
   initRocksProperties();
 }
 
+// the values of the key counters are RecordValues of the decimal counts,
+// merging them adds the counts up.
+class KeyCountMergeOperator : public rocksdb::AssociativeMergeOperator {
+ public:
+  bool Merge(const rocksdb::Slice& key,
+             const rocksdb::Slice* existing_value,
+             const rocksdb::Slice& value,
+             std::string* new_value,
+             rocksdb::Logger* logger) const override {
+    int64_t sum = 0;
+    for (const auto* v : {existing_value, &value}) {
+      if (v == nullptr) {
+        continue;
+      }
+      auto rv = RecordValue::decode(v->ToString());
+      if (!rv.ok()) {
+        return false;
+      }
+      auto n = ::novadbplus::stoll(rv.value().getValue());
+      if (!n.ok()) {
+        return false;
+      }
+      sum += n.value();
+    }
+    *new_value = RocksKVStore::keyCountValue(sum);
+    return true;
+  }
+
+  const char* Name() const override {
+    return "KeyCountMergeOperator";
+  }
+};
+
 rocksdb::Options RocksKVStore::options(const std::string cf) {
   rocksdb::Options options;
   rocksdb::BlockBasedTableOptions table_options;
@@ -1428,6 +1773,7 @@ rocksdb::Options RocksKVStore::options(const std::string cf) {
     // setup the ttlcompactionfilter expect "catalog" db
     options.compaction_filter_factory.reset(
       new KVTtlCompactionFilterFactory(this, _cfg));
+    options.merge_operator = std::make_shared<KeyCountMergeOperator>();
   }
 
   _env->clear();
@@ -1471,6 +1817,13 @@ bool RocksKVStore::isEmpty(bool ignoreBinlog) const {
 
   auto baseCursor = txn->createAllDataCursor();
   Expected<std::string> expKey = baseCursor->key();
+  // NOTE: the key counters are not data
+  if (expKey.ok() &&
+      RecordKey::decodeChunkId(expKey.value()) == KEYCOUNT_CHUNKID) {
+    RecordKey next(KEYCOUNT_CHUNKID + 1, 0, RecordType::RT_INVALID, "", "");
+    baseCursor->seek(next.prefixChunkid());
+    expKey = baseCursor->key();
+  }
 
   if (expKey.ok()) {
     return false;
@@ -1526,12 +1879,39 @@ Status RocksKVStore::stop() {
   }
   _isRunning = false;
 
+  // NOTE: the compaction filter reads the db by _cfHandles, wait for the
+  // running compactions before closing.
+  if (_optdb || _pesdb) {
+    rocksdb::CancelAllBackgroundWork(getBaseDB(), true);
+    auto s = flushDroppedKeyCounts();
+    if (!s.ok()) {
+      LOG(ERROR) << "dbId:" << dbId()
+                 << " flush key counts failed:" << s.toString();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> klk(_keyCountMutex);
+    _droppedKeyCounts.clear();
+  }
+  _keyCountReady = false;
+  _keyCounting = false;
   for (auto* h : _cfHandles) {
     delete h;
   }
   _cfHandles.clear();
   _optdb.reset();
   _pesdb.reset();
+  // NOTE: the sequences of a reopened(or restored) db have nothing to do
+  // with the cached ones
+  if (_valueCache) {
+    _valueCache->invalidateAll(0);
+  }
+  if (_metaCache) {
+    _metaCache->invalidateAll(0);
+  }
+  if (_binlogRing) {
+    _binlogRing->reset(std::numeric_limits<uint64_t>::max());
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -1814,10 +2194,8 @@ Expected<bool> RocksKVStore::validateAllBinlog(Transaction* txn) const {
 }
 
 Status RocksKVStore::setLogObserver(std::shared_ptr<BinlogObserver> ob) {
+  // NOTE: a stopped store keeps its observer when it is restarted
   std::lock_guard<std::mutex> lk(_mutex);
-  if (!_isRunning) {
-    return {ErrorCodes::ERR_OK, ""};
-  }
   if (_logOb != nullptr) {
     return {ErrorCodes::ERR_INTERNAL, "logOb already exists"};
   }
@@ -2383,6 +2761,12 @@ Expected<uint64_t> RocksKVStore::restart(bool restore,
       _highestVisible = maxCommitId;
     }
   }
+  if (_binlogRing) {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _binlogRing->reset(_highestVisible + 1);
+  }
+  auto s = initKeyCount();
+  RET_IF_ERR(s);
   return maxCommitId;
 }
 
@@ -2754,6 +3138,15 @@ uint64_t RocksKVStore::getHighestBinlogId() const {
   return _highestVisible;
 }
 
+Expected<std::vector<ReplLogRawV2>> RocksKVStore::getRecentBinlogs(
+  uint64_t binlogPos, uint32_t maxCount, size_t maxBytes) {
+  if (!_binlogRing) {
+    return {ErrorCodes::ERR_NOTFOUND, "binlog ring disabled"};
+  }
+  return _binlogRing->read(
+    binlogPos, getHighestBinlogId(), maxCount, maxBytes);
+}
+
 uint64_t RocksKVStore::getNextBinlogSeq() const {
   std::lock_guard<std::mutex> lk(_mutex);
   return _nextBinlogSeq;
@@ -2808,6 +3201,7 @@ void RocksKVStore::markCommittedInLock(uint64_t txnId, uint64_t binlogTxnId) {
     i->second.first = true;
     i->second.second = binlogTxnId;
     if (i == _aliveBinlogs.begin()) {
+      uint64_t oldVisible = _highestVisible;
       while (i != _aliveBinlogs.end()) {
         if (!i->second.first) {
           break;
@@ -2819,6 +3213,9 @@ void RocksKVStore::markCommittedInLock(uint64_t txnId, uint64_t binlogTxnId) {
         }
         i = _aliveBinlogs.erase(i);
       }
+      if (_logOb && _highestVisible != oldVisible) {
+        _logOb->onCommitted(_highestVisible);
+      }
     }
   }
 }
@@ -2826,11 +3223,247 @@ void RocksKVStore::markCommittedInLock(uint64_t txnId, uint64_t binlogTxnId) {
 Expected<RecordValue> RocksKVStore::getKV(const RecordKey& key,
                                           Transaction* txn) {
   INVARIANT_D(txn->getKVStoreId() == dbId());
-  Expected<std::string> s = txn->getKV(key.encode());
+  auto rtxn = static_cast<RocksTxn*>(txn);
+  if (!_valueCache || !rtxn->canUseValueCache() ||
+      key.getRecordType() == RecordType::RT_BINLOG) {
+    Expected<std::string> s = txn->getKV(key.encode());
+    if (!s.ok()) {
+      return s.status();
+    }
+    return RecordValue::decode(s.value());
+  }
+
+  std::string encodedKey = key.encode();
+  uint64_t readSeq = rtxn->getReadSeq();
+  RecordValue cached(RecordType::RT_INVALID);
+  if (_valueCache->lookup(encodedKey, readSeq, &cached)) {
+    rtxn->noteKeyExists(encodedKey, true);
+    return std::move(cached);
+  }
+  uint64_t generation = _valueCache->getGeneration();
+  if (readSeq == RocksValueCache::READ_LATEST) {
+    // the read below sees at least this sequence
+    readSeq = getBaseDB()->GetLatestSequenceNumber();
+  }
+  Expected<std::string> s = txn->getKV(encodedKey);
   if (!s.ok()) {
     return s.status();
   }
-  return RecordValue::decode(s.value());
+  auto v = RecordValue::decode(s.value());
+  if (v.ok()) {
+    _valueCache->insert(encodedKey, v.value(), readSeq, generation);
+  }
+  return v;
+}
+
+// collects the keys of the data column family written by a batch
+class CacheKeyCollector : public rocksdb::WriteBatch::Handler {
+ public:
+  CacheKeyCollector(uint32_t cfId, CacheKeys* keys)
+    : _cfId(cfId), _keys(keys) {}
+
+  rocksdb::Status PutCF(uint32_t cfId,
+                        const rocksdb::Slice& key,
+                        const rocksdb::Slice& value) final {
+    return add(cfId, key);
+  }
+  rocksdb::Status DeleteCF(uint32_t cfId, const rocksdb::Slice& key) final {
+    return add(cfId, key);
+  }
+  rocksdb::Status SingleDeleteCF(uint32_t cfId,
+                                 const rocksdb::Slice& key) final {
+    return add(cfId, key);
+  }
+  rocksdb::Status MergeCF(uint32_t cfId,
+                          const rocksdb::Slice& key,
+                          const rocksdb::Slice& value) final {
+    return add(cfId, key);
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t cfId,
+                                const rocksdb::Slice& begin,
+                                const rocksdb::Slice& end) final {
+    if (cfId == _cfId) {
+      _keys->all = true;
+    }
+    return rocksdb::Status::OK();
+  }
+
+ private:
+  rocksdb::Status add(uint32_t cfId, const rocksdb::Slice& key) {
+    if (cfId == _cfId && !_keys->all) {
+      _keys->keys.emplace_back(key.data(), key.size());
+    }
+    return rocksdb::Status::OK();
+  }
+
+  const uint32_t _cfId;
+  CacheKeys* _keys;
+};
+
+void RocksKVStore::collectCacheKeys(const rocksdb::WriteBatch& batch,
+                                    CacheKeys* keys) {
+  INVARIANT_D(hasKeyCache());
+  CacheKeyCollector collector(getDataColumnFamilyHandle()->GetID(), keys);
+  auto s = batch.Iterate(&collector);
+  if (!s.ok()) {
+    // unknown records, drop the whole cache to be safe
+    LOG(WARNING) << "dbId:" << dbId()
+                 << " iterate write batch failed:" << s.ToString();
+    keys->all = true;
+  }
+}
+
+void RocksKVStore::invalidateValueCache(const CacheKeys& keys) {
+  if (!hasKeyCache()) {
+    return;
+  }
+  if (keys.all) {
+    invalidateValueCache();
+  } else if (!keys.keys.empty()) {
+    uint64_t seq = getBaseDB()->GetLatestSequenceNumber();
+    if (_valueCache) {
+      _valueCache->invalidate(keys.keys, seq);
+    }
+    if (_metaCache) {
+      _metaCache->invalidate(keys.keys, seq);
+    }
+  }
+}
+
+rocksdb::Status RocksKVStore::write(const rocksdb::WriteOptions& writeOpts,
+                                    rocksdb::WriteBatch* batch) {
+  auto s = getBaseDB()->Write(writeOpts, batch);
+  if (s.ok() && hasKeyCache()) {
+    CacheKeys keys;
+    collectCacheKeys(*batch, &keys);
+    invalidateValueCache(keys);
+  }
+  return s;
+}
+
+void RocksKVStore::invalidateValueCache() {
+  if (!hasKeyCache()) {
+    return;
+  }
+  uint64_t seq = getBaseDB()->GetLatestSequenceNumber();
+  if (_valueCache) {
+    _valueCache->invalidateAll(seq);
+  }
+  if (_metaCache) {
+    _metaCache->invalidateAll(seq);
+  }
+}
+
+std::vector<Expected<RecordValue>> RocksKVStore::multiGetKV(
+  const std::vector<RecordKey>& keys, Transaction* txn) {
+  INVARIANT_D(txn->getKVStoreId() == dbId());
+  auto rtxn = static_cast<RocksTxn*>(txn);
+  bool useCache = _valueCache && rtxn->canUseValueCache();
+  uint64_t readSeq = useCache ? rtxn->getReadSeq() : 0;
+
+  // the cached ones are served directly, the rest are batched
+  std::vector<std::unique_ptr<RecordValue>> cached(keys.size());
+  std::vector<std::string> encodedKeys;
+  encodedKeys.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto encodedKey = keys[i].encode();
+    if (useCache) {
+      RecordValue v(RecordType::RT_INVALID);
+      if (_valueCache->lookup(encodedKey, readSeq, &v)) {
+        cached[i] = std::make_unique<RecordValue>(std::move(v));
+        continue;
+      }
+    }
+    encodedKeys.emplace_back(std::move(encodedKey));
+  }
+
+  uint64_t generation = 0;
+  if (useCache) {
+    generation = _valueCache->getGeneration();
+    if (readSeq == RocksValueCache::READ_LATEST) {
+      readSeq = getBaseDB()->GetLatestSequenceNumber();
+    }
+  }
+  auto values = txn->multiGetKV(encodedKeys);
+  INVARIANT_D(values.size() == encodedKeys.size());
+
+  std::vector<Expected<RecordValue>> result;
+  result.reserve(keys.size());
+  size_t j = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (cached[i]) {
+      result.emplace_back(std::move(*cached[i]));
+      continue;
+    }
+    auto& v = values[j];
+    if (!v.ok()) {
+      result.emplace_back(v.status());
+    } else {
+      result.emplace_back(RecordValue::decode(v.value()));
+      if (useCache && result.back().ok()) {
+        _valueCache->insert(
+          encodedKeys[j], result.back().value(), readSeq, generation);
+      }
+    }
+    ++j;
+  }
+  return result;
+}
+
+bool RocksKVStore::probeKV(const RecordKey& key,
+                           Expected<RecordValue>* value) {
+  *value = {ErrorCodes::ERR_NOTFOUND, ""};
+  if (!isOpen() || isPaused()) {
+    return false;
+  }
+  rocksdb::ReadOptions readOpts;
+  // NOTE: with kBlockCacheTier, rocksdb only looks into the memtables and
+  // the block cache, and returns Incomplete if the lookup needs any io.
+  readOpts.read_tier = rocksdb::kBlockCacheTier;
+  rocksdb::PinnableSlice pinned;
+  auto s = getBaseDB()->Get(
+    readOpts, getDataColumnFamilyHandle(), key.encode(), &pinned);
+  if (s.ok()) {
+    *value = RecordValue::decode(pinned.ToString());
+    return value->ok();
+  }
+  return s.IsNotFound();
+}
+
+Expected<RecordValue> RocksKVStore::getLatestMeta(const RecordKey& key) {
+  std::string encodedKey = key.encode();
+  uint64_t generation = 0;
+  uint64_t readSeq = 0;
+  if (_metaCache) {
+    RecordValue cached(RecordType::RT_INVALID);
+    if (_metaCache->lookup(encodedKey, RocksValueCache::READ_LATEST, &cached)) {
+      return std::move(cached);
+    }
+    generation = _metaCache->getGeneration();
+    readSeq = getBaseDB()->GetLatestSequenceNumber();
+  }
+
+  rocksdb::PinnableSlice value;
+  auto s = getBaseDB()->Get(
+    rocksdb::ReadOptions(), getDataColumnFamilyHandle(), encodedKey, &value);
+  if (s.IsNotFound()) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  } else if (!s.ok()) {
+    return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+  }
+  auto v = RecordValue::decode(value.ToString());
+  if (!v.ok()) {
+    return v.status();
+  }
+  // NOTE: the value of a meta can be large(e.g. the inline fields of a
+  // hash), only the header is kept.
+  RecordValue meta(
+    "", v.value().getRecordType(), -1, v.value().getTtl(), -1,
+    v.value().getVersion());
+  if (_metaCache) {
+    _metaCache->insert(encodedKey, meta, readSeq, generation);
+  }
+  return std::move(meta);
 }
 
 Status RocksKVStore::setKV(const RecordKey& key,
@@ -2914,6 +3547,15 @@ Status RocksKVStore::deleteRangeWithoutBinlog(
     LOG(ERROR) << "deleteRange failed:" << status.ToString();
     return handleRocksdbError(status);
   }
+  invalidateValueCache();
+  // NOTE: the whole chunks are deleted by the slots gc, the counters of
+  // them are reset. The ranges of the subkeys have no meta in them.
+  if (column_family == getDataColumnFamilyHandle() &&
+      begin.size() == sizeof(uint32_t) && end.size() == sizeof(uint32_t)) {
+    auto s = resetKeyCounts(int32Decode(begin.c_str()),
+                            int32Decode(end.c_str()));
+    RET_IF_ERR(s);
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -2981,6 +3623,322 @@ Status RocksKVStore::deleteFilesInRangeWithoutBinlog(
     LOG(ERROR) << "deleteFilesInRange failed:" << status.ToString();
     return handleRocksdbError(status);
   }
+  invalidateValueCache();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<uint64_t> RocksKVStore::createSlotsSstFile(Transaction* txn,
+                                                  uint32_t begin,
+                                                  uint32_t end,
+                                                  const std::string& fname) {
+  auto cursor = txn->createSlotsCursor(begin, end);
+  rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), defaultColumnOptions());
+  uint64_t count = 0;
+  while (true) {
+    Expected<Record> expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    }
+    RET_IF_ERR_EXPECTED(expRcd);
+    // NOTE: SstFileWriter can't finish an empty file
+    rocksdb::Status s;
+    if (count == 0) {
+      s = writer.Open(fname);
+      if (!s.ok()) {
+        return handleRocksdbError(s);
+      }
+    }
+    s = writer.Put(expRcd.value().getRecordKey().encode(),
+                   expRcd.value().getRecordValue().encode());
+    if (!s.ok()) {
+      return handleRocksdbError(s);
+    }
+    count++;
+  }
+  if (count > 0) {
+    auto s = writer.Finish();
+    if (!s.ok()) {
+      return handleRocksdbError(s);
+    }
+  }
+  return count;
+}
+
+Status RocksKVStore::ingestSstFiles(const std::vector<std::string>& files) {
+  for (const auto& file : files) {
+    auto s = rocksdb::VerifySstFileChecksum(
+      rocksdb::Options(), rocksdb::EnvOptions(), file);
+    if (!s.ok()) {
+      LOG(ERROR) << "verify sst file:" << file << " failed:" << s.ToString();
+      return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+    }
+  }
+  rocksdb::IngestExternalFileOptions ingestOpts;
+  ingestOpts.move_files = true;
+  auto s = getBaseDB()->IngestExternalFile(
+    getDataColumnFamilyHandle(), files, ingestOpts);
+  if (!s.ok()) {
+    LOG(ERROR) << "ingestExternalFile failed:" << s.ToString();
+    return handleRocksdbError(s);
+  }
+  invalidateValueCache();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+// the counters are trusted if this key exists
+static std::string keyCountReadyKey() {
+  return RecordKey(
+           KEYCOUNT_CHUNKID, KEYCOUNT_DBID, RecordType::RT_META, "ready", "")
+    .encode();
+}
+
+static Expected<int64_t> decodeKeyCount(const std::string& value) {
+  auto rv = RecordValue::decode(value);
+  RET_IF_ERR_EXPECTED(rv);
+  return ::novadbplus::stoll(rv.value().getValue());
+}
+
+// NOTE: the counters of a db are adjacent, and ordered by chunkid
+static RecordKey keyCountRecordKey(uint32_t chunkId, uint32_t dbId) {
+  std::string pk(sizeof(chunkId), '\0');
+  int32Encode(&pk[0], chunkId);
+  return RecordKey(KEYCOUNT_CHUNKID, dbId, RecordType::RT_META, pk, "");
+}
+
+static std::string keyCountPrefix(uint32_t chunkId, uint32_t dbId) {
+  return keyCountRecordKey(chunkId, dbId).prefixPk();
+}
+
+std::string RocksKVStore::keyCountKey(uint32_t chunkId, uint32_t dbId) {
+  return keyCountRecordKey(chunkId, dbId).encode();
+}
+
+std::string RocksKVStore::keyCountValue(int64_t n) {
+  return RecordValue(std::to_string(n), RecordType::RT_META, -1).encode();
+}
+
+// NOTE: the stores written by the older versions have no counters, they
+// are ready after recounting all the chunks.
+Status RocksKVStore::initKeyCount() {
+  _keyCountReady = false;
+  _keyCounting = false;
+  if (dbId() == CATALOG_NAME) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  std::string value;
+  auto s = getBaseDB()->Get(
+    rocksdb::ReadOptions(), getDataColumnFamilyHandle(), keyCountReadyKey(),
+    &value);
+  if (!s.ok() && !s.IsNotFound()) {
+    return handleRocksdbError(s);
+  }
+  if (!_cfg->keyCountEnabled) {
+    // the counters go stale from now on, recount them to enable it again
+    if (s.ok()) {
+      rocksdb::WriteBatch batch;
+      batch.Delete(getDataColumnFamilyHandle(), keyCountReadyKey());
+      auto ws = write(writeOptions(), &batch);
+      if (!ws.ok()) {
+        return handleRocksdbError(ws);
+      }
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  if (s.ok()) {
+    _keyCountReady = true;
+    _keyCounting = true;
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  if (isEmpty(true)) {
+    return setKeyCountReady();
+  }
+  LOG(WARNING) << "dbId:" << dbId()
+               << " has no key counters, recount the keys to use them";
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status RocksKVStore::setKeyCountReady() {
+  rocksdb::WriteBatch batch;
+  batch.Put(
+    getDataColumnFamilyHandle(), keyCountReadyKey(), keyCountValue(0));
+  auto s = write(writeOptions(), &batch);
+  if (!s.ok()) {
+    return handleRocksdbError(s);
+  }
+  _keyCounting = true;
+  _keyCountReady = true;
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+void RocksKVStore::startKeyCount() {
+  _keyCounting = _cfg->keyCountEnabled;
+}
+
+void RocksKVStore::onExpiredKeyDropped(const rocksdb::Slice& key,
+                                       const rocksdb::Slice& value) {
+  uint32_t chunkId = int32Decode(key.data() + RecordKey::CHUNKID_OFFSET);
+  if (chunkId >= CLUSTER_SLOTS || !_keyCounting) {
+    return;
+  }
+  // NOTE: if the key is rewritten or deleted later, the version dropped is
+  // not the one counted. The txn rewriting it meanwhile still sees the
+  // dropped one and doesn't count it again, recountkeys fixes it.
+  std::string cur;
+  auto s = getBaseDB()->Get(
+    rocksdb::ReadOptions(), getDataColumnFamilyHandle(), key, &cur);
+  if (!s.ok() || cur != value) {
+    return;
+  }
+  uint32_t dbid = int32Decode(key.data() + RecordKey::DBID_OFFSET);
+  std::lock_guard<std::mutex> lk(_keyCountMutex);
+  _droppedKeyCounts[{chunkId, dbid}]--;
+}
+
+// NOTE: the compaction filter can't write the db, a write stall would
+// wait for the compaction itself.
+Status RocksKVStore::flushDroppedKeyCounts() {
+  std::map<std::pair<uint32_t, uint32_t>, int64_t> dropped;
+  {
+    std::lock_guard<std::mutex> lk(_keyCountMutex);
+    dropped.swap(_droppedKeyCounts);
+  }
+  if (dropped.empty()) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  rocksdb::WriteBatch batch;
+  for (const auto& kv : dropped) {
+    batch.Merge(getDataColumnFamilyHandle(),
+                keyCountKey(kv.first.first, kv.first.second),
+                keyCountValue(kv.second));
+  }
+  auto s = write(writeOptions(), &batch);
+  if (!s.ok()) {
+    std::lock_guard<std::mutex> lk(_keyCountMutex);
+    for (const auto& kv : dropped) {
+      _droppedKeyCounts[kv.first] += kv.second;
+    }
+    return handleRocksdbError(s);
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status RocksKVStore::resetKeyCounts(uint32_t begin, uint32_t end) {
+  end = std::min(end, static_cast<uint32_t>(CLUSTER_SLOTS));
+  if (begin >= end) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  {
+    std::lock_guard<std::mutex> lk(_keyCountMutex);
+    auto it = _droppedKeyCounts.lower_bound({begin, 0});
+    while (it != _droppedKeyCounts.end() && it->first.first < end) {
+      it = _droppedKeyCounts.erase(it);
+    }
+  }
+  rocksdb::WriteBatch batch;
+  for (uint32_t dbid = 0; dbid < _cfg->dbNum; dbid++) {
+    batch.DeleteRange(getDataColumnFamilyHandle(),
+                      keyCountPrefix(begin, dbid),
+                      keyCountPrefix(end, dbid));
+  }
+  auto s = write(writeOptions(), &batch);
+  if (!s.ok()) {
+    return handleRocksdbError(s);
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<std::map<uint32_t, uint64_t>> RocksKVStore::getKeyCounts(
+  uint32_t dbId) {
+  auto s = flushDroppedKeyCounts();
+  RET_IF_ERR(s);
+
+  std::string upper = keyCountPrefix(CLUSTER_SLOTS, dbId);
+  rocksdb::Slice upperSlice(upper);
+  rocksdb::ReadOptions readOpts;
+  readOpts.iterate_upper_bound = &upperSlice;
+  std::unique_ptr<rocksdb::Iterator> iter(
+    getBaseDB()->NewIterator(readOpts, getDataColumnFamilyHandle()));
+  std::map<uint32_t, uint64_t> result;
+  for (iter->Seek(keyCountPrefix(0, dbId)); iter->Valid(); iter->Next()) {
+    auto rk = RecordKey::decode(iter->key().ToString());
+    RET_IF_ERR_EXPECTED(rk);
+    auto n = decodeKeyCount(iter->value().ToString());
+    RET_IF_ERR_EXPECTED(n);
+    if (n.value() > 0) {
+      result[int32Decode(rk.value().getPrimaryKey().c_str())] = n.value();
+    }
+  }
+  if (!iter->status().ok()) {
+    return handleRocksdbError(iter->status());
+  }
+  return result;
+}
+
+Expected<uint64_t> RocksKVStore::getChunkKeyCount(uint32_t chunkId) {
+  auto s = flushDroppedKeyCounts();
+  RET_IF_ERR(s);
+
+  uint64_t count = 0;
+  for (uint32_t dbid = 0; dbid < _cfg->dbNum; dbid++) {
+    std::string value;
+    auto rs = getBaseDB()->Get(rocksdb::ReadOptions(),
+                               getDataColumnFamilyHandle(),
+                               keyCountKey(chunkId, dbid),
+                               &value);
+    if (rs.IsNotFound()) {
+      continue;
+    }
+    if (!rs.ok()) {
+      return handleRocksdbError(rs);
+    }
+    auto n = decodeKeyCount(value);
+    RET_IF_ERR_EXPECTED(n);
+    if (n.value() > 0) {
+      count += n.value();
+    }
+  }
+  return count;
+}
+
+Status RocksKVStore::recountKeys(uint32_t chunkId) {
+  if (!_keyCounting) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  auto ptxn = createTransaction(nullptr);
+  RET_IF_ERR_EXPECTED(ptxn);
+  auto cursor = ptxn.value()->createSlotCursor(chunkId);
+  std::map<uint32_t, int64_t> counts;
+  while (true) {
+    Expected<Record> expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    }
+    RET_IF_ERR_EXPECTED(expRcd);
+    counts[expRcd.value().getRecordKey().getDbId()]++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(_keyCountMutex);
+    auto it = _droppedKeyCounts.lower_bound({chunkId, 0});
+    while (it != _droppedKeyCounts.end() && it->first.first == chunkId) {
+      it = _droppedKeyCounts.erase(it);
+    }
+  }
+  rocksdb::WriteBatch batch;
+  for (uint32_t dbid = 0; dbid < _cfg->dbNum; dbid++) {
+    if (counts.find(dbid) == counts.end()) {
+      batch.Delete(getDataColumnFamilyHandle(), keyCountKey(chunkId, dbid));
+    }
+  }
+  for (const auto& kv : counts) {
+    batch.Put(getDataColumnFamilyHandle(),
+              keyCountKey(chunkId, kv.first),
+              keyCountValue(kv.second));
+  }
+  auto s = write(writeOptions(), &batch);
+  if (!s.ok()) {
+    return handleRocksdbError(s);
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -3193,6 +4151,24 @@ uint64_t RocksKVStore::getStatCountByName(const std::string& name) const {
     return stat.compactFilterCount.load(std::memory_order_relaxed);
   } else if (name == "rocksdb.compaction-kv-expired-count") {
     return stat.compactKvExpiredCount.load(std::memory_order_relaxed);
+  } else if (name == "rocksdb.compaction-subkey-expired-count") {
+    return stat.compactSubKeyExpiredCount.load(std::memory_order_relaxed);
+  } else if (name == "valuecache.capacity") {
+    return _valueCache ? _valueCache->getCapacity() : 0;
+  } else if (name == "valuecache.usage") {
+    return _valueCache ? _valueCache->getUsage() : 0;
+  } else if (name == "valuecache.hits") {
+    return _valueCache ? _valueCache->getHits() : 0;
+  } else if (name == "valuecache.misses") {
+    return _valueCache ? _valueCache->getMisses() : 0;
+  } else if (name == "metacache.capacity") {
+    return _metaCache ? _metaCache->getCapacity() : 0;
+  } else if (name == "metacache.usage") {
+    return _metaCache ? _metaCache->getUsage() : 0;
+  } else if (name == "metacache.hits") {
+    return _metaCache ? _metaCache->getHits() : 0;
+  } else if (name == "metacache.misses") {
+    return _metaCache ? _metaCache->getMisses() : 0;
   }
 
   INVARIANT_D(0);
@@ -3557,6 +4533,8 @@ void RocksKVStore::appendJSONStat(
   w.Uint64(stat.compactFilterCount.load(std::memory_order_relaxed));
   w.Key("compact_kvexpired_count");
   w.Uint64(stat.compactKvExpiredCount.load(std::memory_order_relaxed));
+  w.Key("compact_subkeyexpired_count");
+  w.Uint64(stat.compactSubKeyExpiredCount.load(std::memory_order_relaxed));
   w.Key("paused_error_count");
   w.Uint64(stat.pausedErrorCount.load(std::memory_order_relaxed));
   w.Key("destroyed_error_count");
@@ -25,6 +25,8 @@
 
 #include "novadbplus/server/server_params.h"
 #include "novadbplus/storage/kvstore.h"
+#include "novadbplus/storage/rocks/rocks_binlog_ring.h"
+#include "novadbplus/storage/rocks/rocks_value_cache.h"
 
 namespace novadbplus {
 
@@ -32,6 +34,13 @@ class RocksKVStore;
 class RocksdbEnv;
 class BackgroundErrorListener;
 
+// the keys written, to be invalidated in the value cache
+struct CacheKeys {
+  std::vector<std::string> keys;
+  // a range is deleted, invalidate the whole cache
+  bool all = false;
+};
+
 enum class TxnMode {
   TXN_OPT = 0,
   TXN_PES = 1,
@@ -59,6 +68,8 @@ class RocksTxn : public Transaction {
                                                  uint32_t end) final;
   std::unique_ptr<VersionMetaCursor> createVersionMetaCursor() final;
   std::unique_ptr<BasicDataCursor> createDataCursor() final;
+  std::unique_ptr<BasicDataCursor> createRangeDataCursor(
+    const std::string& upperBound, size_t readaheadSize = 0) final;
   std::unique_ptr<AllDataCursor> createAllDataCursor() final;
   std::unique_ptr<BinlogCursor> createBinlogCursor() final;
 
@@ -66,6 +77,8 @@ class RocksTxn : public Transaction {
   virtual Status rollback();
   // getKV: get data from chosen column family
   Expected<std::string> getKV(const std::string& key) final;
+  std::vector<Expected<std::string>> multiGetKV(
+    const std::vector<std::string>& keys) final;
   Status setKV(const std::string& key,
                const std::string& val,
                const uint64_t ts = 0) final;
@@ -93,6 +106,7 @@ class RocksTxn : public Transaction {
     return _chunkId;
   }
   void setChunkId(uint32_t chunkId) final;
+  void refreshSnapshot() override;
   uint64_t getTxnId() const final;
   bool isReplOnly() const {
     return _replOnly;
@@ -104,6 +118,13 @@ class RocksTxn : public Transaction {
   void setTxnType(TxnMode type) {
     _txnMode = type;
   }
+  // a txn sees its own uncommitted writes, it can't use the value cache
+  bool canUseValueCache();
+  // the snapshot sequence this txn reads at, or
+  // RocksValueCache::READ_LATEST if it has no snapshot
+  uint64_t getReadSeq();
+  // the command has read the meta key, countKey() needn't read it again
+  void noteKeyExists(const std::string& key, bool exists);
 
   // Transaction API
   // put data to default column family
@@ -115,8 +136,18 @@ class RocksTxn : public Transaction {
                               rocksdb::ColumnFamilyHandle* columnFamily,
                               const std::string& key,
                               std::string* value);
+  // keys should be sorted by the bytewise comparator
+  virtual std::vector<rocksdb::Status> multiGet(
+    const rocksdb::ReadOptions& options,
+    rocksdb::ColumnFamilyHandle* columnFamily,
+    const std::vector<rocksdb::Slice>& keys,
+    std::vector<std::string>* values);
   virtual rocksdb::Status del(rocksdb::ColumnFamilyHandle* columnFamily,
                               const std::string& key);
+  // merge without conflict checking, for the key counters
+  virtual rocksdb::Status merge(rocksdb::ColumnFamilyHandle* columnFamily,
+                                const std::string& key,
+                                const std::string& val);
   virtual const rocksdb::Snapshot* getSnapshot();
   virtual rocksdb::Iterator* getIterator(
     rocksdb::ReadOptions readOpts, rocksdb::ColumnFamilyHandle* columnFamily);
@@ -124,8 +155,22 @@ class RocksTxn : public Transaction {
  protected:
   virtual void ensureTxn() {}
   std::unique_ptr<Cursor> createCursor(
-    ColumnFamilyNumber cf, const std::string* iterate_upper_bound = NULL) final;
+    ColumnFamilyNumber cf,
+    const std::string* iterate_upper_bound = NULL,
+    size_t readahead_size = 0) final;
   virtual rocksdb::Status txnCommit();
+  // multiGet() with one latency record for the batch, the status returned
+  // is the first error other than NotFound
+  rocksdb::Status recordMultiGet(const rocksdb::ReadOptions& options,
+                                 rocksdb::ColumnFamilyHandle* columnFamily,
+                                 const std::vector<rocksdb::Slice>& keys,
+                                 std::vector<std::string>* values,
+                                 std::vector<rocksdb::Status>* statuses);
+  // the writes of this txn not committed yet, nullptr if there is none
+  virtual rocksdb::WriteBatch* getPendingBatch();
+  // called before key is put or deleted, see KVStore::isKeyCountReady()
+  Status countKey(const std::string& key, bool put);
+  Status mergeKeyCounts();
 
   uint64_t _txnId;
   uint64_t _binlogId;
@@ -143,6 +188,12 @@ class RocksTxn : public Transaction {
   RocksKVStore* _store;
 
   std::vector<ReplLogValueEntryV2> _replLogValues;
+  // the binlog written, to be kept in the binlog ring after commit
+  ReplLogRawV2::KV _binlog;
+  // <chunkid, dbid> -> the number of keys added
+  std::map<std::pair<uint32_t, uint32_t>, int64_t> _keyCountDeltas;
+  // the counted meta key -> whether it exists, seen by this txn
+  std::unordered_map<std::string, bool> _keyExists;
 
   // if rollback/commit has been explicitly called
   bool _done;
@@ -204,10 +255,12 @@ class RocksWBTxn : public RocksTxn {
  protected:
   void ensureTxn() final;
   void SetSnapshot() final;
+  void refreshSnapshot() final;
 
   rocksdb::WriteBatchWithIndex* getWriteBatch() {
     return _writeBatch;
   }
+  rocksdb::WriteBatch* getPendingBatch() final;
 
   // Transaction API
   // put data into default column family
@@ -219,8 +272,16 @@ class RocksWBTxn : public RocksTxn {
                       rocksdb::ColumnFamilyHandle* columnFamily,
                       const std::string& key,
                       std::string* value) final;
+  std::vector<rocksdb::Status> multiGet(
+    const rocksdb::ReadOptions& options,
+    rocksdb::ColumnFamilyHandle* columnFamily,
+    const std::vector<rocksdb::Slice>& keys,
+    std::vector<std::string>* values) final;
   rocksdb::Status del(rocksdb::ColumnFamilyHandle* columnFamily,
                       const std::string& key) final;
+  rocksdb::Status merge(rocksdb::ColumnFamilyHandle* columnFamily,
+                        const std::string& key,
+                        const std::string& val) final;
   rocksdb::Status txnCommit() final;
   Status rollback() final;
   const rocksdb::Snapshot* getSnapshot() final;
@@ -275,6 +336,13 @@ class RocksKVStore : public KVStore {
   }
   Expected<std::unique_ptr<Transaction>> createTransaction(Session* sess) final;
   Expected<RecordValue> getKV(const RecordKey&, Transaction*) final;
+  std::vector<Expected<RecordValue>> multiGetKV(
+    const std::vector<RecordKey>& keys, Transaction* txn) final;
+  bool probeKV(const RecordKey& key, Expected<RecordValue>* value) final;
+  // the type, ttl and version of the latest committed meta of key(without
+  // its value), read without txn and through the meta cache, it never
+  // fills the value cache. It's for the compaction filter.
+  Expected<RecordValue> getLatestMeta(const RecordKey& key);
   Status setKV(const RecordKey&, const RecordValue&, Transaction*) final;
   Status delKV(const RecordKey&, Transaction*) final;
 
@@ -306,6 +374,32 @@ class RocksKVStore : public KVStore {
     const std::string& end,
     bool include_end = false) override;
 
+  Expected<uint64_t> createSlotsSstFile(Transaction* txn,
+                                        uint32_t begin,
+                                        uint32_t end,
+                                        const std::string& fname) override;
+  Status ingestSstFiles(const std::vector<std::string>& files) override;
+
+  bool isKeyCountReady() const override {
+    return _keyCountReady;
+  }
+  // the txns count the keys they write
+  bool isKeyCounting() const {
+    return _keyCounting;
+  }
+  void startKeyCount() override;
+  Expected<std::map<uint32_t, uint64_t>> getKeyCounts(
+    uint32_t dbId) override;
+  Expected<uint64_t> getChunkKeyCount(uint32_t chunkId) override;
+  Status recountKeys(uint32_t chunkId) override;
+  Status setKeyCountReady() override;
+  // the key of the counter of (chunkId, dbId), and the value adding n to it
+  static std::string keyCountKey(uint32_t chunkId, uint32_t dbId);
+  static std::string keyCountValue(int64_t n);
+  // an expired key is dropped by the compaction filter
+  void onExpiredKeyDropped(const rocksdb::Slice& key,
+                           const rocksdb::Slice& value);
+
   // [begin, end]
   // [nullptr, nullptr] -> [-inf, +inf]
   Status compactRange(ColumnFamilyNumber cf,
@@ -388,6 +482,8 @@ class RocksKVStore : public KVStore {
   rocksdb::TransactionDB* getUnderlayerPesDB();
 
   uint64_t getHighestBinlogId() const final;
+  Expected<std::vector<ReplLogRawV2>> getRecentBinlogs(
+    uint64_t binlogPos, uint32_t maxCount, size_t maxBytes) final;
 
   // NOTE(deyukong): this api is only for debug
   std::set<uint64_t> getUncommittedTxns() const;
@@ -470,6 +566,24 @@ class RocksKVStore : public KVStore {
   }
   rocksdb::DB* getBaseDB() const;
   rocksdb::WriteOptions writeOptions();
+  RocksValueCache* getValueCache() const {
+    return _valueCache.get();
+  }
+  // whether the written keys are needed to invalidate the caches
+  bool hasKeyCache() const {
+    return _valueCache || _metaCache;
+  }
+  // the keys written by batch in the data column family, for the caches
+  void collectCacheKeys(const rocksdb::WriteBatch& batch, CacheKeys* keys);
+  void invalidateValueCache(const CacheKeys& keys);
+  // every write out of a RocksTxn goes here, it keeps the caches consistent
+  // with rocksdb
+  rocksdb::Status write(const rocksdb::WriteOptions& writeOpts,
+                        rocksdb::WriteBatch* batch);
+  RocksBinlogRing* getBinlogRing() const {
+    return _binlogRing.get();
+  }
+  void invalidateValueCache();
 
  private:
   void addUnCommitedTxnInLock(uint64_t txnId);
@@ -483,6 +597,10 @@ class RocksKVStore : public KVStore {
                                        BackupInfo* result);
   Expected<std::string> loadCopy(const std::string& dir);
   Expected<std::string> copyCkpt(const std::string& dir);
+  Status initKeyCount();
+  Status flushDroppedKeyCounts();
+  // reset the counters of chunks [begin, end)
+  Status resetKeyCounts(uint32_t begin, uint32_t end);
 
  private:
   mutable std::mutex _mutex;
@@ -546,6 +664,21 @@ class RocksKVStore : public KVStore {
   std::map<std::string, std::string> _rocksStringProperties;
   std::vector<rocksdb::ColumnFamilyHandle*> _cfHandles;
   std::vector<rocksdb::ColumnFamilyDescriptor> _cfDescs;
+  // nullptr if valueCacheMB == 0
+  std::unique_ptr<RocksValueCache> _valueCache;
+  // the metas looked up by the compaction filter, shared by the compactions
+  // of this store, nullptr if compactionMetaCacheMB == 0
+  std::unique_ptr<RocksValueCache> _metaCache;
+  // nullptr if binlogRingMB == 0
+  std::unique_ptr<RocksBinlogRing> _binlogRing;
+
+  std::atomic<bool> _keyCountReady;
+  // it's ready, or the chunks are being recounted
+  std::atomic<bool> _keyCounting;
+  // <chunkid, dbid> -> the number of the expired keys dropped by the
+  // compaction filter, merged into the counters before they are read
+  std::mutex _keyCountMutex;
+  std::map<std::pair<uint32_t, uint32_t>, int64_t> _droppedKeyCounts;
 };
 
 class RocksdbEnv {
@@ -662,6 +662,155 @@ TEST(RocksKVStore, CursorUpperBound) {
   EXPECT_EQ(cnt, 10000);
 }
 
+TEST(RocksKVStore, SlotsSstFile) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto src = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  auto dst = std::make_unique<RocksKVStore>("1", cfg, blockCache);
+
+  setKV(src.get(), 0, "a", 1000);
+  setKV(src.get(), 1, "b", 1000);
+
+  EXPECT_TRUE(filesystem::create_directories(src->migrateSstDir()));
+  std::string fname = src->migrateSstDir() + "/0.sst";
+  auto eTxn = src->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  auto eNum = src->createSlotsSstFile(eTxn.value().get(), 1, 2, fname);
+  EXPECT_TRUE(eNum.ok());
+  EXPECT_EQ(eNum.value(), 1000);
+
+  // no file for an empty slot
+  std::string emptyName = src->migrateSstDir() + "/2.sst";
+  eNum = src->createSlotsSstFile(eTxn.value().get(), 2, 3, emptyName);
+  EXPECT_TRUE(eNum.ok());
+  EXPECT_EQ(eNum.value(), 0);
+  EXPECT_FALSE(filesystem::exists(emptyName));
+
+  // a corrupted file is not ingested
+  std::string badName = src->migrateSstDir() + "/1.sst";
+  eNum = src->createSlotsSstFile(eTxn.value().get(), 0, 1, badName);
+  EXPECT_TRUE(eNum.ok());
+  {
+    std::fstream f(badName, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(100);
+    f.put('x');
+  }
+  auto s = dst->ingestSstFiles({badName});
+  EXPECT_FALSE(s.ok());
+
+  s = dst->ingestSstFiles({fname});
+  EXPECT_TRUE(s.ok());
+
+  auto eTxn2 = dst->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn2.ok());
+  for (uint32_t i = 0; i < 1000; i++) {
+    RecordKey rk(1, 0, RecordType::RT_KV, "b" + std::to_string(i), "");
+    auto eRv = dst->getKV(rk, eTxn2.value().get());
+    EXPECT_TRUE(eRv.ok());
+    EXPECT_EQ(eRv.value().getValue(), "12345abcdefghijklmn");
+  }
+  RecordKey rk(0, 0, RecordType::RT_KV, "a0", "");
+  auto eRv = dst->getKV(rk, eTxn2.value().get());
+  EXPECT_EQ(eRv.status().code(), ErrorCodes::ERR_NOTFOUND);
+}
+
+TEST(RocksKVStore, KeyCount) {
+  auto cfg = genParams();
+  cfg->keyCountEnabled = true;
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  // an empty store counts from the beginning
+  EXPECT_TRUE(kvstore->isKeyCountReady());
+  EXPECT_TRUE(kvstore->isEmpty(true));
+
+  setKV(kvstore.get(), 0, "a", 100);
+  setKV(kvstore.get(), 1, "b", 200);
+  // overwrite is not counted twice
+  setKV(kvstore.get(), 1, "b", 50);
+
+  auto eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  for (uint32_t i = 0; i < 10; i++) {
+    RecordKey rk(1, 0, RecordType::RT_KV, "b" + std::to_string(i), "");
+    EXPECT_TRUE(kvstore->delKV(rk, eTxn.value().get()).ok());
+  }
+  // delete a key not exists
+  RecordKey rk(1, 0, RecordType::RT_KV, "notexist", "");
+  EXPECT_TRUE(kvstore->delKV(rk, eTxn.value().get()).ok());
+  // subkeys are not counted
+  RecordKey subRk(2, 0, RecordType::RT_HASH_ELE, "h", "f");
+  RecordValue subRv("v", RecordType::RT_HASH_ELE, -1);
+  EXPECT_TRUE(kvstore->setKV(subRk, subRv, eTxn.value().get()).ok());
+  // the existence read by the txn is used
+  RecordKey readRk(0, 0, RecordType::RT_KV, "a0", "");
+  EXPECT_TRUE(kvstore->getKV(readRk, eTxn.value().get()).ok());
+  RecordValue readRv("v", RecordType::RT_KV, -1);
+  EXPECT_TRUE(kvstore->setKV(readRk, readRv, eTxn.value().get()).ok());
+  EXPECT_TRUE(kvstore->delKV(readRk, eTxn.value().get()).ok());
+  EXPECT_TRUE(kvstore->setKV(readRk, readRv, eTxn.value().get()).ok());
+  EXPECT_TRUE(eTxn.value()->commit().ok());
+
+  auto eCnt = kvstore->getChunkKeyCount(0);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 100U);
+  eCnt = kvstore->getChunkKeyCount(1);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 190U);
+  eCnt = kvstore->getChunkKeyCount(2);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 0U);
+  auto eCounts = kvstore->getKeyCounts(0);
+  EXPECT_TRUE(eCounts.ok());
+  EXPECT_EQ(eCounts.value().size(), 2U);
+  EXPECT_EQ(eCounts.value()[0], 100U);
+  EXPECT_EQ(eCounts.value()[1], 190U);
+  // the counters are not data
+  EXPECT_FALSE(kvstore->isEmpty(true));
+
+  // recount gets the same result
+  EXPECT_TRUE(kvstore->recountKeys(1).ok());
+  eCnt = kvstore->getChunkKeyCount(1);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 190U);
+
+  // delete the whole chunk
+  auto s = kvstore->deleteRangeWithoutBinlog(
+    kvstore->getDataColumnFamilyHandle(),
+    RecordKey(0, 0, RecordType::RT_INVALID, "", "").prefixChunkid(),
+    RecordKey(1, 0, RecordType::RT_INVALID, "", "").prefixChunkid());
+  EXPECT_TRUE(s.ok());
+  eCnt = kvstore->getChunkKeyCount(0);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 0U);
+  eCnt = kvstore->getChunkKeyCount(1);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 190U);
+
+  // nothing is counted if it's disabled
+  auto cfg2 = genParams();
+  auto kvstore2 = std::make_unique<RocksKVStore>("1", cfg2, blockCache);
+  EXPECT_FALSE(kvstore2->isKeyCountReady());
+  setKV(kvstore2.get(), 0, "a", 10);
+  EXPECT_TRUE(kvstore2->recountKeys(0).ok());
+  eCnt = kvstore2->getChunkKeyCount(0);
+  EXPECT_TRUE(eCnt.ok());
+  EXPECT_EQ(eCnt.value(), 0U);
+}
+
 TEST(RocksKVStore, BackupCkptInter) {
   auto cfg = genParams();
   EXPECT_TRUE(filesystem::create_directory("db"));
@@ -1027,6 +1176,195 @@ TEST(RocksKVStore, WBCommon) {
   }
 }
 
+void multiGetRoutine(RocksKVStore* kvstore) {
+  std::vector<RecordKey> keys;
+  for (uint32_t i = 0; i < 100; ++i) {
+    keys.emplace_back(
+      genRand() % 16384, 0, RecordType::RT_KV, "key" + std::to_string(i), "");
+  }
+
+  auto eTxn1 = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn1.ok());
+  std::unique_ptr<Transaction> txn1 = std::move(eTxn1.value());
+  // only the even keys exist
+  for (uint32_t i = 0; i < keys.size(); i += 2) {
+    Status s = kvstore->setKV(
+      keys[i],
+      RecordValue("val" + std::to_string(i), RecordType::RT_KV, -1),
+      txn1.get());
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_TRUE(txn1->commit().ok());
+
+  auto eTxn2 = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn2.ok());
+  std::unique_ptr<Transaction> txn2 = std::move(eTxn2.value());
+  // uncommitted writes of the txn itself should be visible
+  Status s = kvstore->setKV(keys[1],
+                            RecordValue("val1", RecordType::RT_KV, -1),
+                            txn2.get());
+  EXPECT_TRUE(s.ok());
+
+  auto values = kvstore->multiGetKV(keys, txn2.get());
+  EXPECT_EQ(values.size(), keys.size());
+  for (uint32_t i = 0; i < keys.size(); ++i) {
+    if (i % 2 == 0 || i == 1) {
+      EXPECT_TRUE(values[i].ok());
+      EXPECT_EQ(values[i].value().getValue(), "val" + std::to_string(i));
+    } else {
+      EXPECT_EQ(values[i].status().code(), ErrorCodes::ERR_NOTFOUND);
+    }
+  }
+  EXPECT_TRUE(kvstore->multiGetKV({}, txn2.get()).empty());
+  EXPECT_TRUE(txn2->rollback().ok());
+}
+
+TEST(RocksKVStore, MultiGet) {
+  for (auto mode : {TxnMode::TXN_OPT, TxnMode::TXN_PES, TxnMode::TXN_WB}) {
+    auto cfg = genParams();
+    EXPECT_TRUE(filesystem::create_directory("db"));
+    EXPECT_TRUE(filesystem::create_directory("log"));
+    const auto guard = MakeGuard([] {
+      filesystem::remove_all("./log");
+      filesystem::remove_all("./db");
+    });
+    auto blockCache =
+      rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+    auto kvstore = genRocksKVStore(cfg, blockCache, mode);
+    multiGetRoutine(kvstore.get());
+  }
+}
+
+TEST(RocksKVStore, ProbeKV) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = genRocksKVStore(cfg, blockCache, TxnMode::TXN_OPT);
+
+  RecordKey rk(0, 0, RecordType::RT_KV, "key", "");
+  Expected<RecordValue> value(RecordValue("", RecordType::RT_KV, -1));
+  // nothing flushed yet, both lookups are answered without io
+  EXPECT_TRUE(kvstore->probeKV(rk, &value));
+  EXPECT_EQ(value.status().code(), ErrorCodes::ERR_NOTFOUND);
+  {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    std::unique_ptr<Transaction> txn = std::move(eTxn.value());
+    EXPECT_TRUE(
+      kvstore
+        ->setKV(rk, RecordValue("val", RecordType::RT_KV, -1, 12345), txn.get())
+        .ok());
+    EXPECT_TRUE(txn->commit().ok());
+  }
+  EXPECT_TRUE(kvstore->probeKV(rk, &value));
+  EXPECT_TRUE(value.ok());
+  EXPECT_EQ(value.value().getValue(), "val");
+  EXPECT_EQ(value.value().getTtl(), 12345U);
+
+  EXPECT_TRUE(kvstore->stop().ok());
+  EXPECT_FALSE(kvstore->probeKV(rk, &value));
+}
+
+void valueCacheRoutine(RocksKVStore* kvstore, TxnMode mode) {
+  RecordKey rk(0, 0, RecordType::RT_KV, "key", "");
+  auto setValue = [kvstore, &rk](const std::string& val) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    auto txn = std::move(eTxn.value());
+    EXPECT_TRUE(
+      kvstore->setKV(rk, RecordValue(val, RecordType::RT_KV, -1), txn.get())
+        .ok());
+    EXPECT_TRUE(txn->commit().ok());
+  };
+  auto getValue = [kvstore, &rk](Transaction* txn) {
+    auto v = kvstore->getKV(rk, txn);
+    EXPECT_TRUE(v.ok());
+    return v.ok() ? v.value().getValue() : "";
+  };
+
+  setValue("v1");
+  auto eTxn1 = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn1.ok());
+  auto txn1 = std::move(eTxn1.value());
+  EXPECT_EQ(getValue(txn1.get()), "v1");
+  EXPECT_EQ(getValue(txn1.get()), "v1");
+  EXPECT_EQ(kvstore->getStatCountByName("valuecache.misses"), 1U);
+  EXPECT_EQ(kvstore->getStatCountByName("valuecache.hits"), 1U);
+
+  // invalidated by the commit
+  setValue("v2");
+  {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    auto txn = std::move(eTxn.value());
+    EXPECT_EQ(getValue(txn.get()), "v2");
+    EXPECT_EQ(getValue(txn.get()), "v2");
+    EXPECT_EQ(kvstore->getStatCountByName("valuecache.hits"), 2U);
+
+    // a txn sees its own writes
+    EXPECT_TRUE(
+      kvstore->setKV(rk, RecordValue("v3", RecordType::RT_KV, -1), txn.get())
+        .ok());
+    EXPECT_EQ(getValue(txn.get()), "v3");
+    EXPECT_TRUE(txn->rollback().ok());
+  }
+
+  // the snapshot of txn1 is older than the cached v2
+  EXPECT_EQ(getValue(txn1.get()), mode == TxnMode::TXN_OPT ? "v1" : "v2");
+  EXPECT_TRUE(txn1->rollback().ok());
+  txn1.reset();
+
+  auto eTxn2 = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn2.ok());
+  auto txn2 = std::move(eTxn2.value());
+  EXPECT_EQ(getValue(txn2.get()), "v2");
+  EXPECT_TRUE(txn2->rollback().ok());
+  txn2.reset();
+
+  // a write out of any txn invalidates the cache too
+  {
+    rocksdb::WriteBatch batch;
+    batch.Put(kvstore->getDataColumnFamilyHandle(),
+              rk.encode(),
+              RecordValue("v4", RecordType::RT_KV, -1).encode());
+    EXPECT_TRUE(kvstore->write(kvstore->writeOptions(), &batch).ok());
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    auto txn = std::move(eTxn.value());
+    EXPECT_EQ(getValue(txn.get()), "v4");
+  }
+
+  EXPECT_TRUE(kvstore->deleteRange(RecordKey(0, 0, RecordType::RT_KV, "", "")
+                                     .prefixChunkid(),
+                                   RecordKey(1, 0, RecordType::RT_KV, "", "")
+                                     .prefixChunkid())
+                .ok());
+  EXPECT_EQ(kvstore->getStatCountByName("valuecache.usage"), 0U);
+}
+
+TEST(RocksKVStore, ValueCache) {
+  for (auto mode : {TxnMode::TXN_OPT, TxnMode::TXN_PES, TxnMode::TXN_WB}) {
+    auto cfg = genParams();
+    cfg->valueCacheMB = 64;
+    EXPECT_TRUE(filesystem::create_directory("db"));
+    EXPECT_TRUE(filesystem::create_directory("log"));
+    const auto guard = MakeGuard([] {
+      filesystem::remove_all("./log");
+      filesystem::remove_all("./db");
+    });
+    auto blockCache =
+      rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+    auto kvstore = genRocksKVStore(cfg, blockCache, mode);
+    valueCacheRoutine(kvstore.get(), mode);
+  }
+}
+
 uint64_t getBinlogCount(Transaction* txn) {
   auto bcursor = txn->createRepllogCursorV2(Transaction::MIN_VALID_TXNID, true);
   uint64_t cnt = 0;
@@ -1041,6 +1379,92 @@ uint64_t getBinlogCount(Transaction* txn) {
   return cnt;
 }
 
+class CountBinlogObserver : public BinlogObserver {
+ public:
+  void onCommitted(uint64_t binlogId) final {
+    EXPECT_GT(binlogId, highest);
+    highest = binlogId;
+    count++;
+  }
+  uint64_t highest = 0;
+  uint32_t count = 0;
+};
+
+TEST(RocksKVStore, BinlogRing) {
+  RocksBinlogRing ring(1024);
+  // nothing is kept before reset()
+  ring.insert(1, "k1", "v1");
+  EXPECT_EQ(ring.read(0, 1, 10, 1024).status().code(),
+            ErrorCodes::ERR_NOTFOUND);
+  ring.reset(2);
+  // out of order, only the visible ones are read
+  ring.insert(3, "k3", "v3");
+  ring.insert(2, "k2", "v2");
+  auto logs = ring.read(1, 2, 10, 1024);
+  EXPECT_TRUE(logs.ok());
+  EXPECT_EQ(logs.value().size(), 1U);
+  EXPECT_EQ(logs.value()[0].getReplLogKey(), "k2");
+  logs = ring.read(1, 3, 1, 1024);
+  EXPECT_EQ(logs.value().size(), 1U);
+  logs = ring.read(1, 3, 10, 1024);
+  EXPECT_EQ(logs.value().size(), 2U);
+  EXPECT_EQ(logs.value()[1].getReplLogValue(), "v3");
+  // the oldest are dropped, the slaves behind them fall back to rocksdb
+  for (uint64_t i = 4; i < 100; i++) {
+    ring.insert(i, "k" + std::to_string(i), "v" + std::to_string(i));
+  }
+  EXPECT_LE(ring.getUsage(), ring.getCapacity());
+  EXPECT_EQ(ring.read(1, 99, 10, 1024).status().code(),
+            ErrorCodes::ERR_NOTFOUND);
+  logs = ring.read(98, 99, 10, 1024);
+  EXPECT_EQ(logs.value().size(), 1U);
+  EXPECT_EQ(logs.value()[0].getReplLogKey(), "k99");
+
+  for (auto mode : {TxnMode::TXN_OPT, TxnMode::TXN_PES, TxnMode::TXN_WB}) {
+    auto cfg = genParams();
+    EXPECT_TRUE(filesystem::create_directory("db"));
+    EXPECT_TRUE(filesystem::create_directory("log"));
+    const auto guard = MakeGuard([] {
+      filesystem::remove_all("./log");
+      filesystem::remove_all("./db");
+    });
+    auto blockCache =
+      rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+    auto kvstore = genRocksKVStore(cfg, blockCache, mode);
+    auto ob = std::make_shared<CountBinlogObserver>();
+    EXPECT_TRUE(kvstore->setLogObserver(ob).ok());
+
+    uint64_t start = kvstore->getHighestBinlogId();
+    const uint32_t txnNum = 10;
+    for (uint32_t i = 0; i < txnNum; i++) {
+      auto eTxn = kvstore->createTransaction(nullptr);
+      EXPECT_TRUE(eTxn.ok());
+      auto txn = std::move(eTxn.value());
+      RecordKey rk(0, 0, RecordType::RT_KV, std::to_string(i), "");
+      RecordValue rv(std::to_string(i), RecordType::RT_KV, -1);
+      EXPECT_TRUE(kvstore->setKV(rk, rv, txn.get()).ok());
+      EXPECT_TRUE(txn->commit().ok());
+    }
+    EXPECT_EQ(ob->count, txnNum);
+    EXPECT_EQ(ob->highest, kvstore->getHighestBinlogId());
+
+    // the ring holds exactly what the binlog cursor reads
+    auto recent = kvstore->getRecentBinlogs(start, 1000, 1024 * 1024);
+    EXPECT_TRUE(recent.ok());
+    EXPECT_EQ(recent.value().size(), txnNum);
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    auto bcursor = eTxn.value()->createRepllogCursorV2(start + 1);
+    for (auto& log : recent.value()) {
+      auto v = bcursor->next();
+      EXPECT_TRUE(v.ok());
+      EXPECT_EQ(v.value().getReplLogKey(), log.getReplLogKey());
+      EXPECT_EQ(v.value().getReplLogValue(), log.getReplLogValue());
+    }
+    EXPECT_EQ(bcursor->next().status().code(), ErrorCodes::ERR_EXHAUST);
+  }
+}
+
 TEST(RocksKVStore, PesTruncateBinlog) {
   auto cfg = genParams();
   EXPECT_TRUE(filesystem::create_directory("db"));
@@ -1291,6 +1715,127 @@ TEST(RocksKVStore, Compaction) {
   testMaxBinlogId(kvstore);
 }
 
+TEST(RocksKVStore, CompactionExpireSubKeys) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = genRocksKVStore(cfg, blockCache, TxnMode::TXN_PES);
+
+  // the subkeys of version 1, under a meta of metaVersion or no meta
+  auto writeHash = [&kvstore](const std::string& pk,
+                              uint64_t ttl,
+                              bool meta,
+                              uint64_t metaVersion) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    if (meta) {
+      RecordKey mk(0, 0, RecordType::RT_HASH_META, pk, "");
+      RecordValue mv("", RecordType::RT_HASH_META, -1, ttl, -1, metaVersion);
+      EXPECT_TRUE(kvstore->setKV(mk, mv, eTxn.value().get()).ok());
+    }
+    for (uint32_t i = 0; i < 100; i++) {
+      RecordKey rk(0, 0, RecordType::RT_HASH_ELE, pk, std::to_string(i), 1);
+      RecordValue rv("v", RecordType::RT_HASH_ELE, -1);
+      EXPECT_TRUE(kvstore->setKV(rk, rv, eTxn.value().get()).ok());
+    }
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  };
+  writeHash("expired", msSinceEpoch() - 1000, true, 1);
+  writeHash("alive", 0, true, 1);
+  writeHash("deleted", 0, false, 0);
+  writeHash("rewritten", 0, true, 2);
+
+  auto status = kvstore->compactRange(
+    ColumnFamilyNumber::ColumnFamily_Default, nullptr, nullptr);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(kvstore->stat.compactSubKeyExpiredCount.load(), 300);
+  EXPECT_GT(kvstore->getStatCountByName("metacache.misses"), 0U);
+
+  {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    for (std::string pk : {"expired", "alive", "deleted", "rewritten"}) {
+      RecordKey rk(0, 0, RecordType::RT_HASH_ELE, pk, "0", 1);
+      auto v = kvstore->getKV(rk, eTxn.value().get());
+      EXPECT_EQ(v.ok(), pk == "alive");
+    }
+    // the meta is left to the ttl index
+    RecordKey mk(0, 0, RecordType::RT_HASH_META, "expired", "");
+    EXPECT_TRUE(kvstore->getKV(mk, eTxn.value().get()).ok());
+  }
+
+  // the cached meta of alive is invalidated by the rewrite
+  {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    RecordKey mk(0, 0, RecordType::RT_HASH_META, "alive", "");
+    RecordValue mv("", RecordType::RT_HASH_META, -1, 0, -1, 2);
+    EXPECT_TRUE(kvstore->setKV(mk, mv, eTxn.value().get()).ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  }
+  status = kvstore->compactRange(
+    ColumnFamilyNumber::ColumnFamily_Default, nullptr, nullptr);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(kvstore->stat.compactSubKeyExpiredCount.load(), 400);
+}
+
+TEST(RocksKVStore, CompactionDropStaleSubKeys) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = genRocksKVStore(cfg, blockCache, TxnMode::TXN_PES);
+
+  // the subkeys of a deleted hash, and a hash recreated by version 2
+  auto writeSubKeys = [&kvstore](const std::string& pk, uint64_t version) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    for (uint32_t i = 0; i < 100; i++) {
+      RecordKey rk(
+        0, 0, RecordType::RT_HASH_ELE, pk, std::to_string(i), version);
+      RecordValue rv("v", RecordType::RT_HASH_ELE, -1);
+      EXPECT_TRUE(kvstore->setKV(rk, rv, eTxn.value().get()).ok());
+    }
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  };
+  writeSubKeys("deleted", 1);
+  writeSubKeys("recreated", 1);
+  writeSubKeys("recreated", 2);
+  {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    RecordKey mk(0, 0, RecordType::RT_HASH_META, "recreated", "");
+    RecordValue mv("", RecordType::RT_HASH_META, -1, 0, -1, 2);
+    EXPECT_TRUE(kvstore->setKV(mk, mv, eTxn.value().get()).ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  }
+
+  auto status = kvstore->compactRange(
+    ColumnFamilyNumber::ColumnFamily_Default, nullptr, nullptr);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(kvstore->stat.compactSubKeyExpiredCount.load(), 200);
+
+  auto eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  for (uint64_t version : {1, 2}) {
+    RecordKey rk(0, 0, RecordType::RT_HASH_ELE, "recreated", "0", version);
+    EXPECT_EQ(kvstore->getKV(rk, eTxn.value().get()).ok(), version == 2);
+  }
+  RecordKey rk(0, 0, RecordType::RT_HASH_ELE, "deleted", "0", 1);
+  EXPECT_FALSE(kvstore->getKV(rk, eTxn.value().get()).ok());
+}
+
 TEST(RocksKVStore, CompactionWithNoexpire) {
   auto cfg = genParams();
   cfg->noexpire = true;
@@ -19,7 +19,7 @@ namespace novadbplus {
 
 class KVTtlCompactionFilter : public CompactionFilter {
  public:
-  explicit KVTtlCompactionFilter(KVStore* store,
+  explicit KVTtlCompactionFilter(RocksKVStore* store,
                                  uint64_t current_time,
                                  const std::shared_ptr<ServerParams> cfg)
     : _store(store), _currentTime(current_time), _cfg(cfg) {}
@@ -27,12 +27,16 @@ class KVTtlCompactionFilter : public CompactionFilter {
   ~KVTtlCompactionFilter() override {
     TEST_SYNC_POINT_CALLBACK("InspectKvTtlExpiredCount", &_expiredCount);
     TEST_SYNC_POINT_CALLBACK("InspectKvTtlFilterCount", &_filterCount);
+    TEST_SYNC_POINT_CALLBACK("InspectSubKeyExpiredCount",
+                             &_subKeyExpiredCount);
 
     // do something statistics here
     _store->stat.compactFilterCount.fetch_add(_filterCount,
                                               std::memory_order_relaxed);
     _store->stat.compactKvExpiredCount.fetch_add(_expiredCount,
                                                  std::memory_order_relaxed);
+    _store->stat.compactSubKeyExpiredCount.fetch_add(
+      _subKeyExpiredCount, std::memory_order_relaxed);
   }
 
   const char* Name() const override {
@@ -78,11 +82,24 @@ class KVTtlCompactionFilter : public CompactionFilter {
             // Expired
             _expiredCount++;
             _expiredSize += key.size() + existing_value.size();
+            _store->onExpiredKeyDropped(key, existing_value);
 
             return true;
           }
         }
         break;
+      case RecordType::RT_HASH_ELE:
+      case RecordType::RT_LIST_ELE:
+      case RecordType::RT_SET_ELE:
+      case RecordType::RT_ZSET_S_ELE:
+      case RecordType::RT_ZSET_H_ELE:
+      case RecordType::RT_TBITMAP_ELE:
+        if (isSubKeyDropped(type, key)) {
+          _subKeyExpiredCount++;
+          _expiredSize += key.size() + existing_value.size();
+          return true;
+        }
+        break;
       case RecordType::RT_INVALID:
         // TODO(vinchen): make sure
         INVARIANT_D(0);
@@ -94,7 +111,53 @@ class KVTtlCompactionFilter : public CompactionFilter {
   }
 
  private:
-  KVStore* _store;
+  // whether the meta of the subkey is deleted, expired, or rewritten with
+  // another version. The versioned subkeys without meta belong to a deleted
+  // key, but the ones without version are kept, nothing can tell whether
+  // they are garbage. The subkeys of the types never versioned are kept
+  // without looking up the meta.
+  // NOTE: the subkeys of an expired meta are dropped before the meta, which
+  // is left to the ttl index. The filter never runs with noexpire, but a
+  // key expired before noexpire is set may lose its elements.
+  bool isSubKeyDropped(RecordType type, const rocksdb::Slice& key) const {
+    if (!isVersionedEleType(type)) {
+      return false;
+    }
+    auto rk = RecordKey::decode(key.ToString());
+    if (!rk.ok()) {
+      return false;
+    }
+    RecordKey mk(rk.value().getChunkId(),
+                 rk.value().getDbId(),
+                 RecordType::RT_DATA_META,
+                 rk.value().getPrimaryKey(),
+                 "");
+    // NOTE: the subkeys of a key are adjacent, so only the last meta is
+    // remembered here, the metas shared by the compactions are cached by
+    // the meta cache of the store.
+    std::string metaKey = mk.encode();
+    if (metaKey != _lastMetaKey) {
+      auto meta = _store->getLatestMeta(mk);
+      if (!meta.ok() && meta.status().code() != ErrorCodes::ERR_NOTFOUND) {
+        return false;
+      }
+      _lastMetaKey = std::move(metaKey);
+      _lastMetaFound = meta.ok();
+      if (_lastMetaFound) {
+        _lastMetaTtl = meta.value().getTtl();
+        _lastMetaVersion = meta.value().getVersion();
+      }
+    }
+    if (!_lastMetaFound) {
+      return rk.value().getVersion() > 0;
+    }
+    if (rk.value().getVersion() != _lastMetaVersion) {
+      return true;
+    }
+    return _lastMetaTtl > 0 && _lastMetaTtl < _currentTime;
+  }
+
+  RocksKVStore* _store;
   // millisecond, same as ttl in the record
   const uint64_t _currentTime;
   const std::shared_ptr<ServerParams> _cfg;
@@ -104,6 +167,11 @@ class KVTtlCompactionFilter : public CompactionFilter {
   mutable uint64_t _expiredCount = 0;
   mutable uint64_t _expiredSize = 0;
   mutable uint64_t _filterCount = 0;
+  mutable uint64_t _subKeyExpiredCount = 0;
+  mutable std::string _lastMetaKey;
+  mutable bool _lastMetaFound = false;
+  mutable uint64_t _lastMetaTtl = 0;
+  mutable uint64_t _lastMetaVersion = 0;
 };
 
 std::unique_ptr<CompactionFilter>
@@ -24,7 +24,7 @@ struct KVTTLCompactionContext {
 
 class KVTtlCompactionFilterFactory : public CompactionFilterFactory {
  public:
-  explicit KVTtlCompactionFilterFactory(KVStore* store,
+  explicit KVTtlCompactionFilterFactory(RocksKVStore* store,
                                         const std::shared_ptr<ServerParams> cfg)
     : _store(store), _cfg(cfg) {}
 
@@ -36,7 +36,7 @@ class KVTtlCompactionFilterFactory : public CompactionFilterFactory {
     const CompactionFilter::Context& /*context*/) override;
 
  private:
-  KVStore* _store;
+  RocksKVStore* _store;
   const std::shared_ptr<ServerParams> _cfg;
 };
 
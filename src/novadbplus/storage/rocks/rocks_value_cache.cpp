@@ -0,0 +1,142 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include "novadbplus/storage/rocks/rocks_value_cache.h"
+
+#include <algorithm>
+
+#include "novadbplus/utils/invariant.h"
+
+namespace novadbplus {
+
+// NOTE: the memory of the list and hash nodes, and the key stored twice
+static constexpr size_t ENTRY_OVERHEAD = 128;
+
+RocksValueCache::RocksValueCache(uint64_t capacity, uint32_t shardBits)
+  : _capacity(capacity),
+    _shardCapacity(capacity >> shardBits),
+    _shardMask((size_t(1) << shardBits) - 1),
+    _shards(new Shard[_shardMask + 1]),
+    _generation(0),
+    _hits(0),
+    _misses(0) {
+  for (size_t i = 0; i <= _shardMask; i++) {
+    _shards[i].hand = _shards[i].ring.end();
+  }
+}
+
+RocksValueCache::Shard& RocksValueCache::getShard(const std::string& key) {
+  return _shards[std::hash<std::string>{}(key) & _shardMask];
+}
+
+void RocksValueCache::eraseInLock(Shard* shard, std::list<Entry>::iterator it) {
+  if (shard->hand == it) {
+    ++shard->hand;
+  }
+  shard->usage -= it->charge;
+  shard->map.erase(it->key);
+  shard->ring.erase(it);
+}
+
+void RocksValueCache::evictInLock(Shard* shard) {
+  while (shard->usage > _shardCapacity && !shard->ring.empty()) {
+    if (shard->hand == shard->ring.end()) {
+      shard->hand = shard->ring.begin();
+    }
+    if (shard->hand->freq > 0) {
+      // second chance, a hot entry survives MAX_FREQ rounds of the hand
+      shard->hand->freq--;
+      ++shard->hand;
+      continue;
+    }
+    eraseInLock(shard, shard->hand);
+  }
+}
+
+bool RocksValueCache::lookup(const std::string& key,
+                             uint64_t readSeq,
+                             RecordValue* value) {
+  Shard& shard = getShard(key);
+  {
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    auto iter = shard.map.find(key);
+    if (iter != shard.map.end() && iter->second->seq <= readSeq) {
+      auto& entry = *iter->second;
+      if (entry.freq < MAX_FREQ) {
+        entry.freq++;
+      }
+      *value = RecordValue(entry.value);
+      _hits.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  _misses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void RocksValueCache::insert(const std::string& key,
+                             const RecordValue& value,
+                             uint64_t readSeq,
+                             uint64_t generation) {
+  size_t charge = key.size() * 2 + value.getValue().size() + ENTRY_OVERHEAD;
+  // NOTE: a single big value would flush the whole shard
+  if (charge > _shardCapacity / 8) {
+    return;
+  }
+  Shard& shard = getShard(key);
+  std::lock_guard<std::mutex> lk(shard.mutex);
+  if (readSeq < shard.invalidatedSeq || generation != getGeneration()) {
+    // the value may be older than a committed write
+    return;
+  }
+  auto iter = shard.map.find(key);
+  if (iter != shard.map.end()) {
+    if (iter->second->seq >= readSeq) {
+      return;
+    }
+    eraseInLock(&shard, iter->second);
+  }
+  // insert just behind the hand, it's the last one the hand comes to
+  auto it = shard.ring.emplace(shard.hand, key, value, readSeq, charge);
+  shard.map.emplace(key, it);
+  shard.usage += charge;
+  evictInLock(&shard);
+}
+
+void RocksValueCache::invalidate(const std::vector<std::string>& keys,
+                                 uint64_t seq) {
+  for (const auto& key : keys) {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    shard.invalidatedSeq = std::max(shard.invalidatedSeq, seq);
+    auto iter = shard.map.find(key);
+    if (iter != shard.map.end()) {
+      eraseInLock(&shard, iter->second);
+    }
+  }
+}
+
+void RocksValueCache::invalidateAll(uint64_t seq) {
+  _generation.fetch_add(1, std::memory_order_acq_rel);
+  for (size_t i = 0; i <= _shardMask; i++) {
+    Shard& shard = _shards[i];
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    shard.map.clear();
+    shard.ring.clear();
+    shard.hand = shard.ring.end();
+    shard.usage = 0;
+    shard.invalidatedSeq = seq;
+  }
+}
+
+uint64_t RocksValueCache::getUsage() const {
+  uint64_t usage = 0;
+  for (size_t i = 0; i <= _shardMask; i++) {
+    std::lock_guard<std::mutex> lk(_shards[i].mutex);
+    usage += _shards[i].usage;
+  }
+  return usage;
+}
+
+}  // namespace novadbplus
@@ -0,0 +1,110 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_VALUE_CACHE_H_
+#define SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_VALUE_CACHE_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "novadbplus/storage/record.h"
+
+namespace novadbplus {
+
+// Decoded values of the hot keys of one RocksKVStore, keyed by the encoded
+// RecordKey. It is sharded, each shard is a CLOCK ring whose entries carry
+// a small access counter(LFU-ish), and it is bounded by the approximate
+// memory of the cached keys and values.
+//
+// Every entry remembers the rocksdb sequence it was read at. A value read
+// at sequence S can only be inserted if no key of its shard was invalidated
+// after S, and a reader at snapshot S only sees the entries read at or
+// before S. Writers invalidate their keys after the commit, so the cache
+// never holds a value older than the latest committed one(except for the
+// moment between the commit and the invalidation, when the writer still
+// holds the key lock).
+class RocksValueCache {
+ public:
+  // capacity is in bytes, split among (1 << shardBits) shards
+  RocksValueCache(uint64_t capacity, uint32_t shardBits);
+  RocksValueCache(const RocksValueCache&) = delete;
+  RocksValueCache& operator=(const RocksValueCache&) = delete;
+
+  static constexpr uint64_t READ_LATEST = UINT64_MAX;
+  static constexpr uint32_t DEFAULT_SHARD_BITS = 6;
+
+  // readSeq: the snapshot sequence of the reader, READ_LATEST if it has
+  // no snapshot
+  bool lookup(const std::string& key, uint64_t readSeq, RecordValue* value);
+  // readSeq: the sequence the value was read at(the snapshot, or the latest
+  // sequence taken before the read), generation: getGeneration() taken
+  // before the read
+  void insert(const std::string& key,
+              const RecordValue& value,
+              uint64_t readSeq,
+              uint64_t generation);
+  // seq: the latest sequence after the writes of keys are committed
+  void invalidate(const std::vector<std::string>& keys, uint64_t seq);
+  // for the writes without a sequence(deleteFilesInRange) or without
+  // keys(deleteRange), and the db is closed/reopened
+  void invalidateAll(uint64_t seq);
+  uint64_t getGeneration() const {
+    return _generation.load(std::memory_order_acquire);
+  }
+
+  uint64_t getCapacity() const {
+    return _capacity;
+  }
+  uint64_t getUsage() const;
+  uint64_t getHits() const {
+    return _hits.load(std::memory_order_relaxed);
+  }
+  uint64_t getMisses() const {
+    return _misses.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Entry {
+    Entry(const std::string& k, const RecordValue& v, uint64_t s, size_t c)
+      : key(k), value(v), seq(s), charge(c), freq(0) {}
+    std::string key;
+    RecordValue value;
+    uint64_t seq;
+    size_t charge;
+    uint8_t freq;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::list<Entry> ring;
+    std::list<Entry>::iterator hand;
+    std::unordered_map<std::string, std::list<Entry>::iterator> map;
+    size_t usage = 0;
+    // the latest sequence any key of this shard is invalidated at
+    uint64_t invalidatedSeq = 0;
+  };
+
+  static constexpr uint8_t MAX_FREQ = 3;
+
+  Shard& getShard(const std::string& key);
+  void eraseInLock(Shard* shard, std::list<Entry>::iterator it);
+  void evictInLock(Shard* shard);
+
+  const uint64_t _capacity;
+  const size_t _shardCapacity;
+  const size_t _shardMask;
+  std::unique_ptr<Shard[]> _shards;
+  std::atomic<uint64_t> _generation;
+  std::atomic<uint64_t> _hits;
+  std::atomic<uint64_t> _misses;
+};
+
+}  // namespace novadbplus
+
+#endif  // SRC_novadbPLUS_STORAGE_ROCKS_ROCKS_VALUE_CACHE_H_
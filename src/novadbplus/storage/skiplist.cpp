@@ -67,7 +67,8 @@ SkipList::SkipList(uint32_t chunkId,
                    uint32_t dbId,
                    const std::string& pk,
                    const ZSlMetaValue& meta,
-                   PStore store)
+                   PStore store,
+                   uint64_t version)
   : nGetFromCache(0),
     nGetFromStore(0),
     nInserted(0),
@@ -81,6 +82,7 @@ SkipList::SkipList(uint32_t chunkId,
     _chunkId(chunkId),
     _dbId(dbId),
     _pk(pk),
+    _version(version),
     _store(store) {}
 
 uint8_t SkipList::randomLevel() {
@@ -98,10 +100,17 @@ uint8_t SkipList::randomLevel() {
   // return redis_port::zslRandomLevel(_maxLevel);
 }
 
-std::pair<uint64_t, SkipList::PSE> SkipList::makeNode(
-  double score, const std::string& subkey) {
-  auto result = std::make_unique<ZSlEleValue>(score, subkey);
-  return {++_posAlloc, std::move(result)};
+uint64_t SkipList::makeNode(double score, const std::string& subkey) {
+  uint64_t pointer = ++_posAlloc;
+  cacheNode(pointer, ZSlEleValue(score, subkey));
+  return pointer;
+}
+
+ZSlEleValue* SkipList::cacheNode(uint64_t pointer, ZSlEleValue&& val) {
+  _arena.emplace_back(std::move(val));
+  ZSlEleValue* node = &_arena.back();
+  cache[pointer] = node;
+  return node;
 }
 
 Expected<ZSlEleValue*> SkipList::getEleByRank(uint32_t rank, Transaction* txn) {
@@ -130,7 +139,7 @@ Expected<ZSlEleValue*> SkipList::getEleByRank(uint32_t rank, Transaction* txn) {
       }
     }
     if (traversed == rank) {
-      return cache[pos].get();
+      return cache[pos];
     }
   }
   return nullptr;
@@ -140,7 +149,7 @@ ZSlEleValue* SkipList::getCacheNode(uint64_t pos) {
   auto it = cache.find(pos);
   if (it != cache.end()) {
     ++nGetFromCache;
-    return it->second.get();
+    return it->second;
   }
   INVARIANT(0);
 }
@@ -150,10 +159,11 @@ Expected<ZSlEleValue*> SkipList::getNode(uint64_t pointer, Transaction* txn) {
   if (it != cache.end()) {
     // TODO(vinchen): a global statistics
     ++nGetFromCache;
-    return it->second.get();
+    return it->second;
   }
   std::string pointerStr = std::to_string(pointer);
-  RecordKey rk(_chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, pointerStr);
+  RecordKey rk(
+    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, pointerStr, _version);
   Expected<RecordValue> rv = _store->getKV(rk, txn);
   if (!rv.ok()) {
     return rv.status();
@@ -163,27 +173,33 @@ Expected<ZSlEleValue*> SkipList::getNode(uint64_t pointer, Transaction* txn) {
   if (!result.ok()) {
     return result.status();
   }
-  auto ptr = std::make_unique<ZSlEleValue>(std::move(result.value()));
-  ZSlEleValue* toReturn = ptr.get();
-  cache[pointer] = std::move(ptr);
+  ZSlEleValue* toReturn = cacheNode(pointer, std::move(result.value()));
   ++nGetFromStore;
   return toReturn;
 }
 
 Status SkipList::delNode(uint64_t pointer, Transaction* txn) {
-  // TODO(vinchen)
+  // NOTE: the node stays in _arena, it is released with the skiplist
   cache.erase(pointer);
   ++nDeleted;
-  RecordKey rk(
-    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, std::to_string(pointer));
+  RecordKey rk(_chunkId,
+               _dbId,
+               RecordType::RT_ZSET_S_ELE,
+               _pk,
+               std::to_string(pointer),
+               _version);
   return _store->delKV(rk, txn);
 }
 
 Status SkipList::saveNode(uint64_t pointer,
                           const ZSlEleValue& val,
                           Transaction* txn) {
-  RecordKey rk(
-    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, std::to_string(pointer));
+  RecordKey rk(_chunkId,
+               _dbId,
+               RecordType::RT_ZSET_S_ELE,
+               _pk,
+               std::to_string(pointer),
+               _version);
   RecordValue rv(val.encode(), RecordType::RT_ZSET_S_ELE, -1);
 
   // NOTE(vinchen): after saveNode, reset the change flag in ZSLEleValue
@@ -212,14 +228,26 @@ Status SkipList::save(Transaction* txn,
   uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
   RecordValue rv(
     mv.encode(), RecordType::RT_ZSET_META, versionEP, ttl, oldValue);
+  rv.setVersion(_version);
   return _store->setKV(rk, rv, txn);
 }
 
+Status SkipList::drop(Transaction* txn) {
+  INVARIANT_D(_count == 1);
+  RecordKey head(_chunkId,
+                 _dbId,
+                 RecordType::RT_ZSET_S_ELE,
+                 _pk,
+                 std::to_string(ZSlMetaValue::HEAD_ID),
+                 _version);
+  return _store->delKV(head, txn);
+}
+
 Status SkipList::removeInternal(uint64_t pos,
                                 const std::vector<uint64_t>& update,
                                 Transaction* txn) {
   for (size_t i = 1; i <= _level; ++i) {
-    auto toupdate = cache[update[i]].get();
+    auto toupdate = cache[update[i]];
     if (toupdate->getForward(i) != pos) {
       toupdate->setSpan(i, toupdate->getSpan(i) - 1);
     } else {
@@ -478,6 +506,55 @@ Expected<uint32_t> SkipList::rank(double score,
   return {ErrorCodes::ERR_INTERNAL, "not reachable"};
 }
 
+Expected<uint32_t> SkipList::countInRange(const Zrangespec& range,
+                                          Transaction* txn) {
+  auto f = firstInRange(range, txn);
+  if (!f.ok()) {
+    return f.status();
+  }
+  if (f.value() == SKIPLIST_INVALID_POS) {
+    return 0;
+  }
+  auto l = lastInRange(range, txn);
+  if (!l.ok()) {
+    return l.status();
+  }
+  return countBetween(f.value(), l.value(), txn);
+}
+
+Expected<uint32_t> SkipList::countInLexRange(const Zlexrangespec& range,
+                                             Transaction* txn) {
+  auto f = firstInLexRange(range, txn);
+  if (!f.ok()) {
+    return f.status();
+  }
+  if (f.value() == SKIPLIST_INVALID_POS) {
+    return 0;
+  }
+  auto l = lastInLexRange(range, txn);
+  if (!l.ok()) {
+    return l.status();
+  }
+  return countBetween(f.value(), l.value(), txn);
+}
+
+Expected<uint32_t> SkipList::countBetween(uint64_t first,
+                                          uint64_t last,
+                                          Transaction* txn) {
+  INVARIANT_D(last != SKIPLIST_INVALID_POS);
+  ZSlEleValue* node = getCacheNode(first);
+  Expected<uint32_t> firstRank = rank(node->getScore(), node->getSubKey(), txn);
+  if (!firstRank.ok()) {
+    return firstRank.status();
+  }
+  node = getCacheNode(last);
+  Expected<uint32_t> lastRank = rank(node->getScore(), node->getSubKey(), txn);
+  if (!lastRank.ok()) {
+    return lastRank.status();
+  }
+  return lastRank.value() - firstRank.value() + 1;
+}
+
 /* Find the first node index that is contained in the specified range.
  * Returns SKIPLIST_INVALID_POS when no element is contained in the range. */
 Expected<uint64_t> SkipList::firstInRange(const Zrangespec& range,
@@ -743,7 +820,7 @@ Expected<std::list<std::pair<double, std::string>>> SkipList::scanByScore(
   }
 
   std::list<std::pair<double, std::string>> result;
-  ZSlEleValue* ln = cache[pos].get();
+  ZSlEleValue* ln = cache[pos];
 
   while (ln != nullptr && offset--) {
     if (rev) {
@@ -828,7 +905,7 @@ Expected<std::list<std::pair<double, std::string>>> SkipList::scanByLex(
     return std::list<std::pair<double, std::string>>();
   }
   std::list<std::pair<double, std::string>> result;
-  ZSlEleValue* ln = cache[pos].get();
+  ZSlEleValue* ln = cache[pos];
 
   while (ln != nullptr && offset--) {
     if (rev) {
@@ -1005,37 +1082,119 @@ Status SkipList::insert(double score,
     }
     _level = lvl;
   }
-  std::pair<uint64_t, SkipList::PSE> p = SkipList::makeNode(score, subkey);
-  cache[p.first] = std::move(p.second);
+  auto p = linkNode(score, subkey, lvl, update, rank, txn);
+  if (!p.ok()) {
+    return p.status();
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<uint64_t> SkipList::linkNode(double score,
+                                      const std::string& subkey,
+                                      uint8_t lvl,
+                                      const std::vector<uint64_t>& update,
+                                      const std::vector<uint32_t>& rank,
+                                      Transaction* txn) {
+  uint64_t p = makeNode(score, subkey);
+  ZSlEleValue* node = cache[p];
   for (size_t i = 1; i <= lvl; ++i) {
     INVARIANT(update[i] >= ZSlMetaValue::HEAD_ID);
     INVARIANT(cache.find(update[i]) != cache.end());
-    cache[p.first]->setForward(i, cache[update[i]]->getForward(i));
-    cache[update[i]]->setForward(i, p.first);
-    cache[p.first]->setSpan(i,
-                            cache[update[i]]->getSpan(i) - (rank[1] - rank[i]));
-    cache[update[i]]->setSpan(i, rank[1] - rank[i] + 1);
+    ZSlEleValue* prev = cache[update[i]];
+    node->setForward(i, prev->getForward(i));
+    prev->setForward(i, p);
+    node->setSpan(i, prev->getSpan(i) - (rank[1] - rank[i]));
+    prev->setSpan(i, rank[1] - rank[i] + 1);
   }
   for (size_t i = lvl + 1; i <= _level; ++i) {
     cache[update[i]]->setSpan(i, cache[update[i]]->getSpan(i) + 1);
   }
   if (update[1] == ZSlMetaValue::HEAD_ID) {
-    cache[p.first]->setBackward(0);
+    node->setBackward(0);
   } else {
-    cache[p.first]->setBackward(update[1]);
+    node->setBackward(update[1]);
   }
 
-  uint64_t btmFwd = cache[p.first]->getForward(1);
+  uint64_t btmFwd = node->getForward(1);
   if (btmFwd != 0) {
-    auto node = getNode(btmFwd, txn);
-    if (!node.ok()) {
-      return node.status();
+    auto next = getNode(btmFwd, txn);
+    if (!next.ok()) {
+      return next.status();
     }
-    cache[btmFwd]->setBackward(p.first);
+    next.value()->setBackward(p);
   } else {
-    _tail = p.first;
+    _tail = p;
   }
   ++_count;
+  return p;
+}
+
+Status SkipList::insertBatch(
+  const std::vector<std::pair<double, std::string>>& members,
+  Transaction* txn) {
+  if (_count + members.size() >= std::numeric_limits<int32_t>::max() / 2) {
+    return {ErrorCodes::ERR_INTERNAL, "zset count reach limit"};
+  }
+  Expected<ZSlEleValue*> expHead = getNode(ZSlMetaValue::HEAD_ID, txn);
+  if (!expHead.ok()) {
+    return expHead.status();
+  }
+
+  // update[i] and rank[i] are kept across the members, they are always
+  // before the next member as the members are sorted.
+  std::vector<uint64_t> update(_maxLevel + 1, ZSlMetaValue::HEAD_ID);
+  std::vector<uint32_t> rank(_maxLevel + 1, 0);
+  for (const auto& member : members) {
+    double score = member.first;
+    const std::string& subkey = member.second;
+    for (size_t i = _level; i >= 1; --i) {
+      // start from the nearer one of the upper level's position and the
+      // previous member's position in this level
+      if (i != _level && rank[i + 1] > rank[i]) {
+        rank[i] = rank[i + 1];
+        update[i] = update[i + 1];
+      }
+      uint64_t pos = update[i];
+      uint64_t tmpPos = cache[pos]->getForward(i);
+      while (tmpPos != 0) {
+        Expected<ZSlEleValue*> next = getNode(tmpPos, txn);
+        if (!next.ok()) {
+          return next.status();
+        }
+        // donot allow duplicate, check existence before insert
+        INVARIANT(next.value()->getSubKey() != subkey);
+        ZSlEleValue* pRaw = next.value();
+        if (slCmp(pRaw->getScore(), pRaw->getSubKey(), score, subkey) < 0) {
+          rank[i] += cache[pos]->getSpan(i);
+          pos = tmpPos;
+          tmpPos = pRaw->getForward(i);
+        } else {
+          break;
+        }
+      }
+      update[i] = pos;
+    }
+
+    uint8_t lvl = randomLevel();
+    if (lvl > _level) {
+      for (size_t i = _level + 1; i <= lvl; i++) {
+        rank[i] = 0;
+        update[i] = ZSlMetaValue::HEAD_ID;
+        cache[update[i]]->setSpan(i, _count - 1);
+      }
+      _level = lvl;
+    }
+    auto p = linkNode(score, subkey, lvl, update, rank, txn);
+    if (!p.ok()) {
+      return p.status();
+    }
+    // the new node is the nearest one before the next member in its levels
+    uint32_t newRank = rank[1] + 1;
+    for (size_t i = 1; i <= lvl; ++i) {
+      update[i] = p.value();
+      rank[i] = newRank;
+    }
+  }
   return {ErrorCodes::ERR_OK, ""};
 }
 
@@ -6,37 +6,59 @@
 #define SRC_novadbPLUS_STORAGE_SKIPLIST_H_
 
 #include <atomic>
+#include <deque>
 #include <limits>
 #include <list>
-#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "novadbplus/storage/kvstore.h"
 #include "novadbplus/storage/record.h"
+#include "novadbplus/storage/zset_index.h"
 #include "novadbplus/utils/redis_port.h"
 
 namespace novadbplus {
 
-using Zrangespec = redis_port::Zrangespec;
-using Zlexrangespec = redis_port::Zlexrangespec;
 const uint64_t SKIPLIST_INVALID_POS = (uint64_t)-1;
-class SkipList {
+// the order of the elements, by score and then subkey.
+// return 0 if equal, -1 if less, 1 if greater
+int slCmp(double score0,
+          const std::string& subk0,
+          double score1,
+          const std::string& subk1);
+class SkipList : public ZsetIndex {
  public:
-  using PSE = std::unique_ptr<ZSlEleValue>;
-  using PSE_MAP = std::map<uint64_t, SkipList::PSE>;
+  // the nodes read or created by the skiplist live in _arena until it is
+  // destroyed, PSE_MAP maps the positions to them.
+  using PSE_MAP = std::unordered_map<uint64_t, ZSlEleValue*>;
+  // version is the version of the subkeys, see Command::getSubKeyVersion()
   SkipList(uint32_t chunkId,
            uint32_t dbId,
            const std::string& pk,
            const ZSlMetaValue& meta,
-           PStore store);
-  Status insert(double score, const std::string& subkey, Transaction* txn);
-  Status remove(double score, const std::string& subkey, Transaction* txn);
+           PStore store,
+           uint64_t version);
+  Status insert(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  // insert the members in one pass, they should be sorted by slCmp() and
+  // none of them exists in the skiplist. Each search starts from where the
+  // previous one stopped, so a node is read at most once for the batch.
+  Status insertBatch(const std::vector<std::pair<double, std::string>>& members,
+                     Transaction* txn) override;
+  Status remove(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
   Expected<uint32_t> rank(double score,
                           const std::string& subkey,
-                          Transaction* txn);
+                          Transaction* txn) override;
+  Expected<uint32_t> countInRange(const Zrangespec& range,
+                                  Transaction* txn) override;
+  Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                     Transaction* txn) override;
 
   Expected<bool> isInRange(const Zrangespec& spec, Transaction* txn);
   Expected<bool> isInLexRange(const Zlexrangespec& spec, Transaction* txn);
@@ -54,32 +76,34 @@ class SkipList {
     uint64_t offset,
     uint64_t limit,
     bool rev,
-    Transaction* txn);
+    Transaction* txn) override;
   Expected<std::list<std::pair<double, std::string>>> scanByRank(
-    int64_t start, int64_t len, bool rev, Transaction* txn);
+    int64_t start, int64_t len, bool rev, Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> scanByScore(
     const Zrangespec& range,
     uint64_t offset,
     uint64_t limit,
     bool rev,
-    Transaction* txn);
+    Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> removeRangeByScore(
-    const Zrangespec& range, Transaction* txn);
+    const Zrangespec& range, Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> removeRangeByLex(
-    const Zlexrangespec& range, Transaction* txn);
+    const Zlexrangespec& range, Transaction* txn) override;
 
   // 1-based index
   Expected<std::list<std::pair<double, std::string>>> removeRangeByRank(
-    uint32_t start, uint32_t end, Transaction* txn);
+    uint32_t start, uint32_t end, Transaction* txn) override;
 
   Status save(Transaction* txn,
               const Expected<RecordValue>& oldValue,
-              uint64_t versionEP);
+              uint64_t versionEP) override;
+  // delete the head node
+  Status drop(Transaction* txn) override;
   Status traverse(std::stringstream& ss, Transaction* txn);
-  uint32_t getCount() const;
+  uint32_t getCount() const override;
   uint64_t getAlloc() const;
   uint64_t getTail() const;
   uint8_t getLevel() const;
@@ -98,9 +122,22 @@ class SkipList {
                         Transaction* txn);
   Status saveNode(uint64_t pointer, const ZSlEleValue& val, Transaction* txn);
   Status delNode(uint64_t pointer, Transaction* txn);
+  // the number of nodes from first to last, both are in the cache
+  Expected<uint32_t> countBetween(uint64_t first,
+                                  uint64_t last,
+                                  Transaction* txn);
   Expected<ZSlEleValue*> getEleByRank(uint32_t rank, Transaction* txn);
   Expected<ZSlEleValue*> getNode(uint64_t pointer, Transaction* txn);
-  std::pair<uint64_t, PSE> makeNode(double score, const std::string& subkey);
+  uint64_t makeNode(double score, const std::string& subkey);
+  // link a new node of lvl levels after update[i] in each level, rank[i]
+  // is the rank of update[i]. Return the position of the new node.
+  Expected<uint64_t> linkNode(double score,
+                              const std::string& subkey,
+                              uint8_t lvl,
+                              const std::vector<uint64_t>& update,
+                              const std::vector<uint32_t>& rank,
+                              Transaction* txn);
+  ZSlEleValue* cacheNode(uint64_t pointer, ZSlEleValue&& val);
   const uint8_t _maxLevel;
   uint8_t _level;
   uint32_t _count;
@@ -109,7 +146,9 @@ class SkipList {
   uint32_t _chunkId;
   uint32_t _dbId;
   std::string _pk;
+  uint64_t _version;
   PStore _store;
+  std::deque<ZSlEleValue> _arena;
   PSE_MAP cache;
 };
 
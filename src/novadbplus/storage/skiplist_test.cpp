@@ -4,13 +4,18 @@
 
 #include <algorithm>
 #include <fstream>
+#include <map>
+#include <random>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 #include "novadbplus/server/server_params.h"
 #include "novadbplus/storage/kvstore.h"
 #include "novadbplus/storage/rocks/rocks_kvstore.h"
+#include "novadbplus/storage/ordered_zset.h"
 #include "novadbplus/storage/skiplist.h"
 #include "novadbplus/utils/portable.h"
 #include "novadbplus/utils/scopeguard.h"
@@ -71,7 +76,7 @@ TEST(SkipList, BackWardTail) {
   Expected<uint64_t> commitStatus = eTxn1.value()->commit();
   EXPECT_TRUE(commitStatus.ok());
 
-  SkipList sl(0, 0, "test", meta, store);
+  SkipList sl(0, 0, "test", meta, store, 0);
   constexpr uint32_t CNT = 1000;
   std::vector<uint32_t> keys;
   for (uint32_t i = 1; i <= CNT; ++i) {
@@ -140,7 +145,8 @@ TEST(SkipList, BackWardTail) {
   EXPECT_TRUE(eMetaContent.ok());
   meta = eMetaContent.value();
   EXPECT_EQ(meta.getCount(), CNT / 2 + 1);
-  SkipList sl2(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, store);
+  SkipList sl2(
+    mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, store, 0);
   std::sort(keys.begin(), keys.end());
   uint64_t now = sl2.getTail();
   for (uint32_t i = CNT / 2; i >= 1; --i) {
@@ -191,7 +197,7 @@ TEST(SkipList, Mix) {
   Expected<uint64_t> commitStatus = eTxn1.value()->commit();
   EXPECT_TRUE(commitStatus.ok());
 
-  SkipList sl(0, 0, "test", meta, store);
+  SkipList sl(0, 0, "test", meta, store, 0);
 
   std::vector<uint32_t> keys;
 
@@ -279,7 +285,7 @@ TEST(SkipList, InsertDelSameKeys) {
       auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
       EXPECT_TRUE(eMetaContent.ok());
       auto meta = eMetaContent.value();
-      SkipList sl(0, 0, "skiplistkey", meta, store);
+      SkipList sl(0, 0, "skiplistkey", meta, store, 0);
       Status s;
       unsigned int seed = 123;
       if (k == "k1") {
@@ -353,7 +359,7 @@ TEST(SkipList, Common) {
   Expected<uint64_t> commitStatus1 = eTxn1.value()->commit();
   EXPECT_TRUE(commitStatus1.ok());
 
-  SkipList sl(0, 0, "test", meta, store);
+  SkipList sl(0, 0, "test", meta, store, 0);
 
   std::vector<uint32_t> keys;
   std::vector<uint32_t> sortedkeys;
@@ -450,4 +456,337 @@ TEST(SkipList, Common) {
   LOG(INFO) << "skiplist level:" << static_cast<uint32_t>(sl.getLevel());
 }
 
+TEST(SkipList, InsertBatch) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  auto loadMeta = [&store](const std::string& pk) {
+    auto eTxn = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    RecordKey mk(0, 0, RecordType::RT_ZSET_META, pk, "");
+    auto eMeta = store->getKV(mk, eTxn.value().get());
+    EXPECT_TRUE(eMeta.ok());
+    return ZSlMetaValue::decode(eMeta.value().getValue()).value();
+  };
+  // members [0, BASE) are in both zsets, [BASE, BASE + CNT) are added
+  // one by one to "single", and by insertBatch() to "batch"
+  const uint32_t BASE = 10000;
+  const uint32_t CNT = 1000;
+  for (auto pk : {"single", "batch"}) {
+    auto eTxn = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    ZSlMetaValue meta(1, 1, 0);
+    RecordKey mk(0, 0, RecordType::RT_ZSET_META, pk, "");
+    RecordValue rv(meta.encode(), RecordType::RT_ZSET_META, -1);
+    EXPECT_TRUE(store->setKV(mk, rv, eTxn.value().get()).ok());
+    RecordKey head(0,
+                   0,
+                   RecordType::RT_ZSET_S_ELE,
+                   pk,
+                   std::to_string(ZSlMetaValue::HEAD_ID));
+    ZSlEleValue headVal;
+    RecordValue headRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
+    EXPECT_TRUE(store->setKV(head, headRv, eTxn.value().get()).ok());
+
+    SkipList sl(0, 0, pk, meta, store, 0);
+    std::vector<std::pair<double, std::string>> members;
+    for (uint32_t i = 0; i < BASE; ++i) {
+      members.emplace_back(i * 2, std::to_string(i));
+    }
+    EXPECT_TRUE(sl.insertBatch(members, eTxn.value().get()).ok());
+    EXPECT_TRUE(
+      sl.save(eTxn.value().get(), {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  }
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<uint32_t> score(0, BASE * 2 - 1);
+  std::vector<std::pair<double, std::string>> members;
+  for (uint32_t i = BASE; i < BASE + CNT; ++i) {
+    members.emplace_back(score(gen), std::to_string(i));
+  }
+  std::sort(members.begin(), members.end(), [](const auto& a, const auto& b) {
+    return slCmp(a.first, a.second, b.first, b.second) < 0;
+  });
+
+  auto eTxn1 = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn1.ok());
+  SkipList single(0, 0, "single", loadMeta("single"), store, 0);
+  for (const auto& m : members) {
+    EXPECT_TRUE(single.insert(m.first, m.second, eTxn1.value().get()).ok());
+  }
+  EXPECT_TRUE(single
+                .save(eTxn1.value().get(), {ErrorCodes::ERR_NOTFOUND, ""}, -1)
+                .ok());
+  EXPECT_TRUE(eTxn1.value()->commit().ok());
+
+  auto eTxn2 = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn2.ok());
+  SkipList batch(0, 0, "batch", loadMeta("batch"), store, 0);
+  EXPECT_TRUE(batch.insertBatch(members, eTxn2.value().get()).ok());
+  EXPECT_TRUE(batch
+                .save(eTxn2.value().get(), {ErrorCodes::ERR_NOTFOUND, ""}, -1)
+                .ok());
+  EXPECT_TRUE(eTxn2.value()->commit().ok());
+
+  // the finger saves the reads from the head for each member
+  EXPECT_LE(batch.nGetFromStore, single.nGetFromStore);
+  EXPECT_LT(batch.nGetFromCache, single.nGetFromCache);
+  EXPECT_EQ(single.getCount(), BASE + CNT + 1);
+  EXPECT_EQ(batch.getCount(), BASE + CNT + 1);
+
+  auto eTxn3 = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn3.ok());
+  SkipList sl1(0, 0, "single", loadMeta("single"), store, 0);
+  SkipList sl2(0, 0, "batch", loadMeta("batch"), store, 0);
+  auto r1 = sl1.scanByRank(0, BASE + CNT, false, eTxn3.value().get());
+  auto r2 = sl2.scanByRank(0, BASE + CNT, false, eTxn3.value().get());
+  EXPECT_TRUE(r1.ok());
+  EXPECT_TRUE(r2.ok());
+  EXPECT_EQ(r1.value().size(), BASE + CNT);
+  EXPECT_EQ(r1.value(), r2.value());
+  for (const auto& m : members) {
+    auto expRank = sl2.rank(m.first, m.second, eTxn3.value().get());
+    EXPECT_TRUE(expRank.ok());
+    auto expRank1 = sl1.rank(m.first, m.second, eTxn3.value().get());
+    EXPECT_EQ(expRank.value(), expRank1.value());
+  }
+}
+
+TEST(OrderedZset, SameAsSkipList) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  // "sl" is a skiplist and "oz" an ordered zset, they always have the same
+  // members
+  for (auto pk : {"sl", "oz"}) {
+    auto eTxn = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    RecordKey mk(0, 0, RecordType::RT_ZSET_META, pk, "");
+    auto encoding = std::string(pk) == "oz"
+      ? ZSlMetaValue::Encoding::ENCODING_ORDERED
+      : ZSlMetaValue::Encoding::ENCODING_SKIPLIST;
+    auto eMeta = initZsetIndex(encoding, mk, 0, store, eTxn.value().get());
+    EXPECT_TRUE(eMeta.ok());
+    auto zi = createZsetIndex(0, 0, pk, eMeta.value(), store, 0);
+    EXPECT_TRUE(
+      zi->save(eTxn.value().get(), {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  }
+  auto open = [&store](const std::string& pk, Transaction* txn) {
+    RecordKey mk(0, 0, RecordType::RT_ZSET_META, pk, "");
+    auto eMeta = store->getKV(mk, txn);
+    EXPECT_TRUE(eMeta.ok());
+    auto meta = ZSlMetaValue::decode(eMeta.value().getValue()).value();
+    return createZsetIndex(0, 0, pk, meta, store, 0);
+  };
+  auto compare = [](ZsetIndex* sl, ZsetIndex* oz, Transaction* txn) {
+    ASSERT_EQ(sl->getCount(), oz->getCount());
+    int64_t n = sl->getCount() - 1;
+    auto r1 = sl->scanByRank(0, n, false, txn);
+    auto r2 = oz->scanByRank(0, n, false, txn);
+    ASSERT_TRUE(r1.ok() && r2.ok());
+    EXPECT_EQ(r1.value(), r2.value());
+    r1 = sl->scanByRank(n / 3, n / 3, true, txn);
+    r2 = oz->scanByRank(n / 3, n / 3, true, txn);
+    EXPECT_EQ(r1.value(), r2.value());
+
+    size_t i = 0;
+    for (const auto& m : sl->scanByRank(0, n, false, txn).value()) {
+      if (i++ % 7 != 0) {
+        continue;
+      }
+      auto rank1 = sl->rank(m.first, m.second, txn);
+      auto rank2 = oz->rank(m.first, m.second, txn);
+      ASSERT_TRUE(rank1.ok() && rank2.ok());
+      EXPECT_EQ(rank1.value(), rank2.value());
+    }
+    for (int lo = -60; lo < 60; lo += 13) {
+      Zrangespec range{static_cast<double>(lo), lo + 20.0, lo % 2, 0};
+      auto c1 = sl->countInRange(range, txn);
+      auto c2 = oz->countInRange(range, txn);
+      ASSERT_TRUE(c1.ok() && c2.ok());
+      EXPECT_EQ(c1.value(), c2.value());
+      for (bool rev : {false, true}) {
+        r1 = sl->scanByScore(range, 3, 50, rev, txn);
+        r2 = oz->scanByScore(range, 3, 50, rev, txn);
+        ASSERT_TRUE(r1.ok() && r2.ok());
+        EXPECT_EQ(r1.value(), r2.value());
+      }
+    }
+  };
+
+  std::mt19937 gen(0);
+  std::map<std::string, double> members;
+  // the index gets more levels in the first rounds, and fewer in the last
+  for (int round = 0; round < 8; ++round) {
+    auto eTxn = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    Transaction* txn = eTxn.value().get();
+    auto sl = open("sl", txn);
+    auto oz = open("oz", txn);
+    if (round < 3) {
+      std::vector<std::pair<double, std::string>> batch;
+      for (uint32_t i = 0; i < 6000; ++i) {
+        std::string m = std::to_string(gen() % 100000);
+        // an escaped byte in the bound
+        if (i % 50 == 0) {
+          m.push_back('\0');
+        }
+        if (members.count(m)) {
+          continue;
+        }
+        members[m] = static_cast<int>(gen() % 100) - 50;
+        batch.emplace_back(members[m], m);
+      }
+      std::sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) {
+        return slCmp(a.first, a.second, b.first, b.second) < 0;
+      });
+      EXPECT_TRUE(sl->insertBatch(batch, txn).ok());
+      EXPECT_TRUE(oz->insertBatch(batch, txn).ok());
+    } else if (round < 6) {
+      for (auto it = members.begin(); it != members.end();) {
+        if (gen() % 3 == 0) {
+          ++it;
+          continue;
+        }
+        EXPECT_TRUE(sl->remove(it->second, it->first, txn).ok());
+        EXPECT_TRUE(oz->remove(it->second, it->first, txn).ok());
+        it = members.erase(it);
+      }
+    } else if (round == 6) {
+      Zrangespec range{-20, 20, 0, 1};
+      auto r1 = sl->removeRangeByScore(range, txn);
+      auto r2 = oz->removeRangeByScore(range, txn);
+      ASSERT_TRUE(r1.ok() && r2.ok());
+      EXPECT_EQ(r1.value(), r2.value());
+      for (const auto& m : r1.value()) {
+        members.erase(m.second);
+      }
+    } else {
+      auto r1 = sl->removeRangeByRank(1, sl->getCount() - 1, txn);
+      auto r2 = oz->removeRangeByRank(1, oz->getCount() - 1, txn);
+      ASSERT_TRUE(r1.ok() && r2.ok());
+      EXPECT_EQ(r1.value(), r2.value());
+      members.clear();
+    }
+    compare(sl.get(), oz.get(), txn);
+    EXPECT_EQ(oz->getCount(), members.size() + 1);
+    EXPECT_TRUE(sl->save(txn, {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+    EXPECT_TRUE(oz->save(txn, {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+
+    // and the same after they are read back
+    auto eTxn1 = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn1.ok());
+    compare(open("sl", eTxn1.value().get()).get(),
+            open("oz", eTxn1.value().get()).get(),
+            eTxn1.value().get());
+  }
+
+  // an empty zset has only the record of BOUND_MAX of level 1
+  auto eTxn = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  auto oz = open("oz", eTxn.value().get());
+  EXPECT_EQ(static_cast<OrderedZset*>(oz.get())->getHeight(), 1);
+  EXPECT_TRUE(oz->drop(eTxn.value().get()).ok());
+  EXPECT_TRUE(eTxn.value()->commit().ok());
+  auto eTxn1 = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn1.ok());
+  auto cursor = eTxn1.value()->createDataCursor();
+  RecordKey fake(0, 0, RecordType::RT_ZSET_S_ELE, "oz", "");
+  cursor->seek(fake.prefixPk());
+  auto eRcd = cursor->next();
+  EXPECT_TRUE(!eRcd.ok() ||
+              eRcd.value().getRecordKey().prefixPk() != fake.prefixPk());
+}
+
+TEST(OrderedZset, LexRange) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  auto eTxn = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  Transaction* txn = eTxn.value().get();
+  std::vector<std::unique_ptr<ZsetIndex>> zsets;
+  for (auto encoding : {ZSlMetaValue::Encoding::ENCODING_SKIPLIST,
+                        ZSlMetaValue::Encoding::ENCODING_ORDERED}) {
+    std::string pk = std::to_string(static_cast<int>(encoding));
+    RecordKey mk(0, 0, RecordType::RT_ZSET_META, pk, "");
+    auto eMeta = initZsetIndex(encoding, mk, 0, store, txn);
+    EXPECT_TRUE(eMeta.ok());
+    zsets.emplace_back(createZsetIndex(0, 0, pk, eMeta.value(), store, 0));
+  }
+  // the members of the same score are sorted by lex
+  std::vector<std::pair<double, std::string>> members;
+  for (uint32_t i = 0; i < 500; ++i) {
+    members.emplace_back(0, std::to_string(i));
+  }
+  members.emplace_back(0, std::string("1\0", 2));
+  members.emplace_back(0, "");
+  std::sort(members.begin(), members.end());
+  for (auto& zi : zsets) {
+    EXPECT_TRUE(zi->insertBatch(members, txn).ok());
+  }
+
+  std::vector<std::pair<std::string, std::string>> ranges = {
+    {"-", "+"},
+    {"[1", "(2"},
+    {"(1", "[2"},
+    {"[", "(1"},
+    {"(1", "(10"},
+    {"[3", "[3"},
+    {"(3", "(3"},
+    {"[5", "[4"},
+    {"+", "-"},
+    {"-", "[250"},
+    {"(499", "+"},
+  };
+  for (const auto& r : ranges) {
+    Zlexrangespec range;
+    EXPECT_EQ(zslParseLexRange(r.first.c_str(), r.second.c_str(), &range), 0);
+    auto c1 = zsets[0]->countInLexRange(range, txn);
+    auto c2 = zsets[1]->countInLexRange(range, txn);
+    ASSERT_TRUE(c1.ok() && c2.ok());
+    EXPECT_EQ(c1.value(), c2.value()) << r.first << " " << r.second;
+    for (bool rev : {false, true}) {
+      auto r1 = zsets[0]->scanByLex(range, 2, 100, rev, txn);
+      auto r2 = zsets[1]->scanByLex(range, 2, 100, rev, txn);
+      ASSERT_TRUE(r1.ok() && r2.ok());
+      EXPECT_EQ(r1.value(), r2.value()) << r.first << " " << r.second;
+    }
+  }
+  Zlexrangespec range;
+  EXPECT_EQ(zslParseLexRange("[2", "(3", &range), 0);
+  auto r1 = zsets[0]->removeRangeByLex(range, txn);
+  auto r2 = zsets[1]->removeRangeByLex(range, txn);
+  ASSERT_TRUE(r1.ok() && r2.ok());
+  EXPECT_EQ(r1.value(), r2.value());
+  EXPECT_EQ(zsets[0]->getCount(), zsets[1]->getCount());
+}
+
 }  // namespace novadbplus
@@ -0,0 +1,64 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include <memory>
+#include <string>
+
+#include "novadbplus/storage/ordered_zset.h"
+#include "novadbplus/storage/skiplist.h"
+#include "novadbplus/storage/zset_index.h"
+#include "novadbplus/utils/invariant.h"
+
+namespace novadbplus {
+
+ZSlMetaValue::Encoding zsetEncodingFromStr(const std::string& encoding) {
+  if (encoding == "ordered") {
+    return ZSlMetaValue::Encoding::ENCODING_ORDERED;
+  }
+  return ZSlMetaValue::Encoding::ENCODING_SKIPLIST;
+}
+
+std::unique_ptr<ZsetIndex> createZsetIndex(uint32_t chunkId,
+                                           uint32_t dbId,
+                                           const std::string& pk,
+                                           const ZSlMetaValue& meta,
+                                           PStore store,
+                                           uint64_t version) {
+  switch (meta.getEncoding()) {
+    case ZSlMetaValue::Encoding::ENCODING_ORDERED:
+      return std::make_unique<OrderedZset>(
+        chunkId, dbId, pk, meta, store, version);
+    case ZSlMetaValue::Encoding::ENCODING_SKIPLIST:
+      return std::make_unique<SkipList>(
+        chunkId, dbId, pk, meta, store, version);
+  }
+  INVARIANT_D(0);
+  return nullptr;
+}
+
+Expected<ZSlMetaValue> initZsetIndex(ZSlMetaValue::Encoding encoding,
+                                     const RecordKey& mk,
+                                     uint64_t version,
+                                     PStore store,
+                                     Transaction* txn) {
+  if (encoding == ZSlMetaValue::Encoding::ENCODING_ORDERED) {
+    return OrderedZset::init(mk, version, store, txn);
+  }
+  // head node also included into the count
+  RecordKey head(mk.getChunkId(),
+                 mk.getDbId(),
+                 RecordType::RT_ZSET_S_ELE,
+                 mk.getPrimaryKey(),
+                 std::to_string(ZSlMetaValue::HEAD_ID),
+                 version);
+  ZSlEleValue headVal;
+  RecordValue headRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
+  Status s = store->setKV(head, headRv, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return ZSlMetaValue(1 /*lvl*/, 1 /*count*/, 0 /*tail*/);
+}
+
+}  // namespace novadbplus
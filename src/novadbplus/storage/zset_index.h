@@ -0,0 +1,110 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_STORAGE_ZSET_INDEX_H_
+#define SRC_novadbPLUS_STORAGE_ZSET_INDEX_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "novadbplus/storage/kvstore.h"
+#include "novadbplus/storage/record.h"
+#include "novadbplus/utils/redis_port.h"
+
+namespace novadbplus {
+
+using Zrangespec = redis_port::Zrangespec;
+using Zlexrangespec = redis_port::Zlexrangespec;
+
+// ZsetIndex keeps the order of the members of a zset in its RT_ZSET_S_ELE
+// records, the RT_ZSET_H_ELE records (member -> score) are maintained by
+// the callers. The encoding in the meta decides the implementation, see
+// SkipList and OrderedZset.
+// The changes are written to txn by save(), or by drop() when the zset
+// becomes empty.
+class ZsetIndex {
+ public:
+  virtual ~ZsetIndex() = default;
+
+  virtual Status insert(double score,
+                        const std::string& subkey,
+                        Transaction* txn) = 0;
+  // insert the members in one pass, they should be sorted by slCmp() and
+  // none of them exists in the zset.
+  virtual Status insertBatch(
+    const std::vector<std::pair<double, std::string>>& members,
+    Transaction* txn) = 0;
+  // The caller shoule guarantee the (score, subkey) exists
+  virtual Status remove(double score,
+                        const std::string& subkey,
+                        Transaction* txn) = 0;
+  // 1-based rank of an existing member
+  virtual Expected<uint32_t> rank(double score,
+                                  const std::string& subkey,
+                                  Transaction* txn) = 0;
+  virtual Expected<uint32_t> countInRange(const Zrangespec& range,
+                                          Transaction* txn) = 0;
+  virtual Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                             Transaction* txn) = 0;
+
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByLex(
+    const Zlexrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) = 0;
+  // 0-based start, the caller should guarantee [start, start + len) exists
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByRank(
+    int64_t start, int64_t len, bool rev, Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByScore(
+    const Zrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) = 0;
+
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByScore(const Zrangespec& range, Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByLex(const Zlexrangespec& range, Transaction* txn) = 0;
+  // 1-based index
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByRank(uint32_t start, uint32_t end, Transaction* txn) = 0;
+
+  // write the changes and the meta
+  virtual Status save(Transaction* txn,
+                      const Expected<RecordValue>& oldValue,
+                      uint64_t versionEP) = 0;
+  // delete the S_ELE records left by an empty zset, the caller deletes
+  // its meta
+  virtual Status drop(Transaction* txn) = 0;
+  // the number of members plus one, as the skiplist counts its head
+  virtual uint32_t getCount() const = 0;
+};
+
+ZSlMetaValue::Encoding zsetEncodingFromStr(const std::string& encoding);
+
+// the index of an existing zset, version is the version of its subkeys,
+// see Command::getSubKeyVersion()
+std::unique_ptr<ZsetIndex> createZsetIndex(uint32_t chunkId,
+                                           uint32_t dbId,
+                                           const std::string& pk,
+                                           const ZSlMetaValue& meta,
+                                           PStore store,
+                                           uint64_t version);
+
+// write the S_ELE records a new, empty zset of the encoding needs, and
+// return its meta. The caller saves the meta.
+Expected<ZSlMetaValue> initZsetIndex(ZSlMetaValue::Encoding encoding,
+                                     const RecordKey& mk,
+                                     uint64_t version,
+                                     PStore store,
+                                     Transaction* txn);
+
+}  // namespace novadbplus
+
+#endif  // SRC_novadbPLUS_STORAGE_ZSET_INDEX_H_
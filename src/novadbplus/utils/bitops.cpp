@@ -0,0 +1,463 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#include "novadbplus/utils/bitops.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BITOPS_HAVE_AVX2
+// the avx512 intrinsics and cpu names need gcc-8 or clang-8
+#if (defined(__clang__) && __clang_major__ >= 8) || \
+  (!defined(__clang__) && __GNUC__ >= 8)
+#define BITOPS_HAVE_AVX512
+#endif
+#endif
+
+namespace novadbplus {
+namespace bitops {
+
+struct Kernels {
+  Isa isa;
+  uint64_t (*popCount)(const uint8_t* p, size_t n);
+  // return an offset that all the bytes before it equal to the skip value,
+  // 0xff if ones is true, or 0 otherwise. It stops at or before the first
+  // byte not equal to the skip value.
+  size_t (*skip)(const uint8_t* p, size_t n, bool ones);
+  void (*apply)(Op op, uint8_t* dst, const uint8_t* src, size_t n);
+  void (*maxBytes)(uint8_t* dst, const uint8_t* src, size_t n);
+  void (*unpack6)(const uint8_t* src, uint8_t* dst, size_t n);
+};
+
+static inline uint64_t load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline uint64_t popCount64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (v * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+template <typename T>
+static inline T applyWord(Op op, T a, T b) {
+  switch (op) {
+    case Op::AND:
+      return a & b;
+    case Op::OR:
+      return a | b;
+    case Op::XOR:
+      return a ^ b;
+    case Op::NOT:
+      return static_cast<T>(~b);
+  }
+  return a;
+}
+
+static uint64_t popCountScalar(const uint8_t* p, size_t n) {
+  uint64_t bits = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    bits += popCount64(load64(p + i));
+  }
+  for (; i < n; i++) {
+    bits += popCount64(p[i]);
+  }
+  return bits;
+}
+
+static size_t skipScalar(const uint8_t* p, size_t n, bool ones) {
+  uint64_t skipval = ones ? UINT64_MAX : 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    if (load64(p + i) != skipval) {
+      break;
+    }
+  }
+  return i;
+}
+
+static void applyScalar(Op op, uint8_t* dst, const uint8_t* src, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    store64(dst + i, applyWord(op, load64(dst + i), load64(src + i)));
+  }
+  for (; i < n; i++) {
+    dst[i] = applyWord(op, dst[i], src[i]);
+  }
+}
+
+static void maxBytesScalar(uint8_t* dst, const uint8_t* src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+}
+
+static void unpack6Scalar(const uint8_t* src, uint8_t* dst, size_t n) {
+  size_t i = 0;
+  const uint8_t* p = src;
+  for (; i + 4 <= n; i += 4, p += 3) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    dst[i] = v & 63;
+    dst[i + 1] = (v >> 6) & 63;
+    dst[i + 2] = (v >> 12) & 63;
+    dst[i + 3] = v >> 18;
+  }
+  for (; i < n; i++) {
+    size_t byte = i * 6 / 8;
+    size_t fb = (i * 6) & 7;
+    uint32_t b0 = src[byte];
+    uint32_t b1 = fb > 2 ? src[byte + 1] : 0;
+    dst[i] = ((b0 >> fb) | (b1 << (8 - fb))) & 63;
+  }
+}
+
+#ifdef BITOPS_HAVE_AVX2
+// count the nibbles by a table lookup with pshufb, the byte counters are
+// summed up by psadbw every 16 rounds, before they can overflow.
+__attribute__((target("avx2"))) static uint64_t popCountAvx2(const uint8_t* p,
+                                                             size_t n) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i total = _mm256_setzero_si256();
+  size_t i = 0;
+  while (i + 32 <= n) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int r = 0; r < 16 && i + 32 <= n; r++, i += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i lo = _mm256_and_si256(v, low);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+      acc = _mm256_add_epi8(acc, _mm256_shuffle_epi8(lookup, lo));
+      acc = _mm256_add_epi8(acc, _mm256_shuffle_epi8(lookup, hi));
+    }
+    total = _mm256_add_epi64(total,
+                             _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+  }
+  uint64_t bits = _mm256_extract_epi64(total, 0) +
+    _mm256_extract_epi64(total, 1) + _mm256_extract_epi64(total, 2) +
+    _mm256_extract_epi64(total, 3);
+  return bits + popCountScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) static size_t skipAvx2(const uint8_t* p,
+                                                       size_t n,
+                                                       bool ones) {
+  const __m256i all = _mm256_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    if (ones ? !_mm256_testc_si256(v, all) : !_mm256_testz_si256(v, v)) {
+      break;
+    }
+  }
+  return i + skipScalar(p + i, n - i, ones);
+}
+
+__attribute__((target("avx2"))) static void applyAvx2(Op op,
+                                                      uint8_t* dst,
+                                                      const uint8_t* src,
+                                                      size_t n) {
+  const __m256i all = _mm256_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    __m256i a = _mm256_loadu_si256(d);
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    switch (op) {
+      case Op::AND:
+        a = _mm256_and_si256(a, b);
+        break;
+      case Op::OR:
+        a = _mm256_or_si256(a, b);
+        break;
+      case Op::XOR:
+        a = _mm256_xor_si256(a, b);
+        break;
+      case Op::NOT:
+        a = _mm256_xor_si256(b, all);
+        break;
+    }
+    _mm256_storeu_si256(d, a);
+  }
+  applyScalar(op, dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void maxBytesAvx2(uint8_t* dst,
+                                                         const uint8_t* src,
+                                                         size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    __m256i a = _mm256_loadu_si256(d);
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(d, _mm256_max_epu8(a, b));
+  }
+  maxBytesScalar(dst + i, src + i, n - i);
+}
+
+// every 3 bytes hold 4 integers, spread them into the 32bit lanes by
+// pshufb and shift each one into its own byte. 24 bytes are loaded as two
+// 16 bytes halves, so stop 4 bytes before the end and leave the tail
+// to the scalar loop.
+__attribute__((target("avx2"))) static void unpack6Avx2(const uint8_t* src,
+                                                        uint8_t* dst,
+                                                        size_t n) {
+  const __m256i shuf = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                        6, 7, 8, -1, 9, 10, 11, -1,
+                                        0, 1, 2, -1, 3, 4, 5, -1,
+                                        6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i m0 = _mm256_set1_epi32(0x3f);
+  const __m256i m1 = _mm256_set1_epi32(0x3f00);
+  const __m256i m2 = _mm256_set1_epi32(0x3f0000);
+  const __m256i m3 = _mm256_set1_epi32(0x3f000000);
+  size_t bytes = (n * 6 + 7) / 8;
+  size_t i = 0;
+  size_t off = 0;
+  for (; i + 32 <= n && off + 28 <= bytes; i += 32, off += 24) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + off));
+    __m128i hi =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + off + 12));
+    __m256i v = _mm256_shuffle_epi8(
+      _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuf);
+    __m256i r0 = _mm256_and_si256(v, m0);
+    __m256i r1 = _mm256_and_si256(_mm256_slli_epi32(v, 2), m1);
+    __m256i r2 = _mm256_and_si256(_mm256_slli_epi32(v, 4), m2);
+    __m256i r3 = _mm256_and_si256(_mm256_slli_epi32(v, 6), m3);
+    _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(dst + i),
+      _mm256_or_si256(_mm256_or_si256(r0, r1), _mm256_or_si256(r2, r3)));
+  }
+  unpack6Scalar(src + off, dst + i, n - i);
+}
+#endif  // BITOPS_HAVE_AVX2
+
+#ifdef BITOPS_HAVE_AVX512
+__attribute__((target("avx512f,avx512vpopcntdq"))) static uint64_t
+popCountAvx512(const uint8_t* p, size_t n) {
+  __m512i total = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i v = _mm512_loadu_si512(p + i);
+    total = _mm512_add_epi64(total, _mm512_popcnt_epi64(v));
+  }
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, total);
+  uint64_t bits = 0;
+  for (auto lane : lanes) {
+    bits += lane;
+  }
+  return bits + popCountScalar(p + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static size_t skipAvx512(const uint8_t* p,
+                                                            size_t n,
+                                                            bool ones) {
+  const __m512i all = _mm512_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i v = _mm512_loadu_si512(p + i);
+    if (ones ? _mm512_cmpneq_epi64_mask(v, all)
+             : _mm512_test_epi64_mask(v, v)) {
+      break;
+    }
+  }
+  return i + skipScalar(p + i, n - i, ones);
+}
+
+__attribute__((target("avx512f"))) static void applyAvx512(Op op,
+                                                           uint8_t* dst,
+                                                           const uint8_t* src,
+                                                           size_t n) {
+  const __m512i all = _mm512_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i a = _mm512_loadu_si512(dst + i);
+    __m512i b = _mm512_loadu_si512(src + i);
+    switch (op) {
+      case Op::AND:
+        a = _mm512_and_si512(a, b);
+        break;
+      case Op::OR:
+        a = _mm512_or_si512(a, b);
+        break;
+      case Op::XOR:
+        a = _mm512_xor_si512(a, b);
+        break;
+      case Op::NOT:
+        a = _mm512_xor_si512(b, all);
+        break;
+    }
+    _mm512_storeu_si512(dst + i, a);
+  }
+  applyScalar(op, dst + i, src + i, n - i);
+}
+#endif  // BITOPS_HAVE_AVX512
+
+static bool isaSupported(Isa isa) {
+#ifdef BITOPS_HAVE_AVX2
+  __builtin_cpu_init();
+#endif
+  switch (isa) {
+    case Isa::SCALAR:
+      return true;
+    case Isa::AVX2:
+#ifdef BITOPS_HAVE_AVX2
+      return __builtin_cpu_supports("avx2");
+#else
+      return false;
+#endif
+    case Isa::AVX512:
+#ifdef BITOPS_HAVE_AVX512
+      return __builtin_cpu_supports("avx512f");
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+static Kernels makeKernels(Isa isa) {
+  Kernels k{Isa::SCALAR,
+            popCountScalar,
+            skipScalar,
+            applyScalar,
+            maxBytesScalar,
+            unpack6Scalar};
+#ifdef BITOPS_HAVE_AVX2
+  if (isa == Isa::AVX2 || isa == Isa::AVX512) {
+    k = Kernels{Isa::AVX2,
+                popCountAvx2,
+                skipAvx2,
+                applyAvx2,
+                maxBytesAvx2,
+                unpack6Avx2};
+  }
+#endif
+#ifdef BITOPS_HAVE_AVX512
+  if (isa == Isa::AVX512) {
+    k.isa = Isa::AVX512;
+    k.skip = skipAvx512;
+    k.apply = applyAvx512;
+    // NOTE: vpopcntq comes later than avx512f(icelake),
+    // or else the avx2 popcount is used. maxBytes and unpack6 keep the
+    // avx2 ones, the hyperloglog registers are only 16KB.
+    if (__builtin_cpu_supports("avx512vpopcntdq")) {
+      k.popCount = popCountAvx512;
+    }
+  }
+#endif
+  return k;
+}
+
+static Kernels& kernels() {
+  static Kernels k = makeKernels(isaSupported(Isa::AVX512)
+                                   ? Isa::AVX512
+                                   : (isaSupported(Isa::AVX2) ? Isa::AVX2
+                                                              : Isa::SCALAR));
+  return k;
+}
+
+Isa getIsa() {
+  return kernels().isa;
+}
+
+bool setIsa(Isa isa) {
+  if (!isaSupported(isa)) {
+    return false;
+  }
+  kernels() = makeKernels(isa);
+  return true;
+}
+
+std::string isaName(Isa isa) {
+  switch (isa) {
+    case Isa::SCALAR:
+      return "scalar";
+    case Isa::AVX2:
+      return "avx2";
+    case Isa::AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+size_t popCount(const void* s, size_t count) {
+  return kernels().popCount(static_cast<const uint8_t*>(s), count);
+}
+
+int64_t bitPos(const void* s, size_t count, uint32_t bit) {
+  const uint8_t* p = static_cast<const uint8_t*>(s);
+  uint8_t skipval = bit ? 0 : UINT8_MAX;
+  for (size_t i = kernels().skip(p, count, bit == 0); i < count; i++) {
+    if (p[i] == skipval) {
+      continue;
+    }
+    uint8_t byte = bit ? p[i] : static_cast<uint8_t>(~p[i]);
+    int64_t pos = i * 8;
+    for (uint8_t one = 0x80; !(byte & one); one >>= 1) {
+      pos++;
+    }
+    return pos;
+  }
+  return bit ? -1 : static_cast<int64_t>(count * 8);
+}
+
+void apply(Op op, void* dst, const void* src, size_t count) {
+  kernels().apply(op,
+                  static_cast<uint8_t*>(dst),
+                  static_cast<const uint8_t*>(src),
+                  count);
+}
+
+std::string bitop(Op op, const std::vector<std::string>& srcs, size_t maxLen) {
+  std::string result(maxLen, 0);
+  if (srcs.empty() || maxLen == 0) {
+    return result;
+  }
+  char* dst = &result[0];
+  memcpy(dst, srcs[0].data(), std::min(srcs[0].size(), maxLen));
+  if (op == Op::NOT) {
+    apply(Op::NOT, dst, dst, maxLen);
+    return result;
+  }
+  for (size_t j = 1; j < srcs.size(); ++j) {
+    size_t len = std::min(srcs[j].size(), maxLen);
+    apply(op, dst, srcs[j].data(), len);
+    if (op == Op::AND && len < maxLen) {
+      memset(dst + len, 0, maxLen - len);
+    }
+  }
+  return result;
+}
+
+void maxBytes(void* dst, const void* src, size_t count) {
+  kernels().maxBytes(static_cast<uint8_t*>(dst),
+                     static_cast<const uint8_t*>(src),
+                     count);
+}
+
+void unpack6(const void* src, void* dst, size_t count) {
+  kernels().unpack6(static_cast<const uint8_t*>(src),
+                    static_cast<uint8_t*>(dst),
+                    count);
+}
+
+}  // namespace bitops
+}  // namespace novadbplus
@@ -0,0 +1,56 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+#ifndef SRC_novadbPLUS_UTILS_BITOPS_H_
+#define SRC_novadbPLUS_UTILS_BITOPS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace novadbplus {
+namespace bitops {
+
+// the bit kernels are picked once by the cpu features at runtime,
+// SCALAR is the portable 64bit-word version used everywhere else.
+enum class Isa {
+  SCALAR,
+  AVX2,
+  AVX512,
+};
+
+enum class Op {
+  AND,
+  OR,
+  XOR,
+  NOT,
+};
+
+Isa getIsa();
+// only for tests and benchmarks, it is not safe with the running kernels.
+// return false if the cpu lacks the isa.
+bool setIsa(Isa isa);
+std::string isaName(Isa isa);
+
+size_t popCount(const void* s, size_t count);
+// position of the first bit(0 or 1) of s, the bytes are read from left to
+// right with the most significant bit first. Like redis, the string is
+// padded by zero on the right, so it returns count * 8 if looking for 0
+// in an all-ones string, and -1 if looking for 1 in an all-zeros string.
+int64_t bitPos(const void* s, size_t count, uint32_t bit);
+// dst[i] = dst[i] op src[i] for i in [0, count), NOT makes dst[i] = ~src[i]
+void apply(Op op, void* dst, const void* src, size_t count);
+// the BITOP of srcs over maxLen bytes, the shorter ones are zero padded
+std::string bitop(Op op, const std::vector<std::string>& srcs, size_t maxLen);
+// dst[i] = max(dst[i], src[i]) for i in [0, count)
+void maxBytes(void* dst, const void* src, size_t count);
+// unpack count 6-bit integers into bytes. They are packed from the least
+// significant bits, which is the layout of the hyperloglog dense registers.
+void unpack6(const void* src, void* dst, size_t count);
+
+}  // namespace bitops
+}  // namespace novadbplus
+
+#endif  // SRC_novadbPLUS_UTILS_BITOPS_H_
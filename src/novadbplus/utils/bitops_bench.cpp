@@ -0,0 +1,117 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this novadb open source
+// project for additional information.
+
+// bitops_bench [bytes] [rounds]
+// runs the bit kernels of every isa the cpu supports over a random bitmap,
+// and prints the throughput of each one.
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "novadbplus/utils/bitops.h"
+
+namespace novadbplus {
+
+static double runBench(size_t bytes,
+                       size_t rounds,
+                       const std::function<uint64_t()>& fn,
+                       uint64_t* sink) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    *sink += fn();
+  }
+  std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+  return static_cast<double>(bytes) * rounds / cost.count() / (1 << 30);
+}
+
+static void benchIsa(bitops::Isa isa, size_t bytes, size_t rounds) {
+  if (!bitops::setIsa(isa)) {
+    std::cout << std::setw(8) << bitops::isaName(isa) << " not supported"
+              << std::endl;
+    return;
+  }
+
+  std::mt19937_64 gen(bytes);
+  std::vector<std::string> srcs(4, std::string(bytes, 0));
+  for (auto& src : srcs) {
+    for (auto& c : src) {
+      c = static_cast<char>(gen());
+    }
+  }
+  // a long run of zeros before the first set bit
+  std::string sparse(bytes, 0);
+  sparse[bytes - 1] = 1;
+
+  uint64_t sink = 0;
+  double popcnt = runBench(
+    bytes,
+    rounds,
+    [&]() { return bitops::popCount(srcs[0].data(), bytes); },
+    &sink);
+  double bitpos = runBench(
+    bytes,
+    rounds,
+    [&]() { return bitops::bitPos(sparse.data(), bytes, 1); },
+    &sink);
+  double bitand_ = runBench(
+    bytes * srcs.size(),
+    rounds,
+    [&]() { return bitops::bitop(bitops::Op::AND, srcs, bytes).size(); },
+    &sink);
+  double bitor_ = runBench(
+    bytes * srcs.size(),
+    rounds,
+    [&]() { return bitops::bitop(bitops::Op::OR, srcs, bytes).size(); },
+    &sink);
+  std::string maxDst(srcs[1]);
+  double maxb = runBench(
+    bytes,
+    rounds,
+    [&]() {
+      bitops::maxBytes(&maxDst[0], srcs[0].data(), bytes);
+      return static_cast<uint64_t>(maxDst[0]);
+    },
+    &sink);
+  // the packed 6-bit registers take 3/4 of the unpacked bytes
+  std::string unpacked(bytes, 0);
+  double unpack = runBench(
+    bytes * 3 / 4,
+    rounds,
+    [&]() {
+      bitops::unpack6(srcs[0].data(), &unpacked[0], bytes);
+      return static_cast<uint64_t>(unpacked[0]);
+    },
+    &sink);
+
+  std::cout << std::setw(8) << bitops::isaName(isa) << std::fixed
+            << std::setprecision(2) << "  popcount:" << popcnt
+            << "GB/s  bitpos:" << bitpos << "GB/s  bitop-and:" << bitand_
+            << "GB/s  bitop-or:" << bitor_ << "GB/s  max:" << maxb
+            << "GB/s  unpack6:" << unpack << "GB/s  (" << sink % 10 << ")"
+            << std::endl;
+}
+
+}  // namespace novadbplus
+
+int main(int argc, char** argv) {
+  size_t bytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4 << 20;
+  size_t rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+  if (bytes == 0 || rounds == 0) {
+    std::cerr << "usage: bitops_bench [bytes] [rounds]" << std::endl;
+    return 1;
+  }
+  std::cout << "bitmap bytes:" << bytes << " rounds:" << rounds << std::endl;
+  for (auto isa : {novadbplus::bitops::Isa::SCALAR,
+                   novadbplus::bitops::Isa::AVX2,
+                   novadbplus::bitops::Isa::AVX512}) {
+    novadbplus::benchIsa(isa, bytes, rounds);
+  }
+  return 0;
+}
@@ -41,6 +41,7 @@
 #include <sstream>
 #include <utility>
 
+#include "novadbplus/utils/bitops.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/time.h"
@@ -66,6 +67,8 @@ struct PEObject {
 
 static struct PEObject peo;
 
+double hllRawSum(uint8_t* registers, double* PE, int* ezp);
+
 /* The Redis HyperLogLog implementation is based on the following ideas:
  *
  * * The use of a 64 bit hash function as proposed in [1], in order to don't
@@ -488,70 +491,12 @@ double hllDenseSum(uint8_t* registers, double* PE, int* ezp) {
 
   /* Redis default is to use 16384 registers 6 bits each. The code works
    * with other values by modifying the defines, but for our target value
-   * we take a faster path with unrolled loops. */
+   * we unpack the registers into bytes by the vectorized bitops::unpack6()
+   * and sum them as the raw encoding. */
   if (HLL_REGISTERS == 16384 && HLL_BITS == 6) {
-    uint8_t* r = registers;
-    uint64_t r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12, r13, r14,
-      r15;
-    for (j = 0; j < 1024; j++) {
-      /* Handle 16 registers per iteration. */
-      r0 = r[0] & 63;
-      if (r0 == 0)
-        ez++;
-      r1 = (r[0] >> 6 | r[1] << 2) & 63;
-      if (r1 == 0)
-        ez++;
-      r2 = (r[1] >> 4 | r[2] << 4) & 63;
-      if (r2 == 0)
-        ez++;
-      r3 = (r[2] >> 2) & 63;
-      if (r3 == 0)
-        ez++;
-      r4 = r[3] & 63;
-      if (r4 == 0)
-        ez++;
-      r5 = (r[3] >> 6 | r[4] << 2) & 63;
-      if (r5 == 0)
-        ez++;
-      r6 = (r[4] >> 4 | r[5] << 4) & 63;
-      if (r6 == 0)
-        ez++;
-      r7 = (r[5] >> 2) & 63;
-      if (r7 == 0)
-        ez++;
-      r8 = r[6] & 63;
-      if (r8 == 0)
-        ez++;
-      r9 = (r[6] >> 6 | r[7] << 2) & 63;
-      if (r9 == 0)
-        ez++;
-      r10 = (r[7] >> 4 | r[8] << 4) & 63;
-      if (r10 == 0)
-        ez++;
-      r11 = (r[8] >> 2) & 63;
-      if (r11 == 0)
-        ez++;
-      r12 = r[9] & 63;
-      if (r12 == 0)
-        ez++;
-      r13 = (r[9] >> 6 | r[10] << 2) & 63;
-      if (r13 == 0)
-        ez++;
-      r14 = (r[10] >> 4 | r[11] << 4) & 63;
-      if (r14 == 0)
-        ez++;
-      r15 = (r[11] >> 2) & 63;
-      if (r15 == 0)
-        ez++;
-
-      /* Additional parens will allow the compiler to optimize the
-       * code more with a loss of precision that is not very relevant
-       * here (floating point math is not commutative!). */
-      E += (PE[r0] + PE[r1]) + (PE[r2] + PE[r3]) + (PE[r4] + PE[r5]) +
-        (PE[r6] + PE[r7]) + (PE[r8] + PE[r9]) + (PE[r10] + PE[r11]) +
-        (PE[r12] + PE[r13]) + (PE[r14] + PE[r15]);
-      r += 12;
-    }
+    uint8_t raw[HLL_REGISTERS];
+    bitops::unpack6(registers, raw, HLL_REGISTERS);
+    return hllRawSum(raw, PE, ezp);
   } else {
     for (j = 0; j < HLL_REGISTERS; j++) {
       uint64_t reg;
@@ -991,56 +936,29 @@ double hllSparseSum(
 /* Implements the SUM operation for uint8_t data type which is only used
  * internally as speedup for PFCOUNT with multiple keys. */
 double hllRawSum(uint8_t* registers, double* PE, int* ezp) {
-  double E = 0;
-  int j, ez = 0;
-  uint64_t* word = reinterpret_cast<uint64_t*>(registers);
-  uint8_t* bytes;
-
-  for (j = 0; j < HLL_REGISTERS / 8; j++) {
-    if (*word == 0) {
-      ez += 8;
-    } else {
-      bytes = reinterpret_cast<uint8_t*>(word);
-      if (bytes[0])
-        E += PE[bytes[0]];
-      else
-        ez++;
-      if (bytes[1])
-        E += PE[bytes[1]];
-      else
-        ez++;
-      if (bytes[2])
-        E += PE[bytes[2]];
-      else
-        ez++;
-      if (bytes[3])
-        E += PE[bytes[3]];
-      else
-        ez++;
-      if (bytes[4])
-        E += PE[bytes[4]];
-      else
-        ez++;
-      if (bytes[5])
-        E += PE[bytes[5]];
-      else
-        ez++;
-      if (bytes[6])
-        E += PE[bytes[6]];
-      else
-        ez++;
-      if (bytes[7])
-        E += PE[bytes[7]];
-      else
-        ez++;
+  /* Build the histogram of the register values, and sum up
+   * histo[reg] * 2^(-reg) at the end, instead of a PE[] lookup and a
+   * floating point add for every register. Registers are at most 63. */
+  int histo[64] = {0};
+  for (int j = 0; j < HLL_REGISTERS; j += 8) {
+    uint64_t word;
+    memcpy(&word, registers + j, sizeof(word));
+    if (word == 0) {
+      histo[0] += 8;
+      continue;
+    }
+    for (int k = 0; k < 8; k++) {
+      histo[registers[j + k] & 63]++;
     }
-    word++;
   }
 
   // 2^(-reg[j]) is 1 when m is 0, add it 'ez' times for every zero register
   // in the HLL.
-  E += ez;
-  *ezp = ez;
+  double E = histo[0];
+  for (int j = 63; j > 0; j--) {
+    E += histo[j] * PE[j];
+  }
+  *ezp = histo[0];
   return E;
 }
 
@@ -1129,13 +1047,9 @@ int hllMerge(uint8_t* max, struct hllhdr* hdr, size_t hdrSize) {
   int i;
 
   if (hdr->encoding == HLL_DENSE) {
-    uint8_t val;
-
-    for (i = 0; i < HLL_REGISTERS; i++) {
-      HLL_DENSE_GET_REGISTER(val, hdr->registers, i);
-      if (val > max[i])
-        max[i] = val;
-    }
+    uint8_t raw[HLL_REGISTERS];
+    bitops::unpack6(hdr->registers, raw, HLL_REGISTERS);
+    bitops::maxBytes(max, raw, HLL_REGISTERS);
   } else {
     uint8_t *p = reinterpret_cast<uint8_t*>(hdr), *end = p + hdrSize;
     int64_t runlen, regval;
@@ -1240,19 +1154,24 @@ bool isHLLObject(const char* ptr, size_t size) {
   return true;
 }
 
+bool hllGetCachedCount(const struct hllhdr* hdr, uint64_t* card) {
+  if (!HLL_VALID_CACHE(hdr)) {
+    return false;
+  }
+  *card = (uint64_t)hdr->card[0];
+  *card |= (uint64_t)hdr->card[1] << 8;
+  *card |= (uint64_t)hdr->card[2] << 16;
+  *card |= (uint64_t)hdr->card[3] << 24;
+  *card |= (uint64_t)hdr->card[4] << 32;
+  *card |= (uint64_t)hdr->card[5] << 40;
+  *card |= (uint64_t)hdr->card[6] << 48;
+  *card |= (uint64_t)hdr->card[7] << 56;
+  return true;
+}
+
 uint64_t hllCountFast(struct hllhdr* hdr, size_t hdrSize, int* invalid) {
   uint64_t card;
-  if (HLL_VALID_CACHE(hdr)) {
-    /* Just return the cached value. */
-    card = (uint64_t)hdr->card[0];
-    card |= (uint64_t)hdr->card[1] << 8;
-    card |= (uint64_t)hdr->card[2] << 16;
-    card |= (uint64_t)hdr->card[3] << 24;
-    card |= (uint64_t)hdr->card[4] << 32;
-    card |= (uint64_t)hdr->card[5] << 40;
-    card |= (uint64_t)hdr->card[6] << 48;
-    card |= (uint64_t)hdr->card[7] << 56;
-  } else {
+  if (!hllGetCachedCount(hdr, &card)) {
     /* Recompute it and update the cached value. */
     card = hllCount(hdr, hdrSize, invalid);
     if (*invalid) {
@@ -16,6 +16,7 @@
 #include <sstream>
 #include <utility>
 
+#include "novadbplus/utils/bitops.h"
 #include "novadbplus/utils/invariant.h"
 #include "novadbplus/utils/time.h"
 
@@ -148,143 +149,38 @@ int stringmatchlen(const char* pattern,
   return 0;
 }
 
-int64_t bitPos(const void* s, size_t count, uint32_t bit) {
-  unsigned long* l;  // NOLINT:runtime/int
-  unsigned char* c;
-  unsigned long skipval, word = 0, one;  // NOLINT:runtime/int
-  /* Position of bit, to return to the caller. */
-  long pos = 0;     // NOLINT:runtime/int
-  unsigned long j;  // NOLINT:runtime/int
-
-  /* Process whole words first, seeking for first word that is not
-   * all ones or all zeros respectively if we are lookig for zeros
-   * or ones. This is much faster with large strings having contiguous
-   * blocks of 1 or 0 bits compared to the vanilla bit per bit processing.
-   *
-   * Note that if we start from an address that is not aligned
-   * to sizeof(unsigned long) we consume it byte by byte until it is
-   * aligned. */
-
-  /* Skip initial bits not aligned to sizeof(unsigned long) byte by byte. */
-  skipval = bit ? 0 : UCHAR_MAX;
-  c = (unsigned char*)s;
-  while ((unsigned long)c & (sizeof(*l) - 1) && count) {  // NOLINT:runtime/int
-    if (*c != skipval)
-      break;
-    c++;
-    count--;
-    pos += 8;
-  }
-
-  /* Skip bits with full word step. */
-  skipval = bit ? 0 : ULONG_MAX;
-  l = (unsigned long*)c;  // NOLINT:runtime/int
-  while (count >= sizeof(*l)) {
-    if (*l != skipval)
-      break;
-    l++;
-    count -= sizeof(*l);
-    pos += sizeof(*l) * 8;
-  }
-
-  /* Load bytes into "word" considering the first byte as the most significant
-   * (we basically consider it as written in big endian, since we consider the
-   * string as a set of bits from left to right, with the first bit at
-   * position zero.
-   *
-   * Note that the loading is designed to work even when the bytes left
-   * (count) are less than a full word. We pad it with zero on the right. */
-  c = (unsigned char*)l;
-  for (j = 0; j < sizeof(*l); j++) {
-    word <<= 8;
-    if (count) {
-      word |= *c;
-      c++;
-      count--;
+/* The literal prefix of a glob-style pattern, all the strings matched by
+ * stringmatchlen(nocase = 0) start with it. */
+std::string stringmatchprefix(const char* pattern, int patternLen) {
+  std::string prefix;
+  while (patternLen) {
+    switch (pattern[0]) {
+      case '*':
+      case '?':
+      case '[':
+        return prefix;
+      case '\\':
+        if (patternLen >= 2) {
+          pattern++;
+          patternLen--;
+        }
+        /* fall through */
+      default:
+        prefix.push_back(pattern[0]);
+        break;
     }
+    pattern++;
+    patternLen--;
   }
+  return prefix;
+}
 
-  /* Special case:
-   * If bits in the string are all zero and we are looking for one,
-   * return -1 to signal that there is not a single "1" in the whole
-   * string. This can't happen when we are looking for "0" as we assume
-   * that the right of the string is zero padded. */
-  if (bit == 1 && word == 0)
-    return -1;
-
-  /* Last word left, scan bit by bit. The first thing we need is to
-   * have a single "1" set in the most significant position in an
-   * unsigned long. We don't know the size of the long so we use a
-   * simple trick. */
-  one = ULONG_MAX; /* All bits set to 1.*/
-  one >>= 1;       /* All bits set to 1 but the MSB. */
-  one = ~one;      /* All bits set to 0 but the MSB. */
-
-  while (one) {
-    if (((one & word) != 0) == bit)
-      return pos;
-    pos++;
-    one >>= 1;
-  }
-
-  /* If we reached this point, there is a bug in the algorithm, since
-   * the case of no match is handled as a special case before. */
-  INVARIANT_D(0);
-  return 0; /* Just to avoid warnings. */
+int64_t bitPos(const void* s, size_t count, uint32_t bit) {
+  return bitops::bitPos(s, count, bit);
 }
 
 size_t popCount(const void* s, long count) {  // (NOLINT)
-  size_t bits = 0;
-  const unsigned char* p = static_cast<const unsigned char*>(s);
-  uint32_t* p4;
-  static const unsigned char bitsinbyte[256] = {
-    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4,
-    2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4,
-    2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6,
-    4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5,
-    3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6,
-    4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8};  // (NOLINT)
-
-  /* Count initial bytes not aligned to 32 bit. */
-  while ((unsigned long)p & 3 && count) {  // (NOLINT)
-    bits += bitsinbyte[*p++];
-    count--;
-  }
-
-  /* Count bits 16 bytes at a time */
-  p4 = (uint32_t*)p;     // (NOLINT)
-  while (count >= 16) {  // (NOLINT)
-    uint32_t aux1, aux2, aux3, aux4;
-
-    aux1 = *p4++;
-    aux2 = *p4++;
-    aux3 = *p4++;
-    aux4 = *p4++;
-    count -= 16;
-
-    aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
-    aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
-    aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
-    aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
-    aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
-    aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
-    aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
-    aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
-    bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
-      ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
-      ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
-      ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
-  }
-  /* Count the remaining bytes. */
-  p = (unsigned char*)p4;
-  while (count--)
-    bits += bitsinbyte[*p++];  // (NOLINT)
-  return bits;
+  return bitops::popCount(s, count);
 }
 
 int64_t bitPos(const std::string& fragment,
@@ -1021,6 +917,9 @@ int getCommandFlags(const char* sflags) {
       case 'c':
         flags |= CMD_ALLOW_CROSS_SLOT;
         break;
+      case 'i':
+        flags |= CMD_INLINE;
+        break;
       default:
         INVARIANT_D(0);
         break;
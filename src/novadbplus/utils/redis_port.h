@@ -77,6 +77,9 @@ int random();
 #define CMD_ALLOW_CROSS_SLOT                      \
   (1 << 16) /* 'c' flag, allow cmd key cross slot \
              */
+#define CMD_INLINE                                      \
+  (1 << 17) /* 'i' flag, a single-key read of the key's \
+               meta only, can run on the io thread */
 
 #define CMD_MASK 0x7FFFFFFF  // enough for 31 CMD_* marco.
 
@@ -165,6 +168,7 @@ int stringmatchlen(const char* pattern,
                    const char* string,
                    int stringLen,
                    int nocase);
+std::string stringmatchprefix(const char* pattern, int patternLen);
 unsigned int keyHashSlot(const char* key, size_t keylen);
 unsigned int keyHashTwemproxy(const std::string& key);
 
@@ -330,6 +334,8 @@ int hllAdd(hllhdr* hdr,
            size_t elesize);
 uint64_t hllCount(struct hllhdr* hdr, size_t hdrSize, int* invalid);
 uint64_t hllCountFast(struct hllhdr* hdr, size_t hdrSize, int* invalid);
+// return false if the cached cardinality is invalid
+bool hllGetCachedCount(const struct hllhdr* hdr, uint64_t* card);
 int hllMerge(uint8_t* max, struct hllhdr* hdr, size_t hdrSize);
 int hllSparseToDense(struct hllhdr* oldhdr,
                      size_t oldSize,
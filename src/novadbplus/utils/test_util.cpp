@@ -288,6 +288,10 @@ void compareData(const std::shared_ptr<ServerEntry>& master,
       INVARIANT(exptRcd1.ok());
 
       auto masterKey = exptRcd1.value().getRecordKey();
+      // the key counters are maintained by each node itself
+      if (masterKey.getChunkId() == KEYCOUNT_CHUNKID) {
+        continue;
+      }
       if (isExpired(kvstore1, masterKey, exptRcd1.value().getRecordValue())) {
         continue;
       }
@@ -350,6 +354,9 @@ void compareData(const std::shared_ptr<ServerEntry>& master,
       INVARIANT(exptRcd2.ok());
 
       auto slaveKey = exptRcd2.value().getRecordKey();
+      if (slaveKey.getChunkId() == KEYCOUNT_CHUNKID) {
+        continue;
+      }
       if (isExpired(kvstore2, slaveKey, exptRcd2.value().getRecordValue())) {
         continue;
       }
@@ -3489,6 +3496,7 @@ void NoSchedNetSession::setArgsFromAof(const std::string& cmd) {
   _args.clear();
   std::copy(cmd.begin(), cmd.end(), std::back_inserter(_queryBuf));
   _queryBufPos = _queryBuf.size();
+  _queryBufStart = 0;
   processMultibulkBuffer();
 
   INVARIANT_D(_args.size() > 0);
@@ -3498,7 +3506,12 @@ std::vector<std::string> NoSchedNetSession::getResponse() {
   std::lock_guard<std::mutex> lk(_mutex);
   std::vector<std::string> ret;
   // be careful, mulit response will return a string
-  ret.emplace_back(std::string(_sendBufferBack.data(), _sendBufferBack.size()));
+  std::string rsp;
+  rsp.reserve(_sendBufferBackBytes);
+  for (const auto& chunk : _sendBufferBack) {
+    rsp.append(chunk);
+  }
+  ret.emplace_back(std::move(rsp));
 
   return ret;
 }
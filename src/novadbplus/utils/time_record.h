@@ -7,16 +7,23 @@
 
 namespace novadbplus {
 
+// NOTE: the per-session records are kept when novadb-latency-limit is set,
+// the process wide histograms when latency-tracking is on.
 #define novadb_LOCK_LATENCY_RECORD(PROC, SESS, NAME, TYPE)                    \
-  if (gParams && gParams->novadbLatencyLimit == 0) {                          \
+  if (gParams && gParams->novadbLatencyLimit == 0 &&                          \
+      !gParams->latencyTracking) {                                            \
     (PROC);                                                                   \
   } else {                                                                    \
     auto timsStart = usSinceEpoch();                                          \
     (PROC);                                                                   \
     auto usSpend = usSinceEpoch() - timsStart;                                \
-    if (SESS) {                                                               \
+    if (!gParams || gParams->latencyTracking) {                               \
+      lockLatencyHistogram(TYPE).record(usSpend);                             \
+    }                                                                         \
+    auto usLimit = gParams ? gParams->novadbLatencyLimit : 100000;            \
+    if (usLimit != 0 && (SESS)) {                                             \
       (SESS)->getCtx()->addLockRecord(usSpend, (NAME), (TYPE));               \
-    } else if (usSpend >= (gParams ? gParams->novadbLatencyLimit : 100000)) { \
+    } else if (usLimit != 0 && usSpend >= usLimit) {                          \
       LOG(WARNING) << "latency too long acquire lock, start ts(us):"          \
                    << timsStart << " latency(us):" << usSpend                 \
                    << " lock type:" << LLTToString[TYPE]                      \
@@ -26,16 +33,21 @@ namespace novadbplus {
   }
 
 #define novadb_ROCKSDB_LATENCY_RECORD(PROC, RWSIZE, TYPE)                      \
-  if (gParams && gParams->novadbLatencyLimit == 0) {                           \
+  if (gParams && gParams->novadbLatencyLimit == 0 &&                           \
+      !gParams->latencyTracking) {                                             \
     return (PROC);                                                             \
   }                                                                            \
   auto timsStart = usSinceEpoch();                                             \
   auto status = (PROC);                                                        \
   auto usSpend = usSinceEpoch() - timsStart;                                   \
-  if (_session) {                                                              \
+  if (!gParams || gParams->latencyTracking) {                                  \
+    rocksdbLatencyHistogram(TYPE).record(usSpend);                             \
+  }                                                                            \
+  auto usLimit = gParams ? gParams->novadbLatencyLimit : 100000;               \
+  if (usLimit != 0 && (_session)) {                                            \
     _session->getCtx()->addRocksdbRecord(                                      \
       usSpend, status.ok(), (RWSIZE), (TYPE));                                 \
-  } else if (usSpend >= (gParams ? gParams->novadbLatencyLimit : 100000)) {    \
+  } else if (usLimit != 0 && usSpend >= usLimit) {                             \
     LOG(WARNING) << "latency too long rocksdb r/w, start ts(us):" << timsStart \
                  << " latency(us):" << usSpend                                 \
                  << " op type:" << RLTToString[TYPE]                           \
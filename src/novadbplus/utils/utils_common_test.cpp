@@ -19,9 +19,11 @@
 
 #include "novadbplus/cluster/cluster_manager.h"
 #include "novadbplus/utils/base64.h"
+#include "novadbplus/utils/bitops.h"
 #include "novadbplus/utils/cursor_map.h"
 #include "novadbplus/utils/file.h"
 #include "novadbplus/utils/param_manager.h"
+#include "novadbplus/utils/redis_port.h"
 #include "novadbplus/utils/string.h"
 #include "novadbplus/utils/test_util.h"
 #include "novadbplus/utils/time.h"
@@ -590,4 +592,118 @@ TEST(string, trimString) {
             std::string("\r\tasdaweqwqewqeqw"));
 }
 
+TEST(redis_port, stringmatchprefix) {
+  auto prefix = [](const std::string& pattern) {
+    return redis_port::stringmatchprefix(pattern.c_str(), pattern.size());
+  };
+  EXPECT_EQ(prefix(""), "");
+  EXPECT_EQ(prefix("*"), "");
+  EXPECT_EQ(prefix("user:123:*"), "user:123:");
+  EXPECT_EQ(prefix("user:?:*"), "user:");
+  EXPECT_EQ(prefix("user:[ab]*"), "user:");
+  EXPECT_EQ(prefix("user\\*:*"), "user*:");
+  EXPECT_EQ(prefix("literal"), "literal");
+  EXPECT_EQ(prefix("tail\\"), "tail\\");
+
+  // all the strings matched start with the prefix
+  std::vector<std::pair<std::string, std::string>> cases = {
+    {"user:123:*", "user:123:abc"},
+    {"user\\*:*", "user*:1"},
+    {"a?c*", "abcd"},
+  };
+  for (const auto& c : cases) {
+    EXPECT_TRUE(redis_port::stringmatchlen(
+      c.first.c_str(), c.first.size(), c.second.c_str(), c.second.size(), 0));
+    EXPECT_EQ(c.second.compare(0, prefix(c.first).size(), prefix(c.first)), 0);
+  }
+}
+
+TEST(bitops, kernels) {
+  auto refPopCount = [](const std::string& s) {
+    size_t bits = 0;
+    for (unsigned char c : s) {
+      bits += std::bitset<8>(c).count();
+    }
+    return bits;
+  };
+  auto refBitPos = [](const std::string& s, uint32_t bit) -> int64_t {
+    for (size_t i = 0; i < s.size() * 8; i++) {
+      if (((static_cast<unsigned char>(s[i / 8]) >> (7 - i % 8)) & 1) == bit) {
+        return i;
+      }
+    }
+    return bit ? -1 : static_cast<int64_t>(s.size() * 8);
+  };
+  auto refBitop = [](bitops::Op op,
+                     const std::vector<std::string>& srcs,
+                     size_t maxLen) {
+    std::string result(maxLen, 0);
+    for (size_t i = 0; i < maxLen; ++i) {
+      unsigned char output = srcs[0].size() <= i ? 0 : srcs[0][i];
+      if (op == bitops::Op::NOT) {
+        output = ~output;
+      }
+      for (size_t j = 1; j < srcs.size(); ++j) {
+        unsigned char byte = srcs[j].size() <= i ? 0 : srcs[j][i];
+        if (op == bitops::Op::AND) {
+          output &= byte;
+        } else if (op == bitops::Op::OR) {
+          output |= byte;
+        } else {
+          output ^= byte;
+        }
+      }
+      result[i] = output;
+    }
+    return result;
+  };
+
+  std::mt19937 gen(0);
+  auto isa = bitops::getIsa();
+  for (auto testIsa :
+       {bitops::Isa::SCALAR, bitops::Isa::AVX2, bitops::Isa::AVX512}) {
+    if (!bitops::setIsa(testIsa)) {
+      continue;
+    }
+    LOG(INFO) << "test bitops with " << bitops::isaName(testIsa);
+    for (size_t len : {0, 1, 7, 8, 31, 32, 33, 63, 64, 65, 200, 1000, 4099}) {
+      std::vector<std::string> srcs;
+      for (size_t j = 0; j < 3; j++) {
+        std::string s(len + j * 5, 0);
+        for (auto& c : s) {
+          c = static_cast<char>(gen());
+        }
+        srcs.emplace_back(s);
+      }
+      std::string zeros(len, 0);
+      std::string ones(len, static_cast<char>(0xff));
+      if (len) {
+        // a single bit at the tail behind long runs of 0 or 1
+        zeros[len - 1] = 0x10;
+        ones[len - 1] = static_cast<char>(0xfd);
+      }
+      for (auto& s : {srcs[0], zeros, ones}) {
+        // unaligned starts
+        for (size_t off = 0; off < std::min<size_t>(len, 3); off++) {
+          std::string sub = s.substr(off);
+          EXPECT_EQ(bitops::popCount(s.data() + off, sub.size()),
+                    refPopCount(sub));
+          EXPECT_EQ(bitops::bitPos(s.data() + off, sub.size(), 0),
+                    refBitPos(sub, 0));
+          EXPECT_EQ(bitops::bitPos(s.data() + off, sub.size(), 1),
+                    refBitPos(sub, 1));
+        }
+      }
+      size_t maxLen = len + 10;
+      for (auto op : {bitops::Op::AND, bitops::Op::OR, bitops::Op::XOR}) {
+        EXPECT_EQ(bitops::bitop(op, srcs, maxLen), refBitop(op, srcs, maxLen));
+      }
+      std::vector<std::string> single{srcs[1]};
+      EXPECT_EQ(bitops::bitop(bitops::Op::NOT, single, srcs[1].size()),
+                refBitop(bitops::Op::NOT, single, srcs[1].size()));
+    }
+  }
+  EXPECT_TRUE(bitops::setIsa(isa));
+}
+
 }  // namespace novadbplus
@@ -169,4 +169,18 @@ start_server {tags {"hll"}} {
     #    r pfadd hll 1 2 3
     #    assert {[r getrange hll 15 15] eq "\x80"}
     #}
+
+    test {PFMERGE caches the cardinality and PFADD invalidates it} {
+        r del hll hll1
+        r pfadd hll1 a b c
+        assert {[r getrange hll1 15 15] eq "\x80"}
+        r pfmerge hll hll1
+        assert {[r getrange hll 15 15] eq "\x00"}
+        assert {[r pfcount hll] == 3}
+        r pfadd hll a b c
+        assert {[r getrange hll 15 15] eq "\x00"}
+        r pfadd hll 1 2 3
+        assert {[r getrange hll 15 15] eq "\x80"}
+        r pfcount hll
+    } {6}
 }
@@ -1069,5 +1069,41 @@ start_server {tags {"zset"}} {
             assert_equal {} [r zrangebylex salary - + limit 2000 100]
             assert_equal {} [r zrangebylex salary - + limit 4000 100]
         }
+
+        test "ZCONVERT needs versioned-keys" {
+            r del zconv
+            r zadd zconv 1 m1
+            assert_error "*versioned keys disabled*" {r zconvert zconv}
+        }
+    }
+}
+
+start_server {tags {"zset"} overrides {versioned-keys yes}} {
+    test "ZCONVERT between skiplist and ordered encoding" {
+        # more members than a convert batch
+        r del zconv
+        for {set i 0} {$i < 2500} {incr i} {
+            r zadd zconv [expr {$i % 17}] m$i
+        }
+        set expected [r zrange zconv 0 -1 withscores]
+        set count [r zcount zconv 3 (9]
+        set rank [r zrank zconv m1]
+
+        r config set zset-encoding ordered
+        assert_equal 1 [r zconvert zconv]
+        assert_equal 0 [r zconvert zconv]
+        assert_equal ordered [r object encoding zconv]
+        assert_equal $expected [r zrange zconv 0 -1 withscores]
+        assert_equal $count [r zcount zconv 3 (9]
+        assert_equal $rank [r zrank zconv m1]
+        r zadd zconv 100 m2500
+        r zrem zconv m0
+
+        r config set zset-encoding skiplist
+        assert_equal 1 [r zconvert zconv]
+        assert_equal skiplist [r object encoding zconv]
+        assert_equal {m2500 100} [r zrevrange zconv 0 0 withscores]
+        assert_equal 2500 [r zcard zconv]
+        assert_equal 0 [r zconvert nokey]
     }
 }